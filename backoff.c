@@ -0,0 +1,18 @@
+#include "backoff.h"
+
+#include "settings.h"
+
+uint32_t backoff_first_delay(uint32_t random)
+{
+	return random % SUBSCRIPTION_BROADCAST_INTERVAL_MIN;
+}
+
+uint32_t backoff_next_delay(uint32_t *p_interval, uint32_t random)
+{
+	uint32_t interval = *p_interval * 2;
+	if (interval > SUBSCRIPTION_BROADCAST_INTERVAL_MAX)
+		interval = SUBSCRIPTION_BROADCAST_INTERVAL_MAX;
+	*p_interval = interval;
+
+	return interval / 2 + random % interval;
+}
@@ -0,0 +1,19 @@
+#ifndef BACKOFF_H__
+#define BACKOFF_H__
+
+#include <stdint.h>
+
+/**@brief Randomised exponential backoff of the /up broadcast.
+ *
+ * @details The interval doubles after every broadcast up to SUBSCRIPTION_BROADCAST_INTERVAL_MAX and the
+ *          next broadcast is drawn uniformly from [interval/2, 1.5*interval], so nodes that rebooted
+ *          together drift apart instead of colliding in the same slots.
+ */
+
+/**@brief Delay of the first broadcast after boot, random within the first interval. */
+uint32_t backoff_first_delay(uint32_t random);
+
+/**@brief Doubles the interval, clamped to the maximum, and returns the delay of the next broadcast. */
+uint32_t backoff_next_delay(uint32_t *p_interval, uint32_t random);
+
+#endif /* BACKOFF_H__ */
@@ -0,0 +1,460 @@
+#include "coap_payload.h"
+
+#include "hal.h"
+#include "settings.h"
+
+#include "tinycbor/cbor.h"
+
+/**@brief Reads a sensor key: a one-character name, a long name or a sensor index.
+ *
+ * @details Advances p_value past the key. *p_sensor_index is -1 for an unknown sensor.
+ */
+static CborError sensor_key_parse(CborValue *p_value, int16_t *p_sensor_index, bool *p_is_index)
+{
+	CborError cborError;
+
+	*p_sensor_index = -1;
+	*p_is_index = false;
+
+	if (cbor_value_is_unsigned_integer(p_value)) {
+		uint64_t index;
+		cborError = cbor_value_get_uint64(p_value, &index);
+		if (cborError != CborNoError)
+			return cborError;
+		if (index < SENSORS_COUNT)
+			*p_sensor_index = (int16_t)index;
+		*p_is_index = true;
+		return cbor_value_advance_fixed(p_value);
+	}
+
+	if (cbor_value_get_type(p_value) != CborTextStringType)
+		return CborErrorIllegalType;
+
+	char key[SENSOR_LONG_NAME_MAX + 1];
+	size_t keyLen = sizeof(key);
+	CborValue next;
+	cborError = cbor_value_copy_text_string(p_value, key, &keyLen, &next);
+	if (cborError == CborErrorOutOfMemory)
+		return cbor_value_advance(p_value);
+	if (cborError != CborNoError)
+		return cborError;
+	*p_value = next;
+
+	if (keyLen == 1)
+		*p_sensor_index = get_sensor_index(key[0]);
+	else
+		*p_sensor_index = get_sensor_index_by_long_name(key, keyLen);
+
+	return CborNoError;
+}
+
+/**@brief Reads a one-character key of a fixed-layout map, false for anything else. */
+static bool short_key_parse(CborValue *p_value, char *p_key)
+{
+	if (cbor_value_get_type(p_value) != CborTextStringType)
+		return false;
+
+	char key[2];
+	size_t keyLen = sizeof(key);
+	CborValue next;
+	if (cbor_value_copy_text_string(p_value, key, &keyLen, &next) != CborNoError || keyLen != 1)
+		return false;
+
+	*p_value = next;
+	*p_key = key[0];
+
+	return !cbor_value_at_end(p_value);
+}
+
+static bool map_enter(const uint8_t *p_payload, size_t payload_size, CborParser *p_parser, CborValue *p_it, CborValue *p_recursed)
+{
+	if (cbor_parser_init(p_payload, payload_size, 0, p_parser, p_it) != CborNoError)
+		return false;
+
+	if (cbor_value_at_end(p_it) || cbor_value_get_type(p_it) != CborMapType)
+		return false;
+
+	return cbor_value_enter_container(p_it, p_recursed) == CborNoError;
+}
+
+bool coap_payload_set_parse(const uint8_t *p_payload, size_t payload_size, set_request *p_request)
+{
+	CborParser parser;
+	CborValue it;
+	CborValue recursed;
+	if (!map_enter(p_payload, payload_size, &parser, &it, &recursed))
+		return false;
+
+	p_request->count = 0;
+	p_request->start_present = false;
+
+	while (!cbor_value_at_end(&recursed)) {
+		bool is_start = false;
+		if (cbor_value_is_text_string(&recursed) && cbor_value_text_string_equals(&recursed, "@", &is_start) != CborNoError)
+			return false;
+
+		if (is_start) {
+			// a network time in milliseconds, the full uint32 range rather than a sensor value
+			if (cbor_value_advance(&recursed) != CborNoError || !cbor_value_is_unsigned_integer(&recursed))
+				return false;
+			uint64_t network_time;
+			if (cbor_value_get_uint64(&recursed, &network_time) != CborNoError || network_time > UINT32_MAX)
+				return false;
+			if (cbor_value_advance_fixed(&recursed) != CborNoError)
+				return false;
+
+			p_request->start = (uint32_t)network_time;
+			p_request->start_present = true;
+			continue;
+		}
+
+		int16_t sensor_index;
+		bool is_index;
+		if (sensor_key_parse(&recursed, &sensor_index, &is_index) != CborNoError)
+			return false;
+
+		if (cbor_value_get_type(&recursed) != CborIntegerType)
+			return false;
+		int64_t val;
+		if (cbor_value_get_int64_checked(&recursed, &val) != CborNoError)
+			return false;
+		if (val < INT32_MIN || val > INT32_MAX)
+			return false;
+		if (cbor_value_advance_fixed(&recursed) != CborNoError)
+			return false;
+
+		if (sensor_index == -1 || (SENSORS_READ_ONLY_MASK & SENSOR_MASK(sensor_index)) != 0)
+			continue;
+
+		if (p_request->count >= SET_REQUEST_ITEMS_MAX)
+			return false;
+
+		set_request_item *p_item = &p_request->items[p_request->count++];
+		p_item->sensor_index = sensor_index;
+		p_item->is_index = is_index;
+		p_item->value = (int32_t)val;
+	}
+
+	return true;
+}
+
+size_t coap_payload_set_response_encode(const set_request *p_request, uint8_t *p_buffer, size_t buffer_size)
+{
+	CborEncoder encoder;
+	cbor_encoder_init(&encoder, p_buffer, buffer_size, 0);
+
+	CborEncoder encoderMap;
+	if (cbor_encoder_create_map(&encoder, &encoderMap, CborIndefiniteLength) != CborNoError)
+		return 0;
+
+	for (int i = 0; i < p_request->count; i++) {
+		const set_request_item *p_item = &p_request->items[i];
+		// the response names the sensor the same way the request did
+		if (p_item->is_index) {
+			cbor_encode_uint(&encoderMap, p_item->sensor_index);
+		} else {
+			char key[2] = {sensor_descriptors[p_item->sensor_index].sensor_name, 0};
+			cbor_encode_text_stringz(&encoderMap, key);
+		}
+		cbor_encode_int(&encoderMap, p_item->value);
+	}
+
+	if (cbor_encoder_close_container(&encoder, &encoderMap) != CborNoError)
+		return 0;
+
+	return cbor_encoder_get_buffer_size(&encoder, p_buffer);
+}
+
+bool coap_payload_get_parse(const uint8_t *p_payload, size_t payload_size, sensor_mask_t *p_sensors)
+{
+	CborParser parser;
+	CborValue it;
+	if (cbor_parser_init(p_payload, payload_size, 0, &parser, &it) != CborNoError)
+		return false;
+
+	if (cbor_value_at_end(&it) || cbor_value_get_type(&it) != CborArrayType)
+		return false;
+
+	CborValue recursed;
+	if (cbor_value_enter_container(&it, &recursed) != CborNoError)
+		return false;
+
+	sensor_mask_t selected = 0;
+	bool keys_present = false;
+
+	while (!cbor_value_at_end(&recursed)) {
+		keys_present = true;
+
+		if (cbor_value_get_type(&recursed) == CborByteStringType) {
+			// the compact form, a bitmap of sensor indices, index 0 in bit 0 of the first byte
+			uint8_t bitmap[sizeof(sensor_mask_t)];
+			size_t bitmap_size = sizeof(bitmap);
+			if (cbor_value_copy_byte_string(&recursed, bitmap, &bitmap_size, &recursed) != CborNoError)
+				return false;
+
+			for (size_t i = 0; i < bitmap_size; i++)
+				selected |= (sensor_mask_t)bitmap[i] << (i * 8);
+			continue;
+		}
+
+		if (cbor_value_is_unsigned_integer(&recursed)) {
+			// a sensor index, the same as the integer keys of /set and /sub
+			uint64_t sensor_index;
+			if (cbor_value_get_uint64(&recursed, &sensor_index) != CborNoError)
+				return false;
+			if (sensor_index < SENSORS_COUNT)
+				selected |= SENSOR_MASK(sensor_index);
+
+			if (cbor_value_advance_fixed(&recursed) != CborNoError)
+				return false;
+			continue;
+		}
+
+		if (cbor_value_get_type(&recursed) != CborTextStringType)
+			return false;
+
+		char key[SENSOR_LONG_NAME_MAX + 1];
+		size_t keyLen = sizeof(key);
+		CborValue next = recursed;
+		CborError cborError = cbor_value_copy_text_string(&recursed, key, &keyLen, &next);
+		if (cborError == CborErrorOutOfMemory) {
+			// longer than any sensor name
+			if (cbor_value_advance(&recursed) != CborNoError)
+				return false;
+			continue;
+		}
+		if (cborError != CborNoError)
+			return false;
+		recursed = next;
+
+		if (keyLen == 1 && key[0] == '*') {
+			selected = SENSORS_ALL_MASK;
+			continue;
+		}
+
+		int16_t sensor_index = keyLen == 1 ? get_sensor_index(key[0]) : get_sensor_index_by_long_name(key, keyLen);
+		if (sensor_index == -1)
+			continue;
+
+		selected |= SENSOR_MASK(sensor_index);
+	}
+
+	if (!keys_present)
+		selected = SENSORS_ALL_MASK;
+
+	*p_sensors = selected & SENSORS_ALL_MASK;
+
+	return true;
+}
+
+static bool sub_sensor_parse(CborValue *p_value, sub_request_item *p_item)
+{
+	if (cbor_value_get_type(p_value) != CborMapType)
+		return false;
+
+	CborValue recursed;
+	if (cbor_value_enter_container(p_value, &recursed) != CborNoError)
+		return false;
+
+	p_item->interval_present = false;
+	p_item->change_present = false;
+
+	while (!cbor_value_at_end(&recursed)) {
+		char key;
+		if (!short_key_parse(&recursed, &key))
+			return false;
+		if (key != 'i' && key != 'r')
+			return false;
+
+		if (cbor_value_get_type(&recursed) != CborIntegerType)
+			return false;
+		int64_t val;
+		if (cbor_value_get_int64_checked(&recursed, &val) != CborNoError)
+			return false;
+		if (val < 0 || val > INT32_MAX)
+			return false;
+		if (cbor_value_advance_fixed(&recursed) != CborNoError)
+			return false;
+
+		if (key == 'i') {
+			p_item->interval_present = true;
+			p_item->interval = (uint32_t)val;
+		} else {
+			p_item->change_present = true;
+			p_item->change = (int32_t)val;
+		}
+	}
+
+	return cbor_value_leave_container(p_value, &recursed) == CborNoError;
+}
+
+bool coap_payload_sub_parse(const uint8_t *p_payload, size_t payload_size, sub_request *p_request)
+{
+	CborParser parser;
+	CborValue it;
+	CborValue recursed;
+	if (!map_enter(p_payload, payload_size, &parser, &it, &recursed))
+		return false;
+
+	p_request->address_present = false;
+	p_request->count = 0;
+
+	while (!cbor_value_at_end(&recursed)) {
+		char key;
+		if (!short_key_parse(&recursed, &key))
+			return false;
+
+		if (key == 'a') {
+			if (cbor_value_get_type(&recursed) != CborByteStringType)
+				return false;
+			size_t addr_size = 0;
+			if (cbor_value_calculate_string_length(&recursed, &addr_size) != CborNoError || addr_size != COAP_PAYLOAD_ADDRESS_SIZE)
+				return false;
+			CborValue next;
+			if (cbor_value_copy_byte_string(&recursed, p_request->address, &addr_size, &next) != CborNoError)
+				return false;
+			recursed = next;
+			p_request->address_present = true;
+		} else if (key == 's') {
+			if (cbor_value_get_type(&recursed) != CborMapType)
+				return false;
+
+			CborValue sensors;
+			if (cbor_value_enter_container(&recursed, &sensors) != CborNoError)
+				return false;
+
+			while (!cbor_value_at_end(&sensors)) {
+				int16_t sensor_index;
+				bool is_index;
+				if (sensor_key_parse(&sensors, &sensor_index, &is_index) != CborNoError)
+					return false;
+				if (sensor_index == -1 || p_request->count >= SUB_REQUEST_ITEMS_MAX)
+					return false;
+
+				sub_request_item *p_item = &p_request->items[p_request->count++];
+				p_item->sensor_index = sensor_index;
+				if (!sub_sensor_parse(&sensors, p_item))
+					return false;
+			}
+
+			if (cbor_value_leave_container(&recursed, &sensors) != CborNoError)
+				return false;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool keyframes_parse(CborValue *p_value, fx_request *p_request)
+{
+	if (cbor_value_get_type(p_value) != CborArrayType)
+		return false;
+
+	CborValue frames;
+	if (cbor_value_enter_container(p_value, &frames) != CborNoError)
+		return false;
+
+	while (!cbor_value_at_end(&frames)) {
+		if (p_request->count >= EFFECT_KEYFRAMES_MAX || cbor_value_get_type(&frames) != CborArrayType)
+			return false;
+
+		effect_keyframe *p_keyframe = &p_request->keyframes[p_request->count];
+
+		CborValue fields;
+		if (cbor_value_enter_container(&frames, &fields) != CborNoError)
+			return false;
+
+		for (int i = 0; i <= HAL_PWM_OUT_CHANNELS; i++) {
+			uint64_t value;
+			if (!cbor_value_is_unsigned_integer(&fields) || cbor_value_get_uint64(&fields, &value) != CborNoError)
+				return false;
+			if (i == 0) {
+				if (value > EFFECT_DURATION_MAX)
+					return false;
+				p_keyframe->time = (uint32_t)value;
+			} else {
+				p_keyframe->values[i - 1] = value > HAL_PWM_OUT_VALUE_MAX ? HAL_PWM_OUT_VALUE_MAX : (uint8_t)value;
+			}
+			if (cbor_value_advance_fixed(&fields) != CborNoError)
+				return false;
+		}
+
+		if (!cbor_value_at_end(&fields))
+			return false;
+
+		if (cbor_value_leave_container(&frames, &fields) != CborNoError)
+			return false;
+
+		p_request->count++;
+	}
+
+	return cbor_value_leave_container(p_value, &frames) == CborNoError;
+}
+
+bool coap_payload_fx_parse(const uint8_t *p_payload, size_t payload_size, fx_request *p_request)
+{
+	CborParser parser;
+	CborValue it;
+	CborValue recursed;
+	if (!map_enter(p_payload, payload_size, &parser, &it, &recursed))
+		return false;
+
+	p_request->count = 0;
+	p_request->loops = 0;
+	p_request->start_present = false;
+
+	while (!cbor_value_at_end(&recursed)) {
+		char key;
+		if (!short_key_parse(&recursed, &key))
+			return false;
+
+		if (key == 'n') {
+			uint64_t loops;
+			if (!cbor_value_is_unsigned_integer(&recursed) || cbor_value_get_uint64(&recursed, &loops) != CborNoError || loops > UINT16_MAX)
+				return false;
+			p_request->loops = (uint16_t)loops;
+			if (cbor_value_advance_fixed(&recursed) != CborNoError)
+				return false;
+		} else if (key == 't') {
+			uint64_t start;
+			if (!cbor_value_is_unsigned_integer(&recursed) || cbor_value_get_uint64(&recursed, &start) != CborNoError || start > UINT32_MAX)
+				return false;
+			p_request->start = (uint32_t)start;
+			p_request->start_present = true;
+			if (cbor_value_advance_fixed(&recursed) != CborNoError)
+				return false;
+		} else if (key == 'k') {
+			if (!keyframes_parse(&recursed, p_request))
+				return false;
+		} else {
+			if (cbor_value_advance(&recursed) != CborNoError)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool coap_payload_timesync_parse(const uint8_t *p_payload, size_t payload_size, uint32_t *p_network_time)
+{
+	CborParser parser;
+	CborValue it;
+	if (cbor_parser_init(p_payload, payload_size, 0, &parser, &it) != CborNoError)
+		return false;
+
+	if (!cbor_value_is_map(&it))
+		return false;
+
+	CborValue value;
+	if (cbor_value_map_find_value(&it, "t", &value) != CborNoError)
+		return false;
+
+	uint64_t network_time;
+	if (!cbor_value_is_unsigned_integer(&value) || cbor_value_get_uint64(&value, &network_time) != CborNoError || network_time > UINT32_MAX)
+		return false;
+
+	*p_network_time = (uint32_t)network_time;
+	return true;
+}
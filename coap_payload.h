@@ -0,0 +1,97 @@
+#ifndef COAP_PAYLOAD_H__
+#define COAP_PAYLOAD_H__
+
+#include "effect.h"
+#include "sensors.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**@brief Decoders for the CBOR payloads of the CoAP requests.
+ *
+ * @details Each decoder only reads the payload and fills in a request, nothing is applied until it returned
+ *          true. The unit depends on tinycbor and the sensor table only, so it also builds on the host for
+ *          the fuzz target in test/.
+ */
+
+#define SET_REQUEST_ITEMS_MAX      SENSORS_COUNT
+#define SUB_REQUEST_ITEMS_MAX      SENSORS_COUNT
+#define SET_RESPONSE_SIZE_MAX      (2 + SET_REQUEST_ITEMS_MAX * 7) // map head and break, 2 byte key and int32 per item
+#define COAP_PAYLOAD_ADDRESS_SIZE  16 // otIp6Address
+
+typedef struct set_request_item
+{
+	int16_t sensor_index;
+	bool is_index; // the request named the sensor by its index, the response does the same
+	int32_t value;
+} set_request_item;
+
+/**@brief /set: {sensor: value, ...}, "@": network time to start the colour transitions at. */
+typedef struct set_request
+{
+	bool start_present;
+	uint32_t start;
+	uint8_t count;
+	set_request_item items[SET_REQUEST_ITEMS_MAX]; // unknown and read-only sensors are left out
+} set_request;
+
+typedef struct sub_request_item
+{
+	int16_t sensor_index;
+	bool interval_present;
+	uint32_t interval; // "i", milliseconds, rounded up to SENSOR_REPORT_INTERVAL_UNIT steps when applied
+	bool change_present;
+	int32_t change;    // "r", reportable change
+} sub_request_item;
+
+/**@brief /sub: {"a": report address, "s": {sensor: {"i": interval, "r": change}, ...}}. */
+typedef struct sub_request
+{
+	bool address_present;
+	uint8_t address[COAP_PAYLOAD_ADDRESS_SIZE];
+	uint8_t count;
+	sub_request_item items[SUB_REQUEST_ITEMS_MAX];
+} sub_request;
+
+/**@brief /fx: {"k": [[time, channel 0, channel 1, ...], ...], "n": loops, "t": start}.
+ *
+ * @details A keyframe holds one value per channel in DIMMER_CHANNELS order. Times are milliseconds from the
+ *          start of the effect, "n" defaults to 0, repeat until stopped.
+ *          "t" is the network time to start at, the effect starts at once without it. A request without
+ *          keyframes stops the running effect.
+ */
+typedef struct fx_request
+{
+	effect_keyframe keyframes[EFFECT_KEYFRAMES_MAX];
+	uint8_t count;
+	uint16_t loops;
+	bool start_present;
+	uint32_t start;
+} fx_request;
+
+bool coap_payload_set_parse(const uint8_t *p_payload, size_t payload_size, set_request *p_request);
+
+/**@brief Encodes the /set response, the applied items echoed back.
+ *
+ * @return The response size, 0 when it does not fit.
+ */
+size_t coap_payload_set_response_encode(const set_request *p_request, uint8_t *p_buffer, size_t buffer_size);
+
+/**@brief Parses a /get request into the set of sensors to return.
+ *
+ * @details The request is an array of sensors: one-character or long names and indices as unsigned
+ *          integers, like the keys of /set and /sub. A byte string selects sensors by a bitmap of their
+ *          indices, index 0 in bit 0 of the first byte. An empty array or the "*" key selects every
+ *          sensor. Unknown sensors are skipped, any other item type fails the request.
+ */
+bool coap_payload_get_parse(const uint8_t *p_payload, size_t payload_size, sensor_mask_t *p_sensors);
+
+bool coap_payload_sub_parse(const uint8_t *p_payload, size_t payload_size, sub_request *p_request);
+
+bool coap_payload_fx_parse(const uint8_t *p_payload, size_t payload_size, fx_request *p_request);
+
+/**@brief Parses a time beacon, {"t": network time}. */
+bool coap_payload_timesync_parse(const uint8_t *p_payload, size_t payload_size, uint32_t *p_network_time);
+
+#endif /* COAP_PAYLOAD_H__ */
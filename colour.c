@@ -0,0 +1,302 @@
+#include "colour.h"
+
+#include "dimmer.h"
+#include "effect.h"
+#include "hal.h"
+#include "sensors.h"
+#include "settings.h"
+
+#include <stdbool.h>
+
+#define COLOUR_MIRED_STEP 25
+
+typedef enum
+{
+	COLOUR_MODE_NONE,
+	COLOUR_MODE_HSV,
+	COLOUR_MODE_CCT,
+	COLOUR_MODE_XY,
+} colour_mode_t;
+
+// the last component of every colour space is the brightness
+typedef struct colour
+{
+	int32_t c[3];
+} colour;
+
+// linear RGB of a black body every COLOUR_MIRED_STEP mired from COLOUR_MIRED_MIN
+static const uint8_t m_cct_lut[][3] = {
+	{255, 243, 255},
+	{255, 225, 199},
+	{255, 198, 157},
+	{255, 176, 124},
+	{255, 157,  97},
+	{255, 141,  76},
+	{255, 128,  58},
+	{255, 116,  44},
+	{255, 106,  32},
+	{255,  97,  23},
+	{255,  88,  16},
+	{255,  81,  10},
+	{255,  75,   6},
+	{255,  69,   3},
+	{255,  64,   1},
+};
+
+_Static_assert(sizeof(m_cct_lut) / sizeof(m_cct_lut[0]) == (COLOUR_MIRED_MAX - COLOUR_MIRED_MIN) / COLOUR_MIRED_STEP + 1,
+	"m_cct_lut does not cover COLOUR_MIRED_MIN-COLOUR_MIRED_MAX");
+
+// XYZ to linear sRGB, Q12
+static const int32_t m_xyz_to_rgb[3][3] = {
+	{ 13273, -6296, -2042 },
+	{ -3969,  7683,   170 },
+	{   228,  -836,  4329 },
+};
+
+static colour_mode_t m_mode = COLOUR_MODE_NONE;
+static colour m_from;
+static colour m_to;
+static colour m_current;
+static uint32_t m_fade_started_at;
+static uint32_t m_fade_time = COLOUR_DEFAULT_FADE_TIME;
+static bool m_fading = false;
+static bool m_start_scheduled = false;
+static uint32_t m_scheduled_start;
+
+// the last accepted input of each colour space, a rejected one is reported as this instead
+static int32_t m_hsv_value = 0;
+static int32_t m_cct_value = 0;
+static int32_t m_xy_value = 0;
+
+static void hsv_to_rgb(const colour *p_hsv, uint16_t *p_rgb)
+{
+	int32_t h = p_hsv->c[0], s = p_hsv->c[1], v = p_hsv->c[2];
+	int32_t sector = h / 60;
+	int32_t f = ((h % 60) * 255) / 60;
+	int32_t p = (v * (255 - s)) / 255;
+	int32_t q = (v * (255 - (s * f) / 255)) / 255;
+	int32_t t = (v * (255 - (s * (255 - f)) / 255)) / 255;
+
+	switch (sector) {
+		case 0:  p_rgb[0] = v; p_rgb[1] = t; p_rgb[2] = p; break;
+		case 1:  p_rgb[0] = q; p_rgb[1] = v; p_rgb[2] = p; break;
+		case 2:  p_rgb[0] = p; p_rgb[1] = v; p_rgb[2] = t; break;
+		case 3:  p_rgb[0] = p; p_rgb[1] = q; p_rgb[2] = v; break;
+		case 4:  p_rgb[0] = t; p_rgb[1] = p; p_rgb[2] = v; break;
+		default: p_rgb[0] = v; p_rgb[1] = p; p_rgb[2] = q; break;
+	}
+}
+
+static void cct_to_rgb(const colour *p_cct, uint16_t *p_rgb)
+{
+	int32_t offset = p_cct->c[0] - COLOUR_MIRED_MIN;
+	int32_t index = offset / COLOUR_MIRED_STEP;
+	int32_t fraction = offset % COLOUR_MIRED_STEP;
+	int32_t last = sizeof(m_cct_lut) / sizeof(m_cct_lut[0]) - 1;
+
+	if (index >= last) {
+		index = last;
+		fraction = 0;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		int32_t value = m_cct_lut[index][i];
+		if (fraction)
+			value += ((m_cct_lut[index + 1][i] - value) * fraction) / COLOUR_MIRED_STEP;
+		p_rgb[i] = (uint16_t)((value * p_cct->c[2]) / 255);
+	}
+}
+
+static void xy_to_rgb(const colour *p_xy, uint16_t *p_rgb)
+{
+	int32_t x = p_xy->c[0], y = p_xy->c[1];
+	int64_t xyz[3] = {
+		((int64_t)x << 12) / y,
+		(int64_t)1 << 12,
+		((int64_t)(1000 - x - y) << 12) / y,
+	};
+
+	int64_t rgb[3];
+	int64_t max = 0;
+	for (int i = 0; i < 3; i++) {
+		rgb[i] = (m_xyz_to_rgb[i][0] * xyz[0] + m_xyz_to_rgb[i][1] * xyz[1] + m_xyz_to_rgb[i][2] * xyz[2]) >> 12;
+		// outside the sRGB gamut, clip to the nearest primary mix
+		if (rgb[i] < 0)
+			rgb[i] = 0;
+		if (rgb[i] > max)
+			max = rgb[i];
+	}
+
+	for (int i = 0; i < 3; i++) {
+		p_rgb[i] = max ? (uint16_t)((rgb[i] * p_xy->c[2]) / max) : 0;
+	}
+}
+
+static void colour_output(void)
+{
+	uint16_t rgbw[4];
+
+	switch (m_mode) {
+		case COLOUR_MODE_HSV: hsv_to_rgb(&m_current, rgbw); break;
+		case COLOUR_MODE_CCT: cct_to_rgb(&m_current, rgbw); break;
+		case COLOUR_MODE_XY:  xy_to_rgb(&m_current, rgbw); break;
+		default:
+			return;
+	}
+
+	// the common part of red, green and blue goes to the white channel
+	uint16_t white = rgbw[0];
+	if (rgbw[1] < white)
+		white = rgbw[1];
+	if (rgbw[2] < white)
+		white = rgbw[2];
+
+	rgbw[0] -= white;
+	rgbw[1] -= white;
+	rgbw[2] -= white;
+	rgbw[3] = white;
+
+	dimmer_channel_set(SENSOR_INDEX(r), rgbw[0]);
+	dimmer_channel_set(SENSOR_INDEX(g), rgbw[1]);
+	dimmer_channel_set(SENSOR_INDEX(b), rgbw[2]);
+	dimmer_channel_set(SENSOR_INDEX(w), rgbw[3]);
+}
+
+static void colour_start(colour_mode_t mode, const colour *p_target)
+{
+	effect_stop();
+
+	if (m_mode == mode) {
+		m_from = m_current;
+	} else {
+		// a different colour space cannot be interpolated, fade in from black instead when the output is off
+		m_from = *p_target;
+		m_from.c[2] = dimmer_output_off() ? 0 : p_target->c[2];
+	}
+
+	m_mode = mode;
+	m_to = *p_target;
+	m_current = m_from;
+	m_fade_started_at = m_start_scheduled ? m_scheduled_start : hal_clock_now();
+	m_fading = true;
+
+	colour_process(hal_clock_now());
+}
+
+void colour_init(void)
+{
+	m_mode = COLOUR_MODE_NONE;
+	m_fading = false;
+	m_start_scheduled = false;
+	m_fade_time = COLOUR_DEFAULT_FADE_TIME;
+	m_hsv_value = 0;
+	m_cct_value = 0;
+	m_xy_value = 0;
+
+	set_sensor_value('f', (int32_t)m_fade_time, false);
+}
+
+void colour_process(uint32_t time_now)
+{
+	if (!m_fading)
+		return;
+
+	// a scheduled transition leaves the channels alone until its start
+	if ((int32_t)(time_now - m_fade_started_at) < 0)
+		return;
+
+	uint32_t elapsed = time_now - m_fade_started_at;
+	if (elapsed >= m_fade_time) {
+		m_current = m_to;
+		m_fading = false;
+	} else {
+		int32_t progress = (int32_t)(((uint64_t)elapsed << 12) / m_fade_time); // Q12
+		for (int i = 0; i < 3; i++) {
+			int32_t delta = m_to.c[i] - m_from.c[i];
+			// hue takes the short way round the circle
+			if (m_mode == COLOUR_MODE_HSV && i == 0) {
+				if (delta > 180)
+					delta -= 360;
+				else if (delta < -180)
+					delta += 360;
+			}
+			m_current.c[i] = m_from.c[i] + ((delta * progress) >> 12);
+		}
+		if (m_mode == COLOUR_MODE_HSV)
+			m_current.c[0] = (m_current.c[0] + 360) % 360;
+	}
+
+	colour_output();
+}
+
+bool colour_is_fading(void)
+{
+	return m_fading;
+}
+
+void colour_cancel(void)
+{
+	m_mode = COLOUR_MODE_NONE;
+	m_fading = false;
+}
+
+void colour_start_time_set(uint32_t start_time)
+{
+	m_start_scheduled = true;
+	m_scheduled_start = start_time;
+}
+
+void colour_start_time_clear(void)
+{
+	m_start_scheduled = false;
+}
+
+void colour_hsv_set(char sensor_name, int32_t sensor_value)
+{
+	colour target = { .c = { (sensor_value >> 16) & 0xFFFF, (sensor_value >> 8) & 0xFF, sensor_value & 0xFF } };
+	if (target.c[0] >= 360) {
+		set_sensor_value(sensor_name, m_hsv_value, false);
+		return;
+	}
+
+	m_hsv_value = (target.c[0] << 16) | (target.c[1] << 8) | target.c[2];
+	set_sensor_value(sensor_name, m_hsv_value, false);
+
+	colour_start(COLOUR_MODE_HSV, &target);
+}
+
+void colour_cct_set(char sensor_name, int32_t sensor_value)
+{
+	colour target = { .c = { (sensor_value >> 8) & 0xFFFF, 0, sensor_value & 0xFF } };
+	if (target.c[0] < COLOUR_MIRED_MIN)
+		target.c[0] = COLOUR_MIRED_MIN;
+	if (target.c[0] > COLOUR_MIRED_MAX)
+		target.c[0] = COLOUR_MIRED_MAX;
+
+	m_cct_value = (target.c[0] << 8) | target.c[2];
+	set_sensor_value(sensor_name, m_cct_value, false);
+
+	colour_start(COLOUR_MODE_CCT, &target);
+}
+
+void colour_xy_set(char sensor_name, int32_t sensor_value)
+{
+	colour target = { .c = { (sensor_value >> 18) & 0x3FF, (sensor_value >> 8) & 0x3FF, sensor_value & 0xFF } };
+	if (target.c[1] == 0 || target.c[0] + target.c[1] > 1000) {
+		set_sensor_value(sensor_name, m_xy_value, false);
+		return;
+	}
+
+	m_xy_value = (target.c[0] << 18) | (target.c[1] << 8) | target.c[2];
+	set_sensor_value(sensor_name, m_xy_value, false);
+
+	colour_start(COLOUR_MODE_XY, &target);
+}
+
+void colour_fade_time_set(char sensor_name, int32_t sensor_value)
+{
+	if (sensor_value < 0)
+		sensor_value = 0;
+	m_fade_time = (uint32_t)sensor_value;
+	set_sensor_value(sensor_name, sensor_value, false);
+}
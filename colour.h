@@ -0,0 +1,39 @@
+#ifndef COLOUR_H__
+#define COLOUR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Colour engine: HSV, colour temperature and CIE xy input mapped to RGBW in fixed point.
+ *
+ * @details The output goes to the channels named r, g, b and w in DIMMER_CHANNELS.
+ *          Each input is one packed sensor value, the low byte is always the brightness:
+ *          'H' hue (0-359) << 16 | saturation (0-255) << 8 | value
+ *          'C' mired (COLOUR_MIRED_MIN-COLOUR_MIRED_MAX) << 8 | brightness
+ *          'x' x (0-1000, 1/1000 units) << 18 | y (0-1000) << 8 | brightness
+ *          A new value fades from the current one over 'f' milliseconds, interpolated in the colour
+ *          space of the input. Writing a raw r, g, b or w value or playing an effect
+ *          cancels the colour engine.
+ */
+
+void colour_init(void);
+
+/**@brief Advances a running fade, called from the PSU control period. */
+void colour_process(uint32_t time_now);
+
+/**@brief Returns true while a fade runs or waits for its scheduled start. */
+bool colour_is_fading(void);
+
+/**@brief Stops the colour engine, the channels keep their current values. */
+void colour_cancel(void);
+
+/**@brief Transitions started until colour_start_time_clear() begin at start_time, local clock, instead of at once. */
+void colour_start_time_set(uint32_t start_time);
+void colour_start_time_clear(void);
+
+void colour_hsv_set(char sensor_name, int32_t sensor_value);
+void colour_cct_set(char sensor_name, int32_t sensor_value);
+void colour_xy_set(char sensor_name, int32_t sensor_value);
+void colour_fade_time_set(char sensor_name, int32_t sensor_value);
+
+#endif /* COLOUR_H__ */
@@ -0,0 +1,354 @@
+#include "dimmer.h"
+
+#include "colour.h"
+#include "effect.h"
+#include "energy.h"
+#include "hal.h"
+#include "psu_hold.h"
+#include "sensors.h"
+#include "settings.h"
+#include "thermal.h"
+
+static bool psu_is_powered_on = false;
+static bool psu_pwm_is_enabled = false;
+static uint32_t psu_power_on_time = 0;
+static bool psu_pending_shutdown = false;
+static uint32_t psu_pending_shutdown_start_time = 0;
+static bool m_outputs_off = true;
+static uint32_t m_outputs_off_since = 0;
+static uint16_t m_led_values_pending[HAL_PWM_OUT_CHANNELS];
+static uint16_t m_led_values_applied[HAL_PWM_OUT_CHANNELS];
+
+#define RAIL_LSB_FROM_MV(mv) ((int32_t)(((mv) * 1000) / ENERGY_RAIL_UV_PER_LSB))
+
+static volatile int32_t m_rail_last = 0; // average of the last ADC buffer
+static volatile uint8_t m_rail_stable_buffers = 0;
+static int32_t m_rail_settled = 0;
+static bool m_soft_start = false;
+static uint32_t m_soft_start_elapsed = 0;
+static uint32_t m_soft_start_checked_at = 0;
+
+static volatile bool m_overcurrent_tripped = false;
+static bool m_overcurrent_reported = false;
+
+static int32_t internal_temp_prev = 0x7FFFFFFF;
+
+static int32_t dc_voltage_12_prev = 0x7FFFFFFF;
+static int32_t dc_voltage_12 = 0;
+static int32_t dc_voltage_3v3_prev = 0x7FFFFFFF;
+static int32_t dc_voltage_3v3 = 0;
+
+static void overcurrent_handler(void)
+{
+	// the PWM was already stopped in hardware, the PSU is switched off from the control loop
+	m_overcurrent_tripped = true;
+}
+
+void dimmer_init(void)
+{
+	psu_is_powered_on = false;
+	psu_pwm_is_enabled = false;
+	psu_pending_shutdown = false;
+	m_outputs_off = true;
+	m_rail_stable_buffers = 0;
+	m_soft_start = false;
+	m_overcurrent_tripped = false;
+	m_overcurrent_reported = false;
+
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		m_led_values_pending[i] = 0;
+		m_led_values_applied[i] = 0;
+	}
+
+	hal_pwm_out_init();
+	hal_pwm_out_mode_set(DIMMER_PWM_MODE_DEFAULT);
+	hal_psu_gpio_init();
+	hal_protection_init(overcurrent_handler);
+
+	set_sensor_value('o', 0, false);
+	set_sensor_value('m', DIMMER_PWM_MODE_DEFAULT, false);
+
+	energy_init();
+	thermal_init();
+	psu_hold_init();
+	colour_init();
+	effect_init();
+}
+
+void dimmer_adc_process(const int16_t *p_samples, uint16_t samples_per_channel)
+{
+	int32_t sums[HAL_ADC_IN_CHANNELS];
+	for (int i = 0; i < HAL_ADC_IN_CHANNELS; i++) {
+		sums[i] = 0;
+		for (int j = 0; j < samples_per_channel; j++) {
+			sums[i] += p_samples[j * HAL_ADC_IN_CHANNELS + i];
+		}
+		sums[i] = sums[i] / samples_per_channel;
+	}
+
+	energy_adc_process(sums[HAL_ADC_IN_RAIL], m_led_values_applied, hal_clock_now());
+
+	// the rail counts as up once it is above the ready level and has stopped moving
+	int32_t rail_change = sums[HAL_ADC_IN_RAIL] - m_rail_last;
+	if (rail_change < 0)
+		rail_change = -rail_change;
+	if (sums[HAL_ADC_IN_RAIL] >= RAIL_LSB_FROM_MV(DIMMER_RAIL_READY_MV) && rail_change <= RAIL_LSB_FROM_MV(DIMMER_RAIL_TOLERANCE_MV)) {
+		if (m_rail_stable_buffers < 0xFF)
+			m_rail_stable_buffers++;
+	} else {
+		m_rail_stable_buffers = 0;
+	}
+	m_rail_last = sums[HAL_ADC_IN_RAIL];
+
+	if (dc_voltage_12_prev == 0x7FFFFFFF) {
+		dc_voltage_12_prev = sums[HAL_ADC_IN_RAIL];
+		dc_voltage_12 = sums[HAL_ADC_IN_RAIL];
+	} else {
+		dc_voltage_12 = (dc_voltage_12_prev + dc_voltage_12_prev + dc_voltage_12_prev + sums[HAL_ADC_IN_RAIL]) >> 2;
+		dc_voltage_12_prev = dc_voltage_12;
+	}
+
+	if (sums[HAL_ADC_IN_VDD] < 0)
+		sums[HAL_ADC_IN_VDD] = 0;
+
+	if (dc_voltage_3v3_prev == 0x7FFFFFFF) {
+		dc_voltage_3v3_prev = sums[HAL_ADC_IN_VDD];
+		dc_voltage_3v3 = sums[HAL_ADC_IN_VDD];
+	} else {
+		dc_voltage_3v3 = (dc_voltage_3v3_prev + dc_voltage_3v3_prev + dc_voltage_3v3_prev + sums[HAL_ADC_IN_VDD]) >> 2;
+		dc_voltage_3v3_prev = dc_voltage_3v3;
+	}
+}
+
+void dimmer_voltage_sensors_update(void)
+{
+	set_sensor_value('v', dc_voltage_3v3, false);
+	set_sensor_value('V', dc_voltage_12, false);
+
+	energy_sensors_update(hal_clock_now());
+}
+
+void dimmer_temperature_process(void)
+{
+	int32_t temp = hal_temp_in_read();
+
+	temp = temp << 2;
+
+	if (internal_temp_prev == 0x7FFFFFFF) {
+		internal_temp_prev = temp;
+	} else {
+		temp = (internal_temp_prev + internal_temp_prev + internal_temp_prev + temp) >> 2;
+		internal_temp_prev = temp;
+
+		set_sensor_value('t', temp >> 2, false);
+
+		thermal_derating_process(temp >> 2);
+	}
+}
+
+static void psu_power_off(void)
+{
+	psu_is_powered_on = false;
+	psu_pending_shutdown = false;
+	psu_pwm_is_enabled = false;
+	m_soft_start = false;
+
+	hal_psu_gpio_set(false);
+
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		m_led_values_applied[i] = 0;
+	}
+
+	set_sensor_value('p', 0, false);
+}
+
+void dimmer_psu_control_process(void)
+{
+	colour_process(hal_clock_now());
+	// an effect starts once the soft-start ramp is done, it does not follow the ramp
+	effect_process(hal_clock_now(), psu_pwm_is_enabled && !m_soft_start);
+
+	// a playing effect keeps the PSU on
+	bool pending_channels_off = !effect_is_playing();
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		if (m_led_values_pending[i]) {
+			pending_channels_off = false;
+			break;
+		}
+	}
+
+	if (m_overcurrent_tripped) {
+		if (!m_overcurrent_reported) {
+			m_overcurrent_reported = true;
+			set_sensor_value('o', 1, false);
+		}
+		effect_stop();
+		if (psu_is_powered_on)
+			psu_power_off();
+
+		// the fault latches until every channel has been switched off
+		if (!pending_channels_off)
+			return;
+
+		m_overcurrent_tripped = false;
+		m_overcurrent_reported = false;
+		hal_protection_rearm();
+		set_sensor_value('o', 0, false);
+	}
+
+	uint32_t now_time = hal_clock_now();
+
+	// the off intervals teach the PSU hold, whether or not the PSU was still on when they ended
+	if (pending_channels_off != m_outputs_off) {
+		m_outputs_off = pending_channels_off;
+		if (m_outputs_off)
+			m_outputs_off_since = now_time;
+		else
+			psu_hold_off_interval_add(now_time - m_outputs_off_since);
+	}
+
+	if (psu_is_powered_on) {
+		if ((!psu_pwm_is_enabled) &&
+			((m_rail_stable_buffers >= DIMMER_RAIL_STABLE_BUFFERS) || (now_time - psu_power_on_time > DIMMER_PSU_ON_TIMEOUT))) {
+			psu_pwm_is_enabled = true;
+			m_rail_settled = m_rail_last;
+			m_soft_start = true;
+			m_soft_start_elapsed = 0;
+			m_soft_start_checked_at = now_time;
+		}
+
+		if (psu_pwm_is_enabled) {
+			uint32_t scale = thermal_scale_get();
+			if (m_soft_start) {
+				// the ramp holds while the load pulls the rail down, a weak PSU gets a slower start
+				if (m_rail_last + RAIL_LSB_FROM_MV(DIMMER_RAIL_SAG_MV) >= m_rail_settled)
+					m_soft_start_elapsed += now_time - m_soft_start_checked_at;
+				m_soft_start_checked_at = now_time;
+
+				if ((m_soft_start_elapsed >= DIMMER_SOFT_START_TIME) || (now_time - psu_power_on_time > DIMMER_PSU_ON_TIMEOUT + DIMMER_SOFT_START_TIME))
+					m_soft_start = false;
+				else
+					scale = (scale * m_soft_start_elapsed) / DIMMER_SOFT_START_TIME;
+			}
+			for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+				uint16_t value = (uint16_t)((m_led_values_pending[i] * scale) >> THERMAL_SCALE_SHIFT);
+				// derating never switches a channel off
+				if (value == 0 && m_led_values_pending[i] != 0)
+					value = 1;
+				hal_pwm_out_set(i, value);
+				m_led_values_applied[i] = value;
+			}
+			// the set values wait in the HAL while the effect streams its own, until the effect
+			// starts they are what the outputs show
+			if (effect_is_streaming())
+				effect_values_get(m_led_values_applied);
+		}
+
+		if (pending_channels_off) {
+			if (!psu_pending_shutdown) {
+				psu_pending_shutdown = true;
+				psu_pending_shutdown_start_time = now_time;
+			}
+			if (now_time - psu_pending_shutdown_start_time > psu_hold_time_get()) {
+				psu_power_off();
+			}
+		} else {
+			psu_pending_shutdown = false;
+		}
+	} else if (!pending_channels_off) {
+		psu_is_powered_on = true;
+		psu_power_on_time = hal_clock_now();
+		m_rail_stable_buffers = 0;
+
+		hal_psu_gpio_set(true);
+
+		set_sensor_value('p', 1, false);
+	}
+}
+
+bool dimmer_psu_starting(void)
+{
+	return psu_is_powered_on && (!psu_pwm_is_enabled || m_soft_start);
+}
+
+bool dimmer_idle(void)
+{
+	// a held PSU counts as idle, its shutdown may come up to one idle period late
+	if (m_overcurrent_tripped || dimmer_psu_starting() || colour_is_fading() || effect_is_playing())
+		return false;
+
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		if (m_led_values_pending[i] || m_led_values_applied[i])
+			return false;
+	}
+	return true;
+}
+
+bool dimmer_output_ready(void)
+{
+	if (psu_pwm_is_enabled)
+		return true;
+
+	if (effect_is_playing())
+		return false;
+
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		if (m_led_values_pending[i])
+			return false;
+	}
+	return true;
+}
+
+bool dimmer_output_off(void)
+{
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		if (m_led_values_applied[i])
+			return false;
+	}
+	return true;
+}
+
+void dimmer_channel_set(uint8_t channel, uint16_t value)
+{
+	if (channel >= HAL_PWM_OUT_CHANNELS)
+		return;
+
+	if (value > HAL_PWM_OUT_VALUE_MAX)
+		value = HAL_PWM_OUT_VALUE_MAX;
+	m_led_values_pending[channel] = value;
+	set_sensor_value(sensor_descriptors[channel].sensor_name, value, false);
+}
+
+void dimmer_channels_set(const uint16_t *p_values)
+{
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		dimmer_channel_set(i, p_values[i]);
+	}
+}
+
+void pwm_set_brightness(char sensor_name, int32_t sensor_value)
+{
+	colour_cancel();
+	effect_stop();
+
+	if (sensor_value < 0)
+		sensor_value = 0;
+	if (sensor_value > HAL_PWM_OUT_VALUE_MAX)
+		sensor_value = HAL_PWM_OUT_VALUE_MAX;
+	set_sensor_value(sensor_name, sensor_value, false);
+
+	int16_t channel = get_sensor_index(sensor_name);
+	if (channel < 0 || channel >= HAL_PWM_OUT_CHANNELS)
+		return;
+
+	m_led_values_pending[channel] = (uint16_t)sensor_value;
+}
+
+void pwm_mode_set(char sensor_name, int32_t sensor_value)
+{
+	if (sensor_value < 0 || sensor_value > (HAL_PWM_OUT_MODE_STAGGERED | HAL_PWM_OUT_MODE_CENTRED))
+		sensor_value = 0;
+
+	hal_pwm_out_mode_set((uint8_t)sensor_value);
+	set_sensor_value(sensor_name, sensor_value, false);
+}
@@ -0,0 +1,46 @@
+#ifndef DIMMER_H__
+#define DIMMER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Dimmer control logic: PSU sequencing, channel values and sensor filtering.
+ *
+ * @details Hardware access goes through hal.h only, timers and scheduling stay with the caller.
+ */
+
+void dimmer_init(void);
+
+/**@brief Filters a buffer of ADC samples. Safe to call from interrupt context. */
+void dimmer_adc_process(const int16_t *p_samples, uint16_t samples_per_channel);
+
+/**@brief Publishes the filtered voltages and the energy totals as sensor values. */
+void dimmer_voltage_sensors_update(void);
+
+void dimmer_temperature_process(void);
+
+void dimmer_psu_control_process(void);
+
+/**@brief Returns true from powering up the PSU until the soft-start ramp ends. The caller samples the
+ *        ADC and runs dimmer_psu_control_process() faster meanwhile, see hal_adc_in_fast_set().
+ */
+bool dimmer_psu_starting(void);
+
+/**@brief Returns true while nothing but a request can change the outputs: no channel is lit or pending and
+ *        no fade, effect or PSU start is running. The caller slows dimmer_psu_control_process() down meanwhile.
+ */
+bool dimmer_idle(void);
+
+/**@brief Returns false while requested channel values wait for the PSU to power up. */
+bool dimmer_output_ready(void);
+
+/**@brief Returns true when no channel is lit. */
+bool dimmer_output_off(void);
+
+/**@brief Sets a channel value and reports it as the channel sensor. */
+void dimmer_channel_set(uint8_t channel, uint16_t value);
+
+/**@brief Sets all HAL_PWM_OUT_CHANNELS channel values at once. */
+void dimmer_channels_set(const uint16_t *p_values);
+
+#endif /* DIMMER_H__ */
@@ -25,6 +25,10 @@ extern "C" {
 #define PSU_12V_SENSE_PIN NRF_GPIO_PIN_MAP(0,28)
 #define PSU_ENABLE_PIN    NRF_GPIO_PIN_MAP(0,2)
 
+// LPCOMP input of an LED current-sense amplifier, enables the hardware overcurrent cutoff. This board
+// has no sense circuit and a floating input trips at random, define it only where one is fitted.
+// #define PROTECTION_SENSE_INPUT NRF_LPCOMP_INPUT_1 // AIN1, P0.03
+
 #define LED_1          LED1_B
 #define LED_2          LED2_R
 #define LED_3          LED2_G
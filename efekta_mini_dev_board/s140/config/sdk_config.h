@@ -279,6 +279,14 @@
 #endif
 
 
+// <q> NRFX_PPI_ENABLED  - nrfx_ppi - PPI peripheral allocator
+
+
+#ifndef NRFX_PPI_ENABLED
+#define NRFX_PPI_ENABLED 1
+#endif
+
+
 // <e> NRFX_PWM_ENABLED - nrfx_pwm - PWM peripheral driver
 //==========================================================
 #ifndef NRFX_PWM_ENABLED
@@ -0,0 +1,229 @@
+#include "effect.h"
+
+#include "colour.h"
+#include "dimmer.h"
+#include "sensors.h"
+#include "settings.h"
+#include "thermal.h"
+
+#include <string.h>
+
+typedef enum
+{
+	EFFECT_IDLE,
+	EFFECT_PLAYING,
+	EFFECT_FINISHED, // holding the last keyframe until effect_process() hands it over to the dimmer
+} effect_state_t;
+
+static effect_keyframe m_keyframes[EFFECT_KEYFRAMES_MAX];
+static uint8_t m_count = 0;
+static uint16_t m_loops;
+static uint16_t m_loops_left;
+static uint8_t m_segment;
+static uint32_t m_position; // microseconds into the current loop
+static uint32_t m_duration; // microseconds
+static volatile effect_state_t m_state = EFFECT_IDLE;
+static bool m_streaming = false;
+static bool m_start_scheduled = false;
+static uint32_t m_scheduled_start;
+static uint16_t m_output[HAL_PWM_OUT_CHANNELS];
+
+static void frame_get(uint16_t *p_values)
+{
+	while (m_segment + 1 < m_count && m_position >= m_keyframes[m_segment + 1].time * 1000) {
+		m_segment++;
+	}
+
+	const effect_keyframe *p_from = &m_keyframes[m_segment];
+	uint32_t start = p_from->time * 1000;
+	// before the first keyframe and after the last one the values are held
+	if (m_segment + 1 >= m_count || m_position <= start) {
+		for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+			p_values[i] = p_from->values[i];
+		}
+		return;
+	}
+
+	const effect_keyframe *p_to = &m_keyframes[m_segment + 1];
+	uint32_t span = p_to->time * 1000 - start;
+	int32_t progress = (int32_t)(((uint64_t)(m_position - start) << 12) / span); // Q12
+
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		int32_t delta = (int32_t)p_to->values[i] - p_from->values[i];
+		p_values[i] = (uint16_t)(p_from->values[i] + ((delta * progress) >> 12));
+	}
+}
+
+static void position_advance(void)
+{
+	m_position += HAL_PWM_OUT_STREAM_STEP_US;
+	if (m_position < m_duration)
+		return;
+
+	if (m_loops == 0 || --m_loops_left > 0) {
+		m_position = m_duration ? m_position % m_duration : 0;
+		m_segment = 0;
+	} else {
+		m_position = m_duration;
+		m_state = EFFECT_FINISHED;
+	}
+}
+
+static void position_skip(uint32_t milliseconds)
+{
+	if (m_duration == 0)
+		return;
+
+	uint64_t position = (uint64_t)milliseconds * 1000;
+	uint64_t loops_done = position / m_duration;
+
+	if (m_loops != 0 && loops_done >= m_loops_left) {
+		m_position = m_duration;
+		m_state = EFFECT_FINISHED;
+		return;
+	}
+
+	m_loops_left -= (uint16_t)loops_done;
+	m_position = (uint32_t)(position % m_duration);
+}
+
+static void stream_fill(uint16_t *p_values, uint16_t steps)
+{
+	uint32_t scale = thermal_scale_get();
+
+	for (uint16_t s = 0; s < steps; s++) {
+		uint16_t *p_step = &p_values[s * HAL_PWM_OUT_CHANNELS];
+
+		frame_get(p_step);
+		if (m_state == EFFECT_PLAYING)
+			position_advance();
+
+		for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+			uint16_t value = (uint16_t)((p_step[i] * scale) >> THERMAL_SCALE_SHIFT);
+			// same rule as the dimmer, derating never switches a channel off
+			if (value == 0 && p_step[i] != 0)
+				value = 1;
+			p_step[i] = value;
+		}
+	}
+
+	memcpy(m_output, &p_values[(steps - 1) * HAL_PWM_OUT_CHANNELS], sizeof(m_output));
+}
+
+static void effect_restart(void)
+{
+	if (m_count == 0)
+		return;
+
+	colour_cancel();
+
+	m_position = 0;
+	m_segment = 0;
+	m_loops_left = m_loops;
+	m_duration = m_keyframes[m_count - 1].time * 1000;
+	m_start_scheduled = false;
+	m_state = EFFECT_PLAYING;
+
+	set_sensor_value('F', 1, false);
+}
+
+void effect_init(void)
+{
+	m_count = 0;
+	m_state = EFFECT_IDLE;
+	m_streaming = false;
+	memset(m_output, 0, sizeof(m_output));
+
+	set_sensor_value('F', 0, false);
+}
+
+bool effect_load(const effect_keyframe *p_keyframes, uint8_t count, uint16_t loops)
+{
+	if (count == 0 || count > EFFECT_KEYFRAMES_MAX)
+		return false;
+
+	for (uint8_t i = 1; i < count; i++) {
+		if (p_keyframes[i].time < p_keyframes[i - 1].time)
+			return false;
+	}
+	if (p_keyframes[count - 1].time > EFFECT_DURATION_MAX)
+		return false;
+
+	// the interrupt must not read the table while it is replaced
+	effect_stop();
+
+	memcpy(m_keyframes, p_keyframes, count * sizeof(effect_keyframe));
+	m_count = count;
+	m_loops = loops;
+
+	effect_restart();
+	return true;
+}
+
+void effect_stop(void)
+{
+	if (m_streaming) {
+		hal_pwm_out_stream_stop();
+		m_streaming = false;
+	}
+
+	m_state = EFFECT_IDLE;
+	set_sensor_value('F', 0, false);
+}
+
+bool effect_is_playing(void)
+{
+	return m_state != EFFECT_IDLE;
+}
+
+bool effect_is_streaming(void)
+{
+	return m_streaming;
+}
+
+void effect_start_time_set(uint32_t start_time)
+{
+	m_start_scheduled = true;
+	m_scheduled_start = start_time;
+}
+
+void effect_process(uint32_t time_now, bool output_enabled)
+{
+	if (m_state == EFFECT_FINISHED) {
+		uint16_t values[HAL_PWM_OUT_CHANNELS];
+		for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+			values[i] = m_keyframes[m_count - 1].values[i];
+		}
+		dimmer_channels_set(values);
+		effect_stop();
+		return;
+	}
+
+	if (m_state == EFFECT_PLAYING && output_enabled && !m_streaming) {
+		if (m_start_scheduled) {
+			int32_t late = (int32_t)(time_now - m_scheduled_start);
+			if (late < 0)
+				return;
+			// a late start catches up, so all nodes play the same frame at the same network time
+			position_skip((uint32_t)late);
+			if (m_state != EFFECT_PLAYING)
+				return;
+		}
+
+		m_streaming = true;
+		hal_pwm_out_stream_start(stream_fill);
+	}
+}
+
+void effect_values_get(uint16_t *p_values)
+{
+	memcpy(p_values, m_output, sizeof(m_output));
+}
+
+void effect_state_set(char sensor_name, int32_t sensor_value)
+{
+	effect_stop();
+
+	if (sensor_value != 0)
+		effect_restart();
+}
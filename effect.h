@@ -0,0 +1,52 @@
+#ifndef EFFECT_H__
+#define EFFECT_H__
+
+#include "hal.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Keyframe effects played by the PWM sequence hardware.
+ *
+ * @details Channel values are interpolated linearly between keyframes into the HAL stream buffers, the
+ *          CPU only wakes up to refill a buffer. The effect repeats a number of times, or until stopped,
+ *          and leaves the channels at the last keyframe. 'F' reports 1 while an effect plays, writing 0
+ *          stops it and 1 plays the loaded effect again. Raw channel and colour writes stop it too.
+ */
+
+typedef struct effect_keyframe
+{
+	uint32_t time; // milliseconds from the start of the effect, non-decreasing
+	uint8_t values[HAL_PWM_OUT_CHANNELS];
+} effect_keyframe;
+
+void effect_init(void);
+
+/**@brief Replaces the loaded effect and plays it, loops 0 repeats it until stopped.
+ *
+ * @return false when the keyframes are out of order, too many or too long.
+ */
+bool effect_load(const effect_keyframe *p_keyframes, uint8_t count, uint16_t loops);
+
+/**@brief Delays the loaded effect to start_time, local clock. A start in the past skips ahead. */
+void effect_start_time_set(uint32_t start_time);
+
+/**@brief Stops the effect, the channels return to their set values. */
+void effect_stop(void);
+
+bool effect_is_playing(void);
+
+/**@brief Starts the stream once the output is enabled and settles a finished effect, called from the PSU control period. */
+void effect_process(uint32_t time_now, bool output_enabled);
+
+/**@brief True while the effect drives the PWM. A scheduled effect that waits for its start does not,
+ *        the set values stay on the outputs until then.
+ */
+bool effect_is_streaming(void);
+
+/**@brief Channel values most recently handed to the PWM, valid while effect_is_streaming(). */
+void effect_values_get(uint16_t *p_values);
+
+void effect_state_set(char sensor_name, int32_t sensor_value);
+
+#endif /* EFFECT_H__ */
@@ -0,0 +1,111 @@
+#include "energy.h"
+
+#include "hal.h"
+#include "sensors.h"
+#include "settings.h"
+
+#include <stdbool.h>
+
+#define ENERGY_UJ_PER_MWH 3600000
+
+typedef struct energy_checkpoint
+{
+	uint32_t energy_mwh;
+	uint32_t energy_mwh_inverted;
+} energy_checkpoint;
+
+#define ENERGY_CHECKPOINTS_PER_PAGE (HAL_NVM_PAGE_SIZE / sizeof(energy_checkpoint))
+
+#define CHANNEL_CURRENT(arg, id, name, lname, pin, instance, current) current,
+
+static const uint16_t m_channel_current_ma[HAL_PWM_OUT_CHANNELS] = { DIMMER_CHANNELS(CHANNEL_CURRENT, _) };
+
+static uint32_t m_energy_mwh = 0;
+static uint32_t m_energy_uj = 0; // remainder below one mWh
+static uint32_t m_power_mw = 0;
+static uint32_t m_last_sample_at = 0;
+static bool m_sampled = false;
+
+static uint32_t m_checkpoint_index = 0;
+static uint32_t m_checkpoint_mwh = 0;
+static uint32_t m_checkpoint_at = 0;
+
+void energy_init(void)
+{
+	m_checkpoint_index = 0;
+
+	// the page is written front to back, the last valid record holds the total
+	for (uint32_t i = 0; i < ENERGY_CHECKPOINTS_PER_PAGE; i++) {
+		energy_checkpoint checkpoint;
+		hal_nvm_read(i * sizeof(energy_checkpoint), &checkpoint, sizeof(checkpoint));
+		if (checkpoint.energy_mwh == 0xFFFFFFFF && checkpoint.energy_mwh_inverted == 0xFFFFFFFF)
+			break;
+		if (checkpoint.energy_mwh == ~checkpoint.energy_mwh_inverted)
+			m_energy_mwh = checkpoint.energy_mwh;
+		m_checkpoint_index = i + 1;
+	}
+
+	m_checkpoint_mwh = m_energy_mwh;
+	m_checkpoint_at = hal_clock_now();
+
+	set_sensor_value('E', (int32_t)m_energy_mwh, false);
+}
+
+void energy_adc_process(int32_t rail_sample, const uint16_t *p_channel_values, uint32_t time_now)
+{
+	if (rail_sample < 0)
+		rail_sample = 0;
+
+	uint32_t rail_mv = ((uint32_t)rail_sample * ENERGY_RAIL_UV_PER_LSB) / 1000;
+
+	uint32_t duty_current = 0; // mA x HAL_PWM_OUT_VALUE_MAX
+	for (int i = 0; i < HAL_PWM_OUT_CHANNELS; i++) {
+		duty_current += (uint32_t)p_channel_values[i] * m_channel_current_ma[i];
+	}
+
+	uint32_t power_mw = (uint32_t)(((uint64_t)rail_mv * duty_current) / (HAL_PWM_OUT_VALUE_MAX * 1000));
+
+	if (m_sampled) {
+		uint32_t elapsed = time_now - m_last_sample_at;
+		if (elapsed > ENERGY_SAMPLE_GAP_MAX)
+			elapsed = ENERGY_SAMPLE_GAP_MAX;
+
+		// trapezoid between the previous and the current buffer, mW x ms = uJ
+		uint64_t energy_uj = m_energy_uj + ((uint64_t)(m_power_mw + power_mw) * elapsed) / 2;
+		m_energy_mwh += (uint32_t)(energy_uj / ENERGY_UJ_PER_MWH);
+		m_energy_uj = (uint32_t)(energy_uj % ENERGY_UJ_PER_MWH);
+	}
+
+	m_power_mw = power_mw;
+	m_last_sample_at = time_now;
+	m_sampled = true;
+}
+
+static void energy_checkpoint_write(void)
+{
+	if (m_checkpoint_index >= ENERGY_CHECKPOINTS_PER_PAGE) {
+		hal_nvm_erase();
+		m_checkpoint_index = 0;
+	}
+
+	uint32_t record[2] = {m_energy_mwh, ~m_energy_mwh};
+	hal_nvm_write(m_checkpoint_index * sizeof(energy_checkpoint), record, 2);
+	m_checkpoint_index++;
+}
+
+void energy_sensors_update(uint32_t time_now)
+{
+	uint32_t energy_mwh = m_energy_mwh;
+
+	set_sensor_value('P', (int32_t)m_power_mw, false);
+	set_sensor_value('E', (int32_t)energy_mwh, false);
+
+	if (energy_mwh == m_checkpoint_mwh)
+		return;
+	if (time_now - m_checkpoint_at < ENERGY_CHECKPOINT_INTERVAL)
+		return;
+
+	energy_checkpoint_write();
+	m_checkpoint_mwh = energy_mwh;
+	m_checkpoint_at = time_now;
+}
@@ -0,0 +1,21 @@
+#ifndef ENERGY_H__
+#define ENERGY_H__
+
+#include <stdint.h>
+
+/**@brief LED energy accounting: rail voltage x channel duty x calibrated channel current.
+ *
+ * @details Power is integrated in fixed point on every ADC buffer. The total is published as the
+ *          read-only sensors 'P' (mW) and 'E' (mWh) and checkpointed to flash.
+ */
+
+/**@brief Restores the energy total from the last flash checkpoint. */
+void energy_init(void);
+
+/**@brief Integrates the power over the time since the previous buffer. Safe to call from interrupt context. */
+void energy_adc_process(int32_t rail_sample, const uint16_t *p_channel_values, uint32_t time_now);
+
+/**@brief Publishes the sensor values and writes a checkpoint when one is due. */
+void energy_sensors_update(uint32_t time_now);
+
+#endif /* ENERGY_H__ */
@@ -0,0 +1,87 @@
+#ifndef HAL_H__
+#define HAL_H__
+
+#include "settings.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Thin hardware abstraction used by the dimmer control logic.
+ *
+ * @details hal_nrfx.c drives the nRF52840 peripherals, hal_host.c records the calls so the
+ *          control logic can run off-target.
+ */
+
+#define HAL_PWM_OUT_CHANNEL_COUNT(arg, id, name, lname, pin, instance, current) + 1
+#define HAL_PWM_OUT_CHANNELS  (0 DIMMER_CHANNELS(HAL_PWM_OUT_CHANNEL_COUNT, _)) // from the channel table in settings.h
+#define HAL_PWM_OUT_VALUE_MAX 255
+
+#define HAL_ADC_IN_CHANNELS   2
+#define HAL_ADC_IN_VDD        0 // index of the VDD sample within a scan
+#define HAL_ADC_IN_RAIL       1 // index of the 12 V rail sample within a scan
+
+/**@brief ADC buffer handler, samples are interleaved by channel. Called from interrupt context. */
+typedef void (*hal_adc_in_handler_t)(const int16_t *p_samples, uint16_t samples_per_channel);
+
+void hal_pwm_out_init(void);
+void hal_pwm_out_set(uint8_t channel, uint16_t value);
+
+#define HAL_PWM_OUT_MODE_STAGGERED  0x01 // odd channels switch on while even channels switch off
+#define HAL_PWM_OUT_MODE_CENTRED    0x02 // up and down counting, pulses centred in the period
+
+/**@brief Selects how the channel pulses are placed within the PWM period, 0 aligns all of them. */
+void hal_pwm_out_mode_set(uint8_t mode);
+
+#define HAL_PWM_OUT_STREAM_STEPS    16 // steps per sequence buffer
+#define HAL_PWM_OUT_STREAM_STEP_US  10200 // 40 PWM periods of 255 us
+
+/**@brief Fills steps x HAL_PWM_OUT_CHANNELS values, interleaved by channel. Called from interrupt context. */
+typedef void (*hal_pwm_out_stream_handler_t)(uint16_t *p_values, uint16_t steps);
+
+/**@brief Plays values produced by the handler from two sequence buffers, the PWM swaps them on its own
+ *        and the handler refills the one just played. hal_pwm_out_set() values are kept for when the
+ *        stream stops.
+ */
+void hal_pwm_out_stream_start(hal_pwm_out_stream_handler_t handler);
+
+/**@brief Returns to the hal_pwm_out_set() values. Does nothing when no stream is playing. */
+void hal_pwm_out_stream_stop(void);
+
+void hal_adc_in_init(hal_adc_in_handler_t handler);
+void hal_adc_in_sample(void);
+
+/**@brief Hands the samples over every ADC_FAST_SAMPLES_PER_CHANNEL scans instead of ADC_SAMPLES_PER_CHANNEL,
+ *        from the next buffer on. The caller speeds up hal_adc_in_sample() to match.
+ *
+ * @details A no-op while both counts are 1, as in settings.h, where every scan is handed over anyway.
+ */
+void hal_adc_in_fast_set(bool enabled);
+
+void hal_temp_in_init(void);
+int32_t hal_temp_in_read(void); // 0.25 degree Celsius units
+
+/**@brief Overcurrent handler, called from interrupt context after the outputs were cut in hardware. */
+typedef void (*hal_protection_handler_t)(void);
+
+/**@brief Arms the current-sense comparator, a trip stops the PWM without CPU involvement.
+ *
+ * @details Only on boards that define PROTECTION_SENSE_INPUT, elsewhere the outputs are never cut.
+ */
+void hal_protection_init(hal_protection_handler_t handler);
+
+/**@brief Restarts the PWM and re-arms the comparator after a trip. */
+void hal_protection_rearm(void);
+
+void hal_psu_gpio_init(void);
+void hal_psu_gpio_set(bool enabled);
+
+uint32_t hal_clock_now(void); // milliseconds
+
+#define HAL_NVM_PAGE_SIZE     4096
+
+/**@brief Flash page reserved for application checkpoints, offsets are relative to the page start. */
+void hal_nvm_read(uint32_t offset, void *p_data, uint32_t size);
+void hal_nvm_write(uint32_t offset, const uint32_t *p_words, uint32_t count);
+void hal_nvm_erase(void);
+
+#endif /* HAL_H__ */
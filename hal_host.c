@@ -0,0 +1,163 @@
+#include "hal_host.h"
+
+#include <stddef.h>
+#include <string.h>
+
+hal_host_state hal_host;
+
+static hal_adc_in_handler_t m_adc_in_handler;
+static hal_protection_handler_t m_protection_handler;
+static hal_pwm_out_stream_handler_t m_stream_handler;
+static uint16_t m_pwm_out_set_values[HAL_PWM_OUT_CHANNELS];
+
+void hal_pwm_out_init(void)
+{
+	memset(hal_host.pwm_out_values, 0, sizeof(hal_host.pwm_out_values));
+	memset(m_pwm_out_set_values, 0, sizeof(m_pwm_out_set_values));
+	hal_host.pwm_out_writes = 0;
+	hal_host.pwm_out_mode = 0;
+	hal_host.pwm_out_streaming = false;
+	hal_host.pwm_out_stream_steps = 0;
+}
+
+void hal_pwm_out_set(uint8_t channel, uint16_t value)
+{
+	if (channel >= HAL_PWM_OUT_CHANNELS)
+		return;
+
+	m_pwm_out_set_values[channel] = value;
+	if (!hal_host.pwm_out_streaming)
+		hal_host.pwm_out_values[channel] = value;
+	hal_host.pwm_out_writes++;
+}
+
+void hal_pwm_out_mode_set(uint8_t mode)
+{
+	hal_host.pwm_out_mode = mode & (HAL_PWM_OUT_MODE_STAGGERED | HAL_PWM_OUT_MODE_CENTRED);
+}
+
+void hal_pwm_out_stream_start(hal_pwm_out_stream_handler_t handler)
+{
+	m_stream_handler = handler;
+	hal_host.pwm_out_streaming = true;
+}
+
+void hal_pwm_out_stream_stop(void)
+{
+	if (m_stream_handler == NULL)
+		return;
+
+	m_stream_handler = NULL;
+	hal_host.pwm_out_streaming = false;
+	memcpy(hal_host.pwm_out_values, m_pwm_out_set_values, sizeof(m_pwm_out_set_values));
+}
+
+void hal_host_pwm_out_stream_play(uint16_t steps)
+{
+	uint16_t values[HAL_PWM_OUT_CHANNELS];
+
+	if (m_stream_handler == NULL || hal_host.pwm_out_stopped)
+		return;
+
+	for (uint16_t i = 0; i < steps; i++) {
+		m_stream_handler(values, 1);
+		memcpy(hal_host.pwm_out_values, values, sizeof(values));
+		hal_host.pwm_out_stream_steps++;
+	}
+}
+
+void hal_adc_in_init(hal_adc_in_handler_t handler)
+{
+	m_adc_in_handler = handler;
+}
+
+void hal_adc_in_sample(void)
+{
+	hal_host.adc_in_samples++;
+}
+
+void hal_host_adc_in_inject(const int16_t *p_samples, uint16_t samples_per_channel)
+{
+	if (m_adc_in_handler)
+		m_adc_in_handler(p_samples, samples_per_channel);
+}
+
+void hal_adc_in_fast_set(bool enabled)
+{
+	hal_host.adc_in_fast = enabled;
+}
+
+void hal_temp_in_init(void)
+{
+}
+
+int32_t hal_temp_in_read(void)
+{
+	return hal_host.temperature;
+}
+
+void hal_protection_init(hal_protection_handler_t handler)
+{
+	m_protection_handler = handler;
+	hal_host.pwm_out_stopped = false;
+	hal_host.protection_rearms = 0;
+}
+
+void hal_protection_rearm(void)
+{
+	hal_host.pwm_out_stopped = false;
+	hal_host.protection_rearms++;
+	m_stream_handler = NULL;
+	hal_host.pwm_out_streaming = false;
+}
+
+void hal_host_protection_trip(void)
+{
+	hal_host.pwm_out_stopped = true;
+	if (m_protection_handler)
+		m_protection_handler();
+}
+
+void hal_psu_gpio_init(void)
+{
+	hal_host.psu_enabled = false;
+	hal_host.psu_switches = 0;
+}
+
+void hal_psu_gpio_set(bool enabled)
+{
+	if (hal_host.psu_enabled != enabled)
+		hal_host.psu_switches++;
+	hal_host.psu_enabled = enabled;
+}
+
+uint32_t hal_clock_now(void)
+{
+	return hal_host.clock;
+}
+
+void hal_host_clock_advance(uint32_t milliseconds)
+{
+	hal_host.clock += milliseconds;
+}
+
+void hal_nvm_read(uint32_t offset, void *p_data, uint32_t size)
+{
+	memcpy(p_data, &hal_host.nvm[offset], size);
+}
+
+void hal_nvm_write(uint32_t offset, const uint32_t *p_words, uint32_t count)
+{
+	const uint8_t *p_bytes = (const uint8_t *)p_words;
+
+	// programming can only clear bits
+	for (uint32_t i = 0; i < count * sizeof(uint32_t); i++) {
+		hal_host.nvm[offset + i] &= p_bytes[i];
+	}
+}
+
+void hal_nvm_erase(void)
+{
+	memset(hal_host.nvm, 0xFF, sizeof(hal_host.nvm));
+	hal_host.nvm_erases++;
+}
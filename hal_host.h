@@ -0,0 +1,39 @@
+#ifndef HAL_HOST_H__
+#define HAL_HOST_H__
+
+#include "hal.h"
+
+/**@brief Recorded hardware state of the host back-end. */
+typedef struct hal_host_state
+{
+	uint16_t pwm_out_values[HAL_PWM_OUT_CHANNELS];
+	uint32_t pwm_out_writes;
+	uint8_t pwm_out_mode;
+	bool psu_enabled;
+	uint32_t psu_switches;
+	uint32_t adc_in_samples;
+	bool adc_in_fast;
+	int32_t temperature;
+	uint32_t clock;
+	uint8_t nvm[HAL_NVM_PAGE_SIZE];
+	uint32_t nvm_erases;
+	bool pwm_out_stopped;
+	uint32_t protection_rearms;
+	bool pwm_out_streaming;
+	uint32_t pwm_out_stream_steps;
+} hal_host_state;
+
+extern hal_host_state hal_host;
+
+/**@brief Delivers a buffer of interleaved samples to the registered ADC handler. */
+void hal_host_adc_in_inject(const int16_t *p_samples, uint16_t samples_per_channel);
+
+void hal_host_clock_advance(uint32_t milliseconds);
+
+/**@brief Simulates a current-sense trip: the PWM stops and the protection handler runs. */
+void hal_host_protection_trip(void);
+
+/**@brief Plays steps of the running stream, the last step played ends up in pwm_out_values. */
+void hal_host_pwm_out_stream_play(uint16_t steps);
+
+#endif /* HAL_HOST_H__ */
@@ -0,0 +1,494 @@
+#include "hal.h"
+
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "nrf_drv_pwm.h"
+#include "nrf_drv_saadc.h"
+#include "nrf_gpio.h"
+#include "nrf_log.h"
+#include "nrf_lpcomp.h"
+#include "nrf_ppi.h"
+#include "nrf_temp.h"
+#include "nrfx_nvmc.h"
+#include "nrfx_ppi.h"
+#include "sdk_config.h"
+
+#include "settings.h"
+
+#include <string.h>
+
+#include <openthread/platform/alarm-milli.h>
+
+#define PWM_POLARITY_FALLING                 0x8000 // compare value bit 15, the first edge of the period is falling
+#define PWM_INSTANCES_MAX                    4
+
+#define CHANNEL_INSTANCE(arg, id, name, lname, pin, instance, current) instance,
+#define CHANNEL_PIN(arg, id, name, lname, pin, instance, current) pin,
+#define CHANNEL_INSTANCE_BIT(arg, id, name, lname, pin, instance, current) | (1 << (instance))
+#define CHANNEL_ON_INSTANCE(arg, id, name, lname, pin, instance, current) + ((instance) == (arg))
+
+#define PWM_INSTANCES_USED                   (0 DIMMER_CHANNELS(CHANNEL_INSTANCE_BIT, _))
+#define PWM_INSTANCES                        (PWM_INSTANCES_USED >= 0x08 ? 4 : PWM_INSTANCES_USED >= 0x04 ? 3 : PWM_INSTANCES_USED >= 0x02 ? 2 : 1)
+
+_Static_assert(PWM_INSTANCES_USED < (1 << PWM_INSTANCES_MAX), "DIMMER_CHANNELS uses a PWM instance above 3");
+_Static_assert(!(PWM_INSTANCES_USED & 0x01) || NRFX_PWM0_ENABLED, "DIMMER_CHANNELS uses PWM0, enable NRFX_PWM0_ENABLED");
+_Static_assert(!(PWM_INSTANCES_USED & 0x02) || NRFX_PWM1_ENABLED, "DIMMER_CHANNELS uses PWM1, enable NRFX_PWM1_ENABLED");
+_Static_assert(!(PWM_INSTANCES_USED & 0x04) || NRFX_PWM2_ENABLED, "DIMMER_CHANNELS uses PWM2, enable NRFX_PWM2_ENABLED");
+_Static_assert(!(PWM_INSTANCES_USED & 0x08) || NRFX_PWM3_ENABLED, "DIMMER_CHANNELS uses PWM3, enable NRFX_PWM3_ENABLED");
+_Static_assert((0 DIMMER_CHANNELS(CHANNEL_ON_INSTANCE, 0)) <= NRF_PWM_CHANNEL_COUNT, "more than four channels on PWM0");
+_Static_assert((0 DIMMER_CHANNELS(CHANNEL_ON_INSTANCE, 1)) <= NRF_PWM_CHANNEL_COUNT, "more than four channels on PWM1");
+_Static_assert((0 DIMMER_CHANNELS(CHANNEL_ON_INSTANCE, 2)) <= NRF_PWM_CHANNEL_COUNT, "more than four channels on PWM2");
+_Static_assert((0 DIMMER_CHANNELS(CHANNEL_ON_INSTANCE, 3)) <= NRF_PWM_CHANNEL_COUNT, "more than four channels on PWM3");
+
+#define PWM_INSTANCE_FOREACH(i) for (uint8_t i = 0; i < PWM_INSTANCES; i++) if (PWM_INSTANCES_USED & (1 << i))
+
+static const nrf_drv_pwm_t m_pwm[PWM_INSTANCES_MAX] =
+{
+#if NRFX_PWM0_ENABLED
+	[0] = NRF_DRV_PWM_INSTANCE(0),
+#endif
+#if NRFX_PWM1_ENABLED
+	[1] = NRF_DRV_PWM_INSTANCE(1),
+#endif
+#if NRFX_PWM2_ENABLED
+	[2] = NRF_DRV_PWM_INSTANCE(2),
+#endif
+#if NRFX_PWM3_ENABLED
+	[3] = NRF_DRV_PWM_INSTANCE(3),
+#endif
+};
+
+typedef struct pwm_output
+{
+	nrf_pwm_values_individual_t values;
+	nrf_pwm_sequence_t seq;
+	nrf_pwm_values_individual_t stream_values[2][HAL_PWM_OUT_STREAM_STEPS];
+	nrf_pwm_sequence_t stream_seq[2];
+} pwm_output;
+
+static pwm_output m_outputs[PWM_INSTANCES];
+
+static const uint8_t m_channel_instance[HAL_PWM_OUT_CHANNELS] = { DIMMER_CHANNELS(CHANNEL_INSTANCE, _) };
+static const uint32_t m_channel_pin[HAL_PWM_OUT_CHANNELS] = { DIMMER_CHANNELS(CHANNEL_PIN, _) };
+static uint8_t m_channel_slot[HAL_PWM_OUT_CHANNELS]; // output of the instance, in table order
+
+// not synchronised in hardware: pwm_playback_start() starts the instances one after another, with the same
+// clock, top value and sequence length, so they wrap within a few microseconds of each other. Only the
+// instance of channel 0 signals the sequence ends, and every instance's buffer is refilled on its END_SEQ,
+// which leaves the others most of a sequence to finish the buffer being replaced.
+#define PWM_STREAM_INSTANCE                  (m_channel_instance[0])
+
+static uint16_t m_stream_scratch[HAL_PWM_OUT_STREAM_STEPS * HAL_PWM_OUT_CHANNELS];
+static volatile hal_pwm_out_stream_handler_t m_stream_handler;
+static volatile bool m_protection_tripped = false;
+static uint8_t m_pwm_mode = 0;
+
+// the DONE event re-queues the buffer with either scan count, it must hold the larger one
+#define ADC_BUFFER_SAMPLES_PER_CHANNEL (ADC_FAST_SAMPLES_PER_CHANNEL > ADC_SAMPLES_PER_CHANNEL ? ADC_FAST_SAMPLES_PER_CHANNEL : ADC_SAMPLES_PER_CHANNEL)
+
+static nrf_saadc_value_t adc_buf[HAL_ADC_IN_CHANNELS * ADC_BUFFER_SAMPLES_PER_CHANNEL];
+static hal_adc_in_handler_t m_adc_in_handler;
+static volatile uint16_t m_adc_in_samples_per_channel = ADC_SAMPLES_PER_CHANNEL;
+static hal_protection_handler_t m_protection_handler;
+
+static uint16_t pwm_compare_get(uint8_t channel, uint16_t value)
+{
+	// with the default rising polarity the inverted value lights a channel at the end of the period, or
+	// around its centre when counting up and down. Staggered odd channels use the falling polarity and light
+	// at the start, or at the edges, so they switch on while the even channels switch off.
+	if ((m_pwm_mode & HAL_PWM_OUT_MODE_STAGGERED) && (channel & 1))
+		return value | PWM_POLARITY_FALLING;
+	return HAL_PWM_OUT_VALUE_MAX - value;
+}
+
+static uint16_t pwm_value_get(uint16_t compare)
+{
+	if (compare & PWM_POLARITY_FALLING)
+		return compare & ~PWM_POLARITY_FALLING;
+	return HAL_PWM_OUT_VALUE_MAX - compare;
+}
+
+static uint16_t *channel_compare(nrf_pwm_values_individual_t *p_values, uint8_t channel)
+{
+	return &((uint16_t *)&p_values[0])[m_channel_slot[channel]];
+}
+
+static void stream_fill(uint8_t buffer)
+{
+	m_stream_handler(m_stream_scratch, HAL_PWM_OUT_STREAM_STEPS);
+
+	for (int step = 0; step < HAL_PWM_OUT_STREAM_STEPS; step++) {
+		for (uint8_t channel = 0; channel < HAL_PWM_OUT_CHANNELS; channel++) {
+			pwm_output *p_output = &m_outputs[m_channel_instance[channel]];
+			*channel_compare(&p_output->stream_values[buffer][step], channel) =
+				pwm_compare_get(channel, m_stream_scratch[step * HAL_PWM_OUT_CHANNELS + channel]);
+		}
+	}
+}
+
+static void pwm_event_handler(nrf_drv_pwm_evt_type_t event_type)
+{
+	// the simple playback does not signal sequence ends, these only come while streaming
+	if (m_stream_handler == NULL)
+		return;
+
+	if (event_type == NRF_DRV_PWM_EVT_END_SEQ0)
+		stream_fill(0);
+	else if (event_type == NRF_DRV_PWM_EVT_END_SEQ1)
+		stream_fill(1);
+}
+
+static void pwm_configure(void)
+{
+	bool centred = (m_pwm_mode & HAL_PWM_OUT_MODE_CENTRED) != 0;
+
+	PWM_INSTANCE_FOREACH(i) {
+		nrf_drv_pwm_config_t led_pwm_config =
+			{
+				.output_pins =
+					{
+						NRF_DRV_PWM_PIN_NOT_USED,
+						NRF_DRV_PWM_PIN_NOT_USED,
+						NRF_DRV_PWM_PIN_NOT_USED,
+						NRF_DRV_PWM_PIN_NOT_USED,
+					},
+				.irq_priority = APP_IRQ_PRIORITY_LOWEST,
+				// counting up and down takes two passes, the doubled clock keeps the period at 255 us
+				.base_clock = centred ? NRF_PWM_CLK_2MHz : NRF_PWM_CLK_1MHz,
+				.count_mode = centred ? NRF_PWM_MODE_UP_AND_DOWN : NRF_PWM_MODE_UP,
+				.top_value = HAL_PWM_OUT_VALUE_MAX,
+				.load_mode = NRF_PWM_LOAD_INDIVIDUAL,
+				.step_mode = NRF_PWM_STEP_AUTO
+			};
+
+		for (uint8_t channel = 0; channel < HAL_PWM_OUT_CHANNELS; channel++) {
+			if (m_channel_instance[channel] == i)
+				led_pwm_config.output_pins[m_channel_slot[channel]] = m_channel_pin[channel] | DIMMER_PWM_INVERSION;
+		}
+
+		ret_code_t err_code = nrf_drv_pwm_init(&m_pwm[i], &led_pwm_config, i == PWM_STREAM_INSTANCE ? pwm_event_handler : NULL);
+		APP_ERROR_CHECK(err_code);
+	}
+}
+
+static void pwm_playback_start(void)
+{
+	PWM_INSTANCE_FOREACH(i) {
+		pwm_output *p_output = &m_outputs[i];
+		ret_code_t err_code;
+
+		if (m_stream_handler != NULL)
+			err_code = nrf_drv_pwm_complex_playback(&m_pwm[i], &p_output->stream_seq[0], &p_output->stream_seq[1], 1,
+				NRF_DRV_PWM_FLAG_LOOP | (i == PWM_STREAM_INSTANCE ? NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ0 | NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ1 : 0));
+		else
+			err_code = nrf_drv_pwm_simple_playback(&m_pwm[i], &p_output->seq, 1, NRF_DRV_PWM_FLAG_LOOP);
+		APP_ERROR_CHECK(err_code);
+	}
+}
+
+static void pwm_playback_stop(void)
+{
+	PWM_INSTANCE_FOREACH(i) {
+		nrf_drv_pwm_stop(&m_pwm[i], true);
+	}
+}
+
+void hal_pwm_out_init(void)
+{
+	uint8_t slots[PWM_INSTANCES_MAX] = {0};
+
+	for (uint8_t channel = 0; channel < HAL_PWM_OUT_CHANNELS; channel++) {
+		m_channel_slot[channel] = slots[m_channel_instance[channel]]++;
+	}
+
+	for (uint8_t i = 0; i < PWM_INSTANCES; i++) {
+		pwm_output *p_output = &m_outputs[i];
+
+		p_output->seq = (nrf_pwm_sequence_t) {
+			.values.p_individual = &p_output->values,
+			.length = NRF_PWM_VALUES_LENGTH(p_output->values),
+			.repeats = 0,
+			.end_delay = 0
+		};
+		for (int buffer = 0; buffer < 2; buffer++) {
+			p_output->stream_seq[buffer] = (nrf_pwm_sequence_t) {
+				.values.p_individual = p_output->stream_values[buffer],
+				.length = NRF_PWM_VALUES_LENGTH(p_output->stream_values[buffer]),
+				.repeats = HAL_PWM_OUT_STREAM_STEP_US / HAL_PWM_OUT_VALUE_MAX - 1,
+				.end_delay = 0
+			};
+		}
+	}
+
+	m_pwm_mode = 0;
+
+	for (uint8_t channel = 0; channel < HAL_PWM_OUT_CHANNELS; channel++) {
+		*channel_compare(&m_outputs[m_channel_instance[channel]].values, channel) = pwm_compare_get(channel, 0);
+	}
+
+	pwm_configure();
+	pwm_playback_start();
+}
+
+void hal_pwm_out_set(uint8_t channel, uint16_t value)
+{
+	if (channel >= HAL_PWM_OUT_CHANNELS)
+		return;
+
+	*channel_compare(&m_outputs[m_channel_instance[channel]].values, channel) = pwm_compare_get(channel, value);
+}
+
+void hal_pwm_out_mode_set(uint8_t mode)
+{
+	mode &= HAL_PWM_OUT_MODE_STAGGERED | HAL_PWM_OUT_MODE_CENTRED;
+	if (mode == m_pwm_mode)
+		return;
+
+	// the count mode only changes with the PWM stopped, its interrupt is off until the driver is initialised again
+	pwm_playback_stop();
+	PWM_INSTANCE_FOREACH(i) {
+		nrf_drv_pwm_uninit(&m_pwm[i]);
+	}
+
+	m_pwm_mode = mode;
+
+	// the polarity bit tells how a compare value was written, so the values are converted in place
+	for (uint8_t channel = 0; channel < HAL_PWM_OUT_CHANNELS; channel++) {
+		pwm_output *p_output = &m_outputs[m_channel_instance[channel]];
+		uint16_t *p_compare = channel_compare(&p_output->values, channel);
+		*p_compare = pwm_compare_get(channel, pwm_value_get(*p_compare));
+
+		for (int buffer = 0; buffer < 2; buffer++) {
+			for (int step = 0; step < HAL_PWM_OUT_STREAM_STEPS; step++) {
+				p_compare = channel_compare(&p_output->stream_values[buffer][step], channel);
+				*p_compare = pwm_compare_get(channel, pwm_value_get(*p_compare));
+			}
+		}
+	}
+
+	pwm_configure();
+
+	// after a trip the outputs stay off until hal_protection_rearm()
+	if (m_protection_tripped)
+		return;
+
+	pwm_playback_start();
+}
+
+void hal_pwm_out_stream_start(hal_pwm_out_stream_handler_t handler)
+{
+	if (m_protection_tripped)
+		return;
+
+	m_stream_handler = handler;
+	stream_fill(0);
+	stream_fill(1);
+
+	pwm_playback_start();
+}
+
+void hal_pwm_out_stream_stop(void)
+{
+	if (m_stream_handler == NULL)
+		return;
+
+	pwm_playback_stop();
+	m_stream_handler = NULL;
+
+	// after a trip the outputs stay off until hal_protection_rearm()
+	if (m_protection_tripped)
+		return;
+
+	pwm_playback_start();
+}
+
+static void saadc_event_handler(nrf_drv_saadc_evt_t const *p_event)
+{
+	if (p_event->type == NRF_DRV_SAADC_EVT_DONE)
+	{
+		if (m_adc_in_handler)
+			m_adc_in_handler(p_event->data.done.p_buffer, p_event->data.done.size / HAL_ADC_IN_CHANNELS);
+
+		ret_code_t err_code = nrf_drv_saadc_buffer_convert(p_event->data.done.p_buffer, HAL_ADC_IN_CHANNELS * m_adc_in_samples_per_channel);
+		APP_ERROR_CHECK(err_code);
+	}
+	else
+	{
+		NRF_LOG_INFO("saadc unhandled event: %d", p_event->type);
+	}
+}
+
+void hal_adc_in_init(hal_adc_in_handler_t handler)
+{
+	m_adc_in_handler = handler;
+
+	// one SAMPLE task runs the whole oversampled scan, burst mode is required with more than one channel
+	nrf_drv_saadc_config_t saadc_config = NRF_DRV_SAADC_DEFAULT_CONFIG;
+	saadc_config.oversample = ADC_OVERSAMPLE;
+	ret_code_t err_code = nrf_drv_saadc_init(&saadc_config, saadc_event_handler);
+	APP_ERROR_CHECK(err_code);
+
+	err_code = nrfx_saadc_calibrate_offset();
+	APP_ERROR_CHECK(err_code);
+
+	while (nrfx_saadc_is_busy());
+
+	nrf_saadc_channel_config_t config0 = NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE(NRF_SAADC_INPUT_VDD);
+	config0.acq_time = NRF_SAADC_ACQTIME_40US;
+	config0.burst = NRF_SAADC_BURST_ENABLED;
+	err_code = nrf_drv_saadc_channel_init(HAL_ADC_IN_VDD, &config0);
+	APP_ERROR_CHECK(err_code);
+
+	nrf_saadc_channel_config_t config1 = NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE(NRF_SAADC_INPUT_AIN4);
+	config1.acq_time = NRF_SAADC_ACQTIME_40US;
+	config1.burst = NRF_SAADC_BURST_ENABLED;
+	err_code = nrf_drv_saadc_channel_init(HAL_ADC_IN_RAIL, &config1);
+	APP_ERROR_CHECK(err_code);
+
+	err_code = nrf_drv_saadc_buffer_convert(adc_buf, HAL_ADC_IN_CHANNELS * ADC_SAMPLES_PER_CHANNEL);
+	APP_ERROR_CHECK(err_code);
+}
+
+void hal_adc_in_sample(void)
+{
+	ret_code_t err_code = nrf_drv_saadc_sample();
+	APP_ERROR_CHECK(err_code);
+}
+
+void hal_adc_in_fast_set(bool enabled)
+{
+	// the buffer being filled keeps its size, the next one is queued from the DONE event; with both scan
+	// counts at 1 in settings.h this changes nothing, only the faster hal_adc_in_sample() calls matter
+	m_adc_in_samples_per_channel = enabled ? ADC_FAST_SAMPLES_PER_CHANNEL : ADC_SAMPLES_PER_CHANNEL;
+}
+
+void hal_temp_in_init(void)
+{
+	nrf_temp_init();
+}
+
+int32_t hal_temp_in_read(void)
+{
+	NRF_TEMP->TASKS_START = 1;
+	/* Busy wait while temperature measurement is not finished. */
+	while (NRF_TEMP->EVENTS_DATARDY == 0) {
+	}
+	NRF_TEMP->EVENTS_DATARDY = 0;
+
+	int32_t temp = nrf_temp_read();
+
+	NRF_TEMP->TASKS_STOP = 1;
+
+	return temp;
+}
+
+#ifdef PROTECTION_SENSE_INPUT
+void hal_protection_init(hal_protection_handler_t handler)
+{
+	m_protection_handler = handler;
+
+	nrf_lpcomp_config_t config = {
+		.reference = PROTECTION_LPCOMP_REFERENCE,
+		.detection = NRF_LPCOMP_DETECT_UP,
+		.hyst = NRF_LPCOMP_HYST_50mV,
+	};
+	nrf_lpcomp_configure(&config);
+	nrf_lpcomp_input_select(PROTECTION_SENSE_INPUT);
+
+	// LPCOMP UP stops the PWM through PPI, so the cutoff does not wait for the CPU. A PPI channel
+	// drives two tasks with its fork, more than two instances take a second channel on the same event.
+	// The channels come from the nrfx allocator, which keeps out those of the radio driver and the FEM.
+	nrf_ppi_channel_t channel;
+	uint8_t tasks = 0;
+	PWM_INSTANCE_FOREACH(i) {
+		uint32_t task = nrf_drv_pwm_task_address_get(&m_pwm[i], NRF_PWM_TASK_STOP);
+
+		if (tasks % 2 == 0) {
+			APP_ERROR_CHECK(nrfx_ppi_channel_alloc(&channel));
+			APP_ERROR_CHECK(nrfx_ppi_channel_assign(channel, (uint32_t)nrf_lpcomp_event_address_get(NRF_LPCOMP_EVENT_UP), task));
+			APP_ERROR_CHECK(nrfx_ppi_channel_enable(channel));
+		} else {
+			APP_ERROR_CHECK(nrfx_ppi_channel_fork_assign(channel, task));
+		}
+		tasks++;
+	}
+
+	nrf_lpcomp_event_clear(NRF_LPCOMP_EVENT_UP);
+	nrf_lpcomp_int_enable(LPCOMP_INTENSET_UP_Msk);
+	NVIC_SetPriority(LPCOMP_IRQn, APP_IRQ_PRIORITY_HIGH);
+	NVIC_ClearPendingIRQ(LPCOMP_IRQn);
+	NVIC_EnableIRQ(LPCOMP_IRQn);
+
+	nrf_lpcomp_enable();
+	nrf_lpcomp_task_trigger(NRF_LPCOMP_TASK_START);
+}
+
+void hal_protection_rearm(void)
+{
+	m_protection_tripped = false;
+	m_stream_handler = NULL;
+
+	nrf_lpcomp_event_clear(NRF_LPCOMP_EVENT_UP);
+	nrf_lpcomp_int_enable(LPCOMP_INTENSET_UP_Msk);
+
+	pwm_playback_start();
+}
+
+void COMP_LPCOMP_IRQHandler(void)
+{
+	if (nrf_lpcomp_event_check(NRF_LPCOMP_EVENT_UP)) {
+		nrf_lpcomp_event_clear(NRF_LPCOMP_EVENT_UP);
+		// one report per trip, hal_protection_rearm() enables it again
+		nrf_lpcomp_int_disable(LPCOMP_INTENCLR_UP_Msk);
+		m_protection_tripped = true;
+
+		if (m_protection_handler)
+			m_protection_handler();
+	}
+}
+#else
+// no current-sense input on this board, the protection never trips
+void hal_protection_init(hal_protection_handler_t handler)
+{
+	m_protection_handler = handler;
+}
+
+void hal_protection_rearm(void)
+{
+}
+#endif
+
+void hal_psu_gpio_init(void)
+{
+	nrf_gpio_cfg_output(DIMMER_PSU_ENABLE_PIN);
+	nrf_gpio_pin_clear(DIMMER_PSU_ENABLE_PIN);
+}
+
+void hal_psu_gpio_set(bool enabled)
+{
+	if (enabled)
+		nrf_gpio_pin_set(DIMMER_PSU_ENABLE_PIN);
+	else
+		nrf_gpio_pin_clear(DIMMER_PSU_ENABLE_PIN);
+}
+
+uint32_t hal_clock_now(void)
+{
+	return otPlatAlarmMilliGetNow();
+}
+
+void hal_nvm_read(uint32_t offset, void *p_data, uint32_t size)
+{
+	memcpy(p_data, (const void *)(uintptr_t)(NVM_PAGE_ADDRESS + offset), size);
+}
+
+void hal_nvm_write(uint32_t offset, const uint32_t *p_words, uint32_t count)
+{
+	nrfx_nvmc_words_write(NVM_PAGE_ADDRESS + offset, p_words, count);
+}
+
+void hal_nvm_erase(void)
+{
+	nrfx_err_t err_code = nrfx_nvmc_page_erase(NVM_PAGE_ADDRESS);
+	APP_ERROR_CHECK(err_code);
+}
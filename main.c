@@ -48,284 +48,69 @@
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 
-#include "nrf_drv_pwm.h"
-#include "nrf_drv_saadc.h"
-#include "nrf_temp.h"
-
 #include "settings.h"
 
+#include "dimmer.h"
+#include "hal.h"
+#include "sensors.h"
 #include "thread_coap_utils.h"
 #include "thread_utils.h"
+#include "wakeup.h"
 
 #include <openthread/thread.h>
 
-#define DIMMER_PWM_INSTANCE                  NRF_DRV_PWM_INSTANCE(0)
-#define DIMMER_PWM_VALUE_MAX                 255
-#define ADC_CHANNELS                         2
-
 #define SCHED_QUEUE_SIZE      32
 #define SCHED_EVENT_DATA_SIZE APP_TIMER_SCHED_EVENT_DATA_SIZE
 
-APP_TIMER_DEF(m_voltage_timer_id);
-APP_TIMER_DEF(m_internal_temperature_timer_id);
-APP_TIMER_DEF(m_psu_control_timer_id);
-
-void pwm_set_brightness(char sensor_name, int64_t sensor_value);
-
-sensor_subscription sensor_subscriptions[] = {
-	{ .sensor_name = 'r', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = false, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = pwm_set_brightness, },
-	{ .sensor_name = 'g', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = false, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = pwm_set_brightness, },
-	{ .sensor_name = 'b', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = false, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = pwm_set_brightness, },
-	{ .sensor_name = 'w', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = false, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = pwm_set_brightness, },
-	{ .sensor_name = 'v', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = true, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = NULL, },
-	{ .sensor_name = 'V', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = true, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = NULL, },
-	{ .sensor_name = 't', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = true, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = NULL, },
-	{ .sensor_name = 'p', .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = true, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = NULL, },
-	{ .sensor_name = SENSOR_SUBSCRIPTION_NAME_LAST, .sent_value = 0, .current_value = 0, .reportable_change = 0, .disable_reporting = true, .read_only = true, .initialized = false, .report_interval = 10000, .last_sent_at = 0, .set_value_handler = NULL, },
-};
-
-static nrf_saadc_value_t adc_buf[ADC_CHANNELS * ADC_SAMPLES_PER_CHANNEL];
-
-static nrf_drv_pwm_t m_led_pwm = DIMMER_PWM_INSTANCE;
-static nrf_pwm_values_individual_t m_led_values;
-static nrf_pwm_sequence_t const m_led_seq =
-{
-	.values.p_individual = &m_led_values,
-	.length = NRF_PWM_VALUES_LENGTH(m_led_values),
-	.repeats = 0,
-	.end_delay = 0
-};
-
-bool psu_is_powered_on = false;
-bool psu_pwm_is_enabled = false;
-uint32_t psu_power_on_time = 0;
-bool psu_pending_shutdown = false;
-uint32_t psu_pending_shutdown_start_time = 0;
-static uint16_t m_led_values_pending[4];
-
-int32_t internal_temp_prev = 0x7FFFFFFF;
-
-int32_t dc_voltage_12_prev = 0x7FFFFFFF;
-int32_t dc_voltage_12 = 0;
-int32_t dc_voltage_3v3_prev = 0x7FFFFFFF;
-int32_t dc_voltage_3v3 = 0;
+static bool m_psu_starting = false;
 
 void update_voltage_attributes_callback(void *p_event_data, uint16_t event_size)
 {
-	set_sensor_value('v', dc_voltage_3v3, false);
-	set_sensor_value('V', dc_voltage_12, false);
+	dimmer_voltage_sensors_update();
 }
 
-void saadc_event_handler(nrf_drv_saadc_evt_t const *p_event)
+static void adc_in_handler(const int16_t *p_samples, uint16_t samples_per_channel)
 {
-	if (p_event->type == NRF_DRV_SAADC_EVT_DONE)
-	{
-		uint32_t err_code;
-
-		int32_t sums[ADC_CHANNELS];
-		for (int i = 0; i < ADC_CHANNELS; i++) {
-			sums[i] = 0;
-			for (int j = 0; j < ADC_SAMPLES_PER_CHANNEL; j++) {
-				sums[i] += p_event->data.done.p_buffer[j * 2 + i];
-			}
-			sums[i] = sums[i] / ADC_SAMPLES_PER_CHANNEL;
-		}
-
-		if (dc_voltage_12_prev == 0x7FFFFFFF) {
-			dc_voltage_12_prev = sums[1];
-			dc_voltage_12 = sums[1];
-		} else {
-			dc_voltage_12 = (dc_voltage_12_prev + dc_voltage_12_prev + dc_voltage_12_prev + sums[1]) >> 2;
-			dc_voltage_12_prev = dc_voltage_12;
-		}
-
-		if (sums[0] < 0)
-			sums[0] = 0;
-
-		if (dc_voltage_3v3_prev == 0x7FFFFFFF) {
-			dc_voltage_3v3_prev = sums[0];
-			dc_voltage_3v3 = sums[0];
-		} else {
-			dc_voltage_3v3 = (dc_voltage_3v3_prev + dc_voltage_3v3_prev + dc_voltage_3v3_prev + sums[0]) >> 2;
-			dc_voltage_3v3_prev = dc_voltage_3v3;
-		}
+	dimmer_adc_process(p_samples, samples_per_channel);
 
-		err_code = nrf_drv_saadc_buffer_convert(p_event->data.done.p_buffer, ADC_CHANNELS * ADC_SAMPLES_PER_CHANNEL);
-		APP_ERROR_CHECK(err_code);
-
-		app_sched_event_put(NULL, 0, update_voltage_attributes_callback);
-	}
-	else
-	{
-		NRF_LOG_INFO("saadc unhandled event: %d", p_event->type);
-	}
-}
-
-static void adc_configure(void)
-{
-	ret_code_t err_code = nrf_drv_saadc_init(NULL, saadc_event_handler);
-	APP_ERROR_CHECK(err_code);
-
-	err_code = nrfx_saadc_calibrate_offset();
-	APP_ERROR_CHECK(err_code);
-
-	while (nrfx_saadc_is_busy());
-
-	nrf_saadc_channel_config_t config0 = NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE(NRF_SAADC_INPUT_VDD);
-	config0.acq_time = NRF_SAADC_ACQTIME_40US;
-	err_code = nrf_drv_saadc_channel_init(0, &config0);
-	APP_ERROR_CHECK(err_code);
-
-	nrf_saadc_channel_config_t config1 = NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE(NRF_SAADC_INPUT_AIN4);
-	config1.acq_time = NRF_SAADC_ACQTIME_40US;
-	err_code = nrf_drv_saadc_channel_init(1, &config1);
-	APP_ERROR_CHECK(err_code);
-
-	err_code = nrf_drv_saadc_buffer_convert(adc_buf, ADC_CHANNELS * ADC_SAMPLES_PER_CHANNEL);
-	APP_ERROR_CHECK(err_code);
+	app_sched_event_put(NULL, 0, update_voltage_attributes_callback);
 }
 
 static void voltage_timeout_handler(void *p_context)
 {
 	UNUSED_PARAMETER(p_context);
 
-	ret_code_t err_code = nrf_drv_saadc_sample();
-	APP_ERROR_CHECK(err_code);
+	hal_adc_in_sample();
 }
 
 static void internal_temperature_timeout_handler(void *p_context)
 {
 	UNUSED_PARAMETER(p_context);
 
-	NRF_TEMP->TASKS_START = 1;
-	/* Busy wait while temperature measurement is not finished. */
-	while (NRF_TEMP->EVENTS_DATARDY == 0) {
-	}
-	NRF_TEMP->EVENTS_DATARDY = 0;
-
-	int32_t temp = nrf_temp_read();
-
-	NRF_TEMP->TASKS_STOP = 1;
-
-	temp = temp << 2;
-
-	if (internal_temp_prev == 0x7FFFFFFF) {
-		internal_temp_prev = temp;
-	} else {
-		temp = (internal_temp_prev + internal_temp_prev + internal_temp_prev + temp) >> 2;
-		internal_temp_prev = temp;
-
-		set_sensor_value('t', temp >> 2, false);
-	}
+	dimmer_temperature_process();
 }
 
 static void psu_control_timer_handler(void *p_context)
 {
 	UNUSED_PARAMETER(p_context);
 
-	bool pending_channels_off = true;
-	for (int i = 0; i < 4; i++) {
-		if (m_led_values_pending[i]) {
-			pending_channels_off = false;
-			break;
-		}
-	}
-
-	uint32_t now_time = otPlatAlarmMilliGetNow();
-
-	if (psu_is_powered_on) {
-		if ((!psu_pwm_is_enabled) && (now_time - psu_power_on_time > DIMMER_PSU_ON_TIMEOUT)) {
-			psu_pwm_is_enabled = true;
-		}
-
-		if (psu_pwm_is_enabled) {
-			uint16_t *p_channels = (uint16_t *)&m_led_values;
-			for (int i = 0; i < 4; i++) {
-				p_channels[i] = DIMMER_PWM_VALUE_MAX - m_led_values_pending[i];
-			}
-		}
-
-		if (pending_channels_off) {
-			if (!psu_pending_shutdown) {
-				psu_pending_shutdown = true;
-				psu_pending_shutdown_start_time = now_time;
-			}
-			if (now_time - psu_pending_shutdown_start_time > DIMMER_PSU_OFF_TIMEOUT) {
-				psu_is_powered_on = false;
-				psu_pending_shutdown = false;
-				psu_pwm_is_enabled = false;
-
-				nrf_gpio_pin_clear(DIMMER_PSU_ENABLE_PIN);
-
-				set_sensor_value('p', 0, false);
-			}
-		} else {
-			psu_pending_shutdown = false;
-		}
-	} else if (!pending_channels_off) {
-		psu_is_powered_on = true;
-		psu_power_on_time = otPlatAlarmMilliGetNow();
+	dimmer_psu_control_process();
 
-		nrf_gpio_pin_set(DIMMER_PSU_ENABLE_PIN);
-
-		set_sensor_value('p', 1, false);
+	// the rail is watched closely while the PSU powers up, so the outputs are enabled as soon as it settles
+	bool psu_starting = dimmer_psu_starting();
+	if (psu_starting != m_psu_starting) {
+		m_psu_starting = psu_starting;
+		hal_adc_in_fast_set(psu_starting);
+		wakeup_period_set(WAKEUP_VOLTAGE, psu_starting ? ADC_FAST_SAMPLE_INTERVAL : VOLTAGE_TIMER_INTERVAL / ADC_SAMPLES_PER_CHANNEL);
 	}
-}
-
-void pwm_set_brightness(char sensor_name, int64_t sensor_value)
-{
-	if (sensor_value < 0)
-		sensor_value = 0;
-	if (sensor_value > DIMMER_PWM_VALUE_MAX)
-		sensor_value = DIMMER_PWM_VALUE_MAX;
-
-	uint8_t channel = 0;
-	switch (sensor_name) {
-		case 'r': { channel = 0; break; }
-		case 'g': { channel = 1; break; }
-		case 'b': { channel = 2; break; }
-		case 'w': { channel = 3; break; }
-		default:
-			return;
-	}
-
-	m_led_values_pending[channel] = (uint16_t)sensor_value;
-}
 
-static void pwm_init()
-{
-	nrf_drv_pwm_config_t const led_pwm_config =
-		{
-			.output_pins =
-				{
-					DIMMER_CHANNEL_PIN_R | DIMMER_PWM_INVERSION, // channel 0
-					DIMMER_CHANNEL_PIN_G | DIMMER_PWM_INVERSION, // channel 1
-					DIMMER_CHANNEL_PIN_B | DIMMER_PWM_INVERSION, // channel 2
-					DIMMER_CHANNEL_PIN_W | DIMMER_PWM_INVERSION, // channel 3
-				},
-			.irq_priority = APP_IRQ_PRIORITY_LOWEST,
-			.base_clock = NRF_PWM_CLK_1MHz,
-			.count_mode = NRF_PWM_MODE_UP,
-			.top_value = DIMMER_PWM_VALUE_MAX,
-			.load_mode = NRF_PWM_LOAD_INDIVIDUAL,
-			.step_mode = NRF_PWM_STEP_AUTO
-		};
-
-	m_led_values.channel_0 = DIMMER_PWM_VALUE_MAX;
-	m_led_values.channel_1 = DIMMER_PWM_VALUE_MAX;
-	m_led_values.channel_2 = DIMMER_PWM_VALUE_MAX;
-	m_led_values.channel_3 = DIMMER_PWM_VALUE_MAX;
-
-	m_led_values_pending[0] = 0;
-	m_led_values_pending[1] = 0;
-	m_led_values_pending[2] = 0;
-	m_led_values_pending[3] = 0;
-
-	ret_code_t err_code = nrf_drv_pwm_init(&m_led_pwm, &led_pwm_config, NULL);
-	APP_ERROR_CHECK(err_code);
-
-	err_code = nrf_drv_pwm_simple_playback(&m_led_pwm, &m_led_seq, 1, NRF_DRV_PWM_FLAG_LOOP);
-	APP_ERROR_CHECK(err_code);
+	// an idle dimmer only changes on a request, which kicks the control loop
+	if (psu_starting)
+		wakeup_period_set(WAKEUP_PSU_CONTROL, PSU_CONTROL_TIMER_FAST_INTERVAL);
+	else if (dimmer_idle())
+		wakeup_period_set(WAKEUP_PSU_CONTROL, PSU_CONTROL_TIMER_IDLE_INTERVAL);
+	else
+		wakeup_period_set(WAKEUP_PSU_CONTROL, PSU_CONTROL_TIMER_INTERVAL);
 }
 
 static void bsp_event_handler(bsp_event_t event)
@@ -341,6 +126,8 @@ static void bsp_event_handler(bsp_event_t event)
 
 static void thread_state_changed_callback(uint32_t flags, void * p_context)
 {
+	thread_coap_utils_state_changed(flags);
+
 	if (flags & OT_CHANGED_THREAD_ROLE) {
 		otDeviceRole device_role = otThreadGetDeviceRole(p_context);
 		const char *szRole = "UNKNOWN ROLE";
@@ -402,26 +189,23 @@ static void timer_init(void)
 	uint32_t error_code = app_timer_init();
 	APP_ERROR_CHECK(error_code);
 
-	// Voltage timer
-	error_code = app_timer_create(&m_voltage_timer_id, APP_TIMER_MODE_REPEATED, voltage_timeout_handler);
-	APP_ERROR_CHECK(error_code);
-
-	// Internal temperature timer
-	error_code = app_timer_create(&m_internal_temperature_timer_id, APP_TIMER_MODE_REPEATED, internal_temperature_timeout_handler);
-	APP_ERROR_CHECK(error_code);
-
-	// PSU on/off control timer
-	error_code = app_timer_create(&m_psu_control_timer_id, APP_TIMER_MODE_REPEATED, psu_control_timer_handler);
-	APP_ERROR_CHECK(error_code);
+	// Voltage, internal temperature, PSU on/off control and subscription work share one timer
+	wakeup_init();
 }
 
 static void thread_instance_init(void)
 {
 	thread_configuration_t thread_configuration =
 	{
+#ifdef SLEEPY_END_DEVICE
+		.radio_mode            = THREAD_RADIO_MODE_RX_OFF_WHEN_IDLE,
+		.poll_period           = DEFAULT_POLL_PERIOD,
+		.default_child_timeout = DEFAULT_CHILD_TIMEOUT,
+#else
 		.radio_mode            = THREAD_RADIO_MODE_RX_ON_WHEN_IDLE,
-		.autocommissioning     = true,
 		.default_child_timeout = 10,
+#endif // SLEEPY_END_DEVICE
+		.autocommissioning     = true,
 		.wipe_settings         = false,
 	};
 
@@ -434,9 +218,9 @@ int main(int argc, char * argv[])
 	log_init();
 	APP_SCHED_INIT(SCHED_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
 	timer_init();
-	pwm_init();
-	adc_configure();
-	nrf_temp_init();
+	dimmer_init();
+	hal_adc_in_init(adc_in_handler);
+	hal_temp_in_init();
 
 	uint32_t error_code = bsp_init(BSP_INIT_LEDS | BSP_INIT_BUTTONS, bsp_event_handler);
 	APP_ERROR_CHECK(error_code);
@@ -445,22 +229,15 @@ int main(int argc, char * argv[])
 	otPlatRadioSetTransmitPower(thread_ot_instance_get(), 8);
 	thread_coap_utils_init();
 
-	ret_code_t err_code = app_timer_start(m_voltage_timer_id, APP_TIMER_TICKS(VOLTAGE_TIMER_INTERVAL / ADC_SAMPLES_PER_CHANNEL), NULL);
-	APP_ERROR_CHECK(err_code);
-
-	err_code = app_timer_start(m_internal_temperature_timer_id, APP_TIMER_TICKS(INTERNAL_TEMPERATURE_TIMER_INTERVAL), NULL);
-	APP_ERROR_CHECK(err_code);
+	wakeup_start(WAKEUP_VOLTAGE, voltage_timeout_handler, VOLTAGE_TIMER_INTERVAL / ADC_SAMPLES_PER_CHANNEL);
+	wakeup_start(WAKEUP_TEMPERATURE, internal_temperature_timeout_handler, INTERNAL_TEMPERATURE_TIMER_INTERVAL);
 
 	set_sensor_value('r', 0, true);
 	set_sensor_value('g', 0, true);
 	set_sensor_value('b', 0, true);
 	set_sensor_value('w', 0, true);
 
-	nrf_gpio_cfg_output(DIMMER_PSU_ENABLE_PIN);
-	nrf_gpio_pin_clear(DIMMER_PSU_ENABLE_PIN);
-
-	err_code = app_timer_start(m_psu_control_timer_id, APP_TIMER_TICKS(50), NULL);
-	APP_ERROR_CHECK(err_code);
+	wakeup_start(WAKEUP_PSU_CONTROL, psu_control_timer_handler, PSU_CONTROL_TIMER_INTERVAL);
 
 	while (true) {
 		thread_process();
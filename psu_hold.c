@@ -0,0 +1,112 @@
+#include "psu_hold.h"
+
+#include "sensors.h"
+#include "settings.h"
+
+#define PSU_HOLD_BINS        12
+#define PSU_HOLD_WEIGHT_ONE  256 // weight of a single interval
+
+// bin b holds intervals from m_bin_edges[b] up to m_bin_edges[b + 1], the last bin is open
+static const uint32_t m_bin_edges[PSU_HOLD_BINS] =
+	{ 0, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000, 256000, 512000 };
+
+static uint16_t m_bin_weights[PSU_HOLD_BINS];
+static uint8_t m_intervals = 0; // seen since init, saturates at PSU_HOLD_INTERVALS_MIN
+static uint32_t m_restart_cost = PSU_HOLD_RESTART_COST;
+static uint32_t m_hold = PSU_HOLD_RESTART_COST;
+
+static uint32_t hold_clamp(uint32_t hold)
+{
+	if (hold < PSU_HOLD_MIN)
+		return PSU_HOLD_MIN;
+	if (hold > PSU_HOLD_MAX)
+		return PSU_HOLD_MAX;
+	return hold;
+}
+
+static void hold_update(void)
+{
+	// without a history, holding for the restart cost is never worse than twice the best choice
+	uint32_t hold = m_restart_cost;
+
+	if (m_intervals >= PSU_HOLD_INTERVALS_MIN) {
+		uint64_t best_cost = UINT64_MAX;
+
+		for (int candidate = 1; candidate < PSU_HOLD_BINS; candidate++) {
+			uint32_t candidate_hold = m_bin_edges[candidate];
+			if (candidate_hold < PSU_HOLD_MIN || candidate_hold > PSU_HOLD_MAX)
+				continue;
+
+			// intervals in the bins below end within the hold and cost their own length on average, the
+			// others cost the full hold and a restart
+			uint64_t cost = 0;
+			for (int b = 0; b < PSU_HOLD_BINS; b++) {
+				uint32_t interval_cost = b < candidate ?
+					(m_bin_edges[b] + m_bin_edges[b + 1]) / 2 :
+					candidate_hold + m_restart_cost;
+				cost += (uint64_t)m_bin_weights[b] * interval_cost;
+			}
+
+			if (cost < best_cost) {
+				best_cost = cost;
+				hold = candidate_hold;
+			}
+		}
+	}
+
+	hold = hold_clamp(hold);
+	if (hold != m_hold) {
+		m_hold = hold;
+		set_sensor_value('h', (int32_t)m_hold, false);
+	}
+}
+
+void psu_hold_init(void)
+{
+	for (int b = 0; b < PSU_HOLD_BINS; b++) {
+		m_bin_weights[b] = 0;
+	}
+	m_intervals = 0;
+	m_restart_cost = PSU_HOLD_RESTART_COST;
+	m_hold = hold_clamp(m_restart_cost);
+
+	set_sensor_value('R', (int32_t)m_restart_cost, false);
+	set_sensor_value('h', (int32_t)m_hold, false);
+}
+
+void psu_hold_off_interval_add(uint32_t interval)
+{
+	int bin = PSU_HOLD_BINS - 1;
+	while (interval < m_bin_edges[bin]) {
+		bin--;
+	}
+
+	// older intervals fade by 1/2^PSU_HOLD_DECAY_SHIFT with every new one
+	for (int b = 0; b < PSU_HOLD_BINS; b++) {
+		m_bin_weights[b] -= m_bin_weights[b] >> PSU_HOLD_DECAY_SHIFT;
+		if (b == bin)
+			m_bin_weights[b] += PSU_HOLD_WEIGHT_ONE;
+	}
+
+	// counted rather than read off the decayed weights, which lag the count
+	if (m_intervals < PSU_HOLD_INTERVALS_MIN)
+		m_intervals++;
+
+	hold_update();
+}
+
+uint32_t psu_hold_time_get(void)
+{
+	return m_hold;
+}
+
+void psu_hold_restart_cost_set(char sensor_name, int32_t sensor_value)
+{
+	if (sensor_value < 0)
+		sensor_value = 0;
+
+	m_restart_cost = (uint32_t)sensor_value;
+	set_sensor_value(sensor_name, sensor_value, false);
+
+	hold_update();
+}
@@ -0,0 +1,24 @@
+#ifndef PSU_HOLD_H__
+#define PSU_HOLD_H__
+
+#include <stdint.h>
+
+/**@brief Adaptive PSU hold: how long the PSU stays powered after the outputs go off.
+ *
+ * @details Recent off intervals are kept in a decaying histogram with doubling bins. The hold is the bin
+ *          edge that minimises the expected standby time plus the cost of a restart for every interval
+ *          the PSU is not held through. The restart cost, in milliseconds of standby, is the writable
+ *          sensor 'R', the chosen hold is reported as 'h'.
+ */
+
+void psu_hold_init(void);
+
+/**@brief Adds the time from the outputs going off until they were requested again. */
+void psu_hold_off_interval_add(uint32_t interval);
+
+/**@brief Milliseconds to keep the PSU powered after the outputs go off. */
+uint32_t psu_hold_time_get(void);
+
+void psu_hold_restart_cost_set(char sensor_name, int32_t sensor_value);
+
+#endif /* PSU_HOLD_H__ */
@@ -0,0 +1,34 @@
+#include "router_policy.h"
+
+#include "settings.h"
+
+router_policy_decision_t router_policy_decide(bool *p_dense, uint8_t routers, uint8_t children, uint32_t frames)
+{
+	if (routers >= ROUTER_POLICY_DENSE_ROUTERS)
+		*p_dense = true;
+	else if (routers + ROUTER_POLICY_DENSE_HYSTERESIS < ROUTER_POLICY_DENSE_ROUTERS)
+		*p_dense = false;
+
+	if (!*p_dense)
+		return ROUTER_POLICY_SPARSE;
+
+	// routers with children or forwarded traffic stay eager, quiet ones leave the slots to them
+	bool busy = children > 0 || frames >= ROUTER_POLICY_BUSY_FRAMES;
+	return busy ? ROUTER_POLICY_DENSE_BUSY : ROUTER_POLICY_DENSE_QUIET;
+}
+
+void router_policy_params_get(router_policy_decision_t decision, const router_policy_params *p_defaults,
+							  router_policy_params *p_params)
+{
+	*p_params = *p_defaults;
+
+	if (decision != ROUTER_POLICY_DENSE_BUSY && decision != ROUTER_POLICY_DENSE_QUIET)
+		return;
+
+	p_params->upgrade_threshold = ROUTER_POLICY_UPGRADE_THRESHOLD;
+	p_params->downgrade_threshold = ROUTER_POLICY_DOWNGRADE_THRESHOLD;
+
+	uint8_t jitter = decision == ROUTER_POLICY_DENSE_QUIET ? ROUTER_POLICY_JITTER_QUIET : ROUTER_POLICY_JITTER_BUSY;
+	if (jitter > p_defaults->jitter)
+		p_params->jitter = jitter;
+}
@@ -0,0 +1,43 @@
+#ifndef ROUTER_POLICY_H__
+#define ROUTER_POLICY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Router selection decision, without OpenThread so that it builds on the host.
+ *
+ * @details The area is dense once ROUTER_POLICY_DENSE_ROUTERS routers are heard with a good link, and sparse
+ *          again below ROUTER_POLICY_DENSE_ROUTERS - ROUTER_POLICY_DENSE_HYSTERESIS. A dense area lowers the
+ *          router upgrade and downgrade thresholds, which OpenThread compares against the active routers of
+ *          the partition, and a quiet node without children waits longer before it becomes a router, so busy
+ *          nodes are promoted first. A sparse area keeps the OpenThread values.
+ */
+
+typedef enum
+{
+	ROUTER_POLICY_NONE = 0, // sleepy, or not attached yet
+	ROUTER_POLICY_SPARSE,
+	ROUTER_POLICY_DENSE_BUSY,
+	ROUTER_POLICY_DENSE_QUIET,
+} router_policy_decision_t;
+
+typedef struct router_policy_params
+{
+	uint8_t upgrade_threshold;
+	uint8_t downgrade_threshold;
+	uint8_t jitter;           // seconds
+} router_policy_params;
+
+/**@brief Decides from the routers heard with a good link, the children and the frames of the last interval.
+ *
+ * @param[inout] p_dense  Whether the area was dense, updated with the hysteresis.
+ */
+router_policy_decision_t router_policy_decide(bool *p_dense, uint8_t routers, uint8_t children, uint32_t frames);
+
+/**@brief Thresholds and jitter of a decision, the OpenThread defaults for ROUTER_POLICY_NONE and SPARSE.
+ *        The jitter is never shorter than the default one.
+ */
+void router_policy_params_get(router_policy_decision_t decision, const router_policy_params *p_defaults,
+							  router_policy_params *p_params);
+
+#endif /* ROUTER_POLICY_H__ */
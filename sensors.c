@@ -0,0 +1,108 @@
+#include "sensors.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define SENSOR_DESCRIPTOR(id, name, lname, ro, handler) \
+	[SENSOR_INDEX(id)] = { .sensor_name = name, .long_name = lname, .set_value_handler = handler, },
+
+#define SENSOR_LONG_NAME_SIZE_CHECK(id, name, lname, ro, handler) \
+	_Static_assert(sizeof(lname) <= SENSOR_LONG_NAME_MAX + 1, "long name of sensor " #id " is too long");
+
+#define SENSOR_REPORT_INTERVAL(id, name, lname, ro, handler) \
+	[SENSOR_INDEX(id)] = SENSOR_DEFAULT_REPORT_INTERVAL / SENSOR_REPORT_INTERVAL_UNIT,
+
+const sensor_descriptor sensor_descriptors[SENSORS_COUNT] = {
+	SENSOR_LIST(SENSOR_DESCRIPTOR)
+};
+
+SENSOR_LIST(SENSOR_LONG_NAME_SIZE_CHECK)
+
+int32_t sensor_current_values[SENSORS_COUNT];
+int32_t sensor_sent_values[SENSORS_COUNT];
+int32_t sensor_reportable_changes[SENSORS_COUNT];
+uint16_t sensor_report_intervals[SENSORS_COUNT] = {
+	SENSOR_LIST(SENSOR_REPORT_INTERVAL)
+};
+uint32_t sensor_last_sent_at[SENSORS_COUNT];
+
+sensor_mask_t sensor_initialized_mask = 0;
+sensor_mask_t sensor_disable_reporting_mask = SENSORS_ALL_MASK;
+
+static uint32_t m_long_name_hashes[SENSORS_COUNT];
+static bool m_long_name_hashes_ready = false;
+
+static uint32_t long_name_hash(const char *p_name, size_t length)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (uint8_t)p_name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+int16_t get_sensor_index_by_long_name(const char *p_long_name, size_t length)
+{
+	if (length > SENSOR_LONG_NAME_MAX)
+		return -1;
+
+	if (!m_long_name_hashes_ready) {
+		for (int i = 0; i < SENSORS_COUNT; i++) {
+			m_long_name_hashes[i] = long_name_hash(sensor_descriptors[i].long_name, strlen(sensor_descriptors[i].long_name));
+		}
+		m_long_name_hashes_ready = true;
+	}
+
+	uint32_t hash = long_name_hash(p_long_name, length);
+	for (int i = 0; i < SENSORS_COUNT; i++) {
+		if (m_long_name_hashes[i] != hash)
+			continue;
+		if (strncmp(sensor_descriptors[i].long_name, p_long_name, length) == 0 && sensor_descriptors[i].long_name[length] == 0)
+			return i;
+	}
+	return -1;
+}
+
+bool set_sensor_value(char sensor_name, int32_t sensor_value, bool external_request)
+{
+	int16_t i = get_sensor_index(sensor_name);
+	if (i == -1)
+		return false;
+
+	sensor_initialized_mask |= SENSOR_MASK(i);
+	sensor_current_values[i] = sensor_value;
+	if (external_request) {
+		sensor_sent_values[i] = sensor_value;
+		if (sensor_descriptors[i].set_value_handler)
+			sensor_descriptors[i].set_value_handler(sensor_name, sensor_value);
+	}
+	return true;
+}
+
+bool get_sensor_value(char sensor_name, int32_t *p_sensor_value)
+{
+	int16_t i = get_sensor_index(sensor_name);
+	if (i == -1)
+		return false;
+	if ((sensor_initialized_mask & SENSOR_MASK(i)) == 0)
+		return false;
+	*p_sensor_value = sensor_current_values[i];
+	return true;
+}
+
+bool is_sensor_readonly(char sensor_name)
+{
+	int16_t i = get_sensor_index(sensor_name);
+	if (i == -1)
+		return true;
+	return (SENSORS_READ_ONLY_MASK & SENSOR_MASK(i)) != 0;
+}
+
+void set_sensor_report_interval(int16_t sensor_index, uint32_t report_interval)
+{
+	uint32_t steps = (report_interval + SENSOR_REPORT_INTERVAL_UNIT - 1) / SENSOR_REPORT_INTERVAL_UNIT;
+	if (steps > UINT16_MAX)
+		steps = UINT16_MAX;
+	sensor_report_intervals[sensor_index] = (uint16_t)steps;
+}
@@ -0,0 +1,117 @@
+#ifndef SENSORS_H__
+#define SENSORS_H__
+
+#include "settings.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*sensor_set_value_handler_t)(char sensor_name, int32_t sensor_value);
+
+#define SENSOR_CHANNEL(X, id, name, lname, pin, instance, current) X(id, name, lname, false, pwm_set_brightness)
+
+/**@brief Sensor definitions.
+ *
+ * @details X(id, sensor_name, long_name, read_only, set_value_handler). The descriptor table, the runtime
+ *          state arrays and the name to index lookup are all generated from this list. The channel sensors
+ *          come first, from DIMMER_CHANNELS in settings.h, so a channel number is also its sensor index.
+ *
+ *          On the wire a sensor is addressed by its one-character name, by its long name, or by its
+ *          index as a CBOR unsigned integer. The long names are published in /info.
+ */
+#define SENSOR_LIST(X) \
+	DIMMER_CHANNELS(SENSOR_CHANNEL, X) \
+	X(v, 'v', "vdd",          true,  NULL) \
+	X(V, 'V', "rail",         true,  NULL) \
+	X(t, 't', "temperature",  true,  NULL) \
+	X(p, 'p', "psu",          true,  NULL) \
+	X(P, 'P', "power",        true,  NULL) \
+	X(E, 'E', "energy",       true,  NULL) \
+	X(o, 'o', "overcurrent",  true,  NULL) \
+	X(d, 'd', "derating",     true,  NULL) \
+	X(T, 'T', "derate_limit", false, thermal_threshold_set) \
+	X(H, 'H', "hsv",          false, colour_hsv_set) \
+	X(C, 'C', "cct",          false, colour_cct_set) \
+	X(x, 'x', "xy",           false, colour_xy_set) \
+	X(f, 'f', "fade",         false, colour_fade_time_set) \
+	X(F, 'F', "effect",       false, effect_state_set) \
+	X(m, 'm', "pwm_mode",     false, pwm_mode_set) \
+	X(h, 'h', "psu_hold",     true,  NULL) \
+	X(R, 'R', "restart_cost", false, psu_hold_restart_cost_set)
+
+#define SENSOR_LONG_NAME_MAX           16
+
+#define SENSOR_DEFAULT_REPORT_INTERVAL 10000
+#define SENSOR_REPORT_INTERVAL_UNIT    100 // milliseconds per report interval step
+
+#define SENSOR_INDEX(id) SENSOR_INDEX_##id
+
+#define SENSOR_INDEX_ENUM(id, name, lname, read_only, handler) SENSOR_INDEX(id),
+
+typedef enum
+{
+	SENSOR_LIST(SENSOR_INDEX_ENUM)
+	SENSORS_COUNT
+} sensor_index_t;
+
+typedef uint64_t sensor_mask_t;
+
+#define SENSOR_MASK(index) ((sensor_mask_t)1 << (index))
+#define SENSORS_ALL_MASK   (SENSOR_MASK(SENSORS_COUNT) - 1)
+
+#define SENSOR_READ_ONLY_BIT(id, name, lname, read_only, handler) | ((read_only) ? SENSOR_MASK(SENSOR_INDEX(id)) : 0)
+
+#define SENSORS_READ_ONLY_MASK ((sensor_mask_t)0 SENSOR_LIST(SENSOR_READ_ONLY_BIT))
+
+_Static_assert(SENSORS_COUNT < sizeof(sensor_mask_t) * 8, "sensor_mask_t is too narrow for SENSOR_LIST");
+
+typedef struct sensor_descriptor
+{
+	char sensor_name;
+	const char *long_name;
+	sensor_set_value_handler_t set_value_handler;
+} sensor_descriptor;
+
+extern const sensor_descriptor sensor_descriptors[SENSORS_COUNT];
+
+/**@brief Sensor runtime state, stored as parallel arrays indexed by sensor_index_t. */
+extern int32_t sensor_current_values[SENSORS_COUNT];
+extern int32_t sensor_sent_values[SENSORS_COUNT];
+extern int32_t sensor_reportable_changes[SENSORS_COUNT];
+extern uint16_t sensor_report_intervals[SENSORS_COUNT]; // in SENSOR_REPORT_INTERVAL_UNIT steps
+extern uint32_t sensor_last_sent_at[SENSORS_COUNT];
+
+extern sensor_mask_t sensor_initialized_mask;
+extern sensor_mask_t sensor_disable_reporting_mask;
+
+void pwm_set_brightness(char sensor_name, int32_t sensor_value);
+void pwm_mode_set(char sensor_name, int32_t sensor_value);
+void thermal_threshold_set(char sensor_name, int32_t sensor_value);
+void colour_hsv_set(char sensor_name, int32_t sensor_value);
+void colour_cct_set(char sensor_name, int32_t sensor_value);
+void colour_xy_set(char sensor_name, int32_t sensor_value);
+void colour_fade_time_set(char sensor_name, int32_t sensor_value);
+void effect_state_set(char sensor_name, int32_t sensor_value);
+void psu_hold_restart_cost_set(char sensor_name, int32_t sensor_value);
+
+#define SENSOR_INDEX_CASE(id, name, lname, read_only, handler) case name: return SENSOR_INDEX(id);
+
+static inline int16_t get_sensor_index(char sensor_name)
+{
+	switch (sensor_name) {
+		SENSOR_LIST(SENSOR_INDEX_CASE)
+		default:
+			return -1;
+	}
+}
+
+/**@brief Looks up a sensor by its long name, returns -1 when there is no such sensor. */
+int16_t get_sensor_index_by_long_name(const char *p_long_name, size_t length);
+
+bool set_sensor_value(char sensor_name, int32_t sensor_value, bool external_request);
+bool get_sensor_value(char sensor_name, int32_t *p_sensor_value);
+bool is_sensor_readonly(char sensor_name);
+void set_sensor_report_interval(int16_t sensor_index, uint32_t report_interval);
+
+#endif /* SENSORS_H__ */
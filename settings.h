@@ -5,15 +5,51 @@
 #define INFO_FIRMWARE_VERSION                "1.1.1"
 
 #define SUBSCRIPTION_TIMER_INTERVAL          500
+#define WAKEUP_TOLERANCE_SHIFT               2 // a periodic wakeup may run up to period >> shift late to share a CPU wakeup
+#define SUBSCRIPTION_BROADCAST_INTERVAL_MIN  1000 // first /up retry interval, doubled after every broadcast
+#define SUBSCRIPTION_BROADCAST_INTERVAL_MAX  60000
+#define COAP_OBSERVERS_MAX                   8
+#define COAP_OBSERVE_CON_INTERVAL            3600000 // milliseconds between confirmable notifications, RFC 7641 allows up to 24 h
+#define COAP_BLOCK_SZX                       3 // block size 16 << szx, 128 bytes
+#define COAP_BLOCK_UNFRAGMENTED_MAX          200 // larger responses are sent with Block2
+#define BLOCK_WRITER_SCRATCH_SIZE            48
+#define COAP_DEDUP_CACHE_SIZE                4
+#define COAP_DEDUP_LIFETIME                  247000 // milliseconds, CoAP EXCHANGE_LIFETIME
+#define COAP_SEPARATE_RESPONSE_TIMEOUT       3000 // milliseconds before a held back /set response is sent anyway
+#define TIMESYNC_BEACON_INTERVAL             10000 // milliseconds between leader time beacons
+#define TIMESYNC_STEP_MIN                    500 // milliseconds, a larger beacon error steps the clock instead of slewing it
+#define TIMESYNC_SKEW_MAX                    1000 // ppm
+#define TIMESYNC_SKEW_SAMPLE_INTERVAL        60000 // milliseconds, the least delayed beacon of each is a skew sample
+#define TIMESYNC_SKEW_SAMPLES                8 // skew samples kept, the estimate spans up to 7 sample intervals
+#define TIMESYNC_SKEW_SAMPLES_MIN            3
+#define TIMESYNC_SED_SYNC_INTERVAL           600000 // milliseconds, a sleepy end device takes one beacon this often
+#define TIMESYNC_SED_WINDOW                  2000 // milliseconds of fast polling around the expected beacon
+#define TIMESYNC_SED_POLL_PERIOD             100 // poll period in the window, the most a taken beacon is delayed
+#define ROUTER_POLICY_INTERVAL               60000 // milliseconds between router policy decisions
+#define ROUTER_POLICY_LINK_QUALITY_MIN       2 // routers heard with a worse incoming link are not counted
+#define ROUTER_POLICY_DENSE_ROUTERS          6 // routers heard with a good link that make the area dense
+#define ROUTER_POLICY_DENSE_HYSTERESIS       2 // the area is sparse again below DENSE_ROUTERS - HYSTERESIS
+#define ROUTER_POLICY_BUSY_FRAMES            600 // frames sent and received per interval that make a node busy
+#define ROUTER_POLICY_UPGRADE_THRESHOLD      10 // dense area, the OpenThread default is 16
+#define ROUTER_POLICY_DOWNGRADE_THRESHOLD    14 // dense area, the OpenThread default is 23
+#define ROUTER_POLICY_JITTER_BUSY            120 // seconds of router selection jitter, the OpenThread default is 120
+#define ROUTER_POLICY_JITTER_QUIET           240
 #define INTERNAL_TEMPERATURE_TIMER_INTERVAL  1000
 #define VOLTAGE_TIMER_INTERVAL               1000
+#define PSU_CONTROL_TIMER_INTERVAL           50
+#define PSU_CONTROL_TIMER_FAST_INTERVAL      5 // while the PSU powers up and the outputs ramp
+#define PSU_CONTROL_TIMER_IDLE_INTERVAL      1000 // PSU off and nothing pending, requests kick the control loop at once
 
-#define DEFAULT_POLL_PERIOD                  120000
-#define DEFAULT_POLL_PERIOD_FAST             50
+#define DEFAULT_POLL_PERIOD                  120000 // idle poll period of a sleepy end device
+#define DEFAULT_POLL_PERIOD_FAST             50 // after a request or a report
 #define DEFAULT_POLL_PERIOD_FAST_TIMEOUT     500
-#define DEFAULT_CHILD_TIMEOUT                240
+#define POLL_PERIOD_BACKOFF_POLLS            2 // polls at each period before it doubles
+#define DEFAULT_CHILD_TIMEOUT                240 // seconds, longer than DEFAULT_POLL_PERIOD
 
-#define ADC_SAMPLES_PER_CHANNEL              32
+#define ADC_OVERSAMPLE                       NRF_SAADC_OVERSAMPLE_32X // averaged in hardware, one burst takes about 2.7 ms
+#define ADC_SAMPLES_PER_CHANNEL              1
+#define ADC_FAST_SAMPLES_PER_CHANNEL         1 // scans per buffer while the PSU powers up
+#define ADC_FAST_SAMPLE_INTERVAL             4 // milliseconds between scans while the PSU powers up, longer than a burst
 
 #define LED_SEND_NOTIFICATION                BSP_BOARD_LED_0
 #define LED_RECV_NOTIFICATION                BSP_BOARD_LED_1
@@ -21,16 +57,60 @@
 #define LED_CHILD_ROLE                       BSP_BOARD_LED_3
 
 // #define DISABLE_OT_ROLE_LIGHTS               1
+// #define SLEEPY_END_DEVICE                    1 // battery SKU, joins as a sleepy end device, see the Release SED configuration
 // #define DISABLE_OT_TRAFFIC_LIGHTS            1
 
-#define DIMMER_CHANNEL_PIN_R                 LED2_DR // pwm channel 0
-#define DIMMER_CHANNEL_PIN_G                 LED2_DG // pwm channel 1
-#define DIMMER_CHANNEL_PIN_B                 LED2_DB // pwm channel 2
-#define DIMMER_CHANNEL_PIN_W                 LED2_DW // pwm channel 3
+#define DIMMER_CHANNEL_PIN_R                 LED2_DR
+#define DIMMER_CHANNEL_PIN_G                 LED2_DG
+#define DIMMER_CHANNEL_PIN_B                 LED2_DB
+#define DIMMER_CHANNEL_PIN_W                 LED2_DW
+
+// X(arg, id, sensor_name, long_name, pin, pwm_instance, current_ma), arg is passed through for nested lists.
+// Up to four channels per PWM instance 0-3, the instance must be enabled in sdk_config.h. current_ma is the
+// channel current at full duty for the energy meter, calibrate per fixture.
+#define DIMMER_CHANNELS(X, arg) \
+	X(arg, r, 'r', "red",   DIMMER_CHANNEL_PIN_R, 0, 1000) \
+	X(arg, g, 'g', "green", DIMMER_CHANNEL_PIN_G, 0, 1000) \
+	X(arg, b, 'b', "blue",  DIMMER_CHANNEL_PIN_B, 0, 1000) \
+	X(arg, w, 'w', "white", DIMMER_CHANNEL_PIN_W, 0, 1000)
+
 #define DIMMER_PWM_INVERSION                 0 // NRF_DRV_PWM_PIN_INVERTED
+#define DIMMER_PWM_MODE_DEFAULT              0 // HAL_PWM_OUT_MODE_STAGGERED | HAL_PWM_OUT_MODE_CENTRED spread the switching edges
 
 #define DIMMER_PSU_ENABLE_PIN                PSU_ENABLE_PIN
-#define DIMMER_PSU_ON_TIMEOUT                1000 // milliseconds before enabling pwm after powering up psu
-#define DIMMER_PSU_OFF_TIMEOUT               10000 // milliseconds before powering off psu after disabling pwm
+#define DIMMER_PSU_ON_TIMEOUT                1000 // milliseconds before enabling pwm when the rail is not seen settling
+#define DIMMER_RAIL_READY_MV                 10800 // rail level of a powered up psu
+#define DIMMER_RAIL_TOLERANCE_MV             100 // largest change between two ADC buffers of a settled rail
+#define DIMMER_RAIL_STABLE_BUFFERS           3 // settled ADC buffers in a row before enabling pwm
+#define DIMMER_RAIL_SAG_MV                   300 // the soft-start ramp holds while the rail is this far below its settled level
+#define DIMMER_SOFT_START_TIME               40 // milliseconds of ramp from off to the requested duty
+#define PSU_HOLD_RESTART_COST                10000 // default cost of a psu restart in milliseconds of standby, sensor 'R'
+#define PSU_HOLD_MIN                         500 // milliseconds, shortest time the psu stays on after the outputs go off
+#define PSU_HOLD_MAX                         128000 // milliseconds, longest
+#define PSU_HOLD_INTERVALS_MIN               4 // off intervals seen before the hold follows the history
+#define PSU_HOLD_DECAY_SHIFT                 4 // each new off interval fades the history by 1/16
+
+#define PROTECTION_LPCOMP_REFERENCE          NRF_LPCOMP_REF_SUPPLY_4_8 // trip level, half of VDD, used with PROTECTION_SENSE_INPUT
+
+#define THERMAL_DERATING_THRESHOLD           (70 * 4) // 0.25 degree Celsius units, same as sensor 't'
+#define THERMAL_DERATING_THRESHOLD_MIN       (-40 * 4) // limits of a threshold written to 'T', the nRF52840 operating range
+#define THERMAL_DERATING_THRESHOLD_MAX       (85 * 4)
+#define THERMAL_DERATING_KP                  8 // scale reduction in 1/1024 per 0.25 degree above the threshold
+#define THERMAL_DERATING_KI                  1 // integral gain per 0.25 degree and temperature period
+#define THERMAL_DERATING_SCALE_MIN           256 // 1/1024 units, output is never derated below 25 %
+
+#define COLOUR_MIRED_MIN                     150 // 6667 K
+#define COLOUR_MIRED_MAX                     500 // 2000 K
+#define COLOUR_DEFAULT_FADE_TIME             500 // milliseconds
+
+#define EFFECT_KEYFRAMES_MAX                 32
+#define EFFECT_REQUEST_SIZE_MAX              512 // bytes, an /fx request with EFFECT_KEYFRAMES_MAX keyframes fits
+#define EFFECT_DURATION_MAX                  3600000 // milliseconds, keeps the position in microseconds within 32 bits
+
+#define NVM_PAGE_ADDRESS                     0xF3000 // flash page below the OpenThread settings, see emProject segments
+
+#define ENERGY_RAIL_UV_PER_LSB               1318 // 3.6 V / 16384 LSB x 6 rail divider, microvolts
+#define ENERGY_SAMPLE_GAP_MAX                5000 // milliseconds, longer gaps between ADC buffers are not integrated in full
+#define ENERGY_CHECKPOINT_INTERVAL           3600000 // milliseconds between flash checkpoints
 
 #endif // __SETTINGS__H__
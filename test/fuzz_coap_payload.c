@@ -0,0 +1,113 @@
+#include "coap_payload.h"
+
+#include <stdlib.h>
+
+/**@brief libFuzzer target for the CoAP payload decoders.
+ *
+ * @details The first byte picks the decoder: 's' /set, 'g' /get, 'u' /sub, 'f' /fx, 't' time beacon, any
+ *          other value runs the rest of the input through all of them. A decoder that accepts the input
+ *          must leave a request the handlers can apply without further checks.
+ */
+
+static void set_check(const uint8_t *p_data, size_t size)
+{
+	set_request request;
+	if (!coap_payload_set_parse(p_data, size, &request))
+		return;
+
+	if (request.count > SET_REQUEST_ITEMS_MAX)
+		abort();
+	for (int i = 0; i < request.count; i++) {
+		int16_t sensor_index = request.items[i].sensor_index;
+		if (sensor_index < 0 || sensor_index >= SENSORS_COUNT || (SENSORS_READ_ONLY_MASK & SENSOR_MASK(sensor_index)))
+			abort();
+	}
+
+	// the handler and the dedup cache hold the echo of every accepted request
+	uint8_t response[SET_RESPONSE_SIZE_MAX];
+	if (coap_payload_set_response_encode(&request, response, sizeof(response)) == 0)
+		abort();
+}
+
+static void get_check(const uint8_t *p_data, size_t size)
+{
+	sensor_mask_t sensors;
+	if (!coap_payload_get_parse(p_data, size, &sensors))
+		return;
+
+	if (sensors & ~SENSORS_ALL_MASK)
+		abort();
+}
+
+static void sub_check(const uint8_t *p_data, size_t size)
+{
+	sub_request request;
+	if (!coap_payload_sub_parse(p_data, size, &request))
+		return;
+
+	if (request.count > SUB_REQUEST_ITEMS_MAX)
+		abort();
+	for (int i = 0; i < request.count; i++) {
+		const sub_request_item *p_item = &request.items[i];
+		if (p_item->sensor_index < 0 || p_item->sensor_index >= SENSORS_COUNT)
+			abort();
+		if ((p_item->interval_present && p_item->interval > INT32_MAX) || (p_item->change_present && p_item->change < 0))
+			abort();
+	}
+}
+
+static void fx_check(const uint8_t *p_data, size_t size)
+{
+	fx_request request;
+	if (!coap_payload_fx_parse(p_data, size, &request))
+		return;
+
+	if (request.count > EFFECT_KEYFRAMES_MAX)
+		abort();
+	for (int i = 0; i < request.count; i++) {
+		if (request.keyframes[i].time > EFFECT_DURATION_MAX)
+			abort();
+	}
+}
+
+static void timesync_check(const uint8_t *p_data, size_t size)
+{
+	uint32_t network_time;
+	coap_payload_timesync_parse(p_data, size, &network_time);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *p_data, size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	const uint8_t *p_payload = p_data + 1;
+	size_t payload_size = size - 1;
+
+	switch (p_data[0]) {
+		case 's':
+			set_check(p_payload, payload_size);
+			break;
+		case 'g':
+			get_check(p_payload, payload_size);
+			break;
+		case 'u':
+			sub_check(p_payload, payload_size);
+			break;
+		case 'f':
+			fx_check(p_payload, payload_size);
+			break;
+		case 't':
+			timesync_check(p_payload, payload_size);
+			break;
+		default:
+			set_check(p_payload, payload_size);
+			get_check(p_payload, payload_size);
+			sub_check(p_payload, payload_size);
+			fx_check(p_payload, payload_size);
+			timesync_check(p_payload, payload_size);
+			break;
+	}
+
+	return 0;
+}
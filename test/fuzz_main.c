@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**@brief Stand-alone driver for the fuzz targets where libFuzzer is not available (GCC).
+ *
+ * @details Runs every input file given on the command line, then FUZZ_MUTATIONS deterministic mutations of
+ *          each: bit flips, byte replacements with CBOR boundary values, insertions, deletions and
+ *          truncations. Built with the sanitizers it catches the same faults, only less efficiently.
+ */
+
+#define FUZZ_INPUT_MAX  1024
+#define FUZZ_MUTATIONS  20000
+
+int LLVMFuzzerTestOneInput(const uint8_t *p_data, size_t size);
+
+static uint32_t m_random = 0x12345678;
+
+static uint32_t random_next(void)
+{
+	// xorshift32
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return m_random;
+}
+
+static const uint8_t m_interesting[] = { 0x00, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1F, 0x20, 0x3B, 0x40, 0x5F, 0x60, 0x7F,
+	0x80, 0x9F, 0xA0, 0xBF, 0xC0, 0xE0, 0xF4, 0xF7, 0xFF };
+
+static size_t mutate(uint8_t *p_data, size_t size)
+{
+	uint32_t position = size ? random_next() % size : 0;
+
+	switch (random_next() % 5) {
+		case 0:
+			if (size)
+				p_data[position] ^= (uint8_t)(1 << (random_next() % 8));
+			break;
+		case 1:
+			if (size)
+				p_data[position] = m_interesting[random_next() % sizeof(m_interesting)];
+			break;
+		case 2:
+			if (size < FUZZ_INPUT_MAX) {
+				memmove(&p_data[position + 1], &p_data[position], size - position);
+				p_data[position] = (uint8_t)random_next();
+				size++;
+			}
+			break;
+		case 3:
+			if (size > 1) {
+				memmove(&p_data[position], &p_data[position + 1], size - position - 1);
+				size--;
+			}
+			break;
+		default:
+			size = position + 1 < size ? position + 1 : size;
+			break;
+	}
+
+	return size;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t seed[FUZZ_INPUT_MAX];
+	static uint8_t input[FUZZ_INPUT_MAX];
+
+	for (int i = 1; i < argc; i++) {
+		FILE *p_file = fopen(argv[i], "rb");
+		if (p_file == NULL) {
+			fprintf(stderr, "cannot open %s\n", argv[i]);
+			return 1;
+		}
+		size_t seed_size = fread(seed, 1, sizeof(seed), p_file);
+		fclose(p_file);
+
+		LLVMFuzzerTestOneInput(seed, seed_size);
+
+		size_t size = seed_size;
+		memcpy(input, seed, size);
+		for (int n = 0; n < FUZZ_MUTATIONS; n++) {
+			// stack a few mutations, then start over from the seed
+			if (n % 8 == 0) {
+				size = seed_size;
+				memcpy(input, seed, size);
+			}
+			size = mutate(input, size);
+			LLVMFuzzerTestOneInput(input, size);
+		}
+	}
+
+	printf("%d inputs, %d mutations each\n", argc - 1, FUZZ_MUTATIONS);
+	return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "sdk_sim.h"
+
+#endif // APP_ERROR_H__
@@ -0,0 +1,10 @@
+#ifndef BOARDS_H__
+#define BOARDS_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "nrf_gpio.h"
+
+#include "efekta_mini_dev_board.h"
+
+#endif // BOARDS_H__
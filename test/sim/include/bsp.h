@@ -0,0 +1,10 @@
+#ifndef BSP_H__
+#define BSP_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "sdk_sim.h"
+
+#include "boards.h"
+
+#endif // BSP_H__
@@ -0,0 +1,8 @@
+#ifndef BSP_THREAD_H__
+#define BSP_THREAD_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "sdk_sim.h"
+
+#endif // BSP_THREAD_H__
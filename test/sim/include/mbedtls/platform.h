@@ -0,0 +1,7 @@
+#ifndef MBEDTLS_PLATFORM_H
+#define MBEDTLS_PLATFORM_H
+
+// Stand-in for the mbed TLS header of the same name, see test/sim/README.md. The simulated OpenThread
+// is built with OPENTHREAD_CONFIG_ENABLE_BUILTIN_MBEDTLS, the platform hooks are not called.
+
+#endif // MBEDTLS_PLATFORM_H
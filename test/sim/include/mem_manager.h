@@ -0,0 +1,8 @@
+#ifndef MEM_MANAGER_H__
+#define MEM_MANAGER_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "sdk_sim.h"
+
+#endif // MEM_MANAGER_H__
@@ -0,0 +1,8 @@
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "sdk_sim.h"
+
+#endif // NRF_GPIO_H__
@@ -0,0 +1,10 @@
+#ifndef OPENTHREAD_CLI_H_
+#define OPENTHREAD_CLI_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+void otCliUartInit(otInstance *aInstance);
+
+#endif // OPENTHREAD_CLI_H_
@@ -0,0 +1,139 @@
+#ifndef OPENTHREAD_COAP_H_
+#define OPENTHREAD_COAP_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/ip6.h>
+#include <openthread/message.h>
+
+#define OT_DEFAULT_COAP_PORT         5683
+#define OT_COAP_DEFAULT_TOKEN_LENGTH 2
+#define OT_COAP_MAX_TOKEN_LENGTH     8
+
+typedef enum otCoapType
+{
+	OT_COAP_TYPE_CONFIRMABLE     = 0,
+	OT_COAP_TYPE_NON_CONFIRMABLE = 1,
+	OT_COAP_TYPE_ACKNOWLEDGMENT  = 2,
+	OT_COAP_TYPE_RESET           = 3,
+} otCoapType;
+
+#define OT_COAP_CODE(c, d) ((((c)&0x7) << 5) | ((d)&0x1f))
+
+typedef enum otCoapCode
+{
+	OT_COAP_CODE_EMPTY                  = OT_COAP_CODE(0, 0),
+	OT_COAP_CODE_GET                    = OT_COAP_CODE(0, 1),
+	OT_COAP_CODE_POST                   = OT_COAP_CODE(0, 2),
+	OT_COAP_CODE_PUT                    = OT_COAP_CODE(0, 3),
+	OT_COAP_CODE_DELETE                 = OT_COAP_CODE(0, 4),
+	OT_COAP_CODE_RESPONSE_MIN           = OT_COAP_CODE(2, 0),
+	OT_COAP_CODE_CREATED                = OT_COAP_CODE(2, 1),
+	OT_COAP_CODE_DELETED                = OT_COAP_CODE(2, 2),
+	OT_COAP_CODE_VALID                  = OT_COAP_CODE(2, 3),
+	OT_COAP_CODE_CHANGED                = OT_COAP_CODE(2, 4),
+	OT_COAP_CODE_CONTENT                = OT_COAP_CODE(2, 5),
+	OT_COAP_CODE_CONTINUE               = OT_COAP_CODE(2, 31),
+	OT_COAP_CODE_BAD_REQUEST            = OT_COAP_CODE(4, 0),
+	OT_COAP_CODE_UNAUTHORIZED           = OT_COAP_CODE(4, 1),
+	OT_COAP_CODE_BAD_OPTION             = OT_COAP_CODE(4, 2),
+	OT_COAP_CODE_FORBIDDEN              = OT_COAP_CODE(4, 3),
+	OT_COAP_CODE_NOT_FOUND              = OT_COAP_CODE(4, 4),
+	OT_COAP_CODE_METHOD_NOT_ALLOWED     = OT_COAP_CODE(4, 5),
+	OT_COAP_CODE_NOT_ACCEPTABLE         = OT_COAP_CODE(4, 6),
+	OT_COAP_CODE_REQUEST_INCOMPLETE     = OT_COAP_CODE(4, 8),
+	OT_COAP_CODE_PRECONDITION_FAILED    = OT_COAP_CODE(4, 12),
+	OT_COAP_CODE_REQUEST_TOO_LARGE      = OT_COAP_CODE(4, 13),
+	OT_COAP_CODE_UNSUPPORTED_FORMAT     = OT_COAP_CODE(4, 15),
+	OT_COAP_CODE_INTERNAL_ERROR         = OT_COAP_CODE(5, 0),
+	OT_COAP_CODE_NOT_IMPLEMENTED        = OT_COAP_CODE(5, 1),
+	OT_COAP_CODE_BAD_GATEWAY            = OT_COAP_CODE(5, 2),
+	OT_COAP_CODE_SERVICE_UNAVAILABLE    = OT_COAP_CODE(5, 3),
+	OT_COAP_CODE_GATEWAY_TIMEOUT        = OT_COAP_CODE(5, 4),
+	OT_COAP_CODE_PROXY_NOT_SUPPORTED    = OT_COAP_CODE(5, 5),
+} otCoapCode;
+
+typedef enum otCoapOptionType
+{
+	OT_COAP_OPTION_IF_MATCH       = 1,
+	OT_COAP_OPTION_URI_HOST       = 3,
+	OT_COAP_OPTION_E_TAG          = 4,
+	OT_COAP_OPTION_IF_NONE_MATCH  = 5,
+	OT_COAP_OPTION_OBSERVE        = 6,
+	OT_COAP_OPTION_URI_PORT       = 7,
+	OT_COAP_OPTION_LOCATION_PATH  = 8,
+	OT_COAP_OPTION_URI_PATH       = 11,
+	OT_COAP_OPTION_CONTENT_FORMAT = 12,
+	OT_COAP_OPTION_MAX_AGE        = 14,
+	OT_COAP_OPTION_URI_QUERY      = 15,
+	OT_COAP_OPTION_ACCEPT         = 17,
+	OT_COAP_OPTION_LOCATION_QUERY = 20,
+	OT_COAP_OPTION_BLOCK2         = 23,
+	OT_COAP_OPTION_BLOCK1         = 27,
+	OT_COAP_OPTION_SIZE2          = 28,
+	OT_COAP_OPTION_PROXY_URI      = 35,
+	OT_COAP_OPTION_PROXY_SCHEME   = 39,
+	OT_COAP_OPTION_SIZE1          = 60,
+} otCoapOptionType;
+
+typedef enum otCoapOptionContentFormat
+{
+	OT_COAP_OPTION_CONTENT_FORMAT_TEXT_PLAIN   = 0,
+	OT_COAP_OPTION_CONTENT_FORMAT_LINK_FORMAT  = 40,
+	OT_COAP_OPTION_CONTENT_FORMAT_OCTET_STREAM = 42,
+	OT_COAP_OPTION_CONTENT_FORMAT_JSON         = 50,
+	OT_COAP_OPTION_CONTENT_FORMAT_CBOR         = 60,
+} otCoapOptionContentFormat;
+
+typedef struct otCoapOption
+{
+	uint16_t mNumber;
+	uint16_t mLength;
+} otCoapOption;
+
+typedef struct otCoapOptionIterator
+{
+	const otMessage *mMessage;
+	otCoapOption mOption;
+	uint16_t mNextOptionOffset;
+} otCoapOptionIterator;
+
+typedef void (*otCoapResponseHandler)(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo, otError aResult);
+typedef void (*otCoapRequestHandler)(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo);
+
+typedef struct otCoapResource
+{
+	const char *mUriPath;
+	otCoapRequestHandler mHandler;
+	void *mContext;
+	struct otCoapResource *mNext;
+} otCoapResource;
+
+otMessage *otCoapNewMessage(otInstance *aInstance, const otMessageSettings *aSettings);
+void otCoapMessageInit(otMessage *aMessage, otCoapType aType, otCoapCode aCode);
+otError otCoapMessageInitResponse(otMessage *aResponse, const otMessage *aRequest, otCoapType aType, otCoapCode aCode);
+otError otCoapMessageSetToken(otMessage *aMessage, const uint8_t *aToken, uint8_t aTokenLength);
+otError otCoapMessageAppendUintOption(otMessage *aMessage, uint16_t aNumber, uint32_t aValue);
+otError otCoapMessageAppendObserveOption(otMessage *aMessage, uint32_t aObserve);
+otError otCoapMessageAppendUriPathOptions(otMessage *aMessage, const char *aUriPath);
+otError otCoapMessageAppendContentFormatOption(otMessage *aMessage, otCoapOptionContentFormat aContentFormat);
+otError otCoapMessageSetPayloadMarker(otMessage *aMessage);
+otCoapType otCoapMessageGetType(const otMessage *aMessage);
+otCoapCode otCoapMessageGetCode(const otMessage *aMessage);
+uint16_t otCoapMessageGetMessageId(const otMessage *aMessage);
+uint8_t otCoapMessageGetTokenLength(const otMessage *aMessage);
+const uint8_t *otCoapMessageGetToken(const otMessage *aMessage);
+
+otError otCoapOptionIteratorInit(otCoapOptionIterator *aIterator, const otMessage *aMessage);
+const otCoapOption *otCoapOptionIteratorGetFirstOptionMatching(otCoapOptionIterator *aIterator, uint16_t aOption);
+const otCoapOption *otCoapOptionIteratorGetNextOptionMatching(otCoapOptionIterator *aIterator, uint16_t aOption);
+otError otCoapOptionIteratorGetOptionValue(otCoapOptionIterator *aIterator, void *aValue);
+
+otError otCoapSendRequest(otInstance *aInstance, otMessage *aMessage, const otMessageInfo *aMessageInfo,
+	otCoapResponseHandler aHandler, void *aContext);
+otError otCoapSendResponse(otInstance *aInstance, otMessage *aMessage, const otMessageInfo *aMessageInfo);
+otError otCoapStart(otInstance *aInstance, uint16_t aPort);
+otError otCoapAddResource(otInstance *aInstance, otCoapResource *aResource);
+void otCoapSetDefaultHandler(otInstance *aInstance, otCoapRequestHandler aHandler, void *aContext);
+
+#endif // OPENTHREAD_COAP_H_
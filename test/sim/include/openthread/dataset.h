@@ -0,0 +1,10 @@
+#ifndef OPENTHREAD_DATASET_H_
+#define OPENTHREAD_DATASET_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+bool otDatasetIsCommissioned(otInstance *aInstance);
+
+#endif // OPENTHREAD_DATASET_H_
@@ -0,0 +1,44 @@
+#ifndef OPENTHREAD_ERROR_H_
+#define OPENTHREAD_ERROR_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+typedef enum otError
+{
+	OT_ERROR_NONE                         = 0,
+	OT_ERROR_FAILED                       = 1,
+	OT_ERROR_DROP                         = 2,
+	OT_ERROR_NO_BUFS                      = 3,
+	OT_ERROR_NO_ROUTE                     = 4,
+	OT_ERROR_BUSY                         = 5,
+	OT_ERROR_PARSE                        = 6,
+	OT_ERROR_INVALID_ARGS                 = 7,
+	OT_ERROR_SECURITY                     = 8,
+	OT_ERROR_ADDRESS_QUERY                = 9,
+	OT_ERROR_NO_ADDRESS                   = 10,
+	OT_ERROR_ABORT                        = 11,
+	OT_ERROR_NOT_IMPLEMENTED              = 12,
+	OT_ERROR_INVALID_STATE                = 13,
+	OT_ERROR_NO_ACK                       = 14,
+	OT_ERROR_CHANNEL_ACCESS_FAILURE       = 15,
+	OT_ERROR_DETACHED                     = 16,
+	OT_ERROR_FCS                          = 17,
+	OT_ERROR_NO_FRAME_RECEIVED            = 18,
+	OT_ERROR_UNKNOWN_NEIGHBOR             = 19,
+	OT_ERROR_INVALID_SOURCE_ADDRESS       = 20,
+	OT_ERROR_ADDRESS_FILTERED             = 21,
+	OT_ERROR_DESTINATION_ADDRESS_FILTERED = 22,
+	OT_ERROR_NOT_FOUND                    = 23,
+	OT_ERROR_ALREADY                      = 24,
+	OT_ERROR_IP6_ADDRESS_CREATION_FAILURE = 26,
+	OT_ERROR_NOT_CAPABLE                  = 27,
+	OT_ERROR_RESPONSE_TIMEOUT             = 28,
+	OT_ERROR_DUPLICATED                   = 29,
+	OT_ERROR_REASSEMBLY_TIMEOUT           = 30,
+	OT_ERROR_NOT_TMF                      = 31,
+	OT_ERROR_NOT_LOWPAN_DATA_FRAME        = 32,
+	OT_ERROR_LINK_MARGIN_LOW              = 34,
+	OT_ERROR_GENERIC                      = 255,
+} otError;
+
+#endif // OPENTHREAD_ERROR_H_
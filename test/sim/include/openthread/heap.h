@@ -0,0 +1,13 @@
+#ifndef OPENTHREAD_HEAP_H_
+#define OPENTHREAD_HEAP_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <stddef.h>
+
+typedef void *(*otHeapCAllocFn)(size_t aCount, size_t aSize);
+typedef void (*otHeapFreeFn)(void *aPointer);
+
+void otHeapSetCAllocFree(otHeapCAllocFn aCAlloc, otHeapFreeFn aFree);
+
+#endif // OPENTHREAD_HEAP_H_
@@ -0,0 +1,35 @@
+#ifndef OPENTHREAD_ICMP6_H_
+#define OPENTHREAD_ICMP6_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/ip6.h>
+
+typedef enum otIcmp6Type
+{
+	OT_ICMP6_TYPE_DST_UNREACH  = 1,
+	OT_ICMP6_TYPE_ECHO_REQUEST = 128,
+	OT_ICMP6_TYPE_ECHO_REPLY   = 129,
+} otIcmp6Type;
+
+typedef struct otIcmp6Header
+{
+	uint8_t mType;
+	uint8_t mCode;
+	uint8_t mChecksum[2];
+	uint8_t mData[4];
+} otIcmp6Header;
+
+typedef void (*otIcmp6ReceiveCallback)(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo,
+	const otIcmp6Header *aIcmpHeader);
+
+typedef struct otIcmp6Handler
+{
+	otIcmp6ReceiveCallback mReceiveCallback;
+	void *mContext;
+	struct otIcmp6Handler *mNext;
+} otIcmp6Handler;
+
+otError otIcmp6RegisterHandler(otInstance *aInstance, otIcmp6Handler *aHandler);
+
+#endif // OPENTHREAD_ICMP6_H_
@@ -0,0 +1,35 @@
+#ifndef OPENTHREAD_INSTANCE_H_
+#define OPENTHREAD_INSTANCE_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/error.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct otInstance otInstance;
+
+#define OT_CHANGED_IP6_ADDRESS_ADDED           (1 << 0)
+#define OT_CHANGED_IP6_ADDRESS_REMOVED         (1 << 1)
+#define OT_CHANGED_THREAD_ROLE                 (1 << 2)
+#define OT_CHANGED_THREAD_LL_ADDR              (1 << 3)
+#define OT_CHANGED_THREAD_ML_ADDR              (1 << 4)
+#define OT_CHANGED_THREAD_RLOC_ADDED           (1 << 5)
+#define OT_CHANGED_THREAD_RLOC_REMOVED         (1 << 6)
+#define OT_CHANGED_THREAD_PARTITION_ID         (1 << 7)
+#define OT_CHANGED_THREAD_KEY_SEQUENCE_COUNTER (1 << 8)
+#define OT_CHANGED_THREAD_NETDATA              (1 << 9)
+#define OT_CHANGED_THREAD_CHILD_ADDED          (1 << 10)
+#define OT_CHANGED_THREAD_CHILD_REMOVED        (1 << 11)
+
+typedef void (*otStateChangedCallback)(uint32_t aFlags, void *aContext);
+
+otInstance *otInstanceInitSingle(void);
+void otInstanceFinalize(otInstance *aInstance);
+otError otInstanceFactoryReset(otInstance *aInstance);
+otError otSetStateChangedCallback(otInstance *aInstance, otStateChangedCallback aCallback, void *aContext);
+const char *otGetVersionString(void);
+
+#endif // OPENTHREAD_INSTANCE_H_
@@ -0,0 +1,43 @@
+#ifndef OPENTHREAD_IP6_H_
+#define OPENTHREAD_IP6_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/message.h>
+
+#define OT_IP6_ADDRESS_SIZE 16
+
+typedef struct otIp6Address
+{
+	union
+	{
+		uint8_t m8[OT_IP6_ADDRESS_SIZE];
+		uint16_t m16[OT_IP6_ADDRESS_SIZE / 2];
+		uint32_t m32[OT_IP6_ADDRESS_SIZE / 4];
+	} mFields;
+} otIp6Address;
+
+typedef struct otSockAddr
+{
+	otIp6Address mAddress;
+	uint16_t mPort;
+	int8_t mScopeId;
+} otSockAddr;
+
+typedef struct otMessageInfo
+{
+	otIp6Address mSockAddr;
+	otIp6Address mPeerAddr;
+	uint16_t mSockPort;
+	uint16_t mPeerPort;
+	const void *mLinkInfo;
+	uint8_t mHopLimit;
+	bool mIsHostInterface : 1;
+} otMessageInfo;
+
+otError otIp6SetEnabled(otInstance *aInstance, bool aEnabled);
+bool otIp6IsAddressEqual(const otIp6Address *aFirst, const otIp6Address *aSecond);
+bool otIp6IsAddressUnspecified(const otIp6Address *aAddress);
+otError otIp6AddressFromString(const char *aString, otIp6Address *aAddress);
+
+#endif // OPENTHREAD_IP6_H_
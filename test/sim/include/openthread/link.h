@@ -0,0 +1,40 @@
+#ifndef OPENTHREAD_LINK_H_
+#define OPENTHREAD_LINK_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+#include <openthread/platform/radio.h>
+
+typedef uint16_t otPanId;
+
+/**@brief The MAC counters the firmware reads, a subset of the OpenThread structure. */
+typedef struct otMacCounters
+{
+	uint32_t mTxTotal;
+	uint32_t mTxUnicast;
+	uint32_t mTxBroadcast;
+	uint32_t mTxDataPoll;
+	uint32_t mTxRetry;
+	uint32_t mTxErrCca;
+	uint32_t mRxTotal;
+	uint32_t mRxUnicast;
+	uint32_t mRxBroadcast;
+	uint32_t mRxDuplicated;
+	uint32_t mRxErrFcs;
+} otMacCounters;
+
+typedef void (*otLinkPcapCallback)(const otRadioFrame *aFrame, bool aIsTx, void *aContext);
+
+uint8_t otLinkGetChannel(otInstance *aInstance);
+otError otLinkSetChannel(otInstance *aInstance, uint8_t aChannel);
+otPanId otLinkGetPanId(otInstance *aInstance);
+otError otLinkSetPanId(otInstance *aInstance, otPanId aPanId);
+uint32_t otLinkGetPollPeriod(otInstance *aInstance);
+otError otLinkSetPollPeriod(otInstance *aInstance, uint32_t aPollPeriod);
+otError otLinkSendDataRequest(otInstance *aInstance);
+const otExtAddress *otLinkGetExtendedAddress(otInstance *aInstance);
+const otMacCounters *otLinkGetCounters(otInstance *aInstance);
+void otLinkSetPcapCallback(otInstance *aInstance, otLinkPcapCallback aPcapCallback, void *aCallbackContext);
+
+#endif // OPENTHREAD_LINK_H_
@@ -0,0 +1,22 @@
+#ifndef OPENTHREAD_MESSAGE_H_
+#define OPENTHREAD_MESSAGE_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+typedef struct otMessage otMessage;
+
+typedef struct otMessageSettings
+{
+	bool mLinkSecurityEnabled;
+	uint8_t mPriority;
+} otMessageSettings;
+
+void otMessageFree(otMessage *aMessage);
+uint16_t otMessageGetLength(const otMessage *aMessage);
+uint16_t otMessageGetOffset(const otMessage *aMessage);
+otError otMessageAppend(otMessage *aMessage, const void *aBuf, uint16_t aLength);
+int otMessageRead(const otMessage *aMessage, uint16_t aOffset, void *aBuf, uint16_t aLength);
+
+#endif // OPENTHREAD_MESSAGE_H_
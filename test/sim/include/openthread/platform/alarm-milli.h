@@ -0,0 +1,10 @@
+#ifndef OPENTHREAD_PLATFORM_ALARM_MILLI_H_
+#define OPENTHREAD_PLATFORM_ALARM_MILLI_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <stdint.h>
+
+uint32_t otPlatAlarmMilliGetNow(void);
+
+#endif // OPENTHREAD_PLATFORM_ALARM_MILLI_H_
@@ -0,0 +1,23 @@
+#ifndef OPENTHREAD_PLATFORM_MISC_H_
+#define OPENTHREAD_PLATFORM_MISC_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+typedef enum otPlatResetReason
+{
+	OT_PLAT_RESET_REASON_POWER_ON = 0,
+	OT_PLAT_RESET_REASON_EXTERNAL = 1,
+	OT_PLAT_RESET_REASON_SOFTWARE = 2,
+	OT_PLAT_RESET_REASON_FAULT    = 3,
+	OT_PLAT_RESET_REASON_CRASH    = 4,
+	OT_PLAT_RESET_REASON_ASSERT   = 5,
+	OT_PLAT_RESET_REASON_OTHER    = 6,
+	OT_PLAT_RESET_REASON_UNKNOWN  = 7,
+	OT_PLAT_RESET_REASON_WATCHDOG = 8,
+} otPlatResetReason;
+
+otPlatResetReason otPlatGetResetReason(otInstance *aInstance);
+
+#endif // OPENTHREAD_PLATFORM_MISC_H_
@@ -0,0 +1,13 @@
+#ifndef OPENTHREAD_SYSTEM_H_
+#define OPENTHREAD_SYSTEM_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+void otSysInit(int aArgCount, char *aArgVector[]);
+void otSysDeinit(void);
+void otSysProcessDrivers(otInstance *aInstance);
+bool otSysPseudoResetWasRequested(void);
+
+#endif // OPENTHREAD_SYSTEM_H_
@@ -0,0 +1,8 @@
+#ifndef PLATFORM_FEM_H_
+#define PLATFORM_FEM_H_
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md. No front-end module.
+
+#define FEM_CONTROL_DEFAULT_ENABLE 0
+
+#endif // PLATFORM_FEM_H_
@@ -0,0 +1,26 @@
+#ifndef OPENTHREAD_PLATFORM_RADIO_H_
+#define OPENTHREAD_PLATFORM_RADIO_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+#define OT_EXT_ADDRESS_SIZE 8
+#define OT_RADIO_FRAME_MAX_SIZE 127
+
+typedef struct otExtAddress
+{
+	uint8_t m8[OT_EXT_ADDRESS_SIZE];
+} otExtAddress;
+
+typedef struct otRadioFrame
+{
+	uint8_t *mPsdu;
+	uint16_t mLength;
+	uint8_t mChannel;
+} otRadioFrame;
+
+void otPlatRadioGetIeeeEui64(otInstance *aInstance, uint8_t *aIeeeEui64);
+otError otPlatRadioSetTransmitPower(otInstance *aInstance, int8_t aPower);
+
+#endif // OPENTHREAD_PLATFORM_RADIO_H_
@@ -0,0 +1,10 @@
+#ifndef OPENTHREAD_RANDOM_NONCRYPTO_H_
+#define OPENTHREAD_RANDOM_NONCRYPTO_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <stdint.h>
+
+uint32_t otRandomNonCryptoGetUint32(void);
+
+#endif // OPENTHREAD_RANDOM_NONCRYPTO_H_
@@ -0,0 +1,11 @@
+#ifndef OPENTHREAD_TASKLET_H_
+#define OPENTHREAD_TASKLET_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/instance.h>
+
+void otTaskletsProcess(otInstance *aInstance);
+bool otTaskletsArePending(otInstance *aInstance);
+
+#endif // OPENTHREAD_TASKLET_H_
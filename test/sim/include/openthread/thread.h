@@ -0,0 +1,76 @@
+#ifndef OPENTHREAD_THREAD_H_
+#define OPENTHREAD_THREAD_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/dataset.h>
+#include <openthread/ip6.h>
+#include <openthread/link.h>
+
+typedef enum otDeviceRole
+{
+	OT_DEVICE_ROLE_DISABLED = 0,
+	OT_DEVICE_ROLE_DETACHED = 1,
+	OT_DEVICE_ROLE_CHILD    = 2,
+	OT_DEVICE_ROLE_ROUTER   = 3,
+	OT_DEVICE_ROLE_LEADER   = 4,
+} otDeviceRole;
+
+typedef struct otLinkModeConfig
+{
+	bool mRxOnWhenIdle : 1;
+	bool mSecureDataRequests : 1;
+	bool mDeviceType : 1;
+	bool mNetworkData : 1;
+} otLinkModeConfig;
+
+typedef struct otNeighborInfo
+{
+	otExtAddress mExtAddress;
+	uint32_t mAge;
+	uint16_t mRloc16;
+	uint32_t mLinkFrameCounter;
+	uint32_t mMleFrameCounter;
+	uint8_t mLinkQualityIn;
+	int8_t mAverageRssi;
+	int8_t mLastRssi;
+	uint16_t mFrameErrorRate;
+	uint16_t mMessageErrorRate;
+	bool mRxOnWhenIdle : 1;
+	bool mSecureDataRequest : 1;
+	bool mFullThreadDevice : 1;
+	bool mFullNetworkData : 1;
+	bool mIsChild : 1;
+} otNeighborInfo;
+
+#define OT_NEIGHBOR_INFO_ITERATOR_INIT 0
+typedef int16_t otNeighborInfoIterator;
+
+typedef struct otRouterInfo
+{
+	otExtAddress mExtAddress;
+	uint16_t mRloc16;
+	uint8_t mRouterId;
+	uint8_t mNextHop;
+	uint8_t mPathCost;
+	uint8_t mLinkQualityIn;
+	uint8_t mLinkQualityOut;
+	uint8_t mAge;
+	bool mAllocated : 1;
+	bool mLinkEstablished : 1;
+} otRouterInfo;
+
+otError otThreadSetEnabled(otInstance *aInstance, bool aEnabled);
+otDeviceRole otThreadGetDeviceRole(otInstance *aInstance);
+otLinkModeConfig otThreadGetLinkMode(otInstance *aInstance);
+otError otThreadSetLinkMode(otInstance *aInstance, otLinkModeConfig aConfig);
+void otThreadSetChildTimeout(otInstance *aInstance, uint32_t aTimeout);
+const char *otThreadGetNetworkName(otInstance *aInstance);
+const otIp6Address *otThreadGetMeshLocalEid(otInstance *aInstance);
+const otIp6Address *otThreadGetRloc(otInstance *aInstance);
+uint16_t otThreadGetRloc16(otInstance *aInstance);
+otError otThreadGetLeaderRloc(otInstance *aInstance, otIp6Address *aLeaderRloc);
+otError otThreadGetNextNeighborInfo(otInstance *aInstance, otNeighborInfoIterator *aIterator, otNeighborInfo *aInfo);
+otError otThreadGetRouterInfo(otInstance *aInstance, uint16_t aRouterId, otRouterInfo *aRouterInfo);
+
+#endif // OPENTHREAD_THREAD_H_
@@ -0,0 +1,16 @@
+#ifndef OPENTHREAD_THREAD_FTD_H_
+#define OPENTHREAD_THREAD_FTD_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/thread.h>
+
+uint8_t otThreadGetMaxRouterId(otInstance *aInstance);
+uint8_t otThreadGetRouterUpgradeThreshold(otInstance *aInstance);
+void otThreadSetRouterUpgradeThreshold(otInstance *aInstance, uint8_t aThreshold);
+uint8_t otThreadGetRouterDowngradeThreshold(otInstance *aInstance);
+void otThreadSetRouterDowngradeThreshold(otInstance *aInstance, uint8_t aThreshold);
+uint8_t otThreadGetRouterSelectionJitter(otInstance *aInstance);
+void otThreadSetRouterSelectionJitter(otInstance *aInstance, uint8_t aRouterJitter);
+
+#endif // OPENTHREAD_THREAD_FTD_H_
@@ -0,0 +1,26 @@
+#ifndef OPENTHREAD_UDP_H_
+#define OPENTHREAD_UDP_H_
+
+// Stand-in for the OpenThread header of the same name, see test/sim/README.md.
+
+#include <openthread/ip6.h>
+
+typedef void (*otUdpReceive)(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo);
+
+typedef struct otUdpSocket
+{
+	otSockAddr mSockName;
+	otSockAddr mPeerName;
+	otUdpReceive mHandler;
+	void *mContext;
+	void *mHandle;
+	struct otUdpSocket *mNext;
+} otUdpSocket;
+
+otMessage *otUdpNewMessage(otInstance *aInstance, const otMessageSettings *aSettings);
+otError otUdpOpen(otInstance *aInstance, otUdpSocket *aSocket, otUdpReceive aCallback, void *aContext);
+otError otUdpClose(otUdpSocket *aSocket);
+otError otUdpBind(otUdpSocket *aSocket, otSockAddr *aSockName);
+otError otUdpSend(otUdpSocket *aSocket, otMessage *aMessage, const otMessageInfo *aMessageInfo);
+
+#endif // OPENTHREAD_UDP_H_
@@ -0,0 +1,8 @@
+#ifndef SDK_ERRORS_H__
+#define SDK_ERRORS_H__
+
+// Stand-in for the nRF5 SDK header of the same name, see test/sim/README.md.
+
+#include "sdk_sim.h"
+
+#endif // SDK_ERRORS_H__
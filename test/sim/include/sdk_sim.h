@@ -0,0 +1,215 @@
+#ifndef SDK_SIM_H__
+#define SDK_SIM_H__
+
+/**@brief Declarations behind the nRF5 SDK stand-in headers of the simulation rig.
+ *
+ * @details Only what the firmware uses, with the SDK names and semantics. node_sdk.c implements them
+ *          on top of the simulated node, see test/sim/README.md.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sdk_config.h"
+
+// sdk_errors.h
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS              0
+#define NRF_ERROR_INTERNAL       3
+#define NRF_ERROR_NO_MEM         4
+#define NRF_ERROR_NOT_FOUND      5
+#define NRF_ERROR_INVALID_PARAM  7
+#define NRF_ERROR_INVALID_STATE  8
+#define NRF_ERROR_INVALID_LENGTH 9
+#define NRF_ERROR_BUSY           17
+
+// app_util.h, nordic_common.h
+
+#define UNUSED_PARAMETER(X)  ((void)(X))
+#define UNUSED_VARIABLE(X)   ((void)(X))
+#define UNUSED_RETURN_VALUE(X) ((void)(X))
+#define STATIC_ASSERT(EXPR, ...) _Static_assert(EXPR, "" __VA_ARGS__)
+#define ROUNDED_DIV(A, B)    (((A) + ((B) / 2)) / (B))
+#define CONCAT_2(p1, p2)     CONCAT_2_(p1, p2)
+#define CONCAT_2_(p1, p2)    p1##p2
+#define STRINGIFY(val)       STRINGIFY_(val)
+#define STRINGIFY_(val)      #val
+
+// app_util_platform.h, the simulated CPU is never interrupted while the firmware runs
+
+#define APP_IRQ_PRIORITY_HIGHEST 0
+#define APP_IRQ_PRIORITY_HIGH    2
+#define APP_IRQ_PRIORITY_MID     4
+#define APP_IRQ_PRIORITY_LOW     6
+#define APP_IRQ_PRIORITY_LOWEST  7
+#define CRITICAL_REGION_ENTER()  {
+#define CRITICAL_REGION_EXIT()   }
+
+// app_error.h, nrf_assert.h, a failure ends the whole simulation with the location
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const uint8_t *p_file_name);
+void assert_nrf_callback(uint16_t line_num, const uint8_t *file_name);
+
+#define APP_ERROR_CHECK(ERR_CODE) \
+	do { \
+		const uint32_t LOCAL_ERR_CODE = (ERR_CODE); \
+		if (LOCAL_ERR_CODE != NRF_SUCCESS) \
+			app_error_handler(LOCAL_ERR_CODE, __LINE__, (const uint8_t *)__FILE__); \
+	} while (0)
+
+#define ASSERT(expr) \
+	do { \
+		if (!(expr)) \
+			assert_nrf_callback((uint16_t)__LINE__, (const uint8_t *)__FILE__); \
+	} while (0)
+
+// nrf_log.h, nrf_log_ctrl.h, the arguments are evaluated and dropped
+
+static inline void nrf_log_discard(const char *p_format, ...)
+{
+	(void)p_format;
+}
+
+#define NRF_LOG_ERROR(...)    nrf_log_discard(__VA_ARGS__)
+#define NRF_LOG_WARNING(...)  nrf_log_discard(__VA_ARGS__)
+#define NRF_LOG_INFO(...)     nrf_log_discard(__VA_ARGS__)
+#define NRF_LOG_DEBUG(...)    nrf_log_discard(__VA_ARGS__)
+#define NRF_LOG_INIT(timestamp_func) (NRF_SUCCESS)
+#define NRF_LOG_DEFAULT_BACKENDS_INIT()
+#define NRF_LOG_PROCESS()     false
+#define NRF_LOG_FLUSH()
+
+// nrf.h, core_cm4.h
+
+typedef struct
+{
+	volatile uint32_t GPREGRET;
+	volatile uint32_t GPREGRET2;
+} NRF_POWER_Type;
+
+extern NRF_POWER_Type sim_nrf_power;
+
+#define NRF_POWER (&sim_nrf_power)
+
+#define __FPU_PRESENT 0
+#define __FPU_USED    0
+
+/**@brief Sleeps until an event, the node yields to the simulation core here. */
+void __WFE(void);
+void __SEV(void);
+void NVIC_SystemReset(void);
+
+// nrf_gpio.h
+
+#define NRF_GPIO_PIN_MAP(port, pin) (((port) << 5) | ((pin) & 0x1F))
+#define NRF_GPIO_PIN_PULLUP 3
+
+void nrf_gpio_cfg_output(uint32_t pin_number);
+void nrf_gpio_cfg_default(uint32_t pin_number);
+void nrf_gpio_pin_set(uint32_t pin_number);
+void nrf_gpio_pin_clear(uint32_t pin_number);
+
+// app_timer.h, APP_TIMER_V2 with the RTC at 16384 Hz and the timeouts run from the scheduler
+
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+
+typedef enum
+{
+	APP_TIMER_MODE_SINGLE_SHOT,
+	APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct app_timer_s
+{
+	app_timer_timeout_handler_t handler;
+	app_timer_mode_t mode;
+	void *p_context;
+	uint64_t expires_at; // microseconds of node time
+	uint32_t period;     // ticks
+	bool active;
+	struct app_timer_s *p_next;
+} app_timer_t;
+
+typedef app_timer_t *app_timer_id_t;
+
+/**@brief What a timeout puts into the scheduler queue. */
+typedef struct
+{
+	app_timer_timeout_handler_t timeout_handler;
+	void *p_context;
+} app_timer_event_t;
+
+#define APP_TIMER_CLOCK_FREQ            32768
+#define APP_TIMER_MIN_TIMEOUT_TICKS     5
+#define APP_TIMER_MAX_CNT_VAL           0x00FFFFFF
+#define APP_TIMER_SCHED_EVENT_DATA_SIZE sizeof(app_timer_event_t)
+
+#define APP_TIMER_TICKS(MS) \
+	((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ, 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)))
+
+#define APP_TIMER_DEF(timer_id) \
+	static app_timer_t CONCAT_2(timer_id, _data); \
+	static const app_timer_id_t timer_id = &CONCAT_2(timer_id, _data)
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+	app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+
+// app_scheduler.h
+
+typedef void (*app_sched_event_handler_t)(void *p_event_data, uint16_t event_size);
+
+#define APP_SCHED_INIT(EVENT_SIZE, QUEUE_SIZE) \
+	APP_ERROR_CHECK(app_sched_init((EVENT_SIZE), (QUEUE_SIZE), NULL))
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void *p_evt_buffer);
+uint32_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void app_sched_execute(void);
+uint16_t app_sched_queue_space_get(void);
+
+// bsp.h, bsp_thread.h
+
+typedef enum
+{
+	BSP_EVENT_NOTHING = 0,
+	BSP_EVENT_KEY_0,
+	BSP_EVENT_KEY_1,
+	BSP_EVENT_KEY_2,
+	BSP_EVENT_KEY_3,
+} bsp_event_t;
+
+typedef void (*bsp_event_callback_t)(bsp_event_t);
+
+#define BSP_INIT_NONE    0
+#define BSP_INIT_LEDS    (1 << 0)
+#define BSP_INIT_BUTTONS (1 << 1)
+
+#define BSP_BOARD_LED_0 0
+#define BSP_BOARD_LED_1 1
+#define BSP_BOARD_LED_2 2
+#define BSP_BOARD_LED_3 3
+#define BSP_BOARD_LED_4 4
+#define BSP_BOARD_LED_5 5
+#define BSP_BOARD_LED_6 6
+#define BSP_BOARD_LED_7 7
+
+uint32_t bsp_init(uint32_t type, bsp_event_callback_t callback);
+void bsp_board_led_on(uint32_t led_idx);
+void bsp_board_led_off(uint32_t led_idx);
+void bsp_board_led_invert(uint32_t led_idx);
+bool bsp_board_led_state_get(uint32_t led_idx);
+
+// mem_manager.h
+
+uint32_t nrf_mem_init(void);
+void *nrf_calloc(size_t count, size_t size);
+void nrf_free(void *p_buffer);
+
+#endif // SDK_SIM_H__
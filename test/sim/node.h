@@ -0,0 +1,24 @@
+#ifndef NODE_H__
+#define NODE_H__
+
+#include "sim_port.h"
+
+/**@brief Shared between the halves of the node runtime, node_sdk.c and node_ot.c. */
+
+extern sim_port *node_port;
+
+/**@brief Node clock in milliseconds, what otPlatAlarmMilliGetNow() and hal_clock_now() return. */
+uint32_t node_millis(void);
+
+uint32_t node_random(void);
+
+/**@brief Unwinds the firmware back into sim_node_main(), does not return. */
+void node_exit(void);
+
+/**@brief Earliest CoAP retransmission or response timeout, SIM_WAKE_NEVER when none is pending. */
+uint64_t node_ot_next_timer_at(void);
+
+/**@brief Reports radio frames sent and received since the last call to the pcap callback. */
+void node_ot_frames_process(void);
+
+#endif /* NODE_H__ */
@@ -0,0 +1,1395 @@
+#include "node.h"
+
+#include <openthread/cli.h>
+#include <openthread/coap.h>
+#include <openthread/dataset.h>
+#include <openthread/heap.h>
+#include <openthread/icmp6.h>
+#include <openthread/instance.h>
+#include <openthread/link.h>
+#include <openthread/random_noncrypto.h>
+#include <openthread/tasklet.h>
+#include <openthread/thread.h>
+#include <openthread/thread_ftd.h>
+#include <openthread/udp.h>
+#include <openthread/platform/alarm-milli.h>
+#include <openthread/platform/misc.h>
+#include <openthread/platform/openthread-system.h>
+#include <openthread/platform/radio.h>
+
+#include <stddef.h>
+#include <string.h>
+
+/**@brief OpenThread half of the node runtime, the API the firmware uses on top of the simulated mesh.
+ *
+ * @details CoAP is kept close to OpenThread: messages carry the wire format, confirmable messages are
+ *          retransmitted (RFC 7252 defaults), responses to confirmable requests are cached for duplicates,
+ *          a separate response is acknowledged and matched by token, and the datagram goes to the most
+ *          recently opened socket bound to its port. Messages come from a pool of 128 byte buffers sized
+ *          like the nRF52840 build. MLE, routing and the radio are modelled by the core, the Thread state
+ *          the firmware reads comes from the port.
+ */
+
+#define MESSAGE_BUFFERS        44 // OPENTHREAD_CONFIG_NUM_MESSAGE_BUFFERS of the nRF52840 platform
+#define MESSAGE_BUFFER_SIZE    128
+#define MESSAGE_HEADROOM       48 // first buffer: metadata, room for the IPv6 and UDP headers
+#define MESSAGES_MAX           MESSAGE_BUFFERS
+
+#define COAP_ACK_TIMEOUT       2000 // milliseconds
+#define COAP_ACK_RANDOM_FACTOR 1500 // per mille
+#define COAP_MAX_RETRANSMIT    4
+#define COAP_MAX_TRANSMIT_WAIT 93000 // milliseconds a response is waited for after the request went out
+#define COAP_EXCHANGE_LIFETIME 247000
+#define COAP_PENDING_MAX       16
+#define COAP_RESPONSES_CACHED  8
+#define COAP_HEADER_SIZE       4
+#define COAP_PAYLOAD_MARKER    0xFF
+
+#define EPHEMERAL_PORT_MIN     49152
+
+struct otInstance
+{
+	uint8_t unused;
+};
+
+struct otMessage
+{
+	bool in_use;
+	uint8_t buffers;
+	uint16_t length;
+	uint16_t offset;
+	uint16_t last_option; // option number last appended to a CoAP message being built
+	uint8_t data[SIM_DATAGRAM_SIZE_MAX];
+};
+
+static otInstance m_instance;
+static otMessage m_messages[MESSAGES_MAX];
+static uint8_t m_buffers_used;
+
+static otStateChangedCallback m_state_changed_callback;
+static void *mp_state_changed_context;
+static otLinkPcapCallback m_pcap_callback;
+static void *mp_pcap_context;
+static uint32_t m_pcap_tx_frames;
+static uint32_t m_pcap_rx_frames;
+
+static uint8_t m_channel = 11;
+static otPanId m_pan_id = 0xFFFF;
+static otLinkModeConfig m_link_mode;
+static uint32_t m_child_timeout;
+static bool m_ip6_enabled;
+static otExtAddress m_ext_address;
+static otIp6Address m_mesh_local_eid;
+static otIp6Address m_rloc;
+static otMacCounters m_mac_counters;
+
+static otUdpSocket *mp_sockets;
+static uint16_t m_ephemeral_port = EPHEMERAL_PORT_MIN;
+
+// message pool
+
+static uint8_t buffers_for(uint16_t length)
+{
+	return (uint8_t)((length + MESSAGE_HEADROOM + MESSAGE_BUFFER_SIZE - 1) / MESSAGE_BUFFER_SIZE);
+}
+
+static otMessage *message_new(uint16_t length)
+{
+	uint8_t buffers = buffers_for(length);
+
+	if (m_buffers_used + buffers > MESSAGE_BUFFERS)
+		goto exit;
+
+	for (int i = 0; i < MESSAGES_MAX; i++) {
+		otMessage *p_message = &m_messages[i];
+		if (p_message->in_use)
+			continue;
+
+		memset(p_message, 0, offsetof(otMessage, data));
+		p_message->in_use = true;
+		p_message->buffers = buffers;
+		p_message->length = length;
+		m_buffers_used += buffers;
+		return p_message;
+	}
+
+exit:
+	node_port->messages_no_bufs++;
+	return NULL;
+}
+
+static otError message_length_set(otMessage *p_message, uint16_t length)
+{
+	if (length > sizeof(p_message->data))
+		return OT_ERROR_NO_BUFS;
+
+	uint8_t buffers = buffers_for(length);
+	if (buffers > p_message->buffers) {
+		if (m_buffers_used + buffers - p_message->buffers > MESSAGE_BUFFERS) {
+			node_port->messages_no_bufs++;
+			return OT_ERROR_NO_BUFS;
+		}
+		m_buffers_used += buffers - p_message->buffers;
+		p_message->buffers = buffers;
+	}
+
+	p_message->length = length;
+	return OT_ERROR_NONE;
+}
+
+static otMessage *message_copy(const otMessage *p_message, uint16_t length)
+{
+	otMessage *p_copy = message_new(length);
+
+	if (p_copy != NULL) {
+		memcpy(p_copy->data, p_message->data, length);
+		p_copy->offset = p_message->offset;
+	}
+	return p_copy;
+}
+
+void otMessageFree(otMessage *aMessage)
+{
+	if (aMessage == NULL || !aMessage->in_use)
+		return;
+
+	m_buffers_used -= aMessage->buffers;
+	aMessage->in_use = false;
+}
+
+uint16_t otMessageGetLength(const otMessage *aMessage)
+{
+	return aMessage->length;
+}
+
+uint16_t otMessageGetOffset(const otMessage *aMessage)
+{
+	return aMessage->offset;
+}
+
+otError otMessageAppend(otMessage *aMessage, const void *aBuf, uint16_t aLength)
+{
+	uint16_t offset = aMessage->length;
+
+	otError error = message_length_set(aMessage, offset + aLength);
+	if (error == OT_ERROR_NONE)
+		memcpy(&aMessage->data[offset], aBuf, aLength);
+	return error;
+}
+
+int otMessageRead(const otMessage *aMessage, uint16_t aOffset, void *aBuf, uint16_t aLength)
+{
+	if (aOffset >= aMessage->length)
+		return 0;
+	if (aLength > aMessage->length - aOffset)
+		aLength = aMessage->length - aOffset;
+
+	memcpy(aBuf, &aMessage->data[aOffset], aLength);
+	return aLength;
+}
+
+// instance, platform
+
+otInstance *otInstanceInitSingle(void)
+{
+	memcpy(m_ext_address.m8, node_port->ext_address, sizeof(m_ext_address.m8));
+	m_link_mode.mRxOnWhenIdle = true;
+	node_port->router_upgrade_threshold = 16;
+	node_port->router_downgrade_threshold = 23;
+	node_port->router_selection_jitter = 120;
+	return &m_instance;
+}
+
+void otInstanceFinalize(otInstance *aInstance)
+{
+}
+
+otError otInstanceFactoryReset(otInstance *aInstance)
+{
+	return OT_ERROR_NONE;
+}
+
+otError otSetStateChangedCallback(otInstance *aInstance, otStateChangedCallback aCallback, void *aContext)
+{
+	m_state_changed_callback = aCallback;
+	mp_state_changed_context = aContext;
+	return OT_ERROR_NONE;
+}
+
+const char *otGetVersionString(void)
+{
+	return "OPENTHREAD/sim";
+}
+
+void otSysInit(int aArgCount, char *aArgVector[])
+{
+}
+
+void otSysDeinit(void)
+{
+}
+
+void otSysProcessDrivers(otInstance *aInstance)
+{
+}
+
+bool otSysPseudoResetWasRequested(void)
+{
+	return false;
+}
+
+void otCliUartInit(otInstance *aInstance)
+{
+}
+
+void otHeapSetCAllocFree(otHeapCAllocFn aCAlloc, otHeapFreeFn aFree)
+{
+}
+
+bool otDatasetIsCommissioned(otInstance *aInstance)
+{
+	return false;
+}
+
+uint32_t otPlatAlarmMilliGetNow(void)
+{
+	return node_millis();
+}
+
+uint32_t otRandomNonCryptoGetUint32(void)
+{
+	return node_random();
+}
+
+otPlatResetReason otPlatGetResetReason(otInstance *aInstance)
+{
+	return (otPlatResetReason)node_port->reset_reason;
+}
+
+void otPlatRadioGetIeeeEui64(otInstance *aInstance, uint8_t *aIeeeEui64)
+{
+	memcpy(aIeeeEui64, node_port->eui64, sizeof(node_port->eui64));
+}
+
+otError otPlatRadioSetTransmitPower(otInstance *aInstance, int8_t aPower)
+{
+	return OT_ERROR_NONE;
+}
+
+otError otIcmp6RegisterHandler(otInstance *aInstance, otIcmp6Handler *aHandler)
+{
+	return OT_ERROR_NONE;
+}
+
+// link
+
+uint8_t otLinkGetChannel(otInstance *aInstance)
+{
+	return m_channel;
+}
+
+otError otLinkSetChannel(otInstance *aInstance, uint8_t aChannel)
+{
+	if (aChannel < 11 || aChannel > 26)
+		return OT_ERROR_INVALID_ARGS;
+
+	m_channel = aChannel;
+	return OT_ERROR_NONE;
+}
+
+otPanId otLinkGetPanId(otInstance *aInstance)
+{
+	return m_pan_id;
+}
+
+otError otLinkSetPanId(otInstance *aInstance, otPanId aPanId)
+{
+	m_pan_id = aPanId;
+	return OT_ERROR_NONE;
+}
+
+uint32_t otLinkGetPollPeriod(otInstance *aInstance)
+{
+	return node_port->poll_period;
+}
+
+otError otLinkSetPollPeriod(otInstance *aInstance, uint32_t aPollPeriod)
+{
+	if (aPollPeriod < 10 || aPollPeriod > 0x3FFFFFF)
+		return OT_ERROR_INVALID_ARGS;
+
+	node_port->poll_period = aPollPeriod;
+	return OT_ERROR_NONE;
+}
+
+otError otLinkSendDataRequest(otInstance *aInstance)
+{
+	return OT_ERROR_NONE;
+}
+
+const otExtAddress *otLinkGetExtendedAddress(otInstance *aInstance)
+{
+	return &m_ext_address;
+}
+
+const otMacCounters *otLinkGetCounters(otInstance *aInstance)
+{
+	m_mac_counters.mTxTotal = node_port->tx_frames;
+	m_mac_counters.mRxTotal = node_port->rx_frames;
+	return &m_mac_counters;
+}
+
+void otLinkSetPcapCallback(otInstance *aInstance, otLinkPcapCallback aPcapCallback, void *aCallbackContext)
+{
+	m_pcap_callback = aPcapCallback;
+	mp_pcap_context = aCallbackContext;
+	m_pcap_tx_frames = node_port->tx_frames;
+	m_pcap_rx_frames = node_port->rx_frames;
+}
+
+void node_ot_frames_process(void)
+{
+	static uint8_t psdu[OT_RADIO_FRAME_MAX_SIZE];
+	otRadioFrame frame = { .mPsdu = psdu, .mLength = sizeof(psdu), .mChannel = m_channel };
+
+	if (m_pcap_callback == NULL)
+		return;
+
+	// one call per direction stands for the frames since the last one, the firmware only blinks on them
+	if (m_pcap_tx_frames != node_port->tx_frames) {
+		m_pcap_tx_frames = node_port->tx_frames;
+		m_pcap_callback(&frame, true, mp_pcap_context);
+	}
+	if (m_pcap_rx_frames != node_port->rx_frames) {
+		m_pcap_rx_frames = node_port->rx_frames;
+		m_pcap_callback(&frame, false, mp_pcap_context);
+	}
+}
+
+// thread
+
+otError otThreadSetEnabled(otInstance *aInstance, bool aEnabled)
+{
+	if (aEnabled && !m_ip6_enabled)
+		return OT_ERROR_INVALID_STATE;
+
+	node_port->thread_enabled = aEnabled;
+	return OT_ERROR_NONE;
+}
+
+otDeviceRole otThreadGetDeviceRole(otInstance *aInstance)
+{
+	return (otDeviceRole)node_port->role;
+}
+
+otLinkModeConfig otThreadGetLinkMode(otInstance *aInstance)
+{
+	return m_link_mode;
+}
+
+otError otThreadSetLinkMode(otInstance *aInstance, otLinkModeConfig aConfig)
+{
+	m_link_mode = aConfig;
+	node_port->rx_on_when_idle = aConfig.mRxOnWhenIdle;
+	node_port->full_thread_device = aConfig.mDeviceType;
+	return OT_ERROR_NONE;
+}
+
+void otThreadSetChildTimeout(otInstance *aInstance, uint32_t aTimeout)
+{
+	m_child_timeout = aTimeout;
+}
+
+const char *otThreadGetNetworkName(otInstance *aInstance)
+{
+	return "OpenThread";
+}
+
+const otIp6Address *otThreadGetMeshLocalEid(otInstance *aInstance)
+{
+	memcpy(m_mesh_local_eid.mFields.m8, node_port->mesh_local_eid, sizeof(m_mesh_local_eid.mFields.m8));
+	return &m_mesh_local_eid;
+}
+
+const otIp6Address *otThreadGetRloc(otInstance *aInstance)
+{
+	memcpy(m_rloc.mFields.m8, node_port->rloc, sizeof(m_rloc.mFields.m8));
+	return &m_rloc;
+}
+
+uint16_t otThreadGetRloc16(otInstance *aInstance)
+{
+	return node_port->rloc16;
+}
+
+otError otThreadGetLeaderRloc(otInstance *aInstance, otIp6Address *aLeaderRloc)
+{
+	if (node_port->role == OT_DEVICE_ROLE_DISABLED || node_port->role == OT_DEVICE_ROLE_DETACHED)
+		return OT_ERROR_DETACHED;
+
+	memcpy(aLeaderRloc->mFields.m8, node_port->leader_rloc, sizeof(aLeaderRloc->mFields.m8));
+	return OT_ERROR_NONE;
+}
+
+otError otThreadGetNextNeighborInfo(otInstance *aInstance, otNeighborInfoIterator *aIterator, otNeighborInfo *aInfo)
+{
+	if (*aIterator < 0 || *aIterator >= node_port->neighbor_count)
+		return OT_ERROR_NOT_FOUND;
+
+	const sim_neighbor *p_neighbor = &node_port->neighbors[(*aIterator)++];
+
+	memset(aInfo, 0, sizeof(*aInfo));
+	aInfo->mRloc16 = p_neighbor->rloc16;
+	aInfo->mLinkQualityIn = p_neighbor->link_quality;
+	aInfo->mRxOnWhenIdle = p_neighbor->rx_on_when_idle;
+	aInfo->mFullThreadDevice = p_neighbor->full_thread_device;
+	aInfo->mIsChild = p_neighbor->is_child;
+	return OT_ERROR_NONE;
+}
+
+uint8_t otThreadGetMaxRouterId(otInstance *aInstance)
+{
+	return SIM_ROUTER_ID_MAX;
+}
+
+otError otThreadGetRouterInfo(otInstance *aInstance, uint16_t aRouterId, otRouterInfo *aRouterInfo)
+{
+	if (aRouterId > SIM_ROUTER_ID_MAX)
+		return OT_ERROR_INVALID_ARGS;
+	if (node_port->router_link_quality[aRouterId] == SIM_LINK_QUALITY_NONE)
+		return OT_ERROR_NOT_FOUND;
+
+	memset(aRouterInfo, 0, sizeof(*aRouterInfo));
+	aRouterInfo->mRouterId = (uint8_t)aRouterId;
+	aRouterInfo->mRloc16 = (uint16_t)(aRouterId << 10);
+	aRouterInfo->mLinkQualityIn = (uint8_t)node_port->router_link_quality[aRouterId];
+	aRouterInfo->mLinkQualityOut = aRouterInfo->mLinkQualityIn;
+	aRouterInfo->mAllocated = true;
+	aRouterInfo->mLinkEstablished = aRouterInfo->mLinkQualityIn > 0;
+	return OT_ERROR_NONE;
+}
+
+uint8_t otThreadGetRouterUpgradeThreshold(otInstance *aInstance)
+{
+	return node_port->router_upgrade_threshold;
+}
+
+void otThreadSetRouterUpgradeThreshold(otInstance *aInstance, uint8_t aThreshold)
+{
+	node_port->router_upgrade_threshold = aThreshold;
+}
+
+uint8_t otThreadGetRouterDowngradeThreshold(otInstance *aInstance)
+{
+	return node_port->router_downgrade_threshold;
+}
+
+void otThreadSetRouterDowngradeThreshold(otInstance *aInstance, uint8_t aThreshold)
+{
+	node_port->router_downgrade_threshold = aThreshold;
+}
+
+uint8_t otThreadGetRouterSelectionJitter(otInstance *aInstance)
+{
+	return node_port->router_selection_jitter;
+}
+
+void otThreadSetRouterSelectionJitter(otInstance *aInstance, uint8_t aRouterJitter)
+{
+	node_port->router_selection_jitter = aRouterJitter;
+}
+
+// ip6
+
+otError otIp6SetEnabled(otInstance *aInstance, bool aEnabled)
+{
+	m_ip6_enabled = aEnabled;
+	return OT_ERROR_NONE;
+}
+
+bool otIp6IsAddressEqual(const otIp6Address *aFirst, const otIp6Address *aSecond)
+{
+	return memcmp(aFirst->mFields.m8, aSecond->mFields.m8, sizeof(aFirst->mFields.m8)) == 0;
+}
+
+bool otIp6IsAddressUnspecified(const otIp6Address *aAddress)
+{
+	static const otIp6Address unspecified;
+
+	return otIp6IsAddressEqual(aAddress, &unspecified);
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+otError otIp6AddressFromString(const char *aString, otIp6Address *aAddress)
+{
+	uint16_t groups[8];
+	int count = 0;
+	int gap = -1;
+	const char *p = aString;
+
+	if (p[0] == ':' && p[1] == ':') {
+		gap = 0;
+		p += 2;
+	}
+
+	while (*p != '\0') {
+		uint32_t value = 0;
+		int digits = 0;
+		for (; hex_digit(*p) >= 0 && digits < 5; p++, digits++)
+			value = (value << 4) | (uint32_t)hex_digit(*p);
+		if (digits == 0 || digits > 4 || count == 8)
+			return OT_ERROR_PARSE;
+		groups[count++] = (uint16_t)value;
+
+		if (*p == '\0')
+			break;
+		if (*p != ':')
+			return OT_ERROR_PARSE;
+		p++;
+		if (*p == ':') {
+			if (gap >= 0)
+				return OT_ERROR_PARSE;
+			gap = count;
+			p++;
+		}
+	}
+
+	if (gap < 0 ? count != 8 : count > 7)
+		return OT_ERROR_PARSE;
+
+	memset(aAddress, 0, sizeof(*aAddress));
+	int tail = gap < 0 ? 0 : count - gap;
+	for (int i = 0; i < count; i++) {
+		int index = (gap >= 0 && i >= gap) ? 8 - tail + (i - gap) : i;
+		aAddress->mFields.m8[index * 2] = (uint8_t)(groups[i] >> 8);
+		aAddress->mFields.m8[index * 2 + 1] = (uint8_t)groups[i];
+	}
+	return OT_ERROR_NONE;
+}
+
+/**@brief Source address selection: RLOC for RLOC destinations, the ML-EID for everything else. */
+static const uint8_t *source_address_select(const otIp6Address *p_destination)
+{
+	static const uint8_t rloc_iid[] = { 0x00, 0x00, 0x00, 0xFF, 0xFE, 0x00 };
+
+	if (p_destination->mFields.m8[0] != 0xFF && memcmp(&p_destination->mFields.m8[8], rloc_iid, sizeof(rloc_iid)) == 0)
+		return node_port->rloc;
+	return node_port->mesh_local_eid;
+}
+
+static otError datagram_send(const otMessageInfo *p_message_info, uint16_t source_port, const otMessage *p_message)
+{
+	static sim_datagram datagram;
+
+	if (!m_ip6_enabled)
+		return OT_ERROR_INVALID_STATE;
+
+	if (otIp6IsAddressUnspecified(&p_message_info->mSockAddr))
+		memcpy(datagram.source, source_address_select(&p_message_info->mPeerAddr), sizeof(datagram.source));
+	else
+		memcpy(datagram.source, p_message_info->mSockAddr.mFields.m8, sizeof(datagram.source));
+	memcpy(datagram.destination, p_message_info->mPeerAddr.mFields.m8, sizeof(datagram.destination));
+	datagram.source_port = source_port;
+	datagram.destination_port = p_message_info->mPeerPort;
+	datagram.hop_limit = p_message_info->mHopLimit != 0 ? p_message_info->mHopLimit : 64;
+	datagram.length = p_message->length;
+	memcpy(datagram.payload, p_message->data, p_message->length);
+
+	return node_port->send(node_port, &datagram) ? OT_ERROR_NONE : OT_ERROR_NO_ROUTE;
+}
+
+// udp
+
+otMessage *otUdpNewMessage(otInstance *aInstance, const otMessageSettings *aSettings)
+{
+	return message_new(0);
+}
+
+otError otUdpOpen(otInstance *aInstance, otUdpSocket *aSocket, otUdpReceive aCallback, void *aContext)
+{
+	for (otUdpSocket *p_socket = mp_sockets; p_socket != NULL; p_socket = p_socket->mNext) {
+		if (p_socket == aSocket)
+			return OT_ERROR_ALREADY;
+	}
+
+	memset(aSocket, 0, sizeof(*aSocket));
+	aSocket->mHandler = aCallback;
+	aSocket->mContext = aContext;
+	aSocket->mNext = mp_sockets;
+	mp_sockets = aSocket;
+	return OT_ERROR_NONE;
+}
+
+otError otUdpClose(otUdpSocket *aSocket)
+{
+	for (otUdpSocket **pp_socket = &mp_sockets; *pp_socket != NULL; pp_socket = &(*pp_socket)->mNext) {
+		if (*pp_socket == aSocket) {
+			*pp_socket = aSocket->mNext;
+			aSocket->mNext = NULL;
+			return OT_ERROR_NONE;
+		}
+	}
+	return OT_ERROR_NONE;
+}
+
+otError otUdpBind(otUdpSocket *aSocket, otSockAddr *aSockName)
+{
+	aSocket->mSockName = *aSockName;
+	if (aSocket->mSockName.mPort == 0)
+		aSocket->mSockName.mPort = m_ephemeral_port++;
+	return OT_ERROR_NONE;
+}
+
+otError otUdpSend(otUdpSocket *aSocket, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+	if (aSocket->mSockName.mPort == 0)
+		aSocket->mSockName.mPort = m_ephemeral_port++;
+
+	otError error = datagram_send(aMessageInfo, aSocket->mSockName.mPort, aMessage);
+	if (error == OT_ERROR_NONE)
+		otMessageFree(aMessage);
+	return error;
+}
+
+// coap message
+
+static otCoapType header_type(const otMessage *p_message)
+{
+	return (otCoapType)((p_message->data[0] >> 4) & 0x3);
+}
+
+static uint8_t header_token_length(const otMessage *p_message)
+{
+	return p_message->data[0] & 0xF;
+}
+
+static uint16_t header_message_id(const otMessage *p_message)
+{
+	return (uint16_t)((p_message->data[2] << 8) | p_message->data[3]);
+}
+
+static void header_message_id_set(otMessage *p_message, uint16_t message_id)
+{
+	p_message->data[2] = (uint8_t)(message_id >> 8);
+	p_message->data[3] = (uint8_t)message_id;
+}
+
+otMessage *otCoapNewMessage(otInstance *aInstance, const otMessageSettings *aSettings)
+{
+	otMessage *p_message = message_new(COAP_HEADER_SIZE);
+
+	if (p_message != NULL)
+		otCoapMessageInit(p_message, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_EMPTY);
+	return p_message;
+}
+
+void otCoapMessageInit(otMessage *aMessage, otCoapType aType, otCoapCode aCode)
+{
+	message_length_set(aMessage, COAP_HEADER_SIZE);
+	aMessage->data[0] = (uint8_t)(0x40 | (aType << 4));
+	aMessage->data[1] = (uint8_t)aCode;
+	header_message_id_set(aMessage, 0);
+	aMessage->offset = 0;
+	aMessage->last_option = 0;
+}
+
+otError otCoapMessageInitResponse(otMessage *aResponse, const otMessage *aRequest, otCoapType aType, otCoapCode aCode)
+{
+	otCoapMessageInit(aResponse, aType, aCode);
+	header_message_id_set(aResponse, header_message_id(aRequest));
+	return otCoapMessageSetToken(aResponse, otCoapMessageGetToken(aRequest), header_token_length(aRequest));
+}
+
+otError otCoapMessageSetToken(otMessage *aMessage, const uint8_t *aToken, uint8_t aTokenLength)
+{
+	if (aTokenLength > OT_COAP_MAX_TOKEN_LENGTH)
+		return OT_ERROR_INVALID_ARGS;
+	if (aMessage->length != COAP_HEADER_SIZE + header_token_length(aMessage))
+		return OT_ERROR_INVALID_STATE;
+
+	otError error = message_length_set(aMessage, COAP_HEADER_SIZE + aTokenLength);
+	if (error != OT_ERROR_NONE)
+		return error;
+
+	memmove(&aMessage->data[COAP_HEADER_SIZE], aToken, aTokenLength);
+	aMessage->data[0] = (uint8_t)((aMessage->data[0] & 0xF0) | aTokenLength);
+	return OT_ERROR_NONE;
+}
+
+static otError option_append(otMessage *p_message, uint16_t number, const uint8_t *p_value, uint16_t length)
+{
+	uint8_t header[5];
+	uint16_t header_size = 1;
+
+	if (number < p_message->last_option)
+		return OT_ERROR_INVALID_ARGS;
+
+	uint16_t delta = number - p_message->last_option;
+	uint8_t delta_nibble;
+	uint8_t length_nibble;
+
+	if (delta < 13) {
+		delta_nibble = (uint8_t)delta;
+	} else if (delta < 269) {
+		delta_nibble = 13;
+		header[header_size++] = (uint8_t)(delta - 13);
+	} else {
+		delta_nibble = 14;
+		header[header_size++] = (uint8_t)((delta - 269) >> 8);
+		header[header_size++] = (uint8_t)(delta - 269);
+	}
+
+	if (length < 13) {
+		length_nibble = (uint8_t)length;
+	} else if (length < 269) {
+		length_nibble = 13;
+		header[header_size++] = (uint8_t)(length - 13);
+	} else {
+		length_nibble = 14;
+		header[header_size++] = (uint8_t)((length - 269) >> 8);
+		header[header_size++] = (uint8_t)(length - 269);
+	}
+	header[0] = (uint8_t)((delta_nibble << 4) | length_nibble);
+
+	uint16_t offset = p_message->length;
+	otError error = message_length_set(p_message, offset + header_size + length);
+	if (error != OT_ERROR_NONE)
+		return error;
+
+	memcpy(&p_message->data[offset], header, header_size);
+	memcpy(&p_message->data[offset + header_size], p_value, length);
+	p_message->last_option = number;
+	return OT_ERROR_NONE;
+}
+
+otError otCoapMessageAppendUintOption(otMessage *aMessage, uint16_t aNumber, uint32_t aValue)
+{
+	uint8_t value[4];
+	uint16_t length = 0;
+
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		if (length > 0 || (aValue >> shift) != 0)
+			value[length++] = (uint8_t)(aValue >> shift);
+	}
+	return option_append(aMessage, aNumber, value, length);
+}
+
+otError otCoapMessageAppendObserveOption(otMessage *aMessage, uint32_t aObserve)
+{
+	return otCoapMessageAppendUintOption(aMessage, OT_COAP_OPTION_OBSERVE, aObserve & 0xFFFFFF);
+}
+
+otError otCoapMessageAppendUriPathOptions(otMessage *aMessage, const char *aUriPath)
+{
+	const char *p_segment = aUriPath;
+
+	while (true) {
+		const char *p_end = strchr(p_segment, '/');
+		size_t length = p_end != NULL ? (size_t)(p_end - p_segment) : strlen(p_segment);
+
+		otError error = option_append(aMessage, OT_COAP_OPTION_URI_PATH, (const uint8_t *)p_segment, (uint16_t)length);
+		if (error != OT_ERROR_NONE || p_end == NULL)
+			return error;
+		p_segment = p_end + 1;
+	}
+}
+
+otError otCoapMessageAppendContentFormatOption(otMessage *aMessage, otCoapOptionContentFormat aContentFormat)
+{
+	return otCoapMessageAppendUintOption(aMessage, OT_COAP_OPTION_CONTENT_FORMAT, aContentFormat);
+}
+
+otError otCoapMessageSetPayloadMarker(otMessage *aMessage)
+{
+	static const uint8_t marker = COAP_PAYLOAD_MARKER;
+
+	otError error = otMessageAppend(aMessage, &marker, sizeof(marker));
+	if (error == OT_ERROR_NONE)
+		aMessage->offset = aMessage->length;
+	return error;
+}
+
+otCoapType otCoapMessageGetType(const otMessage *aMessage)
+{
+	return header_type(aMessage);
+}
+
+otCoapCode otCoapMessageGetCode(const otMessage *aMessage)
+{
+	return (otCoapCode)aMessage->data[1];
+}
+
+uint16_t otCoapMessageGetMessageId(const otMessage *aMessage)
+{
+	return header_message_id(aMessage);
+}
+
+uint8_t otCoapMessageGetTokenLength(const otMessage *aMessage)
+{
+	return header_token_length(aMessage);
+}
+
+const uint8_t *otCoapMessageGetToken(const otMessage *aMessage)
+{
+	return &aMessage->data[COAP_HEADER_SIZE];
+}
+
+/**@brief Decodes the option at offset, returns false at the payload marker, the end or a malformed option. */
+static bool option_decode(const otMessage *p_message, uint16_t offset, uint16_t previous_number, otCoapOption *p_option,
+	uint16_t *p_value_offset)
+{
+	if (offset >= p_message->length || p_message->data[offset] == COAP_PAYLOAD_MARKER)
+		return false;
+
+	uint16_t delta = p_message->data[offset] >> 4;
+	uint16_t length = p_message->data[offset] & 0xF;
+	offset++;
+
+	uint16_t *p_fields[] = { &delta, &length };
+	for (int i = 0; i < 2; i++) {
+		uint16_t *p_field = p_fields[i];
+		if (*p_field == 13) {
+			if (offset + 1 > p_message->length)
+				return false;
+			*p_field = (uint16_t)(13 + p_message->data[offset]);
+			offset += 1;
+		} else if (*p_field == 14) {
+			if (offset + 2 > p_message->length)
+				return false;
+			*p_field = (uint16_t)(269 + ((p_message->data[offset] << 8) | p_message->data[offset + 1]));
+			offset += 2;
+		} else if (*p_field == 15) {
+			return false;
+		}
+	}
+
+	if (offset + length > p_message->length)
+		return false;
+
+	p_option->mNumber = previous_number + delta;
+	p_option->mLength = length;
+	*p_value_offset = offset;
+	return true;
+}
+
+otError otCoapOptionIteratorInit(otCoapOptionIterator *aIterator, const otMessage *aMessage)
+{
+	memset(aIterator, 0, sizeof(*aIterator));
+	aIterator->mMessage = aMessage;
+	aIterator->mNextOptionOffset = COAP_HEADER_SIZE + header_token_length(aMessage);
+	return aMessage->length >= aIterator->mNextOptionOffset ? OT_ERROR_NONE : OT_ERROR_PARSE;
+}
+
+const otCoapOption *otCoapOptionIteratorGetNextOptionMatching(otCoapOptionIterator *aIterator, uint16_t aOption)
+{
+	uint16_t value_offset;
+
+	while (option_decode(aIterator->mMessage, aIterator->mNextOptionOffset, aIterator->mOption.mNumber, &aIterator->mOption,
+		&value_offset)) {
+		aIterator->mNextOptionOffset = value_offset + aIterator->mOption.mLength;
+		if (aIterator->mOption.mNumber == aOption)
+			return &aIterator->mOption;
+	}
+	return NULL;
+}
+
+const otCoapOption *otCoapOptionIteratorGetFirstOptionMatching(otCoapOptionIterator *aIterator, uint16_t aOption)
+{
+	if (otCoapOptionIteratorInit(aIterator, aIterator->mMessage) != OT_ERROR_NONE)
+		return NULL;
+	return otCoapOptionIteratorGetNextOptionMatching(aIterator, aOption);
+}
+
+otError otCoapOptionIteratorGetOptionValue(otCoapOptionIterator *aIterator, void *aValue)
+{
+	if (aIterator->mOption.mNumber == 0)
+		return OT_ERROR_NOT_FOUND;
+
+	memcpy(aValue, &aIterator->mMessage->data[aIterator->mNextOptionOffset - aIterator->mOption.mLength], aIterator->mOption.mLength);
+	return OT_ERROR_NONE;
+}
+
+/**@brief Checks the header and the options of a received message, points the offset at the payload. */
+static bool coap_message_parse(otMessage *p_message)
+{
+	otCoapOption option = { 0, 0 };
+	uint16_t value_offset;
+
+	if (p_message->length < COAP_HEADER_SIZE || (p_message->data[0] >> 6) != 1 || header_token_length(p_message) > OT_COAP_MAX_TOKEN_LENGTH)
+		return false;
+
+	uint16_t offset = COAP_HEADER_SIZE + header_token_length(p_message);
+	if (offset > p_message->length)
+		return false;
+
+	while (option_decode(p_message, offset, option.mNumber, &option, &value_offset))
+		offset = value_offset + option.mLength;
+
+	if (offset < p_message->length) {
+		// a marker has to be followed by a payload
+		if (p_message->data[offset] != COAP_PAYLOAD_MARKER || offset + 1 == p_message->length)
+			return false;
+		offset++;
+	}
+
+	p_message->offset = offset;
+	return true;
+}
+
+// coap
+
+typedef struct
+{
+	bool in_use;
+	otMessage *p_copy; // whole for a confirmable message, only the header otherwise
+	otMessageInfo message_info;
+	bool confirmable;
+	bool acknowledged;
+	otCoapResponseHandler handler;
+	void *p_context;
+	uint64_t next_at;
+	uint32_t timeout;
+	uint8_t retransmissions;
+} coap_pending;
+
+typedef struct
+{
+	bool valid;
+	otIp6Address peer_address;
+	uint16_t peer_port;
+	uint16_t message_id;
+	uint64_t expires_at;
+	uint16_t length;
+	uint8_t data[SIM_DATAGRAM_SIZE_MAX];
+} coap_cached_response;
+
+static otUdpSocket m_coap_socket;
+static otCoapResource *mp_resources;
+static otCoapRequestHandler m_default_handler;
+static void *mp_default_context;
+static uint16_t m_message_id;
+static coap_pending m_pending[COAP_PENDING_MAX];
+static coap_cached_response m_responses[COAP_RESPONSES_CACHED];
+
+static uint64_t millis_to_us(uint32_t milliseconds)
+{
+	return (uint64_t)milliseconds * 1000;
+}
+
+static void pending_finish(coap_pending *p_pending, otMessage *p_message, const otMessageInfo *p_message_info, otError result)
+{
+	otCoapResponseHandler handler = p_pending->handler;
+	void *p_context = p_pending->p_context;
+
+	otMessageFree(p_pending->p_copy);
+	p_pending->in_use = false;
+
+	if (result == OT_ERROR_RESPONSE_TIMEOUT)
+		node_port->coap_timeouts++;
+
+	if (handler != NULL)
+		handler(p_context, p_message, p_message_info, result);
+}
+
+static bool peer_matches(const coap_pending *p_pending, const otMessageInfo *p_message_info)
+{
+	return p_pending->message_info.mPeerPort == p_message_info->mPeerPort &&
+		(p_pending->message_info.mPeerAddr.mFields.m8[0] == 0xFF ||
+		otIp6IsAddressEqual(&p_pending->message_info.mPeerAddr, &p_message_info->mPeerAddr));
+}
+
+static coap_pending *pending_find_by_message_id(uint16_t message_id, const otMessageInfo *p_message_info)
+{
+	for (int i = 0; i < COAP_PENDING_MAX; i++) {
+		coap_pending *p_pending = &m_pending[i];
+		if (p_pending->in_use && header_message_id(p_pending->p_copy) == message_id && peer_matches(p_pending, p_message_info))
+			return p_pending;
+	}
+	return NULL;
+}
+
+static coap_pending *pending_find_by_token(const otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	uint8_t token_length = header_token_length(p_message);
+
+	for (int i = 0; i < COAP_PENDING_MAX; i++) {
+		coap_pending *p_pending = &m_pending[i];
+		if (!p_pending->in_use || header_token_length(p_pending->p_copy) != token_length || !peer_matches(p_pending, p_message_info))
+			continue;
+		if (memcmp(otCoapMessageGetToken(p_pending->p_copy), otCoapMessageGetToken(p_message), token_length) == 0)
+			return p_pending;
+	}
+	return NULL;
+}
+
+static void empty_message_send(otCoapType type, uint16_t message_id, const otMessageInfo *p_message_info)
+{
+	otMessage *p_message = message_new(COAP_HEADER_SIZE);
+	if (p_message == NULL)
+		return;
+
+	p_message->data[0] = (uint8_t)(0x40 | (type << 4));
+	p_message->data[1] = OT_COAP_CODE_EMPTY;
+	header_message_id_set(p_message, message_id);
+
+	otMessageInfo message_info = *p_message_info;
+	memset(&message_info.mSockAddr, 0, sizeof(message_info.mSockAddr));
+	datagram_send(&message_info, m_coap_socket.mSockName.mPort, p_message);
+	otMessageFree(p_message);
+}
+
+static bool response_cache_send(const otMessage *p_request, const otMessageInfo *p_message_info)
+{
+	for (int i = 0; i < COAP_RESPONSES_CACHED; i++) {
+		coap_cached_response *p_response = &m_responses[i];
+		if (!p_response->valid)
+			continue;
+		if (p_response->expires_at <= node_port->now_us) {
+			p_response->valid = false;
+			continue;
+		}
+		if (p_response->message_id != header_message_id(p_request) || p_response->peer_port != p_message_info->mPeerPort ||
+			!otIp6IsAddressEqual(&p_response->peer_address, &p_message_info->mPeerAddr))
+			continue;
+
+		otMessage *p_message = message_new(p_response->length);
+		if (p_message != NULL) {
+			memcpy(p_message->data, p_response->data, p_response->length);
+			otMessageInfo message_info = *p_message_info;
+			memset(&message_info.mSockAddr, 0, sizeof(message_info.mSockAddr));
+			datagram_send(&message_info, m_coap_socket.mSockName.mPort, p_message);
+			otMessageFree(p_message);
+		}
+		return true;
+	}
+	return false;
+}
+
+static void response_cache_store(const otMessage *p_response, const otMessageInfo *p_message_info)
+{
+	coap_cached_response *p_entry = &m_responses[0];
+
+	for (int i = 0; i < COAP_RESPONSES_CACHED; i++) {
+		if (!m_responses[i].valid || m_responses[i].expires_at <= node_port->now_us) {
+			p_entry = &m_responses[i];
+			break;
+		}
+		if (m_responses[i].expires_at < p_entry->expires_at)
+			p_entry = &m_responses[i];
+	}
+
+	p_entry->valid = true;
+	p_entry->peer_address = p_message_info->mPeerAddr;
+	p_entry->peer_port = p_message_info->mPeerPort;
+	p_entry->message_id = header_message_id(p_response);
+	p_entry->expires_at = node_port->now_us + millis_to_us(COAP_EXCHANGE_LIFETIME);
+	p_entry->length = p_response->length;
+	memcpy(p_entry->data, p_response->data, p_response->length);
+}
+
+static bool uri_path_matches(const otMessage *p_message, const char *p_uri_path)
+{
+	otCoapOptionIterator iterator;
+	const otCoapOption *p_option;
+	const char *p_segment = p_uri_path;
+	bool first = true;
+
+	if (otCoapOptionIteratorInit(&iterator, p_message) != OT_ERROR_NONE)
+		return false;
+
+	for (p_option = otCoapOptionIteratorGetNextOptionMatching(&iterator, OT_COAP_OPTION_URI_PATH); p_option != NULL;
+		p_option = otCoapOptionIteratorGetNextOptionMatching(&iterator, OT_COAP_OPTION_URI_PATH)) {
+		if (!first) {
+			if (*p_segment != '/')
+				return false;
+			p_segment++;
+		}
+		first = false;
+
+		const uint8_t *p_value = &p_message->data[iterator.mNextOptionOffset - p_option->mLength];
+		if (strncmp(p_segment, (const char *)p_value, p_option->mLength) != 0 || memchr(p_segment, '\0', p_option->mLength) != NULL)
+			return false;
+		p_segment += p_option->mLength;
+	}
+	return !first && *p_segment == '\0';
+}
+
+static void coap_request_receive(otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	bool confirmable = header_type(p_message) == OT_COAP_TYPE_CONFIRMABLE;
+
+	if (confirmable && response_cache_send(p_message, p_message_info))
+		return;
+
+	for (otCoapResource *p_resource = mp_resources; p_resource != NULL; p_resource = p_resource->mNext) {
+		if (uri_path_matches(p_message, p_resource->mUriPath)) {
+			p_resource->mHandler(p_resource->mContext, p_message, p_message_info);
+			return;
+		}
+	}
+
+	if (m_default_handler != NULL) {
+		m_default_handler(mp_default_context, p_message, p_message_info);
+		return;
+	}
+
+	if (confirmable) {
+		otMessage *p_response = otCoapNewMessage(&m_instance, NULL);
+		if (p_response == NULL)
+			return;
+		if (otCoapMessageInitResponse(p_response, p_message, OT_COAP_TYPE_ACKNOWLEDGMENT, OT_COAP_CODE_NOT_FOUND) != OT_ERROR_NONE ||
+			otCoapSendResponse(&m_instance, p_response, p_message_info) != OT_ERROR_NONE)
+			otMessageFree(p_response);
+	}
+}
+
+static void coap_response_receive(otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	coap_pending *p_pending;
+	bool empty = otCoapMessageGetCode(p_message) == OT_COAP_CODE_EMPTY;
+
+	switch (header_type(p_message)) {
+		case OT_COAP_TYPE_ACKNOWLEDGMENT:
+			p_pending = pending_find_by_message_id(header_message_id(p_message), p_message_info);
+			if (p_pending == NULL || !p_pending->confirmable)
+				break;
+			if (empty) {
+				// a separate response follows, or nothing for a request sent without a handler
+				if (p_pending->handler == NULL) {
+					pending_finish(p_pending, NULL, NULL, OT_ERROR_NONE);
+					break;
+				}
+				p_pending->acknowledged = true;
+				p_pending->next_at = node_port->now_us + millis_to_us(COAP_MAX_TRANSMIT_WAIT);
+				break;
+			}
+			if (header_token_length(p_message) == header_token_length(p_pending->p_copy) &&
+				memcmp(otCoapMessageGetToken(p_message), otCoapMessageGetToken(p_pending->p_copy), header_token_length(p_message)) == 0)
+				pending_finish(p_pending, p_message, p_message_info, OT_ERROR_NONE);
+			break;
+
+		case OT_COAP_TYPE_CONFIRMABLE:
+			empty_message_send(OT_COAP_TYPE_ACKNOWLEDGMENT, header_message_id(p_message), p_message_info);
+			// fall through
+		case OT_COAP_TYPE_NON_CONFIRMABLE:
+			if (empty)
+				break;
+			p_pending = pending_find_by_token(p_message, p_message_info);
+			if (p_pending != NULL && p_pending->handler != NULL)
+				pending_finish(p_pending, p_message, p_message_info, OT_ERROR_NONE);
+			break;
+
+		case OT_COAP_TYPE_RESET:
+			p_pending = pending_find_by_message_id(header_message_id(p_message), p_message_info);
+			if (p_pending != NULL)
+				pending_finish(p_pending, NULL, NULL, OT_ERROR_ABORT);
+			break;
+	}
+}
+
+static void coap_receive(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	if (!coap_message_parse(p_message))
+		return;
+
+	otCoapCode code = otCoapMessageGetCode(p_message);
+	if (code >= OT_COAP_CODE_GET && code < OT_COAP_CODE_RESPONSE_MIN)
+		coap_request_receive(p_message, p_message_info);
+	else
+		coap_response_receive(p_message, p_message_info);
+}
+
+otError otCoapStart(otInstance *aInstance, uint16_t aPort)
+{
+	otSockAddr sock_name;
+
+	otError error = otUdpOpen(aInstance, &m_coap_socket, coap_receive, NULL);
+	if (error != OT_ERROR_NONE)
+		return error;
+
+	memset(&sock_name, 0, sizeof(sock_name));
+	sock_name.mPort = aPort;
+	error = otUdpBind(&m_coap_socket, &sock_name);
+
+	m_message_id = (uint16_t)node_random();
+	return error;
+}
+
+otError otCoapAddResource(otInstance *aInstance, otCoapResource *aResource)
+{
+	for (otCoapResource *p_resource = mp_resources; p_resource != NULL; p_resource = p_resource->mNext) {
+		if (p_resource == aResource)
+			return OT_ERROR_ALREADY;
+	}
+
+	aResource->mNext = mp_resources;
+	mp_resources = aResource;
+	return OT_ERROR_NONE;
+}
+
+void otCoapSetDefaultHandler(otInstance *aInstance, otCoapRequestHandler aHandler, void *aContext)
+{
+	m_default_handler = aHandler;
+	mp_default_context = aContext;
+}
+
+otError otCoapSendRequest(otInstance *aInstance, otMessage *aMessage, const otMessageInfo *aMessageInfo,
+	otCoapResponseHandler aHandler, void *aContext)
+{
+	bool confirmable = header_type(aMessage) == OT_COAP_TYPE_CONFIRMABLE;
+	coap_pending *p_pending = NULL;
+
+	header_message_id_set(aMessage, m_message_id++);
+
+	if (confirmable || aHandler != NULL) {
+		for (int i = 0; i < COAP_PENDING_MAX && p_pending == NULL; i++) {
+			if (!m_pending[i].in_use)
+				p_pending = &m_pending[i];
+		}
+		if (p_pending == NULL)
+			return OT_ERROR_NO_BUFS;
+
+		// like OpenThread, only the header of a non-confirmable request is kept, for the token
+		uint16_t copy_length = confirmable ? aMessage->length : COAP_HEADER_SIZE + header_token_length(aMessage);
+		p_pending->p_copy = message_copy(aMessage, copy_length);
+		if (p_pending->p_copy == NULL)
+			return OT_ERROR_NO_BUFS;
+
+		p_pending->in_use = true;
+		p_pending->message_info = *aMessageInfo;
+		p_pending->confirmable = confirmable;
+		p_pending->acknowledged = false;
+		p_pending->handler = aHandler;
+		p_pending->p_context = aContext;
+		p_pending->retransmissions = 0;
+		if (confirmable) {
+			p_pending->timeout = COAP_ACK_TIMEOUT + node_random() % (COAP_ACK_TIMEOUT * (COAP_ACK_RANDOM_FACTOR - 1000) / 1000);
+			p_pending->next_at = node_port->now_us + millis_to_us(p_pending->timeout);
+		} else {
+			p_pending->next_at = node_port->now_us + millis_to_us(COAP_MAX_TRANSMIT_WAIT);
+		}
+	}
+
+	// a datagram without a route is lost like one lost on the air, a confirmable one is retransmitted
+	datagram_send(aMessageInfo, m_coap_socket.mSockName.mPort, aMessage);
+	otMessageFree(aMessage);
+	return OT_ERROR_NONE;
+}
+
+otError otCoapSendResponse(otInstance *aInstance, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+	otMessageInfo message_info = *aMessageInfo;
+
+	// answered from the address the request was sent to, unless that was a multicast address
+	if (message_info.mSockAddr.mFields.m8[0] == 0xFF)
+		memset(&message_info.mSockAddr, 0, sizeof(message_info.mSockAddr));
+
+	otError error = datagram_send(&message_info, m_coap_socket.mSockName.mPort, aMessage);
+	if (error == OT_ERROR_NO_ROUTE)
+		error = OT_ERROR_NONE;
+	if (error != OT_ERROR_NONE)
+		return error;
+
+	if (header_type(aMessage) == OT_COAP_TYPE_ACKNOWLEDGMENT)
+		response_cache_store(aMessage, &message_info);
+
+	otMessageFree(aMessage);
+	return OT_ERROR_NONE;
+}
+
+static void coap_timers_process(void)
+{
+	for (int i = 0; i < COAP_PENDING_MAX; i++) {
+		coap_pending *p_pending = &m_pending[i];
+		if (!p_pending->in_use || p_pending->next_at > node_port->now_us)
+			continue;
+
+		if (!p_pending->confirmable || p_pending->acknowledged || p_pending->retransmissions == COAP_MAX_RETRANSMIT) {
+			pending_finish(p_pending, NULL, NULL, OT_ERROR_RESPONSE_TIMEOUT);
+			continue;
+		}
+
+		p_pending->retransmissions++;
+		p_pending->timeout *= 2;
+		p_pending->next_at += millis_to_us(p_pending->timeout);
+		node_port->coap_retransmissions++;
+		datagram_send(&p_pending->message_info, m_coap_socket.mSockName.mPort, p_pending->p_copy);
+	}
+}
+
+uint64_t node_ot_next_timer_at(void)
+{
+	uint64_t next_at = SIM_WAKE_NEVER;
+
+	for (int i = 0; i < COAP_PENDING_MAX; i++) {
+		if (m_pending[i].in_use && m_pending[i].next_at < next_at)
+			next_at = m_pending[i].next_at;
+	}
+	return next_at;
+}
+
+// tasklets
+
+static void datagram_receive(const sim_datagram *p_datagram)
+{
+	otMessageInfo message_info;
+	otUdpSocket *p_socket;
+
+	for (p_socket = mp_sockets; p_socket != NULL; p_socket = p_socket->mNext) {
+		if (p_socket->mSockName.mPort == p_datagram->destination_port)
+			break;
+	}
+	if (p_socket == NULL)
+		return;
+
+	otMessage *p_message = message_new(p_datagram->length);
+	if (p_message == NULL)
+		return;
+
+	memcpy(p_message->data, p_datagram->payload, p_datagram->length);
+
+	memset(&message_info, 0, sizeof(message_info));
+	memcpy(message_info.mSockAddr.mFields.m8, p_datagram->destination, sizeof(message_info.mSockAddr.mFields.m8));
+	memcpy(message_info.mPeerAddr.mFields.m8, p_datagram->source, sizeof(message_info.mPeerAddr.mFields.m8));
+	message_info.mSockPort = p_datagram->destination_port;
+	message_info.mPeerPort = p_datagram->source_port;
+	message_info.mHopLimit = p_datagram->hop_limit;
+
+	p_socket->mHandler(p_socket->mContext, p_message, &message_info);
+	otMessageFree(p_message);
+}
+
+void otTaskletsProcess(otInstance *aInstance)
+{
+	while (node_port->inbox_count > 0) {
+		const sim_datagram *p_datagram = &node_port->inbox[node_port->inbox_head];
+		node_port->inbox_head = (node_port->inbox_head + 1) % SIM_INBOX_SIZE;
+		node_port->inbox_count--;
+
+		datagram_receive(p_datagram);
+	}
+
+	coap_timers_process();
+
+	if (node_port->changed != 0) {
+		uint32_t flags = node_port->changed;
+		node_port->changed = 0;
+		if (m_state_changed_callback != NULL)
+			m_state_changed_callback(flags, mp_state_changed_context);
+	}
+}
+
+bool otTaskletsArePending(otInstance *aInstance)
+{
+	return node_port->inbox_count > 0 || node_port->changed != 0 || node_ot_next_timer_at() <= node_port->now_us;
+}
@@ -0,0 +1,470 @@
+#include "node.h"
+
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "bsp.h"
+#include "hal_host.h"
+#include "mem_manager.h"
+#include "settings.h"
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <openthread/tasklet.h>
+
+/**@brief nRF5 SDK and peripheral half of the node runtime.
+ *
+ * @details The hal_host.c recording HAL stands in for PWM, SAADC, TEMP and GPIO. What the interrupts of
+ *          the real peripherals would do happens here when the firmware goes to sleep in __WFE(): RTC
+ *          timeouts are queued to the scheduler, finished ADC scans are handed to the ADC handler and
+ *          a playing PWM stream advances. The firmware is never interrupted while it runs.
+ */
+
+#define TIMER_TICK_US(ticks)   ((uint64_t)(ticks) * 1000000 / (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)))
+
+#define ADC_CONVERSION_US      2700 // one oversampled burst of both channels, see ADC_OVERSAMPLE
+#define ADC_VDD_LSB            15019 // 3.3 V against the 3.6 V full scale of 16384 LSB
+#define RAIL_MV                12000
+#define RAIL_RISE_DELAY_US     10000 // PSU start up before the rail moves
+#define RAIL_RISE_US           20000
+#define RAIL_DECAY_US          200000 // time constant of the rail capacitors once the PSU is off
+
+#define SCHED_QUEUE_SIZE_MAX   64
+#define SCHED_EVENT_SIZE_MAX   32
+
+sim_port *node_port;
+
+NRF_POWER_Type sim_nrf_power;
+
+int sim_firmware_main(int argc, char *argv[]);
+
+static jmp_buf m_exit;
+static uint32_t m_random;
+
+uint32_t node_millis(void)
+{
+	return (uint32_t)(node_port->now_us / 1000);
+}
+
+uint32_t node_random(void)
+{
+	// xorshift32
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return m_random;
+}
+
+void node_exit(void)
+{
+	longjmp(m_exit, 1);
+}
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const uint8_t *p_file_name)
+{
+	fprintf(stderr, "node %u: error 0x%x at %s:%u\n", (unsigned)node_port->id, (unsigned)error_code, (const char *)p_file_name,
+		(unsigned)line_num);
+	abort();
+}
+
+void assert_nrf_callback(uint16_t line_num, const uint8_t *file_name)
+{
+	fprintf(stderr, "node %u: assertion failed at %s:%u\n", (unsigned)node_port->id, (const char *)file_name, (unsigned)line_num);
+	abort();
+}
+
+// app_timer
+
+static app_timer_t *mp_timers; // every created timer, active or not
+
+ret_code_t app_timer_init(void)
+{
+	return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+	if (p_timer_id == NULL || *p_timer_id == NULL || timeout_handler == NULL)
+		return NRF_ERROR_INVALID_PARAM;
+
+	app_timer_t *p_timer = *p_timer_id;
+	if (p_timer->active)
+		return NRF_ERROR_INVALID_STATE;
+
+	bool listed = false;
+	for (app_timer_t *p_listed = mp_timers; p_listed != NULL; p_listed = p_listed->p_next)
+		listed |= p_listed == p_timer;
+
+	p_timer->handler = timeout_handler;
+	p_timer->mode = mode;
+	if (!listed) {
+		p_timer->p_next = mp_timers;
+		mp_timers = p_timer;
+	}
+	return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+	if (timer_id == NULL || timer_id->handler == NULL)
+		return NRF_ERROR_INVALID_STATE;
+	if (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS || timeout_ticks > APP_TIMER_MAX_CNT_VAL)
+		return NRF_ERROR_INVALID_PARAM;
+
+	// APP_TIMER_V2 ignores a start of a timer that is already running
+	if (timer_id->active)
+		return NRF_SUCCESS;
+
+	timer_id->p_context = p_context;
+	timer_id->period = timeout_ticks;
+	timer_id->expires_at = node_port->now_us + TIMER_TICK_US(timeout_ticks);
+	timer_id->active = true;
+	return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+	if (timer_id == NULL)
+		return NRF_ERROR_INVALID_PARAM;
+
+	timer_id->active = false;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+	return (uint32_t)(node_port->now_us * (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / 1000000) & APP_TIMER_MAX_CNT_VAL;
+}
+
+static void timer_event_handler(void *p_event_data, uint16_t event_size)
+{
+	app_timer_event_t *p_event = p_event_data;
+
+	p_event->timeout_handler(p_event->p_context);
+}
+
+static void timers_process(void)
+{
+	for (app_timer_t *p_timer = mp_timers; p_timer != NULL; p_timer = p_timer->p_next) {
+		if (!p_timer->active || p_timer->expires_at > node_port->now_us)
+			continue;
+
+		if (p_timer->mode == APP_TIMER_MODE_REPEATED)
+			p_timer->expires_at += TIMER_TICK_US(p_timer->period);
+		else
+			p_timer->active = false;
+
+		app_timer_event_t event = { .timeout_handler = p_timer->handler, .p_context = p_timer->p_context };
+		uint32_t err_code = app_sched_event_put(&event, sizeof(event), timer_event_handler);
+		APP_ERROR_CHECK(err_code);
+	}
+}
+
+static uint64_t timers_next_at(void)
+{
+	uint64_t next_at = SIM_WAKE_NEVER;
+
+	for (app_timer_t *p_timer = mp_timers; p_timer != NULL; p_timer = p_timer->p_next) {
+		if (p_timer->active && p_timer->expires_at < next_at)
+			next_at = p_timer->expires_at;
+	}
+	return next_at;
+}
+
+// app_scheduler
+
+typedef struct
+{
+	app_sched_event_handler_t handler;
+	uint16_t size;
+	union
+	{
+		uint8_t data[SCHED_EVENT_SIZE_MAX];
+		void *p_align;
+		uint64_t align;
+	};
+} sched_event;
+
+static sched_event m_sched_queue[SCHED_QUEUE_SIZE_MAX];
+static uint16_t m_sched_queue_size;
+static uint16_t m_sched_event_size;
+static uint16_t m_sched_head;
+static uint16_t m_sched_count;
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void *p_evt_buffer)
+{
+	if (max_event_size > SCHED_EVENT_SIZE_MAX || queue_size == 0 || queue_size > SCHED_QUEUE_SIZE_MAX)
+		return NRF_ERROR_INVALID_PARAM;
+
+	m_sched_event_size = max_event_size;
+	m_sched_queue_size = queue_size;
+	m_sched_head = 0;
+	m_sched_count = 0;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+	if (event_size > m_sched_event_size)
+		return NRF_ERROR_INVALID_LENGTH;
+	if (m_sched_count == m_sched_queue_size)
+		return NRF_ERROR_NO_MEM;
+
+	sched_event *p_event = &m_sched_queue[(m_sched_head + m_sched_count) % m_sched_queue_size];
+	p_event->handler = handler;
+	p_event->size = event_size;
+	if (p_event_data != NULL && event_size > 0)
+		memcpy(p_event->data, p_event_data, event_size);
+	m_sched_count++;
+	return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+	while (m_sched_count > 0) {
+		sched_event event = m_sched_queue[m_sched_head];
+		m_sched_head = (m_sched_head + 1) % m_sched_queue_size;
+		m_sched_count--;
+
+		event.handler(event.size > 0 ? event.data : NULL, event.size);
+	}
+}
+
+uint16_t app_sched_queue_space_get(void)
+{
+	return m_sched_queue_size - m_sched_count;
+}
+
+// bsp, nrf_gpio
+
+uint32_t bsp_init(uint32_t type, bsp_event_callback_t callback)
+{
+	node_port->leds = 0;
+	return NRF_SUCCESS;
+}
+
+void bsp_board_led_on(uint32_t led_idx)
+{
+	node_port->leds |= 1u << led_idx;
+}
+
+void bsp_board_led_off(uint32_t led_idx)
+{
+	node_port->leds &= ~(1u << led_idx);
+}
+
+void bsp_board_led_invert(uint32_t led_idx)
+{
+	node_port->leds ^= 1u << led_idx;
+}
+
+bool bsp_board_led_state_get(uint32_t led_idx)
+{
+	return (node_port->leds & (1u << led_idx)) != 0;
+}
+
+void nrf_gpio_cfg_output(uint32_t pin_number)
+{
+}
+
+void nrf_gpio_cfg_default(uint32_t pin_number)
+{
+}
+
+void nrf_gpio_pin_set(uint32_t pin_number)
+{
+}
+
+void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+}
+
+// mem_manager
+
+uint32_t nrf_mem_init(void)
+{
+	return NRF_SUCCESS;
+}
+
+void *nrf_calloc(size_t count, size_t size)
+{
+	return calloc(count, size);
+}
+
+void nrf_free(void *p_buffer)
+{
+	free(p_buffer);
+}
+
+// SAADC: a scan started by hal_adc_in_sample() completes ADC_CONVERSION_US later with the PSU rail as
+// it would be at that time
+
+static uint32_t m_adc_samples_seen;
+static uint64_t m_adc_done_at = SIM_WAKE_NEVER;
+static int16_t m_adc_buffer[ADC_FAST_SAMPLES_PER_CHANNEL > ADC_SAMPLES_PER_CHANNEL ?
+	ADC_FAST_SAMPLES_PER_CHANNEL * HAL_ADC_IN_CHANNELS : ADC_SAMPLES_PER_CHANNEL * HAL_ADC_IN_CHANNELS];
+static uint16_t m_adc_scans;
+
+static bool m_psu_enabled;
+static uint64_t m_psu_changed_at;
+static double m_psu_changed_rail_mv;
+
+static double rail_mv(uint64_t at)
+{
+	double since = (double)(at - m_psu_changed_at);
+
+	if (!m_psu_enabled)
+		return m_psu_changed_rail_mv * exp(-since / RAIL_DECAY_US);
+
+	if (since < RAIL_RISE_DELAY_US)
+		return m_psu_changed_rail_mv;
+	if (since >= RAIL_RISE_DELAY_US + RAIL_RISE_US)
+		return RAIL_MV;
+	return m_psu_changed_rail_mv + (RAIL_MV - m_psu_changed_rail_mv) * (since - RAIL_RISE_DELAY_US) / RAIL_RISE_US;
+}
+
+static void adc_process(void)
+{
+	uint64_t now = node_port->now_us;
+
+	if (hal_host.psu_enabled != m_psu_enabled) {
+		m_psu_changed_rail_mv = rail_mv(now);
+		m_psu_changed_at = now;
+		m_psu_enabled = hal_host.psu_enabled;
+	}
+
+	if (m_adc_done_at <= now) {
+		m_adc_done_at = SIM_WAKE_NEVER;
+
+		// a couple of LSB of noise, as after the hardware oversampling
+		int16_t *p_scan = &m_adc_buffer[m_adc_scans * HAL_ADC_IN_CHANNELS];
+		p_scan[HAL_ADC_IN_VDD] = (int16_t)(ADC_VDD_LSB + (int32_t)(node_random() % 5) - 2);
+		p_scan[HAL_ADC_IN_RAIL] = (int16_t)(rail_mv(now) * 1000 / ENERGY_RAIL_UV_PER_LSB + (int32_t)(node_random() % 5) - 2);
+
+		uint16_t scans_per_buffer = hal_host.adc_in_fast ? ADC_FAST_SAMPLES_PER_CHANNEL : ADC_SAMPLES_PER_CHANNEL;
+		if (++m_adc_scans >= scans_per_buffer) {
+			m_adc_scans = 0;
+			hal_host_adc_in_inject(m_adc_buffer, scans_per_buffer);
+		}
+	}
+
+	// the firmware started a scan, one at a time like the SAADC
+	if (hal_host.adc_in_samples != m_adc_samples_seen) {
+		m_adc_samples_seen = hal_host.adc_in_samples;
+		if (m_adc_done_at == SIM_WAKE_NEVER)
+			m_adc_done_at = now + ADC_CONVERSION_US;
+	}
+}
+
+// PWM stream: the sequence buffers advance one step every HAL_PWM_OUT_STREAM_STEP_US
+
+static bool m_stream_playing;
+static uint64_t m_stream_step_at;
+
+static void stream_process(void)
+{
+	uint64_t now = node_port->now_us;
+
+	if (!hal_host.pwm_out_streaming) {
+		m_stream_playing = false;
+		return;
+	}
+
+	if (!m_stream_playing) {
+		m_stream_playing = true;
+		m_stream_step_at = now + HAL_PWM_OUT_STREAM_STEP_US;
+		return;
+	}
+
+	if (m_stream_step_at > now)
+		return;
+
+	uint64_t steps = (now - m_stream_step_at) / HAL_PWM_OUT_STREAM_STEP_US + 1;
+	hal_host_pwm_out_stream_play((uint16_t)(steps > UINT16_MAX ? UINT16_MAX : steps));
+	m_stream_step_at += steps * HAL_PWM_OUT_STREAM_STEP_US;
+}
+
+// CPU
+
+static void interrupts_process(void)
+{
+	hal_host.clock = node_millis();
+
+	timers_process();
+	adc_process();
+	stream_process();
+	node_ot_frames_process();
+}
+
+static uint64_t next_interrupt_at(void)
+{
+	uint64_t next_at = timers_next_at();
+
+	if (m_adc_done_at < next_at)
+		next_at = m_adc_done_at;
+	if (m_stream_playing && m_stream_step_at < next_at)
+		next_at = m_stream_step_at;
+
+	uint64_t ot_next_at = node_ot_next_timer_at();
+	if (ot_next_at < next_at)
+		next_at = ot_next_at;
+	return next_at;
+}
+
+static void node_yield(void)
+{
+	memcpy(node_port->pwm_out_values, hal_host.pwm_out_values, sizeof(node_port->pwm_out_values));
+	node_port->psu_enabled = hal_host.psu_enabled;
+
+	node_port->yield(node_port);
+	if (node_port->terminate)
+		node_exit();
+}
+
+void __WFE(void)
+{
+	interrupts_process();
+
+	// an interrupt left work for the main loop
+	if (m_sched_count > 0 || otTaskletsArePending(NULL))
+		return;
+
+	node_port->wake_at_us = next_interrupt_at();
+	node_yield();
+
+	interrupts_process();
+}
+
+void __SEV(void)
+{
+}
+
+void NVIC_SystemReset(void)
+{
+	node_port->gpregret = NRF_POWER->GPREGRET;
+	node_port->reset_requested = true;
+	node_port->wake_at_us = SIM_WAKE_NEVER;
+
+	// the core ends the node, terminate is set when the yield returns
+	node_yield();
+	abort();
+}
+
+void sim_node_main(sim_port *p_port)
+{
+	node_port = p_port;
+	m_random = p_port->seed | 1;
+
+	NRF_POWER->GPREGRET = p_port->gpregret;
+	memcpy(hal_host.nvm, p_port->nvm, sizeof(hal_host.nvm));
+	hal_host.temperature = 25 * 4 + (int32_t)(p_port->id % 8);
+	hal_host.clock = node_millis();
+
+	if (setjmp(m_exit) == 0)
+		sim_firmware_main(0, NULL);
+
+	memcpy(p_port->nvm, hal_host.nvm, sizeof(p_port->nvm));
+}
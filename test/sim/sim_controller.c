@@ -0,0 +1,703 @@
+#include "sim_controller.h"
+
+#include "sim_core.h"
+#include "sim_mesh.h"
+#include "sim_node.h"
+
+#include "settings.h"
+
+#include <cbor.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openthread/coap.h>
+
+// RFC 7252 section 4.8
+#define ACK_TIMEOUT_US            SIM_S(2)
+#define ACK_RANDOM_FACTOR         1.5
+#define MAX_RETRANSMIT            4
+#define SEPARATE_RESPONSE_WAIT_US SIM_S(10) // after the Empty ACK, the node answers within COAP_SEPARATE_RESPONSE_TIMEOUT
+
+#define TOKEN_LENGTH              4
+#define HOP_LIMIT                 64
+#define CHANNELS                  4
+#define SED_SET_INTERVAL_US       SIM_S(30)
+#define PWM_WAIT_US               SIM_S(10) // the outputs of a node that took longer count as missed
+
+// what the controller asks the nodes to report
+#define CHANNEL_REPORT_INTERVAL   600000
+#define TEMPERATURE_REPORT_INTERVAL 60000
+#define TEMPERATURE_REPORT_CHANGE 40
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t code;
+	uint16_t message_id;
+	uint8_t token_length;
+	uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+	char uri[32];
+	const uint8_t *p_payload;
+	uint16_t payload_length;
+} coap_message;
+
+/**@brief A confirmable request of the controller until its response arrived or it gave up. */
+typedef struct
+{
+	bool active;
+	bool acknowledged;
+	uint32_t node;
+	uint16_t message_id;
+	uint8_t token[TOKEN_LENGTH];
+	uint8_t retransmissions;
+	uint64_t timeout;
+	uint64_t sent_at;
+	uint32_t generation;      // a new generation cancels the retransmission event
+	sim_datagram datagram;
+} exchange;
+
+typedef struct
+{
+	uint32_t node;
+	uint16_t message_id;
+	bool delivered;
+	uint64_t sent_at;
+} report_record;
+
+typedef struct
+{
+	bool subscribed;
+	uint64_t subscribed_at;
+	exchange sub;
+	exchange set;
+	uint16_t set_values[CHANNELS];
+	bool pwm_pending;
+	uint64_t set_done_at;
+} node_state;
+
+static uint32_t m_nodes;
+static node_state m_node_states[SIM_NODES_MAX];
+static uint16_t m_message_id;
+static sim_controller_metrics m_metrics;
+
+static bool m_traffic;
+static uint64_t m_traffic_interval;
+static uint32_t m_traffic_generation;
+
+static report_record *mp_reports;
+static uint32_t m_reports_count;
+static uint32_t m_reports_size;
+
+static void fail(const char *p_what)
+{
+	fprintf(stderr, "sim: %s\n", p_what);
+	abort();
+}
+
+static void latency_add(sim_latency *p_latency, uint64_t sample)
+{
+	if (p_latency->count == p_latency->size) {
+		p_latency->size = p_latency->size == 0 ? 256 : p_latency->size * 2;
+		p_latency->p_samples = realloc(p_latency->p_samples, p_latency->size * sizeof(*p_latency->p_samples));
+		if (p_latency->p_samples == NULL)
+			fail("out of memory");
+	}
+	p_latency->p_samples[p_latency->count++] = sample;
+}
+
+static int sample_compare(const void *p_a, const void *p_b)
+{
+	uint64_t a = *(const uint64_t *)p_a;
+	uint64_t b = *(const uint64_t *)p_b;
+
+	return a < b ? -1 : a > b;
+}
+
+uint64_t sim_latency_percentile(sim_latency *p_latency, double fraction)
+{
+	if (p_latency->count == 0)
+		return 0;
+
+	qsort(p_latency->p_samples, p_latency->count, sizeof(*p_latency->p_samples), sample_compare);
+
+	uint32_t i = (uint32_t)(fraction * (p_latency->count - 1) + 0.5);
+	return p_latency->p_samples[i];
+}
+
+// CoAP
+
+static bool coap_parse(const uint8_t *p_data, uint16_t length, coap_message *p_message)
+{
+	if (length < 4 || (p_data[0] >> 6) != 1)
+		return false;
+
+	memset(p_message, 0, sizeof(*p_message));
+	p_message->type = (p_data[0] >> 4) & 0x03;
+	p_message->token_length = p_data[0] & 0x0F;
+	p_message->code = p_data[1];
+	p_message->message_id = (uint16_t)((p_data[2] << 8) | p_data[3]);
+
+	uint16_t offset = 4;
+	if (p_message->token_length > OT_COAP_MAX_TOKEN_LENGTH || offset + p_message->token_length > length)
+		return false;
+	memcpy(p_message->token, &p_data[offset], p_message->token_length);
+	offset += p_message->token_length;
+
+	uint16_t number = 0;
+	size_t uri_length = 0;
+	while (offset < length && p_data[offset] != 0xFF) {
+		uint16_t delta = p_data[offset] >> 4;
+		uint16_t option_length = p_data[offset] & 0x0F;
+		offset++;
+
+		uint16_t *p_fields[] = { &delta, &option_length };
+		for (int i = 0; i < 2; i++) {
+			uint16_t *p_field = p_fields[i];
+			if (*p_field == 13) {
+				if (offset + 1 > length)
+					return false;
+				*p_field = (uint16_t)(13 + p_data[offset]);
+				offset += 1;
+			} else if (*p_field == 14) {
+				if (offset + 2 > length)
+					return false;
+				*p_field = (uint16_t)(269 + ((p_data[offset] << 8) | p_data[offset + 1]));
+				offset += 2;
+			} else if (*p_field == 15) {
+				return false;
+			}
+		}
+
+		if (offset + option_length > length)
+			return false;
+
+		number = (uint16_t)(number + delta);
+		if (number == OT_COAP_OPTION_URI_PATH) {
+			if (uri_length + option_length + 1 >= sizeof(p_message->uri))
+				return false;
+			if (uri_length > 0)
+				p_message->uri[uri_length++] = '/';
+			memcpy(&p_message->uri[uri_length], &p_data[offset], option_length);
+			uri_length += option_length;
+		}
+		offset = (uint16_t)(offset + option_length);
+	}
+
+	if (offset < length) {
+		// the payload marker
+		offset++;
+		if (offset == length)
+			return false;
+		p_message->p_payload = &p_data[offset];
+		p_message->payload_length = (uint16_t)(length - offset);
+	}
+	return true;
+}
+
+/**@brief Header, token, the Uri-Path and a CBOR Content-Format when there is a payload, both options fit
+ *        the short form.
+ */
+static uint16_t coap_build(uint8_t *p_data, uint8_t type, uint8_t code, uint16_t message_id,
+	const uint8_t *p_token, uint8_t token_length, const char *p_uri, const uint8_t *p_payload, uint16_t payload_length)
+{
+	uint16_t offset = 0;
+
+	p_data[offset++] = (uint8_t)(0x40 | (type << 4) | token_length);
+	p_data[offset++] = code;
+	p_data[offset++] = (uint8_t)(message_id >> 8);
+	p_data[offset++] = (uint8_t)message_id;
+	if (token_length > 0)
+		memcpy(&p_data[offset], p_token, token_length);
+	offset += token_length;
+
+	uint16_t number = 0;
+	if (p_uri != NULL) {
+		size_t uri_length = strlen(p_uri);
+		p_data[offset++] = (uint8_t)(((OT_COAP_OPTION_URI_PATH - number) << 4) | uri_length);
+		memcpy(&p_data[offset], p_uri, uri_length);
+		offset = (uint16_t)(offset + uri_length);
+		number = OT_COAP_OPTION_URI_PATH;
+	}
+
+	if (payload_length > 0) {
+		p_data[offset++] = (uint8_t)(((OT_COAP_OPTION_CONTENT_FORMAT - number) << 4) | 1);
+		p_data[offset++] = OT_COAP_OPTION_CONTENT_FORMAT_CBOR;
+		p_data[offset++] = 0xFF;
+		memcpy(&p_data[offset], p_payload, payload_length);
+		offset = (uint16_t)(offset + payload_length);
+	}
+	return offset;
+}
+
+static void datagram_to(sim_datagram *p_datagram, const uint8_t *p_destination)
+{
+	memset(p_datagram, 0, offsetof(sim_datagram, payload));
+	sim_mesh_mesh_local_eid_get(sim_mesh_border_router(), p_datagram->source);
+	memcpy(p_datagram->destination, p_destination, sizeof(p_datagram->destination));
+	p_datagram->source_port = OT_DEFAULT_COAP_PORT;
+	p_datagram->destination_port = OT_DEFAULT_COAP_PORT;
+	p_datagram->hop_limit = HOP_LIMIT;
+}
+
+static void datagram_send(const sim_datagram *p_datagram)
+{
+	sim_mesh_send(sim_mesh_border_router(), p_datagram);
+}
+
+// confirmable requests
+
+static void exchange_finish(exchange *p_exchange)
+{
+	p_exchange->active = false;
+	p_exchange->generation++;
+}
+
+static void exchange_failed(exchange *p_exchange);
+
+static void retransmit_event(void *p_context, uint32_t generation)
+{
+	exchange *p_exchange = p_context;
+
+	if (!p_exchange->active || p_exchange->generation != generation)
+		return;
+
+	if (p_exchange->acknowledged || p_exchange->retransmissions == MAX_RETRANSMIT) {
+		exchange_failed(p_exchange);
+		return;
+	}
+
+	p_exchange->retransmissions++;
+	p_exchange->timeout *= 2;
+	if (p_exchange == &m_node_states[p_exchange->node].set)
+		m_metrics.sets_retransmitted++;
+
+	datagram_send(&p_exchange->datagram);
+	sim_event_schedule(sim_now() + p_exchange->timeout, retransmit_event, p_exchange, generation);
+}
+
+static void exchange_start(exchange *p_exchange, uint32_t node, const char *p_uri, const uint8_t *p_payload, uint16_t payload_length)
+{
+	uint8_t address[16];
+
+	p_exchange->generation++;
+	p_exchange->active = true;
+	p_exchange->acknowledged = false;
+	p_exchange->node = node;
+	p_exchange->message_id = m_message_id++;
+	for (int i = 0; i < TOKEN_LENGTH; i++)
+		p_exchange->token[i] = (uint8_t)sim_random();
+	p_exchange->retransmissions = 0;
+	p_exchange->timeout = (uint64_t)(ACK_TIMEOUT_US * (1.0 + (ACK_RANDOM_FACTOR - 1.0) * sim_random_unit()));
+	p_exchange->sent_at = sim_now();
+
+	sim_mesh_mesh_local_eid_get(node, address);
+	datagram_to(&p_exchange->datagram, address);
+	p_exchange->datagram.length = coap_build(p_exchange->datagram.payload, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_PUT,
+		p_exchange->message_id, p_exchange->token, TOKEN_LENGTH, p_uri, p_payload, payload_length);
+
+	datagram_send(&p_exchange->datagram);
+	sim_event_schedule(sim_now() + p_exchange->timeout, retransmit_event, p_exchange, p_exchange->generation);
+}
+
+static void empty_ack_send(const sim_datagram *p_request, uint16_t message_id)
+{
+	sim_datagram ack;
+
+	datagram_to(&ack, p_request->source);
+	ack.destination_port = p_request->source_port;
+	ack.length = coap_build(ack.payload, OT_COAP_TYPE_ACKNOWLEDGMENT, OT_COAP_CODE_EMPTY, message_id, NULL, 0, NULL, NULL, 0);
+	datagram_send(&ack);
+}
+
+// subscriptions
+
+static void subscribe(uint32_t node)
+{
+	uint8_t payload[128];
+	uint8_t address[16];
+	CborEncoder encoder, map, sensors, sensor;
+
+	sim_mesh_mesh_local_eid_get(sim_mesh_border_router(), address);
+
+	cbor_encoder_init(&encoder, payload, sizeof(payload), 0);
+	cbor_encoder_create_map(&encoder, &map, 2);
+	cbor_encode_text_stringz(&map, "a");
+	cbor_encode_byte_string(&map, address, sizeof(address));
+	cbor_encode_text_stringz(&map, "s");
+	cbor_encoder_create_map(&map, &sensors, CHANNELS + 1);
+
+	static const char *const channel_keys[CHANNELS] = { "r", "g", "b", "w" };
+	for (int i = 0; i < CHANNELS; i++) {
+		cbor_encode_text_stringz(&sensors, channel_keys[i]);
+		cbor_encoder_create_map(&sensors, &sensor, 2);
+		cbor_encode_text_stringz(&sensor, "i");
+		cbor_encode_uint(&sensor, CHANNEL_REPORT_INTERVAL);
+		cbor_encode_text_stringz(&sensor, "r");
+		cbor_encode_uint(&sensor, 0);
+		cbor_encoder_close_container(&sensors, &sensor);
+	}
+	cbor_encode_text_stringz(&sensors, "t");
+	cbor_encoder_create_map(&sensors, &sensor, 2);
+	cbor_encode_text_stringz(&sensor, "i");
+	cbor_encode_uint(&sensor, TEMPERATURE_REPORT_INTERVAL);
+	cbor_encode_text_stringz(&sensor, "r");
+	cbor_encode_uint(&sensor, TEMPERATURE_REPORT_CHANGE);
+	cbor_encoder_close_container(&sensors, &sensor);
+
+	cbor_encoder_close_container(&map, &sensors);
+	if (cbor_encoder_close_container(&encoder, &map) != CborNoError)
+		fail("/sub payload");
+
+	m_metrics.subscriptions_sent++;
+	exchange_start(&m_node_states[node].sub, node, "sub", payload, (uint16_t)cbor_encoder_get_buffer_size(&encoder, payload));
+}
+
+static void up_receive(const sim_datagram *p_datagram, const coap_message *p_message)
+{
+	CborParser parser;
+	CborValue it, value;
+	uint8_t address[16];
+	size_t address_length = sizeof(address);
+
+	if (cbor_parser_init(p_message->p_payload, p_message->payload_length, 0, &parser, &it) != CborNoError ||
+		!cbor_value_is_map(&it) ||
+		cbor_value_map_find_value(&it, "a", &value) != CborNoError ||
+		!cbor_value_is_byte_string(&value) ||
+		cbor_value_copy_byte_string(&value, address, &address_length, NULL) != CborNoError ||
+		address_length != sizeof(address) ||
+		memcmp(address, p_datagram->source, sizeof(address)) != 0)
+		return;
+
+	int32_t node = sim_mesh_radio_find(address);
+	if (node < 0 || (uint32_t)node >= m_nodes)
+		return;
+
+	m_metrics.announcements++;
+
+	// a node announces itself when it lost its subscription, a reboot does that
+	node_state *p_state = &m_node_states[node];
+	p_state->subscribed = false;
+	p_state->subscribed_at = 0;
+	if (!p_state->sub.active)
+		subscribe((uint32_t)node);
+}
+
+// /set
+
+static void set_finish(node_state *p_state)
+{
+	exchange_finish(&p_state->set);
+	p_state->set_done_at = sim_now();
+}
+
+static void set_send(uint32_t node)
+{
+	node_state *p_state = &m_node_states[node];
+	uint8_t payload[64];
+	CborEncoder encoder, map;
+
+	static const char *const channel_keys[CHANNELS] = { "r", "g", "b", "w" };
+
+	cbor_encoder_init(&encoder, payload, sizeof(payload), 0);
+	cbor_encoder_create_map(&encoder, &map, CHANNELS);
+	for (int i = 0; i < CHANNELS; i++) {
+		p_state->set_values[i] = (uint16_t)(1 + sim_random_below(255));
+		cbor_encode_text_stringz(&map, channel_keys[i]);
+		cbor_encode_uint(&map, p_state->set_values[i]);
+	}
+	if (cbor_encoder_close_container(&encoder, &map) != CborNoError)
+		fail("/set payload");
+
+	p_state->pwm_pending = true;
+
+	m_metrics.sets_sent++;
+	exchange_start(&p_state->set, node, "set", payload, (uint16_t)cbor_encoder_get_buffer_size(&encoder, payload));
+}
+
+static bool set_ready(uint32_t node)
+{
+	node_state *p_state = &m_node_states[node];
+
+	if (p_state->pwm_pending && !p_state->set.active && sim_now() - p_state->set.sent_at >= PWM_WAIT_US) {
+		m_metrics.sets_pwm_missed++;
+		p_state->pwm_pending = false;
+	}
+
+	return p_state->subscribed && !p_state->set.active && !p_state->pwm_pending && sim_node_powered(node);
+}
+
+static void traffic_event(void *p_context, uint32_t generation)
+{
+	uint32_t candidates[SIM_NODES_MAX];
+	uint32_t count = 0;
+
+	if (!m_traffic || generation != m_traffic_generation)
+		return;
+
+	for (uint32_t node = 0; node < m_nodes; node++) {
+		if (set_ready(node) && sim_node_port(node)->rx_on_when_idle)
+			candidates[count++] = node;
+	}
+	if (count > 0)
+		set_send(candidates[sim_random_below(count)]);
+
+	sim_event_schedule(sim_now() + m_traffic_interval, traffic_event, NULL, generation);
+}
+
+static void response_receive(uint32_t node, const sim_datagram *p_datagram, const coap_message *p_message)
+{
+	node_state *p_state = &m_node_states[node];
+	exchange *p_exchange = NULL;
+
+	// a piggybacked response or an Empty ACK match the message ID, a separate response the token
+	if (p_message->type == OT_COAP_TYPE_ACKNOWLEDGMENT) {
+		if (p_state->sub.active && p_state->sub.message_id == p_message->message_id)
+			p_exchange = &p_state->sub;
+		else if (p_state->set.active && p_state->set.message_id == p_message->message_id)
+			p_exchange = &p_state->set;
+	} else {
+		empty_ack_send(p_datagram, p_message->message_id);
+		if (p_message->token_length == TOKEN_LENGTH) {
+			if (p_state->sub.active && memcmp(p_state->sub.token, p_message->token, TOKEN_LENGTH) == 0)
+				p_exchange = &p_state->sub;
+			else if (p_state->set.active && memcmp(p_state->set.token, p_message->token, TOKEN_LENGTH) == 0)
+				p_exchange = &p_state->set;
+		}
+	}
+	if (p_exchange == NULL)
+		return;
+
+	if (p_message->code == OT_COAP_CODE_EMPTY) {
+		if (p_exchange->acknowledged)
+			return;
+		// stop retransmitting, wait for the response instead
+		p_exchange->acknowledged = true;
+		p_exchange->generation++;
+		if (p_exchange == &p_state->set)
+			m_metrics.sets_separate++;
+		sim_event_schedule(sim_now() + SEPARATE_RESPONSE_WAIT_US, retransmit_event, p_exchange, p_exchange->generation);
+		return;
+	}
+
+	if (p_exchange == &p_state->sub) {
+		exchange_finish(p_exchange);
+		if (p_message->code == OT_COAP_CODE_CONTENT) {
+			p_state->subscribed = true;
+			p_state->subscribed_at = sim_now();
+		}
+		return;
+	}
+
+	m_metrics.sets_answered++;
+	latency_add(&m_metrics.set_response, sim_now() - p_exchange->sent_at);
+	set_finish(p_state);
+}
+
+static void exchange_failed(exchange *p_exchange)
+{
+	node_state *p_state = &m_node_states[p_exchange->node];
+
+	if (p_exchange == &p_state->set) {
+		m_metrics.sets_failed++;
+		set_finish(p_state);
+		return;
+	}
+
+	// the node announces itself again when it does not hear from the controller
+	exchange_finish(p_exchange);
+}
+
+// reports
+
+static void report_receive(uint32_t node, const coap_message *p_message)
+{
+	node_state *p_state = &m_node_states[node];
+
+	// the node took the subscription even when its response to the /sub got lost, it does not announce
+	// itself again then and its reports are all that tell
+	if (!p_state->subscribed) {
+		p_state->subscribed = true;
+		p_state->subscribed_at = sim_now();
+	}
+
+	for (uint32_t i = m_reports_count; i-- > 0;) {
+		report_record *p_record = &mp_reports[i];
+		if (p_record->node == node && p_record->message_id == p_message->message_id && !p_record->delivered) {
+			p_record->delivered = true;
+			break;
+		}
+	}
+
+	// a sleepy node listens right after its report
+	if (m_traffic && !sim_node_port(node)->rx_on_when_idle && set_ready(node) &&
+		sim_now() - p_state->set_done_at >= SED_SET_INTERVAL_US)
+		set_send(node);
+}
+
+// interface
+
+void sim_controller_init(uint32_t nodes)
+{
+	m_nodes = nodes;
+	m_message_id = (uint16_t)sim_random();
+	memset(m_node_states, 0, sizeof(m_node_states));
+}
+
+static void beacon_event(void *p_context, uint32_t arg)
+{
+	uint8_t payload[16];
+	uint8_t address[16] = { 0xFF, 0x03 };
+	sim_datagram datagram;
+	CborEncoder encoder, map;
+
+	address[15] = 0x01;
+
+	cbor_encoder_init(&encoder, payload, sizeof(payload), 0);
+	cbor_encoder_create_map(&encoder, &map, 1);
+	cbor_encode_text_stringz(&map, "t");
+	cbor_encode_uint(&map, (uint32_t)(sim_now() / 1000));
+	cbor_encoder_close_container(&encoder, &map);
+
+	// from the leader RLOC, the nodes take beacons from nowhere else
+	datagram_to(&datagram, address);
+	sim_mesh_rloc_get(sim_mesh_border_router(), datagram.source);
+	datagram.length = coap_build(datagram.payload, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_POST, m_message_id++,
+		NULL, 0, "ts", payload, (uint16_t)cbor_encoder_get_buffer_size(&encoder, payload));
+	datagram_send(&datagram);
+
+	sim_event_schedule(sim_now() + SIM_MS(TIMESYNC_BEACON_INTERVAL), beacon_event, NULL, 0);
+}
+
+void sim_controller_beacons_start(void)
+{
+	sim_event_schedule(sim_now() + SIM_MS(TIMESYNC_BEACON_INTERVAL), beacon_event, NULL, 0);
+}
+
+void sim_controller_traffic_set(bool enabled, uint64_t interval)
+{
+	m_traffic = enabled;
+	m_traffic_interval = interval;
+	m_traffic_generation++;
+
+	if (enabled)
+		sim_event_schedule(sim_now() + interval, traffic_event, NULL, m_traffic_generation);
+}
+
+void sim_controller_subscriptions_reset(void)
+{
+	for (uint32_t node = 0; node < m_nodes; node++) {
+		node_state *p_state = &m_node_states[node];
+		p_state->subscribed = false;
+		p_state->subscribed_at = 0;
+		p_state->pwm_pending = false;
+		exchange_finish(&p_state->sub);
+		exchange_finish(&p_state->set);
+	}
+}
+
+uint32_t sim_controller_subscribed_count(void)
+{
+	uint32_t count = 0;
+
+	for (uint32_t node = 0; node < m_nodes; node++)
+		count += m_node_states[node].subscribed;
+	return count;
+}
+
+uint64_t sim_controller_subscribed_at(uint32_t node)
+{
+	return m_node_states[node].subscribed_at;
+}
+
+void sim_controller_metrics_reset(void)
+{
+	free(m_metrics.set_response.p_samples);
+	free(m_metrics.set_pwm.p_samples);
+	memset(&m_metrics, 0, sizeof(m_metrics));
+	m_reports_count = 0;
+}
+
+sim_controller_metrics *sim_controller_metrics_get(void)
+{
+	return &m_metrics;
+}
+
+void sim_controller_report_delivery(uint64_t sent_before, uint32_t *p_sent, uint32_t *p_delivered)
+{
+	*p_sent = 0;
+	*p_delivered = 0;
+
+	for (uint32_t i = 0; i < m_reports_count; i++) {
+		if (mp_reports[i].sent_at >= sent_before)
+			continue;
+		(*p_sent)++;
+		*p_delivered += mp_reports[i].delivered;
+	}
+}
+
+void sim_controller_receive(const sim_datagram *p_datagram)
+{
+	coap_message message;
+
+	if (p_datagram->destination_port != OT_DEFAULT_COAP_PORT || !coap_parse(p_datagram->payload, p_datagram->length, &message))
+		return;
+
+	if (message.code == OT_COAP_CODE_POST && message.type == OT_COAP_TYPE_NON_CONFIRMABLE && message.p_payload != NULL &&
+		strcmp(message.uri, "up") == 0) {
+		up_receive(p_datagram, &message);
+		return;
+	}
+
+	int32_t node = sim_mesh_radio_find(p_datagram->source);
+	if (node < 0 || (uint32_t)node >= m_nodes)
+		return;
+
+	if (message.code == OT_COAP_CODE_POST && strcmp(message.uri, "rep") == 0)
+		report_receive((uint32_t)node, &message);
+	else if (message.code == OT_COAP_CODE_EMPTY || message.code >= OT_COAP_CODE_RESPONSE_MIN)
+		response_receive((uint32_t)node, p_datagram, &message);
+}
+
+void sim_controller_node_sent(uint32_t node, const sim_datagram *p_datagram)
+{
+	coap_message message;
+	uint8_t controller[16];
+
+	sim_mesh_mesh_local_eid_get(sim_mesh_border_router(), controller);
+	if (memcmp(p_datagram->destination, controller, sizeof(controller)) != 0 ||
+		p_datagram->destination_port != OT_DEFAULT_COAP_PORT ||
+		!coap_parse(p_datagram->payload, p_datagram->length, &message) ||
+		message.code != OT_COAP_CODE_POST || strcmp(message.uri, "rep") != 0)
+		return;
+
+	if (m_reports_count == m_reports_size) {
+		m_reports_size = m_reports_size == 0 ? 1024 : m_reports_size * 2;
+		mp_reports = realloc(mp_reports, m_reports_size * sizeof(*mp_reports));
+		if (mp_reports == NULL)
+			fail("out of memory");
+	}
+
+	report_record *p_record = &mp_reports[m_reports_count++];
+	p_record->node = node;
+	p_record->message_id = message.message_id;
+	p_record->delivered = false;
+	p_record->sent_at = sim_now();
+}
+
+void sim_controller_node_ran(uint32_t node, const sim_port *p_port)
+{
+	node_state *p_state = &m_node_states[node];
+
+	if (!p_state->pwm_pending)
+		return;
+
+	for (int i = 0; i < CHANNELS; i++) {
+		if (p_port->pwm_out_values[i] != p_state->set_values[i])
+			return;
+	}
+
+	p_state->pwm_pending = false;
+	latency_add(&m_metrics.set_pwm, sim_now() - p_state->set.sent_at);
+}
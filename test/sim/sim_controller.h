@@ -0,0 +1,78 @@
+#ifndef SIM_CONTROLLER_H__
+#define SIM_CONTROLLER_H__
+
+#include "sim_port.h"
+
+/**@brief The controller on the border router: subscribes the nodes, sends /set traffic and time beacons,
+ *        and measures what the nodes do with it.
+ *
+ * @details It speaks CoAP over the mesh like the real controller: a /up gets a confirmable PUT /sub back,
+ *          confirmable requests are retransmitted as RFC 7252 says and a separate response is acknowledged.
+ *          The nodes are watched from the side as well: every /rep a node hands to its stack is counted
+ *          against the ones that arrive, and the PWM values of a node are compared with the last /set
+ *          after every time it ran.
+ */
+
+/**@brief Latency samples in microseconds. */
+typedef struct sim_latency
+{
+	uint32_t count;
+	uint32_t size;
+	uint64_t *p_samples;
+} sim_latency;
+
+typedef struct sim_controller_metrics
+{
+	uint32_t announcements;       // /up received
+	uint32_t subscriptions_sent;
+	uint32_t sets_sent;
+	uint32_t sets_retransmitted;
+	uint32_t sets_answered;
+	uint32_t sets_separate;       // acknowledged with an Empty ACK, answered later
+	uint32_t sets_failed;         // no response after the last retransmission
+	uint32_t sets_pwm_missed;     // the outputs never showed the values of the request
+	sim_latency set_response;     // request to response
+	sim_latency set_pwm;          // request to the PWM values on the outputs
+} sim_controller_metrics;
+
+void sim_controller_init(uint32_t nodes);
+
+/**@brief Starts the time beacons of the leader, one every TIMESYNC_BEACON_INTERVAL. */
+void sim_controller_beacons_start(void);
+
+/**@brief Starts or stops the /set traffic: one request every interval to a node without one pending, and
+ *        one after every /rep of a sleepy node that was not set for a while.
+ */
+void sim_controller_traffic_set(bool enabled, uint64_t interval);
+
+/**@brief Forgets every subscription, a node counts as subscribed again once it answers the next /sub or reports. */
+void sim_controller_subscriptions_reset(void);
+
+uint32_t sim_controller_subscribed_count(void);
+
+/**@brief Time the node was last subscribed at, 0 when it is not. */
+uint64_t sim_controller_subscribed_at(uint32_t node);
+
+/**@brief Clears the metrics and the /rep records. */
+void sim_controller_metrics_reset(void);
+
+sim_controller_metrics *sim_controller_metrics_get(void);
+
+/**@brief The /rep sent by the nodes before sent_before since the metrics were reset, and how many of them
+ *        reached the controller.
+ */
+void sim_controller_report_delivery(uint64_t sent_before, uint32_t *p_sent, uint32_t *p_delivered);
+
+/**@brief Sample at the given fraction of the sorted samples, 0 when there are none. */
+uint64_t sim_latency_percentile(sim_latency *p_latency, double fraction);
+
+/**@brief A datagram for the border router came out of the mesh. */
+void sim_controller_receive(const sim_datagram *p_datagram);
+
+/**@brief A node handed a datagram to its stack. */
+void sim_controller_node_sent(uint32_t node, const sim_datagram *p_datagram);
+
+/**@brief A node ran and yielded. */
+void sim_controller_node_ran(uint32_t node, const sim_port *p_port);
+
+#endif /* SIM_CONTROLLER_H__ */
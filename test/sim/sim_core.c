@@ -0,0 +1,114 @@
+#include "sim_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct
+{
+	uint64_t at;
+	uint64_t sequence;
+	sim_event_handler_t handler;
+	void *p_context;
+	uint32_t arg;
+} sim_event;
+
+static uint64_t m_now;
+static uint64_t m_sequence;
+static uint64_t m_random_state;
+
+// binary min-heap ordered by time, then by the order of scheduling
+static sim_event *mp_events;
+static size_t m_events_count;
+static size_t m_events_size;
+
+static bool event_before(const sim_event *p_a, const sim_event *p_b)
+{
+	return p_a->at < p_b->at || (p_a->at == p_b->at && p_a->sequence < p_b->sequence);
+}
+
+uint64_t sim_now(void)
+{
+	return m_now;
+}
+
+void sim_event_schedule(uint64_t at, sim_event_handler_t handler, void *p_context, uint32_t arg)
+{
+	if (at < m_now)
+		at = m_now;
+
+	if (m_events_count == m_events_size) {
+		m_events_size = m_events_size == 0 ? 1024 : m_events_size * 2;
+		mp_events = realloc(mp_events, m_events_size * sizeof(*mp_events));
+		if (mp_events == NULL) {
+			fprintf(stderr, "sim: out of memory for events\n");
+			abort();
+		}
+	}
+
+	size_t i = m_events_count++;
+	sim_event event = { .at = at, .sequence = m_sequence++, .handler = handler, .p_context = p_context, .arg = arg };
+
+	while (i > 0 && event_before(&event, &mp_events[(i - 1) / 2])) {
+		mp_events[i] = mp_events[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	mp_events[i] = event;
+}
+
+static sim_event event_pop(void)
+{
+	sim_event first = mp_events[0];
+	sim_event last = mp_events[--m_events_count];
+	size_t i = 0;
+
+	while (true) {
+		size_t child = 2 * i + 1;
+		if (child >= m_events_count)
+			break;
+		if (child + 1 < m_events_count && event_before(&mp_events[child + 1], &mp_events[child]))
+			child++;
+		if (!event_before(&mp_events[child], &last))
+			break;
+		mp_events[i] = mp_events[child];
+		i = child;
+	}
+	if (m_events_count > 0)
+		mp_events[i] = last;
+
+	return first;
+}
+
+void sim_run_until(uint64_t time)
+{
+	while (m_events_count > 0 && mp_events[0].at <= time) {
+		sim_event event = event_pop();
+		m_now = event.at;
+		event.handler(event.p_context, event.arg);
+	}
+	m_now = time;
+}
+
+void sim_random_seed(uint64_t seed)
+{
+	m_random_state = seed;
+}
+
+uint32_t sim_random(void)
+{
+	// splitmix64
+	uint64_t z = (m_random_state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+uint64_t sim_random_below(uint64_t range)
+{
+	uint64_t value = ((uint64_t)sim_random() << 32) | sim_random();
+	return value % range;
+}
+
+double sim_random_unit(void)
+{
+	return (double)sim_random() / 4294967296.0;
+}
@@ -0,0 +1,35 @@
+#ifndef SIM_CORE_H__
+#define SIM_CORE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Discrete event core of the simulation: the global clock, the event queue and the random source.
+ *
+ * @details Time is in microseconds since the start of the run. Events at the same time run in the order
+ *          they were scheduled. Everything random draws from one seeded generator, a run is reproducible.
+ */
+
+#define SIM_MS(ms) ((uint64_t)(ms) * 1000)
+#define SIM_S(s)   ((uint64_t)(s) * 1000000)
+
+typedef void (*sim_event_handler_t)(void *p_context, uint32_t arg);
+
+uint64_t sim_now(void);
+
+void sim_event_schedule(uint64_t at, sim_event_handler_t handler, void *p_context, uint32_t arg);
+
+/**@brief Runs the events up to and including time, returns with the clock at time. */
+void sim_run_until(uint64_t time);
+
+void sim_random_seed(uint64_t seed);
+
+uint32_t sim_random(void);
+
+/**@brief Uniform in [0, range), range greater than zero. */
+uint64_t sim_random_below(uint64_t range);
+
+/**@brief Uniform in [0, 1). */
+double sim_random_unit(void);
+
+#endif /* SIM_CORE_H__ */
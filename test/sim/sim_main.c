@@ -0,0 +1,196 @@
+#include "sim_controller.h"
+#include "sim_core.h"
+#include "sim_mesh.h"
+#include "sim_node.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <openthread/thread.h>
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+#define NODES               60
+#define SLEEPY_NODE(node)   ((node) % 10 == 5) // one sleepy node in ten, spread over the rings
+#define SEED                0x5EED // the run is reproducible, another seed gives another placement and timing
+#define POWER_ON_JITTER     SIM_S(2)
+#define CONVERGE_LIMIT      SIM_S(300)
+#define CONVERGE_EXPECTED   SIM_S(240) // 80 to 180 s over the default seed and seeds 1 to 6
+#define TRAFFIC_INTERVAL    SIM_MS(250)
+#define TRAFFIC_DURATION    SIM_S(300)
+#define DRAIN               SIM_S(10)
+#define REPORT_GRACE        SIM_S(5) // reports sent this close to the end may still be on their way
+#define POWER_CUT           SIM_S(2)
+#define RESTORE_JITTER      SIM_MS(500)
+
+static int m_failures = 0;
+
+static void check(bool passed, const char *p_condition, int line)
+{
+	if (passed)
+		return;
+
+	m_failures++;
+	printf("sim_main.c:%d: %s\n", line, p_condition);
+}
+
+static void power_on_event(void *p_context, uint32_t node)
+{
+	sim_node_power_on(node);
+}
+
+/**@brief Runs until every node is subscribed or the limit passed, returns the time it took. */
+static uint64_t run_until_subscribed(uint64_t started_at, uint64_t limit)
+{
+	while (sim_controller_subscribed_count() < NODES && sim_now() - started_at < limit)
+		sim_run_until(sim_now() + SIM_MS(100));
+
+	uint64_t last = started_at;
+	for (uint32_t node = 0; node < NODES; node++) {
+		uint64_t at = sim_controller_subscribed_at(node);
+		if (at > last)
+			last = at;
+	}
+	return last - started_at;
+}
+
+static void roles_print(void)
+{
+	uint32_t roles[OT_DEVICE_ROLE_LEADER + 1] = { 0 };
+
+	for (uint32_t node = 0; node < NODES; node++)
+		roles[sim_mesh_role(node)]++;
+
+	printf("  roles: %u routers, %u children, %u detached, %u disabled\n", roles[OT_DEVICE_ROLE_ROUTER],
+		roles[OT_DEVICE_ROLE_CHILD], roles[OT_DEVICE_ROLE_DETACHED], roles[OT_DEVICE_ROLE_DISABLED]);
+}
+
+static void node_counters_print(void)
+{
+	uint32_t retransmissions = 0;
+	uint32_t timeouts = 0;
+	uint32_t no_bufs = 0;
+	uint32_t boots = 0;
+
+	for (uint32_t node = 0; node < NODES; node++) {
+		const sim_port *p_port = sim_node_port(node);
+		retransmissions += p_port->coap_retransmissions;
+		timeouts += p_port->coap_timeouts;
+		no_bufs += p_port->messages_no_bufs;
+		boots += sim_node_boots(node);
+	}
+
+	const sim_mesh_stats *p_stats = sim_mesh_stats_get();
+	printf("  nodes: %u boots, %u CoAP retransmissions, %u CoAP timeouts, %u out of message buffers\n", boots,
+		retransmissions, timeouts, no_bufs);
+	printf("  mesh: %u frames, %u collisions, %u channel access failures, %u datagrams dropped, %u attaches\n",
+		p_stats->frames, p_stats->collisions, p_stats->channel_access_failures, p_stats->datagrams_dropped,
+		p_stats->attaches);
+}
+
+static void ms_print(const char *p_name, sim_latency *p_latency)
+{
+	printf("  %s: %u samples, median %.1f ms, 95th %.1f ms, max %.1f ms\n", p_name, p_latency->count,
+		sim_latency_percentile(p_latency, 0.5) / 1000.0, sim_latency_percentile(p_latency, 0.95) / 1000.0,
+		sim_latency_percentile(p_latency, 1.0) / 1000.0);
+}
+
+/**@brief 60 nodes power up together and subscribe. */
+static void scenario_power_up(void)
+{
+	for (uint32_t node = 0; node < NODES; node++)
+		sim_event_schedule(sim_random_below(POWER_ON_JITTER), power_on_event, NULL, node);
+
+	uint64_t converged = run_until_subscribed(0, CONVERGE_LIMIT);
+
+	printf("power up: %u of %u nodes subscribed after %.1f s, %u routers\n", sim_controller_subscribed_count(),
+		NODES, converged / 1e6, sim_mesh_routers());
+	roles_print();
+
+	CHECK(sim_controller_subscribed_count() == NODES);
+	CHECK(converged < CONVERGE_EXPECTED);
+}
+
+/**@brief /set traffic to the subscribed nodes while they report. */
+static void scenario_traffic(void)
+{
+	sim_controller_metrics_reset();
+	sim_controller_traffic_set(true, TRAFFIC_INTERVAL);
+	uint64_t end = sim_now() + TRAFFIC_DURATION;
+	sim_run_until(end);
+	sim_controller_traffic_set(false, 0);
+	sim_run_until(sim_now() + DRAIN);
+
+	sim_controller_metrics *p_metrics = sim_controller_metrics_get();
+	uint32_t reports_sent;
+	uint32_t reports_delivered;
+	sim_controller_report_delivery(end - REPORT_GRACE, &reports_sent, &reports_delivered);
+	double delivery = reports_sent > 0 ? (double)reports_delivered / reports_sent : 0.0;
+
+	printf("traffic: %u /set sent, %u answered, %u separate, %u retransmitted, %u failed, %u outputs missed\n",
+		p_metrics->sets_sent, p_metrics->sets_answered, p_metrics->sets_separate, p_metrics->sets_retransmitted,
+		p_metrics->sets_failed, p_metrics->sets_pwm_missed);
+	ms_print("/set response", &p_metrics->set_response);
+	ms_print("/set to PWM", &p_metrics->set_pwm);
+	printf("  /rep: %u of %u delivered, %.2f %%\n", reports_delivered, reports_sent, 100.0 * delivery);
+
+	CHECK(p_metrics->sets_sent > 0);
+	CHECK(p_metrics->sets_failed * 100 <= p_metrics->sets_sent);
+	CHECK(p_metrics->sets_answered + p_metrics->sets_failed == p_metrics->sets_sent);
+	CHECK(sim_latency_percentile(&p_metrics->set_response, 0.5) < SIM_MS(100));
+	CHECK(sim_latency_percentile(&p_metrics->set_response, 0.95) < SIM_S(3));
+	CHECK(sim_latency_percentile(&p_metrics->set_pwm, 0.5) < SIM_MS(100));
+	CHECK(p_metrics->set_pwm.count + p_metrics->sets_pwm_missed >= p_metrics->sets_answered);
+	CHECK(reports_sent >= NODES * 4); // the temperature of every node once a minute, of a sleepy node every other
+	CHECK(delivery >= 0.97);
+}
+
+/**@brief Power to every node is cut at once and comes back, each node must subscribe again. */
+static void scenario_mass_reboot(void)
+{
+	for (uint32_t node = 0; node < NODES; node++)
+		sim_node_power_off(node);
+	sim_controller_subscriptions_reset();
+	sim_run_until(sim_now() + POWER_CUT);
+
+	uint64_t restored_at = sim_now();
+	for (uint32_t node = 0; node < NODES; node++)
+		sim_event_schedule(restored_at + sim_random_below(RESTORE_JITTER), power_on_event, NULL, node);
+
+	uint64_t converged = run_until_subscribed(restored_at, CONVERGE_LIMIT);
+
+	printf("mass reboot: %u of %u nodes subscribed after %.1f s, %u routers\n", sim_controller_subscribed_count(),
+		NODES, converged / 1e6, sim_mesh_routers());
+	roles_print();
+
+	CHECK(sim_controller_subscribed_count() == NODES);
+	CHECK(converged < CONVERGE_EXPECTED);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 3 && argc != 4) {
+		fprintf(stderr, "usage: %s <router node library> <sleepy node library> [seed]\n", argv[0]);
+		return 2;
+	}
+
+	sim_random_seed(argc == 4 ? strtoull(argv[3], NULL, 0) : SEED);
+	sim_mesh_init(NODES);
+	sim_controller_init(NODES);
+	for (uint32_t node = 0; node < NODES; node++)
+		sim_node_init(node, SLEEPY_NODE(node) ? argv[2] : argv[1]);
+	sim_controller_beacons_start();
+
+	scenario_power_up();
+	scenario_traffic();
+	scenario_mass_reboot();
+	node_counters_print();
+
+	sim_node_shutdown();
+
+	if (m_failures)
+		printf("%d checks failed\n", m_failures);
+
+	return m_failures ? 1 : 0;
+}
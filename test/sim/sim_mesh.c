@@ -0,0 +1,1579 @@
+#include "sim_mesh.h"
+
+#include "sim_controller.h"
+#include "sim_core.h"
+#include "sim_node.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openthread/instance.h>
+#include <openthread/thread.h>
+
+#define RADIOS_MAX               (SIM_NODES_MAX + 1)
+#define BROADCAST                (-1)
+#define NONE                     (-1)
+#define NEVER                    UINT64_MAX
+
+// placement and links, in units of the distance at which the link quality starts to drop
+#define RING_NODES               10 // nodes of the first ring, ring k holds k times as many
+#define LQ3_RANGE                1.0
+#define LQ2_RANGE                1.5
+#define LQ1_RANGE                2.0 // beyond it the radios do not hear each other at all
+
+// IEEE 802.15.4 O-QPSK at 2.4 GHz, unslotted CSMA-CA with the OpenThread defaults
+#define BYTE_US                  32
+#define PHY_HEADER_SIZE          6
+#define BACKOFF_PERIOD_US        320
+#define CCA_US                   128
+#define TURNAROUND_US            192
+#define ACK_SIZE                 5
+#define MAC_MIN_BE               3
+#define MAC_MAX_BE               5
+#define MAC_MAX_CSMA_BACKOFFS    4
+#define MAC_MAX_FRAME_RETRIES    3
+#define MAC_OVERHEAD             21 // header with short addresses, security and FCS
+#define POLL_PSDU                28 // secured data request command
+
+// 6LoWPAN
+#define LOWPAN_OVERHEAD          28 // compressed IPv6 and UDP headers of mesh-local traffic
+#define MESH_HEADER_SIZE         5
+#define MPL_OPTION_SIZE          8
+#define FRAME_PAYLOAD_MAX        106
+#define FRAGMENT_PAYLOAD         96
+#define FRAGMENT_HEADER_SIZE     5
+
+#define FORWARD_DELAY_US         1000
+#define TX_QUEUE_MAX             64
+#define INDIRECT_PER_CHILD_MAX   8
+#define MPL_INTERVAL_US          64000
+#define MPL_TRANSMISSIONS        2
+#define MPL_SEEN_SIZE            64
+
+// MLE
+#define CHILDREN_MAX             10
+#define ROUTERS_MAX              32
+#define ROUTER_ID_REUSE_DELAY    SIM_S(100)
+#define ROUTER_ID_EXPIRY         SIM_S(120) // the leader frees the ID of a router it stopped hearing from
+#define ATTACH_ROUTER_US         SIM_MS(850)
+#define ATTACH_REED_US           SIM_MS(2100) // the REED becomes a router before it takes the child
+#define ATTACH_BACKOFF_MIN       SIM_S(1)
+#define ATTACH_BACKOFF_MAX       SIM_S(60)
+#define RESTORE_US               SIM_MS(150)
+#define RESTORE_RETRY_US         SIM_S(1)
+#define RESTORE_ATTEMPTS         3
+#define CHILD_TIMEOUT_RX_ON      SIM_S(10) // main.c sets 10 s for a node that keeps its receiver on
+#define CHILD_TIMEOUT_SLEEPY     SIM_S(240) // DEFAULT_CHILD_TIMEOUT
+#define POLL_PERIOD_DEFAULT_US   SIM_S(236) // OpenThread polls a little inside the child timeout when none is set
+#define POLL_RETRY_US            SIM_S(1)
+#define POLL_FAILURES_MAX        5
+#define DOWNGRADE_NEIGHBORS_MIN  7
+#define MLE_TICK_US              SIM_S(1)
+
+static const uint8_t m_mesh_local_prefix[8] = { 0xFD, 0x00, 0x0D, 0xB8, 0x00, 0x00, 0x00, 0x00 };
+static const uint8_t m_rloc_iid[6] = { 0x00, 0x00, 0x00, 0xFF, 0xFE, 0x00 };
+static const double m_frame_loss[4] = { 1.0, 0.15, 0.05, 0.01 }; // by link quality
+static const uint8_t m_link_cost[4] = { 0, 4, 2, 1 };
+
+typedef struct packet
+{
+	sim_datagram datagram;
+	uint32_t origin;     // radio the datagram entered the mesh at
+	uint32_t mpl_sequence;
+	bool multicast;
+	bool to_seed;        // multicast of a child, on its way to the parent that floods it
+} packet;
+
+typedef enum
+{
+	JOB_DATA,
+	JOB_POLL,
+} job_kind;
+
+/**@brief A datagram going over one hop, or a data poll, in the transmit queue of a radio. */
+typedef struct job
+{
+	struct job *p_next;
+	job_kind kind;
+	packet *p_packet;
+	int32_t to;             // radio, BROADCAST
+	uint16_t lowpan_size;
+	uint8_t fragments;
+	uint8_t fragment;
+	uint8_t attempts;
+	uint8_t backoffs;
+	uint8_t exponent;
+	uint16_t *p_received;   // by radio, the fragments it received
+} job;
+
+typedef struct indirect
+{
+	struct indirect *p_next;
+	uint32_t child;
+	packet *p_packet;
+} indirect;
+
+typedef struct
+{
+	uint32_t id;
+	uint32_t source;
+	int32_t to;
+	bool ack;
+	uint64_t start;
+	uint64_t end;
+} air_frame;
+
+typedef struct
+{
+	uint32_t radio;
+	packet *p_packet;
+	uint32_t mac_generation;
+	uint8_t remaining;
+} mpl_transmission;
+
+typedef struct
+{
+	double x;
+	double y;
+	uint32_t ring;
+	uint8_t mesh_local_iid[8];
+
+	bool powered;
+	bool enabled;
+	bool rx_on_when_idle;
+	bool full_thread_device;
+	uint8_t role;
+	uint8_t router_id;
+	uint16_t rloc16;
+	int32_t parent;
+	uint16_t next_child_id;
+	uint64_t powered_off_at;
+	uint32_t changed;
+	uint32_t tx_frames;
+	uint32_t rx_frames;
+
+	// what OpenThread keeps in its settings to restore the role after a reboot
+	uint8_t saved_role;
+	uint16_t saved_rloc16;
+	int32_t saved_parent;
+
+	// MLE, a new generation cancels the pending attach and restore events
+	uint32_t mle_generation;
+	uint64_t attach_backoff;
+	int32_t attaching_to;
+	uint8_t restore_attempts;
+	uint64_t parent_lost_at;
+	uint64_t upgrade_at;
+	uint64_t downgrade_at;
+	uint8_t upgrade_threshold;
+	uint8_t downgrade_threshold;
+	uint8_t selection_jitter;
+
+	// data polls of a sleepy child
+	uint32_t poll_period;
+	uint32_t poll_generation;
+	uint8_t poll_failures;
+	bool poll_queued;
+
+	// MAC, a new generation cancels the pending events of a radio that lost power
+	uint32_t mac_generation;
+	job *p_queue_head;
+	job *p_queue_tail;
+	uint32_t queue_length;
+	bool busy;
+	air_frame frame;
+	air_frame ack;
+	indirect *p_indirect;
+
+	uint32_t mpl_sequence;
+	uint32_t mpl_seen_origin[MPL_SEEN_SIZE];
+	uint32_t mpl_seen_sequence[MPL_SEEN_SIZE];
+	uint8_t mpl_seen_count;
+	uint8_t mpl_seen_next;
+} radio;
+
+typedef struct
+{
+	int32_t owner;
+	uint64_t seen_at;
+	uint64_t released_at;
+	bool released;
+} router_id_entry;
+
+static radio m_radios[RADIOS_MAX];
+static uint32_t m_radio_count;
+static uint32_t m_border_router;
+static uint8_t m_link_quality[RADIOS_MAX][RADIOS_MAX];
+static router_id_entry m_router_ids[SIM_ROUTER_ID_MAX + 1];
+static sim_mesh_stats m_stats;
+
+static air_frame *mp_air;
+static uint32_t m_air_count;
+static uint32_t m_air_size;
+static uint32_t m_frame_id;
+
+// shortest paths between the routers, a tree towards every target, rebuilt after the topology changed
+static uint32_t m_topology_generation = 1;
+static uint32_t m_route_generation[RADIOS_MAX];
+static int32_t m_route_next[RADIOS_MAX][RADIOS_MAX];
+static uint32_t m_route_cost[RADIOS_MAX][RADIOS_MAX];
+
+static void mac_kick(uint32_t r);
+static void csma_start(uint32_t r);
+static void attach_start(uint32_t r, uint64_t delay);
+static void packet_arrive(uint32_t r, packet *p_packet);
+static void mpl_receive(uint32_t r, packet *p_packet, bool seed);
+
+static void fail(const char *p_what)
+{
+	fprintf(stderr, "sim: %s\n", p_what);
+	abort();
+}
+
+static void *allocate(size_t size)
+{
+	void *p = calloc(1, size);
+	if (p == NULL)
+		fail("out of memory");
+	return p;
+}
+
+static packet *packet_copy(const packet *p_packet)
+{
+	packet *p_copy = allocate(sizeof(*p_copy));
+	*p_copy = *p_packet;
+	return p_copy;
+}
+
+// state
+
+static bool is_router(int32_t r)
+{
+	return r >= 0 && m_radios[r].powered && (m_radios[r].role == OT_DEVICE_ROLE_ROUTER || m_radios[r].role == OT_DEVICE_ROLE_LEADER);
+}
+
+static bool is_attached(int32_t r)
+{
+	return r >= 0 && m_radios[r].powered && m_radios[r].role >= OT_DEVICE_ROLE_CHILD;
+}
+
+static bool is_sleepy_child_of(int32_t c, int32_t parent)
+{
+	return is_attached(c) && m_radios[c].role == OT_DEVICE_ROLE_CHILD && m_radios[c].parent == parent && !m_radios[c].rx_on_when_idle;
+}
+
+/**@brief The parent keeps a child that lost power until the child timeout runs out. */
+static bool is_child_of(uint32_t c, uint32_t parent)
+{
+	const radio *p_child = &m_radios[c];
+
+	if (p_child->parent != (int32_t)parent)
+		return false;
+	if (p_child->powered)
+		return p_child->role == OT_DEVICE_ROLE_CHILD;
+
+	uint64_t timeout = p_child->rx_on_when_idle ? CHILD_TIMEOUT_RX_ON : CHILD_TIMEOUT_SLEEPY;
+	return sim_now() - p_child->powered_off_at < timeout;
+}
+
+static uint32_t children_count(uint32_t r)
+{
+	uint32_t count = 0;
+
+	for (uint32_t c = 0; c < m_radio_count; c++)
+		count += is_child_of(c, r);
+	return count;
+}
+
+static uint32_t active_routers(void)
+{
+	uint32_t count = 0;
+
+	for (uint32_t r = 0; r < m_radio_count; r++)
+		count += is_router(r);
+	return count;
+}
+
+static uint32_t allocated_router_ids(void)
+{
+	uint32_t count = 0;
+
+	for (int id = 0; id <= SIM_ROUTER_ID_MAX; id++)
+		count += m_router_ids[id].owner != NONE;
+	return count;
+}
+
+static bool router_id_available(void)
+{
+	if (allocated_router_ids() >= ROUTERS_MAX)
+		return false;
+
+	for (int id = 1; id <= SIM_ROUTER_ID_MAX; id++) {
+		const router_id_entry *p_entry = &m_router_ids[id];
+		if (p_entry->owner == NONE && (!p_entry->released || sim_now() - p_entry->released_at >= ROUTER_ID_REUSE_DELAY))
+			return true;
+	}
+	return false;
+}
+
+static int router_id_allocate(uint32_t r)
+{
+	if (allocated_router_ids() >= ROUTERS_MAX)
+		return NONE;
+
+	for (int id = 1; id <= SIM_ROUTER_ID_MAX; id++) {
+		router_id_entry *p_entry = &m_router_ids[id];
+		if (p_entry->owner == NONE && (!p_entry->released || sim_now() - p_entry->released_at >= ROUTER_ID_REUSE_DELAY)) {
+			p_entry->owner = (int32_t)r;
+			p_entry->seen_at = sim_now();
+			return id;
+		}
+	}
+	return NONE;
+}
+
+static void router_id_release(int id)
+{
+	m_router_ids[id].owner = NONE;
+	m_router_ids[id].released = true;
+	m_router_ids[id].released_at = sim_now();
+	m_topology_generation++;
+}
+
+static void rloc_address(uint16_t rloc16, uint8_t *p_address)
+{
+	memcpy(p_address, m_mesh_local_prefix, sizeof(m_mesh_local_prefix));
+	memcpy(&p_address[8], m_rloc_iid, sizeof(m_rloc_iid));
+	p_address[14] = (uint8_t)(rloc16 >> 8);
+	p_address[15] = (uint8_t)rloc16;
+}
+
+static void changed_notify(uint32_t r, uint32_t flags)
+{
+	m_radios[r].changed |= flags;
+	if (r != m_border_router)
+		sim_node_wake(r);
+}
+
+static void role_set(uint32_t r, uint8_t role, uint16_t rloc16)
+{
+	radio *p_radio = &m_radios[r];
+	uint32_t flags = 0;
+
+	bool was_router = is_router(r);
+	if (p_radio->role != role)
+		flags |= OT_CHANGED_THREAD_ROLE;
+	if (p_radio->rloc16 != rloc16 || (p_radio->role < OT_DEVICE_ROLE_CHILD) != (role < OT_DEVICE_ROLE_CHILD))
+		flags |= OT_CHANGED_THREAD_RLOC_ADDED | OT_CHANGED_THREAD_RLOC_REMOVED;
+	if ((p_radio->role < OT_DEVICE_ROLE_CHILD) && role >= OT_DEVICE_ROLE_CHILD)
+		flags |= OT_CHANGED_THREAD_ML_ADDR | OT_CHANGED_IP6_ADDRESS_ADDED;
+
+	p_radio->role = role;
+	p_radio->rloc16 = rloc16;
+	if (was_router || is_router(r))
+		m_topology_generation++;
+
+	if (flags != 0)
+		changed_notify(r, flags);
+}
+
+// routing
+
+static void routes_build(uint32_t target)
+{
+	bool done[RADIOS_MAX] = { false };
+	uint32_t *p_cost = m_route_cost[target];
+	int32_t *p_next = m_route_next[target];
+
+	for (uint32_t r = 0; r < m_radio_count; r++) {
+		p_cost[r] = UINT32_MAX;
+		p_next[r] = NONE;
+	}
+	p_cost[target] = 0;
+	p_next[target] = (int32_t)target;
+
+	// Dijkstra over the routers, O(n^2) is fine for this size
+	while (true) {
+		int32_t best = NONE;
+		for (uint32_t r = 0; r < m_radio_count; r++) {
+			if (!done[r] && is_router(r) && p_cost[r] != UINT32_MAX && (best == NONE || p_cost[r] < p_cost[best]))
+				best = (int32_t)r;
+		}
+		if (best == NONE)
+			break;
+
+		done[best] = true;
+		for (uint32_t r = 0; r < m_radio_count; r++) {
+			uint8_t link_quality = m_link_quality[best][r];
+			if (done[r] || !is_router(r) || link_quality == 0)
+				continue;
+			uint32_t cost = p_cost[best] + m_link_cost[link_quality];
+			if (cost < p_cost[r]) {
+				p_cost[r] = cost;
+				p_next[r] = best;
+			}
+		}
+	}
+
+	m_route_generation[target] = m_topology_generation;
+}
+
+static void routes_update(uint32_t target)
+{
+	if (m_route_generation[target] != m_topology_generation)
+		routes_build(target);
+}
+
+/**@brief Cost of the path from a router to the leader, UINT32_MAX when there is none. */
+static uint32_t leader_cost(uint32_t r)
+{
+	routes_update(m_border_router);
+	return m_route_cost[m_border_router][r];
+}
+
+static int32_t next_hop(uint32_t from, uint32_t destination)
+{
+	const radio *p_from = &m_radios[from];
+	const radio *p_destination = &m_radios[destination];
+
+	if (p_from->role == OT_DEVICE_ROLE_CHILD)
+		return p_from->parent;
+
+	int32_t target = is_router(destination) ? (int32_t)destination : p_destination->parent;
+	if (target == NONE || !is_router(target))
+		return NONE;
+	if (target == (int32_t)from)
+		return (int32_t)destination;
+
+	routes_update((uint32_t)target);
+	return m_route_next[target][from];
+}
+
+// the air
+
+static bool overlaps(const air_frame *p_a, const air_frame *p_b)
+{
+	return p_a->start < p_b->end && p_b->start < p_a->end;
+}
+
+static void air_add(air_frame *p_frame)
+{
+	uint64_t now = sim_now();
+
+	// frames that ended long before anything still in flight started are of no interest
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < m_air_count; i++) {
+		if (mp_air[i].end + SIM_MS(20) >= now)
+			mp_air[kept++] = mp_air[i];
+	}
+	m_air_count = kept;
+
+	if (m_air_count == m_air_size) {
+		m_air_size = m_air_size == 0 ? 256 : m_air_size * 2;
+		mp_air = realloc(mp_air, m_air_size * sizeof(*mp_air));
+		if (mp_air == NULL)
+			fail("out of memory");
+	}
+
+	p_frame->id = ++m_frame_id;
+	mp_air[m_air_count++] = *p_frame;
+}
+
+static bool channel_busy(uint32_t r, uint64_t from, uint64_t to)
+{
+	air_frame window = { .start = from, .end = to };
+
+	for (uint32_t i = 0; i < m_air_count; i++) {
+		const air_frame *p_other = &mp_air[i];
+		if (p_other->source != r && m_link_quality[p_other->source][r] > 0 && overlaps(p_other, &window))
+			return true;
+	}
+	return false;
+}
+
+static bool frame_receive(uint32_t r, const air_frame *p_frame)
+{
+	const radio *p_radio = &m_radios[r];
+
+	if (r == p_frame->source || !p_radio->powered || m_link_quality[p_frame->source][r] == 0)
+		return false;
+	if (p_frame->to != BROADCAST && p_frame->to != (int32_t)r)
+		return false;
+	// a sleepy radio only listens for the ACK of its own frames and for its frames after a poll
+	if (!p_radio->rx_on_when_idle && p_frame->to != (int32_t)r)
+		return false;
+
+	for (uint32_t i = 0; i < m_air_count; i++) {
+		const air_frame *p_other = &mp_air[i];
+		if (p_other->id == p_frame->id || !overlaps(p_other, p_frame))
+			continue;
+		// half duplex
+		if (p_other->source == r)
+			return false;
+		if (m_link_quality[p_other->source][r] > 0) {
+			m_stats.collisions++;
+			return false;
+		}
+	}
+
+	return sim_random_unit() >= m_frame_loss[m_link_quality[p_frame->source][r]];
+}
+
+static uint64_t airtime(uint16_t psdu)
+{
+	return (uint64_t)(psdu + PHY_HEADER_SIZE) * BYTE_US;
+}
+
+static uint16_t frame_psdu(const job *p_job)
+{
+	if (p_job->kind == JOB_POLL)
+		return POLL_PSDU;
+	if (p_job->fragments == 1)
+		return (uint16_t)(p_job->lowpan_size + MAC_OVERHEAD);
+
+	uint16_t left = (uint16_t)(p_job->lowpan_size - p_job->fragment * FRAGMENT_PAYLOAD);
+	return (uint16_t)((left < FRAGMENT_PAYLOAD ? left : FRAGMENT_PAYLOAD) + FRAGMENT_HEADER_SIZE + MAC_OVERHEAD);
+}
+
+// MAC
+
+static void job_free(job *p_job)
+{
+	free(p_job->p_packet);
+	free(p_job->p_received);
+	free(p_job);
+}
+
+static bool job_queue(uint32_t r, job_kind kind, packet *p_packet, int32_t to)
+{
+	radio *p_radio = &m_radios[r];
+
+	if (!p_radio->powered || p_radio->queue_length >= TX_QUEUE_MAX) {
+		free(p_packet);
+		m_stats.datagrams_dropped += kind == JOB_DATA;
+		return false;
+	}
+
+	job *p_job = allocate(sizeof(*p_job));
+	p_job->kind = kind;
+	p_job->p_packet = p_packet;
+	p_job->to = to;
+	p_job->fragments = 1;
+	p_job->p_received = allocate(m_radio_count * sizeof(*p_job->p_received));
+
+	if (kind == JOB_DATA) {
+		uint32_t size = p_packet->datagram.length + LOWPAN_OVERHEAD;
+		if (p_packet->multicast && !p_packet->to_seed)
+			size += MPL_OPTION_SIZE;
+		if (to != BROADCAST && sim_mesh_radio_find(p_packet->datagram.destination) != to)
+			size += MESH_HEADER_SIZE;
+		p_job->lowpan_size = (uint16_t)size;
+		if (size > FRAME_PAYLOAD_MAX)
+			p_job->fragments = (uint8_t)((size + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD);
+	}
+
+	if (p_radio->p_queue_tail != NULL)
+		p_radio->p_queue_tail->p_next = p_job;
+	else
+		p_radio->p_queue_head = p_job;
+	p_radio->p_queue_tail = p_job;
+	p_radio->queue_length++;
+
+	mac_kick(r);
+	return true;
+}
+
+static void queue_flush(uint32_t r)
+{
+	radio *p_radio = &m_radios[r];
+
+	while (p_radio->p_queue_head != NULL) {
+		job *p_job = p_radio->p_queue_head;
+		p_radio->p_queue_head = p_job->p_next;
+		job_free(p_job);
+	}
+	p_radio->p_queue_tail = NULL;
+	p_radio->queue_length = 0;
+	p_radio->busy = false;
+	p_radio->poll_queued = false;
+
+	while (p_radio->p_indirect != NULL) {
+		indirect *p_indirect = p_radio->p_indirect;
+		p_radio->p_indirect = p_indirect->p_next;
+		free(p_indirect->p_packet);
+		free(p_indirect);
+	}
+}
+
+static void poll_schedule(uint32_t r, uint64_t delay);
+
+static uint64_t poll_interval(const radio *p_radio)
+{
+	return p_radio->poll_period != 0 ? SIM_MS(p_radio->poll_period) : POLL_PERIOD_DEFAULT_US;
+}
+
+static void indirect_release(uint32_t parent, uint32_t child)
+{
+	radio *p_parent = &m_radios[parent];
+	indirect **pp_indirect = &p_parent->p_indirect;
+
+	while (*pp_indirect != NULL) {
+		indirect *p_indirect = *pp_indirect;
+		if (p_indirect->child != child) {
+			pp_indirect = &p_indirect->p_next;
+			continue;
+		}
+		*pp_indirect = p_indirect->p_next;
+		job_queue(parent, JOB_DATA, p_indirect->p_packet, (int32_t)child);
+		free(p_indirect);
+	}
+}
+
+static void indirect_queue(uint32_t parent, uint32_t child, packet *p_packet)
+{
+	radio *p_parent = &m_radios[parent];
+	indirect **pp_indirect = &p_parent->p_indirect;
+	uint32_t count = 0;
+
+	while (*pp_indirect != NULL) {
+		count += (*pp_indirect)->child == child;
+		pp_indirect = &(*pp_indirect)->p_next;
+	}
+
+	if (count >= INDIRECT_PER_CHILD_MAX) {
+		free(p_packet);
+		m_stats.datagrams_dropped++;
+		return;
+	}
+
+	indirect *p_indirect = allocate(sizeof(*p_indirect));
+	p_indirect->child = child;
+	p_indirect->p_packet = p_packet;
+	*pp_indirect = p_indirect;
+}
+
+static void detach(uint32_t r);
+
+static void job_finish(uint32_t r, bool acknowledged)
+{
+	radio *p_radio = &m_radios[r];
+	job *p_job = p_radio->p_queue_head;
+
+	p_radio->p_queue_head = p_job->p_next;
+	if (p_radio->p_queue_head == NULL)
+		p_radio->p_queue_tail = NULL;
+	p_radio->queue_length--;
+	p_radio->busy = false;
+
+	uint16_t all = (uint16_t)((1u << p_job->fragments) - 1);
+
+	if (p_job->kind == JOB_POLL) {
+		p_radio->poll_queued = false;
+		if (acknowledged) {
+			p_radio->poll_failures = 0;
+			indirect_release((uint32_t)p_job->to, r);
+			poll_schedule(r, poll_interval(p_radio));
+		} else if (++p_radio->poll_failures >= POLL_FAILURES_MAX) {
+			detach(r);
+		} else {
+			poll_schedule(r, POLL_RETRY_US);
+		}
+	} else if (p_job->to == BROADCAST) {
+		for (uint32_t x = 0; x < m_radio_count; x++) {
+			if (p_job->p_received[x] == all)
+				mpl_receive(x, packet_copy(p_job->p_packet), false);
+		}
+	} else if (p_job->p_received[p_job->to] == all) {
+		// the receiver may have it all even when its last ACK was lost
+		packet_arrive((uint32_t)p_job->to, p_job->p_packet);
+		p_job->p_packet = NULL;
+	} else {
+		m_stats.datagrams_dropped++;
+	}
+
+	job_free(p_job);
+	mac_kick(r);
+}
+
+static void frame_next(uint32_t r)
+{
+	job *p_job = m_radios[r].p_queue_head;
+
+	p_job->attempts = 0;
+	if (++p_job->fragment < p_job->fragments)
+		csma_start(r);
+	else
+		job_finish(r, true);
+}
+
+static void frame_failed(uint32_t r)
+{
+	job *p_job = m_radios[r].p_queue_head;
+
+	// a broadcast is sent once, a lost fragment spoils the datagram for everyone
+	if (p_job->to == BROADCAST || ++p_job->attempts > MAC_MAX_FRAME_RETRIES) {
+		job_finish(r, false);
+		return;
+	}
+	csma_start(r);
+}
+
+static bool mac_event_valid(uint32_t r, uint32_t generation)
+{
+	return m_radios[r].mac_generation == generation && m_radios[r].busy;
+}
+
+static uint32_t radio_index(const void *p_context)
+{
+	return (uint32_t)((const radio *)p_context - m_radios);
+}
+
+static void ack_done_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+
+	if (!mac_event_valid(r, generation))
+		return;
+
+	if (frame_receive(r, &m_radios[r].ack))
+		frame_next(r);
+	else
+		frame_failed(r);
+}
+
+static void ack_timeout_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+
+	if (!mac_event_valid(r, generation))
+		return;
+
+	frame_failed(r);
+}
+
+static void tx_end_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (!mac_event_valid(r, generation))
+		return;
+
+	job *p_job = p_radio->p_queue_head;
+	const air_frame *p_frame = &p_radio->frame;
+	uint64_t ack_wait_end = p_frame->end + TURNAROUND_US + airtime(ACK_SIZE);
+
+	if (p_job->to == BROADCAST) {
+		for (uint32_t x = 0; x < m_radio_count; x++) {
+			if (frame_receive(x, p_frame)) {
+				p_job->p_received[x] |= (uint16_t)(1u << p_job->fragment);
+				m_radios[x].rx_frames++;
+			}
+		}
+		frame_next(r);
+		return;
+	}
+
+	uint32_t to = (uint32_t)p_job->to;
+	if (!frame_receive(to, p_frame)) {
+		sim_event_schedule(ack_wait_end, ack_timeout_event, p_radio, generation);
+		return;
+	}
+
+	if (p_job->kind == JOB_DATA)
+		p_job->p_received[to] |= (uint16_t)(1u << p_job->fragment);
+	m_radios[to].rx_frames++;
+
+	air_frame ack = { .source = to, .to = (int32_t)r, .ack = true, .start = p_frame->end + TURNAROUND_US, .end = ack_wait_end };
+	air_add(&ack);
+	p_radio->ack = mp_air[m_air_count - 1];
+	sim_event_schedule(ack_wait_end, ack_done_event, p_radio, generation);
+}
+
+static void tx_start_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (!mac_event_valid(r, generation))
+		return;
+
+	job *p_job = p_radio->p_queue_head;
+	air_frame frame = { .source = r, .to = p_job->to, .ack = false, .start = sim_now(), .end = sim_now() + airtime(frame_psdu(p_job)) };
+	air_add(&frame);
+	p_radio->frame = mp_air[m_air_count - 1];
+	p_radio->tx_frames++;
+	m_stats.frames++;
+
+	sim_event_schedule(frame.end, tx_end_event, p_radio, generation);
+}
+
+static void backoff_schedule(uint32_t r);
+
+static void cca_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (!mac_event_valid(r, generation))
+		return;
+
+	job *p_job = p_radio->p_queue_head;
+	if (!channel_busy(r, sim_now() - CCA_US, sim_now())) {
+		sim_event_schedule(sim_now() + TURNAROUND_US, tx_start_event, p_radio, generation);
+		return;
+	}
+
+	p_job->exponent = p_job->exponent < MAC_MAX_BE ? p_job->exponent + 1 : MAC_MAX_BE;
+	if (++p_job->backoffs > MAC_MAX_CSMA_BACKOFFS) {
+		m_stats.channel_access_failures++;
+		frame_failed(r);
+		return;
+	}
+	backoff_schedule(r);
+}
+
+static void backoff_schedule(uint32_t r)
+{
+	radio *p_radio = &m_radios[r];
+	uint64_t backoff = sim_random_below(1u << p_radio->p_queue_head->exponent) * BACKOFF_PERIOD_US;
+
+	sim_event_schedule(sim_now() + backoff + CCA_US, cca_event, p_radio, p_radio->mac_generation);
+}
+
+static void csma_start(uint32_t r)
+{
+	job *p_job = m_radios[r].p_queue_head;
+
+	// a retry after a missing ACK backs off further, two hidden radios would collide again otherwise
+	p_job->backoffs = 0;
+	p_job->exponent = p_job->attempts < MAC_MAX_BE - MAC_MIN_BE ? MAC_MIN_BE + p_job->attempts : MAC_MAX_BE;
+	backoff_schedule(r);
+}
+
+static void mac_kick(uint32_t r)
+{
+	radio *p_radio = &m_radios[r];
+
+	if (p_radio->busy || p_radio->p_queue_head == NULL || !p_radio->powered)
+		return;
+
+	p_radio->busy = true;
+	p_radio->p_queue_head->attempts = 0;
+	csma_start(r);
+}
+
+// data polls
+
+static void poll_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (p_radio->poll_generation != generation || !is_sleepy_child_of((int32_t)r, p_radio->parent) || p_radio->poll_queued)
+		return;
+
+	p_radio->poll_queued = job_queue(r, JOB_POLL, NULL, p_radio->parent);
+}
+
+static void poll_schedule(uint32_t r, uint64_t delay)
+{
+	radio *p_radio = &m_radios[r];
+
+	p_radio->poll_generation++;
+	if (is_sleepy_child_of((int32_t)r, p_radio->parent))
+		sim_event_schedule(sim_now() + delay, poll_event, p_radio, p_radio->poll_generation);
+}
+
+// datagrams
+
+static void host_deliver(uint32_t r, const sim_datagram *p_datagram)
+{
+	if (r == m_border_router)
+		sim_controller_receive(p_datagram);
+	else
+		sim_node_deliver(r, p_datagram);
+}
+
+static void route_and_send(uint32_t from, packet *p_packet)
+{
+	int32_t destination = sim_mesh_radio_find(p_packet->datagram.destination);
+
+	if (!is_attached(from) || !is_attached(destination) || destination == (int32_t)from || p_packet->datagram.hop_limit == 0) {
+		free(p_packet);
+		m_stats.datagrams_dropped++;
+		return;
+	}
+
+	int32_t to = next_hop(from, (uint32_t)destination);
+	if (to == NONE) {
+		free(p_packet);
+		m_stats.datagrams_dropped++;
+		return;
+	}
+
+	if (is_sleepy_child_of(to, (int32_t)from))
+		indirect_queue(from, (uint32_t)to, p_packet);
+	else
+		job_queue(from, JOB_DATA, p_packet, to);
+}
+
+static void forward_event(void *p_context, uint32_t r)
+{
+	route_and_send(r, p_context);
+}
+
+static void packet_arrive(uint32_t r, packet *p_packet)
+{
+	if (p_packet->to_seed) {
+		p_packet->to_seed = false;
+		mpl_receive(r, p_packet, true);
+		return;
+	}
+
+	// a copy of a multicast the parent kept for its sleepy child
+	if (p_packet->multicast) {
+		mpl_receive(r, p_packet, false);
+		return;
+	}
+
+	if (sim_mesh_radio_find(p_packet->datagram.destination) == (int32_t)r) {
+		host_deliver(r, &p_packet->datagram);
+		free(p_packet);
+		return;
+	}
+
+	p_packet->datagram.hop_limit--;
+	sim_event_schedule(sim_now() + FORWARD_DELAY_US, forward_event, p_packet, r);
+}
+
+// MPL
+
+static bool mpl_seen(uint32_t r, const packet *p_packet)
+{
+	radio *p_radio = &m_radios[r];
+
+	for (uint8_t i = 0; i < p_radio->mpl_seen_count; i++) {
+		if (p_radio->mpl_seen_origin[i] == p_packet->origin && p_radio->mpl_seen_sequence[i] == p_packet->mpl_sequence)
+			return true;
+	}
+
+	p_radio->mpl_seen_origin[p_radio->mpl_seen_next] = p_packet->origin;
+	p_radio->mpl_seen_sequence[p_radio->mpl_seen_next] = p_packet->mpl_sequence;
+	p_radio->mpl_seen_next = (uint8_t)((p_radio->mpl_seen_next + 1) % MPL_SEEN_SIZE);
+	if (p_radio->mpl_seen_count < MPL_SEEN_SIZE)
+		p_radio->mpl_seen_count++;
+	return false;
+}
+
+static void mpl_transmit_event(void *p_context, uint32_t arg)
+{
+	mpl_transmission *p_transmission = p_context;
+	radio *p_radio = &m_radios[p_transmission->radio];
+
+	if (!is_router(p_transmission->radio) || p_radio->mac_generation != p_transmission->mac_generation) {
+		free(p_transmission->p_packet);
+		free(p_transmission);
+		return;
+	}
+
+	job_queue(p_transmission->radio, JOB_DATA, packet_copy(p_transmission->p_packet), BROADCAST);
+
+	if (--p_transmission->remaining > 0) {
+		sim_event_schedule(sim_now() + MPL_INTERVAL_US, mpl_transmit_event, p_transmission, 0);
+		return;
+	}
+	free(p_transmission->p_packet);
+	free(p_transmission);
+}
+
+static void mpl_receive(uint32_t r, packet *p_packet, bool seed)
+{
+	if (!is_attached(r) || mpl_seen(r, p_packet)) {
+		free(p_packet);
+		return;
+	}
+
+	if (r != p_packet->origin)
+		host_deliver(r, &p_packet->datagram);
+
+	if (!is_router(r)) {
+		free(p_packet);
+		return;
+	}
+
+	// sleepy children do not hear the flood, their parent keeps a copy for their next poll
+	for (uint32_t c = 0; c < m_radio_count; c++) {
+		if (c != p_packet->origin && is_sleepy_child_of(c, r))
+			indirect_queue(r, c, packet_copy(p_packet));
+	}
+
+	mpl_transmission *p_transmission = allocate(sizeof(*p_transmission));
+	p_transmission->radio = r;
+	p_transmission->p_packet = p_packet;
+	p_transmission->mac_generation = m_radios[r].mac_generation;
+	p_transmission->remaining = MPL_TRANSMISSIONS;
+
+	uint64_t first = seed ? sim_now() : sim_now() + sim_random_below(MPL_INTERVAL_US);
+	sim_event_schedule(first, mpl_transmit_event, p_transmission, 0);
+}
+
+// MLE
+
+static uint8_t link_quality_between(uint32_t a, uint32_t b)
+{
+	return m_link_quality[a][b];
+}
+
+/**@brief Parent selection: link quality first, then a router over a REED, the path cost to the leader
+ *        and the fewest children.
+ */
+static int32_t parent_select(uint32_t r, bool routers_only)
+{
+	int32_t best = NONE;
+	uint8_t best_link_quality = 0;
+	bool best_router = false;
+	uint32_t best_cost = UINT32_MAX;
+	uint32_t best_children = UINT32_MAX;
+
+	for (uint32_t c = 0; c < m_radio_count; c++) {
+		uint8_t link_quality = link_quality_between(r, c);
+		if (c == r || link_quality == 0 || !is_attached(c))
+			continue;
+
+		bool router = is_router(c);
+		uint32_t cost;
+		uint32_t children;
+
+		if (router) {
+			children = children_count(c);
+			if (children >= CHILDREN_MAX)
+				continue;
+			cost = leader_cost(c);
+		} else {
+			// a REED takes a child by becoming a router first
+			const radio *p_candidate = &m_radios[c];
+			if (routers_only || !p_candidate->rx_on_when_idle || !p_candidate->full_thread_device || !router_id_available())
+				continue;
+			if (!is_router(p_candidate->parent))
+				continue;
+			children = 0;
+			cost = leader_cost((uint32_t)p_candidate->parent);
+			if (cost != UINT32_MAX)
+				cost += m_link_cost[link_quality_between(c, (uint32_t)p_candidate->parent)];
+		}
+		if (cost == UINT32_MAX)
+			continue;
+
+		bool better = best == NONE ||
+			link_quality > best_link_quality ||
+			(link_quality == best_link_quality && router && !best_router) ||
+			(link_quality == best_link_quality && router == best_router && cost < best_cost) ||
+			(link_quality == best_link_quality && router == best_router && cost == best_cost && children < best_children);
+		if (!better)
+			continue;
+
+		best = (int32_t)c;
+		best_link_quality = link_quality;
+		best_router = router;
+		best_cost = cost;
+		best_children = children;
+	}
+	return best;
+}
+
+static void saved_update(uint32_t r)
+{
+	radio *p_radio = &m_radios[r];
+
+	p_radio->saved_role = p_radio->role;
+	p_radio->saved_rloc16 = p_radio->rloc16;
+	p_radio->saved_parent = p_radio->parent;
+}
+
+static void child_become(uint32_t r, uint32_t parent, uint16_t rloc16)
+{
+	radio *p_radio = &m_radios[r];
+	radio *p_parent = &m_radios[parent];
+
+	if (rloc16 == 0) {
+		p_parent->next_child_id = (uint16_t)(p_parent->next_child_id % 511 + 1);
+		rloc16 = (uint16_t)(p_parent->rloc16 | p_parent->next_child_id);
+	}
+
+	p_radio->mle_generation++;
+	p_radio->parent = (int32_t)parent;
+	p_radio->parent_lost_at = NEVER;
+	p_radio->upgrade_at = NEVER;
+	p_radio->downgrade_at = NEVER;
+	p_radio->attach_backoff = ATTACH_BACKOFF_MIN;
+	p_radio->poll_failures = 0;
+	role_set(r, OT_DEVICE_ROLE_CHILD, rloc16);
+	saved_update(r);
+	m_stats.attaches++;
+
+	if (!p_radio->rx_on_when_idle)
+		poll_schedule(r, poll_interval(p_radio));
+}
+
+static void router_become(uint32_t r, int id)
+{
+	radio *p_radio = &m_radios[r];
+
+	p_radio->mle_generation++;
+	p_radio->parent = NONE;
+	p_radio->router_id = (uint8_t)id;
+	p_radio->upgrade_at = NEVER;
+	p_radio->downgrade_at = NEVER;
+	p_radio->attach_backoff = ATTACH_BACKOFF_MIN;
+	m_router_ids[id].seen_at = sim_now();
+	role_set(r, OT_DEVICE_ROLE_ROUTER, (uint16_t)(id << 10));
+	saved_update(r);
+}
+
+static void detach(uint32_t r)
+{
+	radio *p_radio = &m_radios[r];
+
+	p_radio->parent = NONE;
+	p_radio->poll_generation++;
+	role_set(r, OT_DEVICE_ROLE_DETACHED, 0xFFFE);
+	attach_start(r, 0);
+}
+
+static void attach_complete_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (p_radio->mle_generation != generation || !p_radio->powered || !p_radio->enabled)
+		return;
+
+	int32_t parent = p_radio->attaching_to;
+	bool valid = is_attached(parent);
+	if (valid && is_router(parent)) {
+		valid = children_count((uint32_t)parent) < CHILDREN_MAX;
+	} else if (valid) {
+		int id = m_radios[parent].role == OT_DEVICE_ROLE_CHILD ? router_id_allocate((uint32_t)parent) : NONE;
+		valid = id != NONE;
+		if (valid)
+			router_become((uint32_t)parent, id);
+	}
+
+	if (valid)
+		child_become(r, (uint32_t)parent, 0);
+	else
+		attach_start(r, 0);
+}
+
+static void attach_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (p_radio->mle_generation != generation || !p_radio->powered || !p_radio->enabled)
+		return;
+
+	int32_t parent = parent_select(r, false);
+	if (parent == NONE) {
+		uint64_t backoff = p_radio->attach_backoff;
+		p_radio->attach_backoff = backoff * 2 < ATTACH_BACKOFF_MAX ? backoff * 2 : ATTACH_BACKOFF_MAX;
+		sim_event_schedule(sim_now() + backoff, attach_event, p_radio, generation);
+		return;
+	}
+
+	p_radio->attaching_to = parent;
+	sim_event_schedule(sim_now() + (is_router(parent) ? ATTACH_ROUTER_US : ATTACH_REED_US), attach_complete_event, p_radio, generation);
+}
+
+static void attach_start(uint32_t r, uint64_t delay)
+{
+	radio *p_radio = &m_radios[r];
+
+	p_radio->mle_generation++;
+	sim_event_schedule(sim_now() + delay, attach_event, p_radio, p_radio->mle_generation);
+}
+
+static void restore_event(void *p_context, uint32_t generation)
+{
+	uint32_t r = radio_index(p_context);
+	radio *p_radio = &m_radios[r];
+
+	if (p_radio->mle_generation != generation || !p_radio->powered || !p_radio->enabled)
+		return;
+
+	if (p_radio->saved_role == OT_DEVICE_ROLE_ROUTER) {
+		int id = p_radio->saved_rloc16 >> 10;
+		if (m_router_ids[id].owner == (int32_t)r)
+			router_become(r, id);
+		else
+			attach_start(r, 0);
+		return;
+	}
+
+	// a child asks its previous parent to take it back
+	int32_t parent = p_radio->saved_parent;
+	if (is_router(parent) && m_radios[parent].rloc16 == (p_radio->saved_rloc16 & 0xFC00)) {
+		child_become(r, (uint32_t)parent, p_radio->saved_rloc16);
+		return;
+	}
+
+	if (++p_radio->restore_attempts < RESTORE_ATTEMPTS)
+		sim_event_schedule(sim_now() + RESTORE_RETRY_US, restore_event, p_radio, generation);
+	else
+		attach_start(r, 0);
+}
+
+static void thread_start(uint32_t r)
+{
+	radio *p_radio = &m_radios[r];
+
+	p_radio->parent = NONE;
+	p_radio->attach_backoff = ATTACH_BACKOFF_MIN;
+	p_radio->restore_attempts = 0;
+	p_radio->upgrade_at = NEVER;
+	p_radio->downgrade_at = NEVER;
+	role_set(r, OT_DEVICE_ROLE_DETACHED, 0xFFFE);
+
+	if (p_radio->saved_role == OT_DEVICE_ROLE_ROUTER || p_radio->saved_role == OT_DEVICE_ROLE_CHILD) {
+		p_radio->mle_generation++;
+		sim_event_schedule(sim_now() + RESTORE_US, restore_event, p_radio, p_radio->mle_generation);
+		return;
+	}
+	attach_start(r, 0);
+}
+
+static uint32_t good_router_neighbors(uint32_t r)
+{
+	uint32_t count = 0;
+
+	for (uint32_t x = 0; x < m_radio_count; x++)
+		count += x != r && is_router(x) && link_quality_between(r, x) >= 2;
+	return count;
+}
+
+static uint64_t jitter_draw(const radio *p_radio)
+{
+	return sim_random_below(SIM_S(p_radio->selection_jitter) + 1);
+}
+
+/**@brief Once a second: router upgrade and downgrade, children noticing a lost parent, router ID expiry. */
+static void mle_tick_event(void *p_context, uint32_t arg)
+{
+	uint64_t now = sim_now();
+
+	for (uint32_t r = 0; r < m_radio_count; r++) {
+		radio *p_radio = &m_radios[r];
+		if (r == m_border_router || !is_attached(r))
+			continue;
+
+		if (p_radio->role == OT_DEVICE_ROLE_CHILD) {
+			// a sleepy child finds out from its polls
+			if (p_radio->rx_on_when_idle) {
+				if (is_router(p_radio->parent)) {
+					p_radio->parent_lost_at = NEVER;
+				} else if (p_radio->parent_lost_at == NEVER) {
+					p_radio->parent_lost_at = now;
+				} else if (now - p_radio->parent_lost_at >= CHILD_TIMEOUT_RX_ON) {
+					detach(r);
+					continue;
+				}
+			}
+
+			if (p_radio->rx_on_when_idle && p_radio->full_thread_device && active_routers() < p_radio->upgrade_threshold &&
+				router_id_available()) {
+				if (p_radio->upgrade_at == NEVER) {
+					p_radio->upgrade_at = now + jitter_draw(p_radio);
+				} else if (now >= p_radio->upgrade_at) {
+					int id = router_id_allocate(r);
+					if (id != NONE)
+						router_become(r, id);
+				}
+			} else {
+				p_radio->upgrade_at = NEVER;
+			}
+		} else if (p_radio->role == OT_DEVICE_ROLE_ROUTER) {
+			m_router_ids[p_radio->router_id].seen_at = now;
+
+			if (active_routers() > p_radio->downgrade_threshold && children_count(r) == 0 &&
+				good_router_neighbors(r) >= DOWNGRADE_NEIGHBORS_MIN) {
+				if (p_radio->downgrade_at == NEVER) {
+					p_radio->downgrade_at = now + jitter_draw(p_radio);
+				} else if (now >= p_radio->downgrade_at) {
+					int32_t parent = parent_select(r, true);
+					if (parent != NONE) {
+						router_id_release(p_radio->router_id);
+						child_become(r, (uint32_t)parent, 0);
+					}
+					p_radio->downgrade_at = NEVER;
+				}
+			} else {
+				p_radio->downgrade_at = NEVER;
+			}
+		}
+	}
+
+	m_router_ids[0].seen_at = now;
+	for (int id = 1; id <= SIM_ROUTER_ID_MAX; id++) {
+		if (m_router_ids[id].owner != NONE && now - m_router_ids[id].seen_at >= ROUTER_ID_EXPIRY)
+			router_id_release(id);
+	}
+
+	sim_event_schedule(now + MLE_TICK_US, mle_tick_event, NULL, 0);
+}
+
+// interface
+
+void sim_mesh_init(uint32_t nodes)
+{
+	if (nodes + 1 > RADIOS_MAX)
+		fail("too many nodes");
+
+	m_radio_count = nodes + 1;
+	m_border_router = nodes;
+
+	for (uint32_t r = 0; r < m_radio_count; r++) {
+		radio *p_radio = &m_radios[r];
+		memset(p_radio, 0, sizeof(*p_radio));
+		p_radio->parent = NONE;
+		p_radio->saved_parent = NONE;
+		p_radio->attaching_to = NONE;
+		p_radio->role = OT_DEVICE_ROLE_DISABLED;
+		p_radio->rloc16 = 0xFFFE;
+		p_radio->parent_lost_at = NEVER;
+		p_radio->upgrade_at = NEVER;
+		p_radio->downgrade_at = NEVER;
+		p_radio->rx_on_when_idle = true;
+
+		for (size_t i = 0; i < sizeof(p_radio->mesh_local_iid); i++)
+			p_radio->mesh_local_iid[i] = (uint8_t)sim_random();
+		// never mistaken for an RLOC
+		p_radio->mesh_local_iid[0] |= 0x02;
+	}
+
+	// ring k at k units from the border router, the nodes of a ring evenly spread with some slack
+	uint32_t ring = 1;
+	uint32_t ring_first = 0;
+	for (uint32_t r = 0; r < nodes; r++) {
+		if (r - ring_first == ring * RING_NODES) {
+			ring_first = r;
+			ring++;
+		}
+		uint32_t ring_size = ring * RING_NODES;
+		double angle = 2 * M_PI * ((double)(r - ring_first) + 0.3 * sim_random_unit()) / ring_size + 0.5 * ring;
+		double radius = ring * (0.85 + 0.15 * sim_random_unit());
+		m_radios[r].x = radius * cos(angle);
+		m_radios[r].y = radius * sin(angle);
+		m_radios[r].ring = ring;
+	}
+
+	for (uint32_t a = 0; a < m_radio_count; a++) {
+		for (uint32_t b = 0; b < m_radio_count; b++) {
+			double distance = hypot(m_radios[a].x - m_radios[b].x, m_radios[a].y - m_radios[b].y);
+			m_link_quality[a][b] = a == b ? 0 : distance <= LQ3_RANGE ? 3 : distance <= LQ2_RANGE ? 2 : distance <= LQ1_RANGE ? 1 : 0;
+		}
+	}
+
+	for (int id = 0; id <= SIM_ROUTER_ID_MAX; id++)
+		m_router_ids[id].owner = NONE;
+
+	radio *p_border_router = &m_radios[m_border_router];
+	p_border_router->powered = true;
+	p_border_router->enabled = true;
+	p_border_router->full_thread_device = true;
+	p_border_router->role = OT_DEVICE_ROLE_LEADER;
+	p_border_router->router_id = 0;
+	p_border_router->rloc16 = 0x0000;
+	m_router_ids[0].owner = (int32_t)m_border_router;
+
+	sim_event_schedule(sim_now() + MLE_TICK_US, mle_tick_event, NULL, 0);
+}
+
+uint32_t sim_mesh_border_router(void)
+{
+	return m_border_router;
+}
+
+void sim_mesh_power_set(uint32_t r, bool on)
+{
+	radio *p_radio = &m_radios[r];
+
+	if (on == p_radio->powered)
+		return;
+
+	bool was_router = is_router(r);
+	p_radio->mac_generation++;
+	p_radio->mle_generation++;
+	p_radio->poll_generation++;
+	queue_flush(r);
+
+	p_radio->powered = on;
+	p_radio->enabled = false;
+	p_radio->role = OT_DEVICE_ROLE_DISABLED;
+	p_radio->rloc16 = 0xFFFE;
+	p_radio->changed = 0;
+	p_radio->poll_period = 0;
+	p_radio->mpl_seen_count = 0;
+	if (!on)
+		p_radio->powered_off_at = sim_now();
+
+	if (was_router)
+		m_topology_generation++;
+}
+
+void sim_mesh_port_refresh(uint32_t r, sim_port *p_port)
+{
+	radio *p_radio = &m_radios[r];
+
+	sim_mesh_mesh_local_eid_get(r, p_port->mesh_local_eid);
+	rloc_address(p_radio->rloc16, p_port->rloc);
+	rloc_address(m_radios[m_border_router].rloc16, p_port->leader_rloc);
+	p_port->role = p_radio->role;
+	p_port->rloc16 = p_radio->rloc16;
+	p_port->changed |= p_radio->changed;
+	p_radio->changed = 0;
+	p_port->tx_frames = p_radio->tx_frames;
+	p_port->rx_frames = p_radio->rx_frames;
+
+	// the router table as the node learnt it from the advertisements, a child only has its parent
+	for (int id = 0; id <= SIM_ROUTER_ID_MAX; id++) {
+		int32_t owner = m_router_ids[id].owner;
+		if (owner == NONE || !is_attached(r))
+			p_port->router_link_quality[id] = SIM_LINK_QUALITY_NONE;
+		else if (owner == (int32_t)r || !is_router(owner))
+			p_port->router_link_quality[id] = 0;
+		else
+			p_port->router_link_quality[id] = (int8_t)link_quality_between(r, (uint32_t)owner);
+	}
+
+	p_port->neighbor_count = 0;
+	for (uint32_t x = 0; x < m_radio_count && is_attached(r); x++) {
+		bool neighbor;
+		bool child = false;
+		if (p_radio->role == OT_DEVICE_ROLE_CHILD) {
+			neighbor = (int32_t)x == p_radio->parent;
+		} else {
+			child = is_child_of(x, r);
+			neighbor = child || (x != r && is_router(x) && link_quality_between(r, x) > 0);
+		}
+		if (!neighbor || p_port->neighbor_count == SIM_NEIGHBORS_MAX)
+			continue;
+
+		sim_neighbor *p_neighbor = &p_port->neighbors[p_port->neighbor_count++];
+		p_neighbor->rloc16 = m_radios[x].rloc16;
+		p_neighbor->link_quality = link_quality_between(r, x);
+		p_neighbor->is_child = child;
+		p_neighbor->rx_on_when_idle = m_radios[x].rx_on_when_idle;
+		p_neighbor->full_thread_device = m_radios[x].full_thread_device;
+	}
+}
+
+void sim_mesh_port_update(uint32_t r, const sim_port *p_port)
+{
+	radio *p_radio = &m_radios[r];
+
+	if (!p_radio->powered)
+		return;
+
+	p_radio->rx_on_when_idle = p_port->rx_on_when_idle;
+	p_radio->full_thread_device = p_port->full_thread_device;
+	p_radio->upgrade_threshold = p_port->router_upgrade_threshold;
+	p_radio->downgrade_threshold = p_port->router_downgrade_threshold;
+	p_radio->selection_jitter = p_port->router_selection_jitter;
+
+	// OpenThread restarts the poll timer with the new period
+	if (p_port->poll_period != p_radio->poll_period) {
+		p_radio->poll_period = p_port->poll_period;
+		if (!p_radio->poll_queued)
+			poll_schedule(r, poll_interval(p_radio));
+	}
+
+	if (p_port->thread_enabled && !p_radio->enabled) {
+		p_radio->enabled = true;
+		thread_start(r);
+	}
+}
+
+bool sim_mesh_send(uint32_t r, const sim_datagram *p_datagram)
+{
+	radio *p_radio = &m_radios[r];
+
+	if (!is_attached(r))
+		return false;
+
+	packet *p_packet = allocate(sizeof(*p_packet));
+	p_packet->datagram = *p_datagram;
+	p_packet->origin = r;
+
+	if (p_datagram->destination[0] != 0xFF) {
+		route_and_send(r, p_packet);
+		return true;
+	}
+
+	p_packet->multicast = true;
+	p_packet->mpl_sequence = p_radio->mpl_sequence++;
+	if (is_router(r)) {
+		mpl_receive(r, p_packet, true);
+		return true;
+	}
+
+	// a child hands its multicast to the parent, which seeds the flood
+	mpl_seen(r, p_packet);
+	p_packet->to_seed = true;
+	job_queue(r, JOB_DATA, p_packet, p_radio->parent);
+	return true;
+}
+
+int32_t sim_mesh_radio_find(const uint8_t *p_address)
+{
+	if (memcmp(p_address, m_mesh_local_prefix, sizeof(m_mesh_local_prefix)) != 0)
+		return NONE;
+
+	if (memcmp(&p_address[8], m_rloc_iid, sizeof(m_rloc_iid)) == 0) {
+		uint16_t rloc16 = (uint16_t)((p_address[14] << 8) | p_address[15]);
+		for (uint32_t r = 0; r < m_radio_count; r++) {
+			if (is_attached(r) && m_radios[r].rloc16 == rloc16)
+				return (int32_t)r;
+		}
+		return NONE;
+	}
+
+	for (uint32_t r = 0; r < m_radio_count; r++) {
+		if (memcmp(&p_address[8], m_radios[r].mesh_local_iid, sizeof(m_radios[r].mesh_local_iid)) == 0)
+			return (int32_t)r;
+	}
+	return NONE;
+}
+
+void sim_mesh_mesh_local_eid_get(uint32_t r, uint8_t *p_address)
+{
+	memcpy(p_address, m_mesh_local_prefix, sizeof(m_mesh_local_prefix));
+	memcpy(&p_address[8], m_radios[r].mesh_local_iid, sizeof(m_radios[r].mesh_local_iid));
+}
+
+void sim_mesh_rloc_get(uint32_t r, uint8_t *p_address)
+{
+	rloc_address(m_radios[r].rloc16, p_address);
+}
+
+uint8_t sim_mesh_role(uint32_t r)
+{
+	return m_radios[r].powered ? m_radios[r].role : OT_DEVICE_ROLE_DISABLED;
+}
+
+uint32_t sim_mesh_ring(uint32_t r)
+{
+	return m_radios[r].ring;
+}
+
+uint32_t sim_mesh_routers(void)
+{
+	return active_routers();
+}
+
+const sim_mesh_stats *sim_mesh_stats_get(void)
+{
+	return &m_stats;
+}
@@ -0,0 +1,61 @@
+#ifndef SIM_MESH_H__
+#define SIM_MESH_H__
+
+#include "sim_port.h"
+
+/**@brief Model of the Thread network the nodes and the border router share.
+ *
+ * @details The radio is modelled frame by frame: unslotted CSMA-CA, half-duplex radios, collisions at
+ *          each receiver, acknowledgements and retries, link quality and loss from the distance, and
+ *          6LoWPAN fragmentation of the datagrams. Above it MPL floods multicast through the routers,
+ *          routers forward unicast along the cheapest path and sleepy children get their frames after a
+ *          data poll. MLE is abstracted to its outcome: attach times, router upgrade and downgrade with
+ *          the thresholds and jitter the node sets, router ID allocation by the leader, and restoring the
+ *          previous role after a reboot. MLE messages themselves take no airtime.
+ *
+ *          Radio 0 to nodes - 1 are the nodes, radio nodes is the border router: always on, the leader,
+ *          and the host of the controller.
+ */
+
+typedef struct sim_mesh_stats
+{
+	uint32_t frames;                  // MAC frames sent, ACKs not counted
+	uint32_t collisions;              // receptions lost to an overlapping frame
+	uint32_t channel_access_failures;
+	uint32_t datagrams_dropped;       // no route, retries used up or a full queue
+	uint32_t attaches;
+} sim_mesh_stats;
+
+/**@brief Places the nodes on rings around the border router, ring k holds 10 * k nodes. */
+void sim_mesh_init(uint32_t nodes);
+
+uint32_t sim_mesh_border_router(void);
+
+void sim_mesh_power_set(uint32_t radio, bool on);
+
+/**@brief Writes the Thread state of the node to the port before it runs. */
+void sim_mesh_port_refresh(uint32_t radio, sim_port *p_port);
+
+/**@brief Takes what the node set in the port after it ran: Thread enabled, link mode, poll period, thresholds. */
+void sim_mesh_port_update(uint32_t radio, const sim_port *p_port);
+
+/**@brief Sends a datagram from the radio, returns false when it is not attached. */
+bool sim_mesh_send(uint32_t radio, const sim_datagram *p_datagram);
+
+/**@brief Radio with the ML-EID or the RLOC, -1 when there is none. */
+int32_t sim_mesh_radio_find(const uint8_t *p_address);
+
+void sim_mesh_mesh_local_eid_get(uint32_t radio, uint8_t *p_address);
+
+void sim_mesh_rloc_get(uint32_t radio, uint8_t *p_address);
+
+/**@brief otDeviceRole of the radio. */
+uint8_t sim_mesh_role(uint32_t radio);
+
+uint32_t sim_mesh_ring(uint32_t radio);
+
+uint32_t sim_mesh_routers(void);
+
+const sim_mesh_stats *sim_mesh_stats_get(void);
+
+#endif /* SIM_MESH_H__ */
@@ -0,0 +1,330 @@
+#include "sim_node.h"
+
+#include "sim_controller.h"
+#include "sim_core.h"
+#include "sim_mesh.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <openthread/platform/misc.h>
+
+#define CLOCK_TOLERANCE_PPM 30 // 32 MHz crystal of the module
+#define RESET_DURATION_US   1000
+#define WAKE_ANY            UINT32_MAX // wake event that is never stale
+
+typedef struct
+{
+	uint32_t id;
+	const char *p_library_path;
+	void *p_library;
+	sim_node_main_t main;
+	pthread_t thread;
+	sem_t run;
+	sem_t done;
+	bool alive;    // the firmware thread exists
+	bool exited;   // and returned from sim_node_main()
+	bool powered;
+	uint64_t boot_at;
+	double rate;   // node clock ticks per global microsecond
+	uint32_t wake_generation;
+	uint32_t boots;
+	sim_port port;
+} sim_node;
+
+static sim_node *mp_nodes[SIM_NODES_MAX];
+
+static sim_node *node_of(sim_port *p_port)
+{
+	return (sim_node *)((char *)p_port - offsetof(sim_node, port));
+}
+
+static void fail(const char *p_what, const char *p_detail)
+{
+	fprintf(stderr, "sim: %s: %s\n", p_what, p_detail);
+	abort();
+}
+
+// the node thread side
+
+static void *node_thread(void *p_context)
+{
+	sim_node *p_node = p_context;
+
+	sem_wait(&p_node->run);
+	p_node->main(&p_node->port);
+	p_node->exited = true;
+	sem_post(&p_node->done);
+	return NULL;
+}
+
+static void node_yield(sim_port *p_port)
+{
+	sim_node *p_node = node_of(p_port);
+
+	sem_post(&p_node->done);
+	sem_wait(&p_node->run);
+}
+
+static bool node_send(sim_port *p_port, const sim_datagram *p_datagram)
+{
+	sim_node *p_node = node_of(p_port);
+
+	sim_controller_node_sent(p_node->id, p_datagram);
+	return sim_mesh_send(p_node->id, p_datagram);
+}
+
+// the core side
+
+static uint64_t local_time(const sim_node *p_node, uint64_t global)
+{
+	return (uint64_t)((double)(global - p_node->boot_at) * p_node->rate);
+}
+
+static uint64_t global_time(const sim_node *p_node, uint64_t local)
+{
+	uint64_t global = p_node->boot_at + (uint64_t)ceil((double)local / p_node->rate);
+
+	// the node must see its wake time reached when it runs, whatever the rounding
+	while (local_time(p_node, global) < local)
+		global++;
+	return global;
+}
+
+static void library_load(sim_node *p_node)
+{
+	char path[] = "/tmp/sim_node_XXXXXX";
+	char buffer[65536];
+
+	int target = mkstemp(path);
+	if (target < 0)
+		fail("mkstemp", strerror(errno));
+
+	int source = open(p_node->p_library_path, O_RDONLY);
+	if (source < 0)
+		fail(p_node->p_library_path, strerror(errno));
+
+	ssize_t length;
+	while ((length = read(source, buffer, sizeof(buffer))) > 0) {
+		if (write(target, buffer, (size_t)length) != length)
+			fail(path, strerror(errno));
+	}
+	close(source);
+	close(target);
+
+	// a file of its own, dlopen() would hand out the already loaded copy otherwise
+	p_node->p_library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	unlink(path);
+	if (p_node->p_library == NULL)
+		fail("dlopen", dlerror());
+
+	p_node->main = (sim_node_main_t)dlsym(p_node->p_library, SIM_NODE_MAIN);
+	if (p_node->main == NULL)
+		fail("dlsym", dlerror());
+}
+
+static void wake_event(void *p_context, uint32_t generation);
+
+static void node_resume(sim_node *p_node)
+{
+	if (!p_node->alive)
+		return;
+
+	sim_port *p_port = &p_node->port;
+	p_port->now_us = local_time(p_node, sim_now());
+	sim_mesh_port_refresh(p_node->id, p_port);
+
+	sem_post(&p_node->run);
+	sem_wait(&p_node->done);
+
+	if (p_node->exited) {
+		pthread_join(p_node->thread, NULL);
+		dlclose(p_node->p_library);
+		p_node->alive = false;
+		return;
+	}
+
+	sim_mesh_port_update(p_node->id, p_port);
+	sim_controller_node_ran(p_node->id, p_port);
+
+	p_node->wake_generation++;
+	if (p_port->wake_at_us != SIM_WAKE_NEVER) {
+		uint64_t at = global_time(p_node, p_port->wake_at_us);
+		if (at <= sim_now())
+			at = sim_now() + 1;
+		sim_event_schedule(at, wake_event, p_node, p_node->wake_generation);
+	}
+}
+
+static void node_stop(sim_node *p_node)
+{
+	if (p_node->alive) {
+		p_node->port.terminate = true;
+		node_resume(p_node);
+	}
+
+	p_node->powered = false;
+	sim_mesh_power_set(p_node->id, false);
+}
+
+static void node_start(sim_node *p_node, uint8_t reset_reason)
+{
+	sim_port *p_port = &p_node->port;
+
+	// the node fills in its half when it runs
+	p_port->seed = sim_random();
+	p_port->reset_reason = reset_reason;
+	p_port->terminate = false;
+	p_port->inbox_head = 0;
+	p_port->inbox_count = 0;
+	p_port->changed = 0;
+	p_port->thread_enabled = false;
+	p_port->poll_period = 0;
+	p_port->wake_at_us = SIM_WAKE_NEVER;
+	p_port->reset_requested = false;
+	p_port->leds = 0;
+	memset(p_port->pwm_out_values, 0, sizeof(p_port->pwm_out_values));
+	p_port->psu_enabled = false;
+
+	library_load(p_node);
+
+	p_node->powered = true;
+	p_node->alive = true;
+	p_node->exited = false;
+	p_node->boot_at = sim_now();
+	p_node->boots++;
+	sim_mesh_power_set(p_node->id, true);
+
+	if (pthread_create(&p_node->thread, NULL, node_thread, p_node) != 0)
+		fail("pthread_create", "failed");
+
+	node_resume(p_node);
+}
+
+static void reset_event(void *p_context, uint32_t arg)
+{
+	sim_node *p_node = p_context;
+
+	if (!p_node->powered)
+		node_start(p_node, OT_PLAT_RESET_REASON_SOFTWARE);
+}
+
+static void wake_event(void *p_context, uint32_t generation)
+{
+	sim_node *p_node = p_context;
+
+	if (generation != WAKE_ANY && generation != p_node->wake_generation)
+		return;
+
+	node_resume(p_node);
+
+	if (p_node->alive && p_node->port.reset_requested) {
+		// GPREGRET survives the reset, the node stored it on the way down
+		node_stop(p_node);
+		sim_event_schedule(sim_now() + RESET_DURATION_US, reset_event, p_node, 0);
+	}
+}
+
+void sim_node_init(uint32_t id, const char *p_library_path)
+{
+	sim_node *p_node = calloc(1, sizeof(*p_node));
+	if (p_node == NULL)
+		fail("calloc", "node");
+
+	p_node->id = id;
+	p_node->p_library_path = p_library_path;
+	p_node->rate = 1.0 + (double)((int32_t)sim_random_below(2 * CLOCK_TOLERANCE_PPM + 1) - CLOCK_TOLERANCE_PPM) * 1e-6;
+	sem_init(&p_node->run, 0, 0);
+	sem_init(&p_node->done, 0, 0);
+
+	sim_port *p_port = &p_node->port;
+	p_port->id = id;
+	p_port->send = node_send;
+	p_port->yield = node_yield;
+	// an erased flash page
+	memset(p_port->nvm, 0xFF, sizeof(p_port->nvm));
+
+	const uint8_t eui64[] = { 0xF4, 0xCE, 0x36, 0x00, 0x00, 0x01, (uint8_t)(id >> 8), (uint8_t)id };
+	memcpy(p_port->eui64, eui64, sizeof(eui64));
+	for (size_t i = 0; i < sizeof(p_port->ext_address); i++)
+		p_port->ext_address[i] = (uint8_t)sim_random();
+
+	mp_nodes[id] = p_node;
+}
+
+void sim_node_power_on(uint32_t id)
+{
+	sim_node *p_node = mp_nodes[id];
+
+	if (!p_node->powered)
+		node_start(p_node, OT_PLAT_RESET_REASON_POWER_ON);
+}
+
+void sim_node_power_off(uint32_t id)
+{
+	sim_node *p_node = mp_nodes[id];
+
+	if (!p_node->powered)
+		return;
+
+	node_stop(p_node);
+	p_node->port.gpregret = 0;
+}
+
+bool sim_node_powered(uint32_t id)
+{
+	return mp_nodes[id]->powered;
+}
+
+uint32_t sim_node_boots(uint32_t id)
+{
+	return mp_nodes[id]->boots;
+}
+
+bool sim_node_deliver(uint32_t id, const sim_datagram *p_datagram)
+{
+	sim_node *p_node = mp_nodes[id];
+	sim_port *p_port = &p_node->port;
+
+	if (!p_node->alive || p_port->inbox_count == SIM_INBOX_SIZE)
+		return false;
+
+	p_port->inbox[(p_port->inbox_head + p_port->inbox_count) % SIM_INBOX_SIZE] = *p_datagram;
+	p_port->inbox_count++;
+	sim_node_wake(id);
+	return true;
+}
+
+void sim_node_wake(uint32_t id)
+{
+	sim_event_schedule(sim_now(), wake_event, mp_nodes[id], WAKE_ANY);
+}
+
+const sim_port *sim_node_port(uint32_t id)
+{
+	return &mp_nodes[id]->port;
+}
+
+void sim_node_shutdown(void)
+{
+	for (uint32_t id = 0; id < SIM_NODES_MAX; id++) {
+		sim_node *p_node = mp_nodes[id];
+		if (p_node == NULL)
+			continue;
+
+		sim_node_power_off(id);
+		sem_destroy(&p_node->run);
+		sem_destroy(&p_node->done);
+		free(p_node);
+		mp_nodes[id] = NULL;
+	}
+}
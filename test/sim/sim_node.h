@@ -0,0 +1,40 @@
+#ifndef SIM_NODE_H__
+#define SIM_NODE_H__
+
+#include "sim_port.h"
+
+/**@brief Simulated dimmer nodes, each a private copy of the firmware library on its own thread.
+ *
+ * @details Only one thread runs at a time: the core resumes a node and waits until it yields, so the
+ *          firmware sees no concurrency it would not see on the chip. The library is copied to a new
+ *          file for every power up and loaded with RTLD_LOCAL, which gives every node its own globals
+ *          and a power cut its fresh .bss. NVM and GPREGRET are kept in the port across power ups.
+ */
+
+#define SIM_NODES_MAX 96
+
+/**@brief Sets up a node that runs the firmware library at p_library_path, powered off. */
+void sim_node_init(uint32_t id, const char *p_library_path);
+
+void sim_node_power_on(uint32_t id);
+
+/**@brief Cuts the power: the firmware is ended wherever it is and GPREGRET is lost. */
+void sim_node_power_off(uint32_t id);
+
+bool sim_node_powered(uint32_t id);
+
+/**@brief Number of times the firmware of the node was started. */
+uint32_t sim_node_boots(uint32_t id);
+
+/**@brief Queues a received datagram and wakes the node, returns false when its inbox is full. */
+bool sim_node_deliver(uint32_t id, const sim_datagram *p_datagram);
+
+/**@brief Runs the node soon, after the core changed what it reads from the port. */
+void sim_node_wake(uint32_t id);
+
+const sim_port *sim_node_port(uint32_t id);
+
+/**@brief Powers off every node and unloads the libraries. */
+void sim_node_shutdown(void);
+
+#endif /* SIM_NODE_H__ */
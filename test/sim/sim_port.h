@@ -0,0 +1,105 @@
+#ifndef SIM_PORT_H__
+#define SIM_PORT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief Boundary between a simulated node and the simulation core.
+ *
+ * @details Every node runs its own copy of the firmware library (node_ot.c, node_sdk.c and the firmware
+ *          sources) on its own thread. The core and the nodes take turns: the core resumes a node with
+ *          its clock set, the node runs until it would sleep, then yields with the time it wants to be
+ *          woken at. The fields the core writes only change while the node is suspended.
+ */
+
+#define SIM_DATAGRAM_SIZE_MAX 1280 // IPv6 minimum MTU
+#define SIM_INBOX_SIZE        16
+#define SIM_ROUTER_ID_MAX     62
+#define SIM_NEIGHBORS_MAX     64
+#define SIM_NVM_SIZE          4096 // HAL_NVM_PAGE_SIZE
+#define SIM_WAKE_NEVER        UINT64_MAX
+
+#define SIM_LINK_QUALITY_NONE (-1) // router ID not allocated
+
+/**@brief A UDP datagram as seen by the IPv6 layer, link and 6LoWPAN framing are added by the core. */
+typedef struct sim_datagram
+{
+	uint8_t source[16];
+	uint8_t destination[16];
+	uint16_t source_port;
+	uint16_t destination_port;
+	uint8_t hop_limit;
+	uint16_t length;
+	uint8_t payload[SIM_DATAGRAM_SIZE_MAX];
+} sim_datagram;
+
+typedef struct sim_neighbor
+{
+	uint16_t rloc16;
+	uint8_t link_quality;
+	bool is_child;
+	bool rx_on_when_idle;
+	bool full_thread_device;
+} sim_neighbor;
+
+typedef struct sim_port sim_port;
+
+struct sim_port
+{
+	// set by the core
+	uint32_t id;
+	uint32_t seed;              // differs for every power up
+	uint64_t now_us;            // node clock, zero at power up
+	uint8_t reset_reason;       // otPlatResetReason
+	uint8_t eui64[8];
+	uint8_t ext_address[8];
+	uint8_t mesh_local_eid[16];
+	uint8_t rloc[16];
+	uint8_t leader_rloc[16];
+	uint8_t role;               // otDeviceRole
+	uint16_t rloc16;
+	uint32_t changed;           // OT_CHANGED_* flags not yet reported to the node
+	int8_t router_link_quality[SIM_ROUTER_ID_MAX + 1];
+	uint8_t neighbor_count;
+	sim_neighbor neighbors[SIM_NEIGHBORS_MAX];
+	uint32_t tx_frames;
+	uint32_t rx_frames;
+	uint8_t inbox_head;
+	uint8_t inbox_count;
+	sim_datagram inbox[SIM_INBOX_SIZE];
+	bool terminate;             // power cut or reset, the node unwinds at its next yield
+
+	// kept by the core across power ups
+	uint8_t nvm[SIM_NVM_SIZE];
+	uint32_t gpregret;          // retained across a reset, cleared by a power cut
+
+	// set by the node
+	bool thread_enabled;
+	bool rx_on_when_idle;
+	bool full_thread_device;
+	uint32_t poll_period;       // milliseconds
+	uint8_t router_upgrade_threshold;
+	uint8_t router_downgrade_threshold;
+	uint8_t router_selection_jitter; // seconds
+	uint64_t wake_at_us;        // node clock, SIM_WAKE_NEVER to sleep until a datagram arrives
+	bool reset_requested;
+	uint32_t leds;
+	uint16_t pwm_out_values[4];
+	bool psu_enabled;
+	uint32_t coap_retransmissions;
+	uint32_t coap_timeouts;
+	uint32_t messages_no_bufs;
+
+	/**@brief Hands a datagram to the mesh, returns false when the node has no route for it. */
+	bool (*send)(sim_port *p_port, const sim_datagram *p_datagram);
+
+	/**@brief Suspends the node until the core resumes it. */
+	void (*yield)(sim_port *p_port);
+};
+
+/**@brief Entry point of the firmware library, returns once the node was told to terminate. */
+typedef void (*sim_node_main_t)(sim_port *p_port);
+
+#define SIM_NODE_MAIN "sim_node_main"
+
+#endif /* SIM_PORT_H__ */
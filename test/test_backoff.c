@@ -0,0 +1,123 @@
+#include "backoff.h"
+#include "settings.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+#define NODES           50
+#define AIRTIME         50 // milliseconds a multicast /up occupies the mesh, overlapping broadcasts are lost
+#define SIMULATION_END  600000
+
+static int m_failures = 0;
+
+static void check(bool passed, const char *p_condition, int line)
+{
+	if (passed)
+		return;
+
+	m_failures++;
+	printf("test_backoff.c:%d: %s\n", line, p_condition);
+}
+
+static uint32_t m_random = 0x2545F491;
+
+static uint32_t random_next(void)
+{
+	// xorshift32
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return m_random;
+}
+
+static void test_interval_clamped(void)
+{
+	uint32_t interval = SUBSCRIPTION_BROADCAST_INTERVAL_MIN;
+
+	for (int i = 0; i < 20; i++) {
+		uint32_t delay = backoff_next_delay(&interval, random_next());
+		CHECK(interval <= SUBSCRIPTION_BROADCAST_INTERVAL_MAX);
+		CHECK(delay >= interval / 2 && delay < interval + interval / 2);
+	}
+	CHECK(interval == SUBSCRIPTION_BROADCAST_INTERVAL_MAX);
+
+	// not a power of two multiple of the minimum, doubling would overshoot
+	interval = SUBSCRIPTION_BROADCAST_INTERVAL_MAX * 2 / 3;
+	backoff_next_delay(&interval, 0);
+	CHECK(interval == SUBSCRIPTION_BROADCAST_INTERVAL_MAX);
+}
+
+/**@brief All nodes reboot at once, a controller subscribes to every node whose /up arrives. A /up is lost
+ *        when another one is on the air within AIRTIME.
+ */
+static void test_mass_reboot_converges(void)
+{
+	uint32_t next_at[NODES];
+	uint32_t last_at[NODES];
+	bool     sent[NODES] = { false };
+	uint32_t interval[NODES];
+	bool     subscribed[NODES] = { false };
+	int      broadcasts = 0;
+	int      lost = 0;
+	uint32_t converged_at = 0;
+
+	for (int i = 0; i < NODES; i++) {
+		interval[i] = SUBSCRIPTION_BROADCAST_INTERVAL_MIN;
+		next_at[i] = backoff_first_delay(random_next());
+	}
+
+	for (int remaining = NODES; remaining > 0;) {
+		int node = -1;
+		for (int i = 0; i < NODES; i++) {
+			if (!subscribed[i] && (node < 0 || next_at[i] < next_at[node]))
+				node = i;
+		}
+		uint32_t time = next_at[node];
+		if (time > SIMULATION_END)
+			break;
+
+		bool collided = false;
+		for (int i = 0; i < NODES; i++) {
+			if (i == node)
+				continue;
+			// another broadcast that started just before is still on the air, or one starts before this ends
+			if ((sent[i] && time - last_at[i] < AIRTIME) || (!subscribed[i] && next_at[i] - time < AIRTIME))
+				collided = true;
+		}
+
+		broadcasts++;
+		last_at[node] = time;
+		sent[node] = true;
+		if (collided) {
+			lost++;
+			next_at[node] = time + backoff_next_delay(&interval[node], random_next());
+		} else {
+			subscribed[node] = true;
+			converged_at = time;
+			remaining--;
+		}
+	}
+
+	int subscribed_count = 0;
+	for (int i = 0; i < NODES; i++)
+		subscribed_count += subscribed[i];
+
+	printf("%d nodes: %d subscribed after %u ms, %d broadcasts, %d lost\n", NODES, subscribed_count,
+		converged_at, broadcasts, lost);
+
+	CHECK(subscribed_count == NODES);
+	CHECK(converged_at < 4 * SUBSCRIPTION_BROADCAST_INTERVAL_MAX);
+}
+
+int main(void)
+{
+	test_interval_clamped();
+	test_mass_reboot_converges();
+
+	if (m_failures)
+		printf("%d checks failed\n", m_failures);
+
+	return m_failures ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+#include "coap_payload.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static int m_failures = 0;
+
+static void check(bool passed, const char *p_condition, int line)
+{
+	if (passed)
+		return;
+
+	m_failures++;
+	printf("test_coap_payload.c:%d: %s\n", line, p_condition);
+}
+
+static void test_set(void)
+{
+	set_request request;
+
+	// {"r": 128, "g": 5, "zz": 1, "V": 7}, "zz" is unknown and "V" read-only
+	const uint8_t rgb[] = { 0xA4, 0x61, 'r', 0x18, 0x80, 0x61, 'g', 0x05, 0x62, 'z', 'z', 0x01, 0x61, 'V', 0x07 };
+	CHECK(coap_payload_set_parse(rgb, sizeof(rgb), &request));
+	CHECK(request.count == 2);
+	CHECK(request.items[0].sensor_index == SENSOR_INDEX(r) && request.items[0].value == 128 && !request.items[0].is_index);
+	CHECK(request.items[1].sensor_index == SENSOR_INDEX(g) && request.items[1].value == 5);
+	CHECK(!request.start_present);
+
+	uint8_t response[64];
+	const uint8_t rgb_response[] = { 0xBF, 0x61, 'r', 0x18, 0x80, 0x61, 'g', 0x05, 0xFF };
+	CHECK(coap_payload_set_response_encode(&request, response, sizeof(response)) == sizeof(rgb_response));
+	CHECK(memcmp(response, rgb_response, sizeof(rgb_response)) == 0);
+
+	// {0: 10}, answered by index as well
+	const uint8_t index[] = { 0xA1, 0x00, 0x0A };
+	CHECK(coap_payload_set_parse(index, sizeof(index), &request));
+	CHECK(request.count == 1 && request.items[0].is_index);
+	const uint8_t index_response[] = { 0xBF, 0x00, 0x0A, 0xFF };
+	CHECK(coap_payload_set_response_encode(&request, response, sizeof(response)) == sizeof(index_response));
+	CHECK(memcmp(response, index_response, sizeof(index_response)) == 0);
+
+	// {"@": 2147483648, "r": 1}, a network time past 2^31 ms
+	const uint8_t start[] = { 0xA2, 0x61, '@', 0x1A, 0x80, 0x00, 0x00, 0x00, 0x61, 'r', 0x01 };
+	CHECK(coap_payload_set_parse(start, sizeof(start), &request));
+	CHECK(request.start_present && request.start == 0x80000000);
+	CHECK(request.count == 1 && request.items[0].sensor_index == SENSOR_INDEX(r));
+
+	// {"@": 2^32, "r": 1} and {"@": -1, "r": 1}
+	const uint8_t start_large[] = { 0xA2, 0x61, '@', 0x1B, 0, 0, 0, 1, 0, 0, 0, 0, 0x61, 'r', 0x01 };
+	const uint8_t start_negative[] = { 0xA2, 0x61, '@', 0x20, 0x61, 'r', 0x01 };
+	CHECK(!coap_payload_set_parse(start_large, sizeof(start_large), &request));
+	CHECK(!coap_payload_set_parse(start_negative, sizeof(start_negative), &request));
+
+	// the largest response fits the dedup cache
+	request.count = SET_REQUEST_ITEMS_MAX;
+	for (int i = 0; i < SET_REQUEST_ITEMS_MAX; i++) {
+		request.items[i].sensor_index = SENSOR_INDEX(r);
+		request.items[i].is_index = false;
+		request.items[i].value = INT32_MIN;
+	}
+	uint8_t largest[SET_RESPONSE_SIZE_MAX];
+	CHECK(coap_payload_set_response_encode(&request, largest, sizeof(largest)) == SET_RESPONSE_SIZE_MAX);
+
+	// {"r": "x"}, truncated {"r": 1 and an array
+	const uint8_t text_value[] = { 0xA1, 0x61, 'r', 0x61, 'x' };
+	const uint8_t truncated[] = { 0xA2, 0x61, 'r', 0x01 };
+	const uint8_t array[] = { 0x81, 0x01 };
+	CHECK(!coap_payload_set_parse(text_value, sizeof(text_value), &request));
+	CHECK(!coap_payload_set_parse(truncated, sizeof(truncated), &request));
+	CHECK(!coap_payload_set_parse(array, sizeof(array), &request));
+}
+
+static void test_get(void)
+{
+	sensor_mask_t sensors;
+
+	const uint8_t empty[] = { 0x80 };
+	CHECK(coap_payload_get_parse(empty, sizeof(empty), &sensors));
+	CHECK(sensors == SENSORS_ALL_MASK);
+
+	// ["r", "temperature"]
+	const uint8_t keys[] = { 0x82, 0x61, 'r', 0x6B, 't', 'e', 'm', 'p', 'e', 'r', 'a', 't', 'u', 'r', 'e' };
+	CHECK(coap_payload_get_parse(keys, sizeof(keys), &sensors));
+	CHECK(sensors == (SENSOR_MASK(SENSOR_INDEX(r)) | SENSOR_MASK(SENSOR_INDEX(t))));
+
+	// [0, 1, 99], integers are indices as in /set, an unknown index is skipped
+	const uint8_t indices[] = { 0x83, 0x00, 0x01, 0x18, 0x63 };
+	CHECK(coap_payload_get_parse(indices, sizeof(indices), &sensors));
+	CHECK(sensors == (SENSOR_MASK(0) | SENSOR_MASK(1)));
+
+	// [h'0500'], a bitmap of indices 0 and 2
+	const uint8_t bitmap[] = { 0x81, 0x42, 0x05, 0x00 };
+	CHECK(coap_payload_get_parse(bitmap, sizeof(bitmap), &sensors));
+	CHECK(sensors == (SENSOR_MASK(0) | SENSOR_MASK(2)));
+
+	// [-1], [{}] and a bitmap longer than sensor_mask_t
+	const uint8_t negative[] = { 0x81, 0x20 };
+	const uint8_t map[] = { 0x81, 0xA0 };
+	const uint8_t long_bitmap[] = { 0x81, 0x49, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	CHECK(!coap_payload_get_parse(negative, sizeof(negative), &sensors));
+	CHECK(!coap_payload_get_parse(map, sizeof(map), &sensors));
+	CHECK(!coap_payload_get_parse(long_bitmap, sizeof(long_bitmap), &sensors));
+}
+
+static void test_sub(void)
+{
+	sub_request request;
+
+	// {"a": h'fd00..01', "s": {"r": {"i": 10, "r": 5}}}
+	const uint8_t sub[] = { 0xA2, 0x61, 'a', 0x50, 0xFD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+		0x61, 's', 0xA1, 0x61, 'r', 0xA2, 0x61, 'i', 0x0A, 0x61, 'r', 0x05 };
+	CHECK(coap_payload_sub_parse(sub, sizeof(sub), &request));
+	CHECK(request.address_present && request.address[0] == 0xFD && request.address[15] == 1);
+	CHECK(request.count == 1);
+	CHECK(request.items[0].sensor_index == SENSOR_INDEX(r));
+	CHECK(request.items[0].interval_present && request.items[0].interval == 10);
+	CHECK(request.items[0].change_present && request.items[0].change == 5);
+
+	// a short address
+	const uint8_t short_address[] = { 0xA1, 0x61, 'a', 0x42, 0xFD, 0x00 };
+	CHECK(!coap_payload_sub_parse(short_address, sizeof(short_address), &request));
+}
+
+static void test_fx(void)
+{
+	fx_request request;
+
+	// {"k": [[0, 0, 0, 0, 0], [1000, 255, 0, 0, 10]], "n": 2}
+	const uint8_t fx[] = { 0xA2, 0x61, 'k', 0x82, 0x85, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x85, 0x19, 0x03, 0xE8, 0x18, 0xFF, 0x00, 0x00, 0x0A, 0x61, 'n', 0x02 };
+	CHECK(coap_payload_fx_parse(fx, sizeof(fx), &request));
+	CHECK(request.count == 2 && request.loops == 2 && !request.start_present);
+	CHECK(request.keyframes[1].time == 1000 && request.keyframes[1].values[0] == 255 && request.keyframes[1].values[3] == 10);
+
+	// a keyframe one channel short
+	const uint8_t short_frame[] = { 0xA1, 0x61, 'k', 0x81, 0x84, 0x00, 0x00, 0x00, 0x00 };
+	CHECK(!coap_payload_fx_parse(short_frame, sizeof(short_frame), &request));
+}
+
+static void test_timesync(void)
+{
+	uint32_t network_time;
+
+	const uint8_t beacon[] = { 0xA1, 0x61, 't', 0x1A, 0x07, 0x5B, 0xCD, 0x15 };
+	CHECK(coap_payload_timesync_parse(beacon, sizeof(beacon), &network_time));
+	CHECK(network_time == 123456789);
+
+	const uint8_t wide_time[] = { 0xA1, 0x61, 't', 0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 };
+	CHECK(!coap_payload_timesync_parse(wide_time, sizeof(wide_time), &network_time));
+}
+
+int main(void)
+{
+	test_set();
+	test_get();
+	test_sub();
+	test_fx();
+	test_timesync();
+
+	if (m_failures)
+		printf("%d checks failed\n", m_failures);
+
+	return m_failures ? 1 : 0;
+}
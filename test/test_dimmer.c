@@ -0,0 +1,276 @@
+#include "dimmer.h"
+#include "effect.h"
+#include "hal_host.h"
+#include "psu_hold.h"
+#include "sensors.h"
+#include "settings.h"
+#include "thermal.h"
+
+#include <stdio.h>
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static int m_failures = 0;
+
+static void check(bool passed, const char *p_condition, int line)
+{
+	if (passed)
+		return;
+
+	m_failures++;
+	printf("test_dimmer.c:%d: %s\n", line, p_condition);
+}
+
+static void adc_in_handler(const int16_t *p_samples, uint16_t samples_per_channel)
+{
+	dimmer_adc_process(p_samples, samples_per_channel);
+}
+
+static void rail_sample(uint32_t rail_mv)
+{
+	int16_t samples[HAL_ADC_IN_CHANNELS];
+	samples[HAL_ADC_IN_VDD] = 3000;
+	samples[HAL_ADC_IN_RAIL] = (int16_t)((rail_mv * 1000) / ENERGY_RAIL_UV_PER_LSB);
+
+	hal_host_adc_in_inject(samples, 1);
+}
+
+static void run(uint32_t milliseconds, uint32_t rail_mv)
+{
+	for (uint32_t t = 0; t < milliseconds; t += PSU_CONTROL_TIMER_FAST_INTERVAL) {
+		rail_sample(hal_host.psu_enabled ? rail_mv : 0);
+		dimmer_psu_control_process();
+		hal_host_clock_advance(PSU_CONTROL_TIMER_FAST_INTERVAL);
+	}
+}
+
+static void setup(void)
+{
+	hal_nvm_erase();
+	hal_host.clock = 0;
+	dimmer_init();
+	hal_adc_in_init(adc_in_handler);
+	run(PSU_CONTROL_TIMER_FAST_INTERVAL, 0);
+}
+
+static void test_psu_powers_up_and_ramps(void)
+{
+	setup();
+	CHECK(dimmer_idle());
+	CHECK(!hal_host.psu_enabled);
+
+	set_sensor_value('r', 200, true);
+	CHECK(!dimmer_output_ready());
+
+	run(PSU_CONTROL_TIMER_FAST_INTERVAL, 12000);
+	CHECK(hal_host.psu_enabled);
+	CHECK(dimmer_psu_starting());
+	CHECK(hal_host.pwm_out_values[0] == 0);
+
+	// a settled rail enables the outputs long before DIMMER_PSU_ON_TIMEOUT
+	run(DIMMER_RAIL_STABLE_BUFFERS * PSU_CONTROL_TIMER_FAST_INTERVAL * 2, 12000);
+	CHECK(dimmer_output_ready());
+	CHECK(hal_host.pwm_out_values[0] < 200);
+
+	run(DIMMER_SOFT_START_TIME * 2, 12000);
+	CHECK(!dimmer_psu_starting());
+	CHECK(hal_host.pwm_out_values[0] == 200);
+	CHECK(!dimmer_idle());
+}
+
+static void test_psu_on_timeout_without_rail(void)
+{
+	setup();
+
+	set_sensor_value('g', 100, true);
+	run(DIMMER_PSU_ON_TIMEOUT / 2, 0);
+	CHECK(hal_host.psu_enabled);
+	CHECK(!dimmer_output_ready());
+
+	run(DIMMER_PSU_ON_TIMEOUT + DIMMER_SOFT_START_TIME * 2, 0);
+	CHECK(dimmer_output_ready());
+	CHECK(hal_host.pwm_out_values[1] == 100);
+}
+
+static void test_psu_held_then_off(void)
+{
+	setup();
+
+	set_sensor_value('b', 50, true);
+	run(200, 12000);
+	CHECK(hal_host.pwm_out_values[2] == 50);
+
+	set_sensor_value('b', 0, true);
+	run(PSU_CONTROL_TIMER_FAST_INTERVAL, 12000);
+	CHECK(hal_host.pwm_out_values[2] == 0);
+	CHECK(hal_host.psu_enabled);
+	CHECK(dimmer_idle());
+
+	run(PSU_HOLD_MAX + 1000, 12000);
+	CHECK(!hal_host.psu_enabled);
+	CHECK(hal_host.psu_switches == 2);
+}
+
+static void test_overcurrent_latches_until_off(void)
+{
+	setup();
+
+	set_sensor_value('w', HAL_PWM_OUT_VALUE_MAX, true);
+	run(200, 12000);
+	CHECK(hal_host.pwm_out_values[3] == HAL_PWM_OUT_VALUE_MAX);
+
+	hal_host_protection_trip();
+	run(PSU_CONTROL_TIMER_FAST_INTERVAL, 12000);
+	CHECK(!hal_host.psu_enabled);
+	CHECK(sensor_current_values[SENSOR_INDEX(o)] == 1);
+	CHECK(!dimmer_idle());
+
+	// a channel left on keeps the fault latched
+	run(1000, 12000);
+	CHECK(!hal_host.psu_enabled);
+	CHECK(hal_host.protection_rearms == 0);
+
+	set_sensor_value('w', 0, true);
+	run(PSU_CONTROL_TIMER_FAST_INTERVAL, 12000);
+	CHECK(hal_host.protection_rearms == 1);
+	CHECK(sensor_current_values[SENSOR_INDEX(o)] == 0);
+	CHECK(dimmer_idle());
+}
+
+static void test_scheduled_effect_reports_set_values(void)
+{
+	setup();
+
+	set_sensor_value('w', 200, true);
+	run(200, 12000);
+	CHECK(hal_host.pwm_out_values[3] == 200);
+
+	const effect_keyframe keyframes[] = { { 0, { 0, 0, 0, 0 } }, { 1000, { 0, 0, 0, 0 } } };
+	CHECK(effect_load(keyframes, 2, 1));
+	effect_start_time_set(hal_clock_now() + 5000);
+
+	// until the effect starts the set values are on the outputs and metered
+	run(1000, 12000);
+	CHECK(!hal_host.pwm_out_streaming);
+	CHECK(hal_host.pwm_out_values[3] == 200);
+	CHECK(!dimmer_output_off());
+
+	run(5000, 12000);
+	CHECK(hal_host.pwm_out_streaming);
+	hal_host_pwm_out_stream_play(1);
+	run(PSU_CONTROL_TIMER_FAST_INTERVAL, 12000);
+	CHECK(dimmer_output_off());
+
+	effect_stop();
+}
+
+static void test_psu_hold_follows_history_after_min_intervals(void)
+{
+	psu_hold_init();
+
+	for (int i = 1; i < PSU_HOLD_INTERVALS_MIN; i++)
+		psu_hold_off_interval_add(1500);
+	CHECK(psu_hold_time_get() == PSU_HOLD_RESTART_COST);
+
+	psu_hold_off_interval_add(1500);
+	CHECK(psu_hold_time_get() == 2000);
+}
+
+static void test_thermal_threshold_clamped(void)
+{
+	setup();
+	thermal_init();
+
+	set_sensor_value('T', INT32_MIN, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(T)] == THERMAL_DERATING_THRESHOLD_MIN);
+	thermal_derating_process(85 * 4);
+	CHECK(thermal_scale_get() == THERMAL_DERATING_SCALE_MIN);
+
+	set_sensor_value('T', INT32_MAX, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(T)] == THERMAL_DERATING_THRESHOLD_MAX);
+	for (int i = 0; i < 1000; i++)
+		thermal_derating_process(-40 * 4);
+	CHECK(thermal_scale_get() == THERMAL_SCALE_ONE);
+}
+
+static bool rgbw_is(int32_t r, int32_t g, int32_t b, int32_t w)
+{
+	return sensor_current_values[SENSOR_INDEX(r)] == r && sensor_current_values[SENSOR_INDEX(g)] == g &&
+		sensor_current_values[SENSOR_INDEX(b)] == b && sensor_current_values[SENSOR_INDEX(w)] == w;
+}
+
+static void test_colour_known_values(void)
+{
+	setup();
+	set_sensor_value('f', 0, true);
+
+	// HSV, the common part of r, g and b goes to white
+	set_sensor_value('H', (0 << 16) | (255 << 8) | 255, true);
+	CHECK(rgbw_is(255, 0, 0, 0));
+	set_sensor_value('H', (60 << 16) | (255 << 8) | 255, true);
+	CHECK(rgbw_is(255, 255, 0, 0));
+	set_sensor_value('H', (120 << 16) | (255 << 8) | 128, true);
+	CHECK(rgbw_is(0, 128, 0, 0));
+	set_sensor_value('H', (200 << 16) | (0 << 8) | 200, true);
+	CHECK(rgbw_is(0, 0, 0, 200));
+
+	// CCT from the table, and halfway between two entries: 162 mired is 12/25 from 150 to 175
+	set_sensor_value('C', (150 << 8) | 255, true);
+	CHECK(rgbw_is(12, 0, 12, 243));
+	set_sensor_value('C', (162 << 8) | 255, true);
+	CHECK(rgbw_is(26, 6, 0, 229));
+
+	// CIE xy, D65 is white and a point outside the gamut clips to red
+	set_sensor_value('x', (313 << 18) | (329 << 8) | 255, true);
+	CHECK(rgbw_is(1, 0, 0, 254));
+	set_sensor_value('x', (700 << 18) | (299 << 8) | 255, true);
+	CHECK(rgbw_is(255, 0, 0, 0));
+}
+
+static void test_colour_reports_applied_values(void)
+{
+	setup();
+	set_sensor_value('f', 0, true);
+
+	// rejected inputs read back as the last accepted one, the channels are left alone
+	set_sensor_value('H', (120 << 16) | (255 << 8) | 255, true);
+	set_sensor_value('H', (400 << 16) | (255 << 8) | 255, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(H)] == ((120 << 16) | (255 << 8) | 255));
+	CHECK(rgbw_is(0, 255, 0, 0));
+
+	set_sensor_value('x', (313 << 18) | (329 << 8) | 255, true);
+	set_sensor_value('x', (313 << 18) | (0 << 8) | 255, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(x)] == ((313 << 18) | (329 << 8) | 255));
+	set_sensor_value('x', (700 << 18) | (400 << 8) | 255, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(x)] == ((313 << 18) | (329 << 8) | 255));
+	CHECK(rgbw_is(1, 0, 0, 254));
+
+	// a mired value out of range reads back clamped
+	set_sensor_value('C', (100 << 8) | 255, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(C)] == ((COLOUR_MIRED_MIN << 8) | 255));
+	set_sensor_value('C', (900 << 8) | 255, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(C)] == ((COLOUR_MIRED_MAX << 8) | 255));
+
+	set_sensor_value('f', -5, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(f)] == 0);
+	set_sensor_value('r', 300, true);
+	CHECK(sensor_current_values[SENSOR_INDEX(r)] == HAL_PWM_OUT_VALUE_MAX);
+}
+
+int main(void)
+{
+	test_psu_powers_up_and_ramps();
+	test_psu_on_timeout_without_rail();
+	test_psu_held_then_off();
+	test_overcurrent_latches_until_off();
+	test_scheduled_effect_reports_set_values();
+	test_psu_hold_follows_history_after_min_intervals();
+	test_thermal_threshold_clamped();
+	test_colour_known_values();
+	test_colour_reports_applied_values();
+
+	if (m_failures)
+		printf("%d checks failed\n", m_failures);
+
+	return m_failures ? 1 : 0;
+}
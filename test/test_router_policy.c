@@ -0,0 +1,79 @@
+#include "router_policy.h"
+#include "settings.h"
+
+#include <stdio.h>
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static int m_failures = 0;
+
+static void check(bool passed, const char *p_condition, int line)
+{
+	if (passed)
+		return;
+
+	m_failures++;
+	printf("test_router_policy.c:%d: %s\n", line, p_condition);
+}
+
+static const router_policy_params m_defaults = { .upgrade_threshold = 16, .downgrade_threshold = 23, .jitter = 120 };
+
+static void test_density_hysteresis(void)
+{
+	bool dense = false;
+
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS - 1, 0, 0) == ROUTER_POLICY_SPARSE);
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS, 0, 0) == ROUTER_POLICY_DENSE_QUIET);
+
+	// stays dense down to the hysteresis
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS - ROUTER_POLICY_DENSE_HYSTERESIS, 0, 0) == ROUTER_POLICY_DENSE_QUIET);
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS - ROUTER_POLICY_DENSE_HYSTERESIS - 1, 0, 0) == ROUTER_POLICY_SPARSE);
+	CHECK(!dense);
+}
+
+static void test_busy(void)
+{
+	bool dense = true;
+
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS, 1, 0) == ROUTER_POLICY_DENSE_BUSY);
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS, 0, ROUTER_POLICY_BUSY_FRAMES) == ROUTER_POLICY_DENSE_BUSY);
+	CHECK(router_policy_decide(&dense, ROUTER_POLICY_DENSE_ROUTERS, 0, ROUTER_POLICY_BUSY_FRAMES - 1) == ROUTER_POLICY_DENSE_QUIET);
+}
+
+static void test_params(void)
+{
+	router_policy_params params;
+
+	// sparse and unattached nodes keep the OpenThread values
+	router_policy_params_get(ROUTER_POLICY_SPARSE, &m_defaults, &params);
+	CHECK(params.upgrade_threshold == 16 && params.downgrade_threshold == 23 && params.jitter == 120);
+	router_policy_params_get(ROUTER_POLICY_NONE, &m_defaults, &params);
+	CHECK(params.upgrade_threshold == 16 && params.downgrade_threshold == 23 && params.jitter == 120);
+
+	router_policy_params_get(ROUTER_POLICY_DENSE_QUIET, &m_defaults, &params);
+	CHECK(params.upgrade_threshold == ROUTER_POLICY_UPGRADE_THRESHOLD);
+	CHECK(params.downgrade_threshold == ROUTER_POLICY_DOWNGRADE_THRESHOLD);
+	CHECK(params.jitter == ROUTER_POLICY_JITTER_QUIET);
+
+	// a busy node in a dense area never races faster than OpenThread would
+	router_policy_params_get(ROUTER_POLICY_DENSE_BUSY, &m_defaults, &params);
+	CHECK(params.jitter >= m_defaults.jitter);
+
+	const router_policy_params long_jitter = { .upgrade_threshold = 16, .downgrade_threshold = 23, .jitter = 250 };
+	for (int decision = ROUTER_POLICY_NONE; decision <= ROUTER_POLICY_DENSE_QUIET; decision++) {
+		router_policy_params_get((router_policy_decision_t)decision, &long_jitter, &params);
+		CHECK(params.jitter >= long_jitter.jitter);
+	}
+}
+
+int main(void)
+{
+	test_density_hysteresis();
+	test_busy();
+	test_params();
+
+	if (m_failures)
+		printf("%d checks failed\n", m_failures);
+
+	return m_failures ? 1 : 0;
+}
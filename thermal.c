@@ -0,0 +1,61 @@
+#include "thermal.h"
+
+#include "sensors.h"
+#include "settings.h"
+
+static int32_t m_threshold = THERMAL_DERATING_THRESHOLD;
+static int32_t m_integral = 0;
+static uint16_t m_scale = THERMAL_SCALE_ONE;
+
+void thermal_init(void)
+{
+	m_threshold = THERMAL_DERATING_THRESHOLD;
+	m_integral = 0;
+	m_scale = THERMAL_SCALE_ONE;
+
+	set_sensor_value('T', m_threshold, false);
+	set_sensor_value('d', 0, false);
+}
+
+void thermal_derating_process(int32_t temperature)
+{
+	const int32_t reduction_max = THERMAL_SCALE_ONE - THERMAL_DERATING_SCALE_MIN;
+
+	int32_t error = temperature - m_threshold;
+
+	// the integral only holds a reduction, so it unwinds to zero as the node cools
+	m_integral += error * THERMAL_DERATING_KI;
+	if (m_integral < 0)
+		m_integral = 0;
+	if (m_integral > reduction_max)
+		m_integral = reduction_max;
+
+	int32_t reduction = error * THERMAL_DERATING_KP + m_integral;
+	if (reduction < 0)
+		reduction = 0;
+	if (reduction > reduction_max)
+		reduction = reduction_max;
+
+	uint16_t scale = (uint16_t)(THERMAL_SCALE_ONE - reduction);
+	if (scale != m_scale) {
+		m_scale = scale;
+		set_sensor_value('d', (reduction * 100 + THERMAL_SCALE_ONE / 2) >> THERMAL_SCALE_SHIFT, false);
+	}
+}
+
+uint16_t thermal_scale_get(void)
+{
+	return m_scale;
+}
+
+void thermal_threshold_set(char sensor_name, int32_t sensor_value)
+{
+	// within the operating range, so the error and its gains cannot overflow
+	if (sensor_value < THERMAL_DERATING_THRESHOLD_MIN)
+		sensor_value = THERMAL_DERATING_THRESHOLD_MIN;
+	if (sensor_value > THERMAL_DERATING_THRESHOLD_MAX)
+		sensor_value = THERMAL_DERATING_THRESHOLD_MAX;
+
+	m_threshold = sensor_value;
+	set_sensor_value(sensor_name, sensor_value, false);
+}
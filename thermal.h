@@ -0,0 +1,25 @@
+#ifndef THERMAL_H__
+#define THERMAL_H__
+
+#include <stdint.h>
+
+/**@brief Thermal derating: a fixed point PI controller that scales the LED output down above a threshold.
+ *
+ * @details The threshold is the writable sensor 'T', the current derating in percent is reported as 'd'.
+ *          Both use the units of the temperature sensor 't', 0.25 degree Celsius.
+ */
+
+#define THERMAL_SCALE_SHIFT 10
+#define THERMAL_SCALE_ONE   (1 << THERMAL_SCALE_SHIFT)
+
+void thermal_init(void);
+
+/**@brief Runs one controller step on a filtered temperature, called once per temperature period. */
+void thermal_derating_process(int32_t temperature);
+
+/**@brief Output scale, THERMAL_SCALE_ONE for full output. */
+uint16_t thermal_scale_get(void);
+
+void thermal_threshold_set(char sensor_name, int32_t sensor_value);
+
+#endif /* THERMAL_H__ */
@@ -0,0 +1,276 @@
+#include "thread_coap_observe.h"
+
+#include "nrf_assert.h"
+#include "sdk_config.h"
+#include "sensors.h"
+#include "settings.h"
+#include "thread_coap_utils.h"
+#include "thread_utils.h"
+
+#include "tinycbor/cbor.h"
+
+#include <string.h>
+
+#include <openthread/ip6.h>
+#include <openthread/platform/alarm-milli.h>
+
+#define OBSERVE_REGISTER       0
+#define OBSERVE_NONE           0xFFFFFFFF
+#define OBSERVE_SEQUENCE_MASK  0x00FFFFFF
+
+typedef struct coap_observer
+{
+	otIp6Address address;
+	uint16_t port;
+	uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+	uint8_t token_length;
+	int16_t sensor_index; // -1 for a free slot
+	int32_t sent_value;
+	uint32_t last_sent_at;
+	uint32_t con_sent_at;
+	bool con_pending; // the slot is kept until the confirmable notification is acknowledged or fails
+} coap_observer;
+
+static void observe_request_handler(void *, otMessage *, const otMessageInfo *);
+
+#define SENSOR_OBSERVE_RESOURCE(id, name, lname, ro, handler) \
+	[SENSOR_INDEX(id)] = { .mUriPath = "s/" #id, .mHandler = observe_request_handler, .mContext = (void *)(intptr_t)SENSOR_INDEX(id), .mNext = NULL, },
+
+static otCoapResource m_observe_resources[SENSORS_COUNT] = {
+	SENSOR_LIST(SENSOR_OBSERVE_RESOURCE)
+};
+
+static coap_observer m_observers[COAP_OBSERVERS_MAX];
+static uint32_t m_observe_sequence = 0;
+
+static uint32_t observe_option_get(otMessage *p_message)
+{
+	uint32_t observe;
+	if (!coap_message_uint_option_get(p_message, OT_COAP_OPTION_OBSERVE, &observe))
+		return OBSERVE_NONE;
+	return observe;
+}
+
+static coap_observer *observer_find(int16_t sensor_index, const otMessageInfo *p_message_info, const uint8_t *p_token, uint8_t token_length)
+{
+	for (int i = 0; i < COAP_OBSERVERS_MAX; i++) {
+		coap_observer *p_observer = &m_observers[i];
+		if (p_observer->sensor_index != sensor_index)
+			continue;
+		if (p_observer->port != p_message_info->mPeerPort || !otIp6IsAddressEqual(&p_observer->address, &p_message_info->mPeerAddr))
+			continue;
+		if (p_observer->token_length != token_length || memcmp(p_observer->token, p_token, token_length) != 0)
+			continue;
+		return p_observer;
+	}
+	return NULL;
+}
+
+/**@brief Finds a slot for a new observer, NULL when every slot waits for a confirmable notification. */
+static coap_observer *observer_allocate(void)
+{
+	coap_observer *p_oldest = NULL;
+	for (int i = 0; i < COAP_OBSERVERS_MAX; i++) {
+		if (m_observers[i].con_pending)
+			continue;
+		if (m_observers[i].sensor_index == -1)
+			return &m_observers[i];
+		if (p_oldest == NULL || (int32_t)(m_observers[i].last_sent_at - p_oldest->last_sent_at) < 0)
+			p_oldest = &m_observers[i];
+	}
+	// all slots are taken, the observer that was notified least recently makes room
+	return p_oldest;
+}
+
+/**@brief An observer that does not acknowledge a confirmable notification, or resets it, is gone
+ *        (RFC 7641 section 4.5).
+ */
+static void observer_con_response_handler(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info, otError result)
+{
+	coap_observer *p_observer = (coap_observer *)p_context;
+
+	p_observer->con_pending = false;
+	if (result != OT_ERROR_NONE)
+		p_observer->sensor_index = -1;
+}
+
+/**@brief Completes and sends a response or notification, a confirmable notification reports to p_observer. */
+static otError observe_message_send(otMessage *p_message, const otMessageInfo *p_message_info, uint32_t observe, int32_t sensor_value,
+	coap_observer *p_observer)
+{
+	otError error;
+	otInstance *p_instance = thread_ot_instance_get();
+
+	do {
+		if (observe != OBSERVE_NONE) {
+			error = otCoapMessageAppendObserveOption(p_message, observe);
+			if (error != OT_ERROR_NONE)
+				break;
+		}
+
+		error = otCoapMessageAppendContentFormatOption(p_message, OT_COAP_OPTION_CONTENT_FORMAT_CBOR);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapMessageSetPayloadMarker(p_message);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		uint8_t buff[16];
+		CborEncoder encoder;
+		cbor_encoder_init(&encoder, buff, sizeof(buff), 0);
+		if (cbor_encode_int(&encoder, sensor_value) != CborNoError) {
+			error = OT_ERROR_NO_BUFS;
+			break;
+		}
+
+		error = otMessageAppend(p_message, buff, cbor_encoder_get_buffer_size(&encoder, buff));
+		if (error != OT_ERROR_NONE)
+			break;
+
+		if (p_observer != NULL)
+			error = otCoapSendRequest(p_instance, p_message, p_message_info, observer_con_response_handler, p_observer);
+		else
+			error = otCoapSendResponse(p_instance, p_message, p_message_info);
+	} while (false);
+
+	return error;
+}
+
+static void observe_request_handler(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	int16_t sensor_index = (int16_t)(intptr_t)p_context;
+	otInstance *p_instance = thread_ot_instance_get();
+	otMessage *p_response = NULL;
+	otError error = OT_ERROR_NO_BUFS;
+
+	do {
+		if (otCoapMessageGetCode(p_message) != OT_COAP_CODE_GET)
+			break;
+
+		if ((sensor_initialized_mask & SENSOR_MASK(sensor_index)) == 0)
+			break;
+
+		const uint8_t *p_token = otCoapMessageGetToken(p_message);
+		uint8_t token_length = otCoapMessageGetTokenLength(p_message);
+		int32_t sensor_value = sensor_current_values[sensor_index];
+		uint32_t observe = observe_option_get(p_message);
+
+		coap_observer *p_observer = observer_find(sensor_index, p_message_info, p_token, token_length);
+
+		if (observe == OBSERVE_REGISTER && p_observer == NULL)
+			p_observer = observer_allocate();
+
+		if (observe == OBSERVE_REGISTER && p_observer != NULL) {
+			uint32_t time_now = otPlatAlarmMilliGetNow();
+
+			p_observer->sensor_index = sensor_index;
+			p_observer->address = p_message_info->mPeerAddr;
+			p_observer->port = p_message_info->mPeerPort;
+			memcpy(p_observer->token, p_token, token_length);
+			p_observer->token_length = token_length;
+			p_observer->sent_value = sensor_value;
+			p_observer->last_sent_at = time_now;
+			if (!p_observer->con_pending)
+				p_observer->con_sent_at = time_now;
+
+			observe = m_observe_sequence;
+			m_observe_sequence = (m_observe_sequence + 1) & OBSERVE_SEQUENCE_MASK;
+		} else {
+			// a deregistration, or no slot is free and the plain response tells the client so
+			if (p_observer != NULL)
+				p_observer->sensor_index = -1;
+			observe = OBSERVE_NONE;
+		}
+
+		p_response = otCoapNewMessage(p_instance, NULL);
+		if (p_response == NULL)
+			break;
+
+		error = coap_response_init(p_response, p_message, OT_COAP_CODE_CONTENT);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = observe_message_send(p_response, p_message_info, observe, sensor_value, NULL);
+	} while (false);
+
+	if (error != OT_ERROR_NONE && p_response != NULL)
+		otMessageFree(p_response);
+}
+
+static void observer_notify(coap_observer *p_observer, int32_t sensor_value, bool confirmable)
+{
+	otInstance *p_instance = thread_ot_instance_get();
+	otMessageInfo message_info;
+	otError error = OT_ERROR_NO_BUFS;
+
+	otMessage *p_notification = otCoapNewMessage(p_instance, NULL);
+	if (p_notification == NULL)
+		return;
+
+	do {
+		otCoapMessageInit(p_notification, confirmable ? OT_COAP_TYPE_CONFIRMABLE : OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
+
+		error = otCoapMessageSetToken(p_notification, p_observer->token, p_observer->token_length);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		memset(&message_info, 0, sizeof(message_info));
+		message_info.mPeerAddr = p_observer->address;
+		message_info.mPeerPort = p_observer->port;
+
+		error = observe_message_send(p_notification, &message_info, m_observe_sequence, sensor_value, confirmable ? p_observer : NULL);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		if (confirmable)
+			p_observer->con_pending = true;
+		m_observe_sequence = (m_observe_sequence + 1) & OBSERVE_SEQUENCE_MASK;
+	} while (false);
+
+	if (error != OT_ERROR_NONE)
+		otMessageFree(p_notification);
+}
+
+void thread_coap_observe_process(uint32_t time_now)
+{
+	for (int i = 0; i < COAP_OBSERVERS_MAX; i++) {
+		coap_observer *p_observer = &m_observers[i];
+		int16_t sensor_index = p_observer->sensor_index;
+		if (sensor_index == -1)
+			continue;
+
+		int32_t current_value = sensor_current_values[sensor_index];
+		// the values can be a full int32 range apart
+		int64_t change = (int64_t)current_value - p_observer->sent_value;
+		if (change < 0)
+			change = -change;
+
+		// RFC 7641 section 4.5, a confirmable notification now and then finds the observers that are gone
+		bool confirmable = !p_observer->con_pending && time_now - p_observer->con_sent_at >= COAP_OBSERVE_CON_INTERVAL;
+
+		if ((time_now - p_observer->last_sent_at <= (uint32_t)sensor_report_intervals[sensor_index] * SENSOR_REPORT_INTERVAL_UNIT) &&
+			(change <= sensor_reportable_changes[sensor_index]) && !confirmable)
+			continue;
+
+		p_observer->last_sent_at = time_now;
+		p_observer->sent_value = current_value;
+		if (confirmable)
+			p_observer->con_sent_at = time_now;
+
+		observer_notify(p_observer, current_value, confirmable);
+	}
+}
+
+void thread_coap_observe_init(otInstance *p_instance)
+{
+	for (int i = 0; i < COAP_OBSERVERS_MAX; i++) {
+		m_observers[i].sensor_index = -1;
+		m_observers[i].con_pending = false;
+	}
+
+	for (int i = 0; i < SENSORS_COUNT; i++) {
+		otError error = otCoapAddResource(p_instance, &m_observe_resources[i]);
+		ASSERT(error == OT_ERROR_NONE);
+	}
+}
@@ -0,0 +1,19 @@
+#ifndef THREAD_COAP_OBSERVE_H__
+#define THREAD_COAP_OBSERVE_H__
+
+#include <stdint.h>
+#include <openthread/coap.h>
+
+/**@brief CoAP Observe (RFC 7641) on the per-sensor resources "s/<sensor name>".
+ *
+ * @details Notifications follow the report_interval and reportable_change settings of each sensor. They
+ *          are non-confirmable, except one every COAP_OBSERVE_CON_INTERVAL, and an observer that does
+ *          not acknowledge it loses its slot.
+ */
+
+void thread_coap_observe_init(otInstance *p_instance);
+
+/**@brief Sends the pending notifications, called from the subscription timer. */
+void thread_coap_observe_process(uint32_t time_now);
+
+#endif /* THREAD_COAP_OBSERVE_H__ */
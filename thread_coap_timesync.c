@@ -0,0 +1,321 @@
+#include "thread_coap_timesync.h"
+
+#include "coap_payload.h"
+#include "nrf_assert.h"
+#include "settings.h"
+#include "thread_utils.h"
+
+#include "tinycbor/cbor.h"
+
+#include <string.h>
+
+#include <openthread/ip6.h>
+#include <openthread/link.h>
+#include <openthread/thread.h>
+#include <openthread/platform/alarm-milli.h>
+
+#define PPM 1000000
+
+_Static_assert(TIMESYNC_SED_SYNC_INTERVAL % TIMESYNC_BEACON_INTERVAL == 0, "the beacon window must fall on a beacon");
+
+static void timesync_request_handler(void *, otMessage *, const otMessageInfo *);
+
+static otCoapResource m_timesync_resource = { .mUriPath = "ts", .mHandler = timesync_request_handler, .mContext = NULL, .mNext = NULL, };
+
+static bool m_synced = false;
+static uint32_t m_anchor_local;    // local time of the last correction
+static uint32_t m_anchor_network;  // network time at m_anchor_local
+static int32_t m_skew_ppm = 0;     // network clock rate relative to the local one
+static uint32_t m_last_beacon_at;
+static bool m_window_open = false;
+static uint32_t m_window_at;        // local time the next beacon window of a sleepy end device opens
+static uint32_t m_window_opened_at;
+
+/**@brief Skew samples, oldest first, one per TIMESYNC_SKEW_SAMPLE_INTERVAL: the least delayed beacon
+ *        of that interval.
+ */
+static uint32_t m_samples_local[TIMESYNC_SKEW_SAMPLES];
+static uint32_t m_samples_network[TIMESYNC_SKEW_SAMPLES];
+static uint8_t m_samples_count = 0;
+static bool m_bucket_open = false;
+static uint32_t m_bucket_started_at;
+static uint32_t m_bucket_local;
+static uint32_t m_bucket_network;
+
+static uint32_t network_time_get(uint32_t local_time)
+{
+	int32_t elapsed = (int32_t)(local_time - m_anchor_local);
+	return m_anchor_network + elapsed + (int32_t)(((int64_t)elapsed * m_skew_ppm) / PPM);
+}
+
+/**@brief Skew as the median of the slopes between every pair of samples (Theil-Sen).
+ *
+ * @details A beacon is only ever delayed, so the least delayed one per sample interval is the closest to
+ *          the leader clock, and the minutes between samples divide the remaining jitter down. The
+ *          median drops the pairs that include an outlier.
+ */
+static void skew_update(void)
+{
+	int32_t slopes[TIMESYNC_SKEW_SAMPLES * (TIMESYNC_SKEW_SAMPLES - 1) / 2];
+	uint8_t count = 0;
+
+	for (uint8_t from = 0; from < m_samples_count; from++) {
+		for (uint8_t to = from + 1; to < m_samples_count; to++) {
+			int32_t local_elapsed = (int32_t)(m_samples_local[to] - m_samples_local[from]);
+			int32_t network_elapsed = (int32_t)(m_samples_network[to] - m_samples_network[from]);
+			int32_t slope = (int32_t)(((int64_t)(network_elapsed - local_elapsed) * PPM) / local_elapsed);
+
+			// insertion sort, a few dozen values
+			uint8_t i = count++;
+			for (; i > 0 && slopes[i - 1] > slope; i--)
+				slopes[i] = slopes[i - 1];
+			slopes[i] = slope;
+		}
+	}
+
+	int32_t skew = slopes[count / 2];
+	if (skew > TIMESYNC_SKEW_MAX)
+		skew = TIMESYNC_SKEW_MAX;
+	if (skew < -TIMESYNC_SKEW_MAX)
+		skew = -TIMESYNC_SKEW_MAX;
+	m_skew_ppm = skew;
+}
+
+static void sample_add(uint32_t local_time, uint32_t network_time)
+{
+	if (m_samples_count == TIMESYNC_SKEW_SAMPLES) {
+		memmove(&m_samples_local[0], &m_samples_local[1], sizeof(m_samples_local) - sizeof(m_samples_local[0]));
+		memmove(&m_samples_network[0], &m_samples_network[1], sizeof(m_samples_network) - sizeof(m_samples_network[0]));
+		m_samples_count--;
+	}
+
+	m_samples_local[m_samples_count] = local_time;
+	m_samples_network[m_samples_count] = network_time;
+	m_samples_count++;
+
+	if (m_samples_count >= TIMESYNC_SKEW_SAMPLES_MIN)
+		skew_update();
+}
+
+static void skew_beacon_add(uint32_t network_time, uint32_t time_now)
+{
+	if (m_bucket_open && time_now - m_bucket_started_at >= TIMESYNC_SKEW_SAMPLE_INTERVAL) {
+		sample_add(m_bucket_local, m_bucket_network);
+		m_bucket_open = false;
+	}
+
+	if (!m_bucket_open) {
+		m_bucket_open = true;
+		m_bucket_started_at = time_now;
+		m_bucket_local = time_now;
+		m_bucket_network = network_time;
+		return;
+	}
+
+	// the larger network minus local time is the beacon that spent the least time in flight
+	if ((int32_t)((network_time - time_now) - (m_bucket_network - m_bucket_local)) > 0) {
+		m_bucket_local = time_now;
+		m_bucket_network = network_time;
+	}
+}
+
+static void beacon_process(uint32_t network_time, uint32_t time_now)
+{
+	int32_t error = m_synced ? (int32_t)(network_time - network_time_get(time_now)) : 0;
+
+	if (!m_synced || error > TIMESYNC_STEP_MIN || error < -TIMESYNC_STEP_MIN) {
+		// first beacon or a new leader, step to its clock and start the skew estimate over
+		m_synced = true;
+		m_skew_ppm = 0;
+		m_anchor_local = time_now;
+		m_anchor_network = network_time;
+		m_samples_count = 0;
+		m_bucket_open = false;
+		skew_beacon_add(network_time, time_now);
+		return;
+	}
+
+	skew_beacon_add(network_time, time_now);
+
+	// half of the error is corrected per beacon, the latency jitter averages out
+	m_anchor_network = network_time_get(time_now) + error / 2;
+	m_anchor_local = time_now;
+}
+
+static void timesync_request_handler(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	otInstance *p_instance = thread_ot_instance_get();
+	uint32_t time_now = otPlatAlarmMilliGetNow();
+
+	do {
+		if (otCoapMessageGetType(p_message) != OT_COAP_TYPE_NON_CONFIRMABLE)
+			break;
+
+		if (otCoapMessageGetCode(p_message) != OT_COAP_CODE_POST)
+			break;
+
+		// the leader is the reference, and the only node whose beacons count
+		if (otThreadGetDeviceRole(p_instance) == OT_DEVICE_ROLE_LEADER)
+			break;
+
+		otIp6Address leader_rloc;
+		if (otThreadGetLeaderRloc(p_instance, &leader_rloc) != OT_ERROR_NONE)
+			break;
+		if (!otIp6IsAddressEqual(&leader_rloc, &p_message_info->mPeerAddr))
+			break;
+
+		uint8_t buff[16];
+
+		uint16_t body_len = otMessageGetLength(p_message) - otMessageGetOffset(p_message);
+
+		if (body_len > sizeof(buff))
+			break;
+
+		if (otMessageRead(p_message, otMessageGetOffset(p_message), buff, body_len) != body_len)
+			break;
+
+		uint32_t network_time;
+		if (!coap_payload_timesync_parse(buff, body_len, &network_time))
+			break;
+
+		if (!otThreadGetLinkMode(p_instance).mRxOnWhenIdle) {
+			// the first polls of the window fetch the beacons the parent queued since the last poll, all stale
+			if (!m_window_open || time_now - m_window_opened_at < 2 * TIMESYNC_SED_POLL_PERIOD)
+				break;
+
+			m_window_open = false;
+			// centred on a beacon, they are sent on a fixed schedule
+			m_window_at = time_now + TIMESYNC_SED_SYNC_INTERVAL - TIMESYNC_SED_WINDOW / 2;
+		}
+
+		beacon_process(network_time, time_now);
+	} while (false);
+}
+
+static void beacon_send(uint32_t network_time)
+{
+	otError       error = OT_ERROR_NONE;
+	otMessage   * p_request;
+	otMessageInfo message_info;
+	otInstance  * p_instance = thread_ot_instance_get();
+
+	do {
+		p_request = otCoapNewMessage(p_instance, NULL);
+		if (p_request == NULL)
+			break;
+
+		otCoapMessageInit(p_request, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_POST);
+
+		error = otCoapMessageAppendUriPathOptions(p_request, "ts");
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapMessageAppendContentFormatOption(p_request, OT_COAP_OPTION_CONTENT_FORMAT_CBOR);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapMessageSetPayloadMarker(p_request);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		uint8_t buff[16];
+		CborEncoder encoder;
+		CborEncoder encoderMap;
+		cbor_encoder_init(&encoder, buff, sizeof(buff), 0);
+		if (cbor_encoder_create_map(&encoder, &encoderMap, 1) != CborNoError ||
+			cbor_encode_text_stringz(&encoderMap, "t") != CborNoError ||
+			cbor_encode_uint(&encoderMap, network_time) != CborNoError ||
+			cbor_encoder_close_container(&encoder, &encoderMap) != CborNoError) {
+			error = OT_ERROR_NO_BUFS;
+			break;
+		}
+
+		error = otMessageAppend(p_request, buff, cbor_encoder_get_buffer_size(&encoder, buff));
+		if (error != OT_ERROR_NONE)
+			break;
+
+		memset(&message_info, 0, sizeof(message_info));
+		message_info.mPeerPort = OT_DEFAULT_COAP_PORT;
+		// sent from the RLOC, which the followers check against the leader RLOC
+		message_info.mSockAddr = *otThreadGetRloc(p_instance);
+
+		error = otIp6AddressFromString("ff03::1", &message_info.mPeerAddr);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapSendRequest(p_instance, p_request, &message_info, NULL, NULL);
+	} while (false);
+
+	if (error != OT_ERROR_NONE && p_request != NULL)
+		otMessageFree(p_request);
+}
+
+void thread_coap_timesync_process(uint32_t time_now)
+{
+	if (otThreadGetDeviceRole(thread_ot_instance_get()) != OT_DEVICE_ROLE_LEADER)
+		return;
+
+	if (!m_synced) {
+		// a leader that never heard a beacon starts the network time from its own clock
+		m_synced = true;
+		m_skew_ppm = 0;
+		m_anchor_local = time_now;
+		m_anchor_network = time_now;
+	}
+
+	if (time_now - m_last_beacon_at < TIMESYNC_BEACON_INTERVAL)
+		return;
+
+	// a fixed schedule, a sleepy end device opens its beacon window a whole number of intervals ahead
+	m_last_beacon_at += TIMESYNC_BEACON_INTERVAL;
+	if (time_now - m_last_beacon_at >= TIMESYNC_BEACON_INTERVAL)
+		m_last_beacon_at = time_now;
+	// a new leader carries on with the time it tracked as a follower
+	beacon_send(network_time_get(time_now));
+}
+
+uint32_t thread_coap_timesync_poll_period_get(uint32_t time_now)
+{
+	if (otThreadGetLinkMode(thread_ot_instance_get()).mRxOnWhenIdle)
+		return 0;
+
+	if (!m_window_open) {
+		if ((int32_t)(time_now - m_window_at) < 0)
+			return 0;
+		m_window_open = true;
+		m_window_opened_at = time_now;
+	}
+
+	uint32_t window = m_synced ? TIMESYNC_SED_WINDOW : TIMESYNC_BEACON_INTERVAL + TIMESYNC_SED_WINDOW;
+	if (time_now - m_window_opened_at >= window) {
+		// no beacon, the leader may be gone, try again at the next sync interval
+		m_window_open = false;
+		m_window_at = m_window_opened_at + TIMESYNC_SED_SYNC_INTERVAL;
+		return 0;
+	}
+
+	return TIMESYNC_SED_POLL_PERIOD;
+}
+
+bool thread_coap_timesync_local_time_get(uint32_t network_time, uint32_t *p_local_time)
+{
+	if (!m_synced)
+		return false;
+
+	int32_t delta = (int32_t)(network_time - m_anchor_network);
+	*p_local_time = m_anchor_local + (int32_t)(((int64_t)delta * PPM) / (PPM + m_skew_ppm));
+	return true;
+}
+
+void thread_coap_timesync_init(otInstance *p_instance)
+{
+	m_synced = false;
+	m_last_beacon_at = otPlatAlarmMilliGetNow() - TIMESYNC_BEACON_INTERVAL;
+	m_window_open = false;
+	m_window_at = otPlatAlarmMilliGetNow();
+
+	m_timesync_resource.mContext = p_instance;
+
+	otError error = otCoapAddResource(p_instance, &m_timesync_resource);
+	ASSERT(error == OT_ERROR_NONE);
+}
@@ -0,0 +1,36 @@
+#ifndef THREAD_COAP_TIMESYNC_H__
+#define THREAD_COAP_TIMESYNC_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <openthread/coap.h>
+
+/**@brief Network time: the partition leader multicasts its clock on "ts", the other nodes track its offset and skew.
+ *
+ * @details Network time is in milliseconds, like otPlatAlarmMilliGetNow(). The one-way beacon latency is not
+ *          measured, it is about the same for all nodes in radio range of each other.
+ */
+
+void thread_coap_timesync_init(otInstance *p_instance);
+
+/**@brief Sends a beacon when one is due and this node is the leader, called from the subscription timer. */
+void thread_coap_timesync_process(uint32_t time_now);
+
+/**@brief Poll period a sleepy end device needs now to take a beacon fresh.
+ *
+ * @details The parent queues the beacons for a sleepy end device until its next poll, so they arrive up to a
+ *          poll period late. Every TIMESYNC_SED_SYNC_INTERVAL the device polls at TIMESYNC_SED_POLL_PERIOD
+ *          for TIMESYNC_SED_WINDOW around the expected beacon, and only a beacon received in that window is
+ *          taken. Before the first beacon the window spans a whole beacon interval.
+ *
+ * @return the poll period in milliseconds, or 0 outside of a window and on a node that keeps its receiver on.
+ */
+uint32_t thread_coap_timesync_poll_period_get(uint32_t time_now);
+
+/**@brief Converts a network time to the local clock.
+ *
+ * @return false until a beacon was received or this node became the leader.
+ */
+bool thread_coap_timesync_local_time_get(uint32_t network_time, uint32_t *p_local_time);
+
+#endif /* THREAD_COAP_TIMESYNC_H__ */
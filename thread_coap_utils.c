@@ -41,10 +41,19 @@
 #include "thread_coap_utils.h"
 
 #include "app_timer.h"
+#include "backoff.h"
 #include "bsp_thread.h"
+#include "coap_payload.h"
+#include "colour.h"
+#include "dimmer.h"
+#include "effect.h"
 #include "nrf_assert.h"
 #include "sdk_config.h"
+#include "thread_coap_observe.h"
+#include "thread_coap_timesync.h"
+#include "thread_router_policy.h"
 #include "thread_utils.h"
+#include "wakeup.h"
 
 #include "settings.h"
 
@@ -53,10 +62,18 @@
 #include <openthread/ip6.h>
 #include <openthread/link.h>
 #include <openthread/thread.h>
+#include <openthread/udp.h>
 #include <openthread/icmp6.h>
+#include <openthread/random_noncrypto.h>
 #include <openthread/platform/alarm-milli.h>
 #include <openthread/platform/misc.h>
 
+#define CBOR_INDEFINITE_ARRAY  0x9F
+#define CBOR_INDEFINITE_MAP    0xBF
+#define CBOR_BREAK             0xFF
+
+_Static_assert(sizeof(otIp6Address) == COAP_PAYLOAD_ADDRESS_SIZE, "COAP_PAYLOAD_ADDRESS_SIZE does not match otIp6Address");
+
 APP_TIMER_DEF(m_led_send_timer);
 APP_TIMER_DEF(m_led_recv_timer);
 APP_TIMER_DEF(m_boot_timer);
@@ -98,137 +115,106 @@ static void icmp_receive_callback(void                * p_context,
 	}
 }
 
-static uint32_t m_poll_period = 0;
+static uint32_t m_poll_period = DEFAULT_POLL_PERIOD;
+static uint32_t m_report_window_at = 0;
 
 static void boot_request_handler(void *, otMessage *, const otMessageInfo *);
 static void info_request_handler(void *, otMessage *, const otMessageInfo *);
 static void set_request_handler(void *, otMessage *, const otMessageInfo *);
 static void get_request_handler(void *, otMessage *, const otMessageInfo *);
 static void sub_request_handler(void *, otMessage *, const otMessageInfo *);
+static void fx_request_handler(void *, otMessage *, const otMessageInfo *);
+static void stats_request_handler(void *, otMessage *, const otMessageInfo *);
 
 static otCoapResource m_boot_resource = { .mUriPath = "boot", .mHandler = boot_request_handler, .mContext = NULL, .mNext = NULL, };
 static otCoapResource m_info_resource = { .mUriPath = "info", .mHandler = info_request_handler, .mContext = NULL, .mNext = NULL, };
 static otCoapResource m_set_resource = { .mUriPath = "set", .mHandler = set_request_handler, .mContext = NULL, .mNext = NULL, };
 static otCoapResource m_get_resource = { .mUriPath = "get", .mHandler = get_request_handler, .mContext = NULL, .mNext = NULL, };
 static otCoapResource m_sub_resource = { .mUriPath = "sub", .mHandler = sub_request_handler, .mContext = NULL, .mNext = NULL, };
-
-APP_TIMER_DEF(m_subscription_timer);
+static otCoapResource m_fx_resource = { .mUriPath = "fx", .mHandler = fx_request_handler, .mContext = NULL, .mNext = NULL, };
+static otCoapResource m_stats_resource = { .mUriPath = "stats", .mHandler = stats_request_handler, .mContext = NULL, .mNext = NULL, };
 
 static subscription_settings_data subscription_settings = {
 	.subscription_address = {0},
-	.subscription_interval = 1000,
-	.last_sent_at = 0,
+	.subscription_interval = SUBSCRIPTION_BROADCAST_INTERVAL_MIN,
+	.next_broadcast_at = 0,
 };
 
-extern sensor_subscription sensor_subscriptions[];
-
-bool set_sensor_value(char sensor_name, int64_t sensor_value, bool external_request)
+/**@brief Adaptive poll period of a sleepy end device.
+ *
+ * @details Traffic switches to DEFAULT_POLL_PERIOD_FAST for DEFAULT_POLL_PERIOD_FAST_TIMEOUT, after that the
+ *          period doubles every POLL_PERIOD_BACKOFF_POLLS polls until it is back at DEFAULT_POLL_PERIOD.
+ *          A time beacon window polls faster still. A node that keeps its receiver on is left alone.
+ */
+static void poll_period_apply(uint32_t time_now)
 {
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		if (sensor_subscriptions[i].sensor_name == sensor_name) {
-			sensor_subscriptions[i].initialized = true;
-			if (external_request) {
-				sensor_subscriptions[i].sent_value = sensor_value;
-				sensor_subscriptions[i].current_value = sensor_value;
-				if (sensor_subscriptions[i].set_value_handler)
-					sensor_subscriptions[i].set_value_handler(sensor_name, sensor_value);
-			} else {
-				sensor_subscriptions[i].current_value = sensor_value;
-			}
-			return true;
-		}
-	}
-	return false;
-}
+	otInstance * p_instance = thread_ot_instance_get();
 
-bool get_sensor_value(char sensor_name, int64_t *p_sensor_value)
-{
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		if (sensor_subscriptions[i].sensor_name == sensor_name) {
-			if (sensor_subscriptions[i].initialized == false)
-				return false;
-			*p_sensor_value = sensor_subscriptions[i].current_value;
-			return true;
-		}
-	}
-	return false;
-}
+	if (otThreadGetLinkMode(p_instance).mRxOnWhenIdle)
+		return;
 
-bool is_sensor_readonly(char sensor_name)
-{
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		if (sensor_subscriptions[i].sensor_name == sensor_name) {
-			return sensor_subscriptions[i].read_only;
-		}
-	}
-	return true;
-}
+	uint32_t poll_period = m_poll_period;
+	uint32_t timesync_poll_period = thread_coap_timesync_poll_period_get(time_now);
+	if (timesync_poll_period != 0 && timesync_poll_period < poll_period)
+		poll_period = timesync_poll_period;
 
-int16_t get_sensor_index(char sensor_name)
-{
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		if (sensor_subscriptions[i].sensor_name == sensor_name) {
-			return i;
-		}
-	}
-	return -1;
+	if (poll_period == otLinkGetPollPeriod(p_instance))
+		return;
+
+	otError error = otLinkSetPollPeriod(p_instance, poll_period);
+	ASSERT(error == OT_ERROR_NONE);
 }
 
-static uint32_t poll_period_fast_set(void)
+static void poll_period_fast_set(void)
 {
-	uint32_t     error;
-	otError      ot_error;
 	otInstance * p_instance = thread_ot_instance_get();
 
-	do {
-		if (otThreadGetLinkMode(p_instance).mRxOnWhenIdle) {
-			error = NRF_ERROR_INVALID_STATE;
-			break;
-		}
-
-		if (!m_poll_period) {
-			m_poll_period = otLinkGetPollPeriod(p_instance);
-
-			ot_error = otLinkSetPollPeriod(p_instance, DEFAULT_POLL_PERIOD_FAST);
-			ASSERT(ot_error == OT_ERROR_NONE);
-
-			error = NRF_SUCCESS;
+	if (otThreadGetLinkMode(p_instance).mRxOnWhenIdle)
+		return;
 
-			app_timer_start(m_poll_period_fast_timer, APP_TIMER_TICKS(DEFAULT_POLL_PERIOD_FAST_TIMEOUT), NULL);
-		} else {
-			error = NRF_ERROR_BUSY;
-		}
-	} while (false);
+	if (m_poll_period != DEFAULT_POLL_PERIOD_FAST) {
+		m_poll_period = DEFAULT_POLL_PERIOD_FAST;
+		poll_period_apply(otPlatAlarmMilliGetNow());
+	}
 
-	return error;
+	app_timer_stop(m_poll_period_fast_timer);
+	app_timer_start(m_poll_period_fast_timer, APP_TIMER_TICKS(DEFAULT_POLL_PERIOD_FAST_TIMEOUT), NULL);
 }
 
-static void poll_period_restore(void)
+static void poll_period_fast_timer_handler(void * p_context)
 {
-	otError      error;
+	UNUSED_PARAMETER(p_context);
+
 	otInstance * p_instance = thread_ot_instance_get();
 
-	do {
-		if (otThreadGetLinkMode(p_instance).mRxOnWhenIdle) {
-			break;
-		}
+	if (otThreadGetLinkMode(p_instance).mRxOnWhenIdle)
+		return;
 
-		if (m_poll_period) {
-			error = otLinkSetPollPeriod(p_instance, m_poll_period);
-			ASSERT(error == OT_ERROR_NONE);
+	m_poll_period *= 2;
+	if (m_poll_period >= DEFAULT_POLL_PERIOD)
+		m_poll_period = DEFAULT_POLL_PERIOD;
 
-			m_poll_period = 0;
+	poll_period_apply(otPlatAlarmMilliGetNow());
 
-			app_timer_stop(m_poll_period_fast_timer);
-		}
-	} while (false);
+	if (m_poll_period < DEFAULT_POLL_PERIOD)
+		app_timer_start(m_poll_period_fast_timer, APP_TIMER_TICKS(m_poll_period * POLL_PERIOD_BACKOFF_POLLS), NULL);
 }
 
-static void poll_period_fast_timer_handler(void * p_context)
+/**@brief A sleepy end device sends its reports once per poll period, so the changes of a period go out
+ *        together instead of waking the radio for each of them.
+ */
+static bool report_window_open(uint32_t time_now)
 {
-	UNUSED_PARAMETER(p_context);
+	otInstance * p_instance = thread_ot_instance_get();
+
+	if (otThreadGetLinkMode(p_instance).mRxOnWhenIdle)
+		return true;
+
+	if (time_now - m_report_window_at < otLinkGetPollPeriod(p_instance))
+		return false;
 
-	poll_period_restore();
+	m_report_window_at = time_now;
+	return true;
 }
 
 static void coap_default_handler(void * p_context, otMessage * p_message, const otMessageInfo * p_message_info)
@@ -262,6 +248,14 @@ static void boot_timer_handler(void * p_context)
 	NVIC_SystemReset();
 }
 
+otError coap_response_init(otMessage *p_response, const otMessage *p_request, otCoapCode code)
+{
+	// a confirmable request gets its response piggybacked on the ACK
+	otCoapType type = otCoapMessageGetType(p_request) == OT_COAP_TYPE_CONFIRMABLE ? OT_COAP_TYPE_ACKNOWLEDGMENT : OT_COAP_TYPE_NON_CONFIRMABLE;
+
+	return otCoapMessageInitResponse(p_response, p_request, type, code);
+}
+
 static otError boot_response_send(otMessage * p_request_message, const otMessageInfo * p_message_info)
 {
 	otError error = OT_ERROR_NO_BUFS;
@@ -273,9 +267,7 @@ static otError boot_response_send(otMessage * p_request_message, const otMessage
 		if (p_response == NULL)
 			break;
 
-		otCoapMessageInit(p_response, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
-
-		error = otCoapMessageSetToken(p_response, otCoapMessageGetToken(p_request_message), otCoapMessageGetTokenLength(p_request_message));
+		error = coap_response_init(p_response, p_request_message, OT_COAP_CODE_CONTENT);
 		if (error != OT_ERROR_NONE)
 			break;
 
@@ -308,91 +300,146 @@ static void boot_request_handler(void * p_context, otMessage * p_message, const
 	}
 }
 
-size_t fill_info_packet(uint8_t *pBuffer, size_t stBufferSize)
+bool coap_message_uint_option_get(const otMessage *p_message, uint16_t option_number, uint32_t *p_value)
 {
-	CborEncoder encoder;
-	CborError cborError = CborNoError;
-
-	cbor_encoder_init(&encoder, pBuffer, stBufferSize, 0);
+	otCoapOptionIterator iterator;
+	if (otCoapOptionIteratorInit(&iterator, p_message) != OT_ERROR_NONE)
+		return false;
 
-	CborEncoder encoderMap;
-
-	cborError = cbor_encoder_create_map(&encoder, &encoderMap, CborIndefiniteLength);
-	if (cborError != CborNoError)
-		return 0;
-
-	cborError = cbor_encode_map_set_stringz(&encoderMap, "t", INFO_FIRMWARE_TYPE);
-	if (cborError != CborNoError)
-		return 0;
+	const otCoapOption *p_option = otCoapOptionIteratorGetFirstOptionMatching(&iterator, option_number);
+	if (p_option == NULL || p_option->mLength > sizeof(uint32_t))
+		return false;
 
-	cborError = cbor_encode_map_set_stringz(&encoderMap, "v", INFO_FIRMWARE_VERSION);
-	if (cborError != CborNoError)
-		return 0;
+	uint8_t value[sizeof(uint32_t)];
+	if (otCoapOptionIteratorGetOptionValue(&iterator, value) != OT_ERROR_NONE)
+		return false;
 
-	cborError = cbor_encode_map_set_int(&encoderMap, "r", otPlatGetResetReason(thread_ot_instance_get()));
-	if (cborError != CborNoError)
-		return 0;
+	*p_value = 0;
+	for (int i = 0; i < p_option->mLength; i++) {
+		*p_value = (*p_value << 8) | value[i];
+	}
+	return true;
+}
 
-	uint8_t macAddr[8];
-	otPlatRadioGetIeeeEui64(thread_ot_instance_get(), macAddr);
+/**@brief Payload writer that keeps only the bytes inside the [offset, offset + size) window.
+ *
+ * @details Content is produced item by item into a small scratch encoder, so a block is
+ *          generated without materialising the whole payload. With p_message set to NULL
+ *          the writer only counts the payload length.
+ */
+typedef struct block_writer
+{
+	otMessage *p_message;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t position;
+	otError error;
+	CborEncoder encoder;
+	uint8_t scratch[BLOCK_WRITER_SCRATCH_SIZE];
+} block_writer;
 
-	cborError = cbor_encode_text_stringz(&encoderMap, "m");
-	if (cborError != CborNoError)
-		return 0;
-	cborError = cbor_encode_byte_string(&encoderMap, macAddr, sizeof(macAddr));
-	if (cborError != CborNoError)
-		return 0;
+typedef void (*block_content_writer_t)(block_writer *p_writer, const void *p_context);
 
-	cborError = cbor_encode_text_stringz(&encoderMap, "e");
-	if (cborError != CborNoError)
-		return 0;
-	cborError = cbor_encode_byte_string(&encoderMap, (const uint8_t *)otLinkGetExtendedAddress(thread_ot_instance_get()), sizeof(otExtAddress));
-	if (cborError != CborNoError)
-		return 0;
+static void block_writer_init(block_writer *p_writer, otMessage *p_message, uint32_t offset, uint32_t size)
+{
+	p_writer->p_message = p_message;
+	p_writer->offset = offset;
+	p_writer->size = size;
+	p_writer->position = 0;
+	p_writer->error = OT_ERROR_NONE;
+	cbor_encoder_init(&p_writer->encoder, p_writer->scratch, sizeof(p_writer->scratch), 0);
+}
 
-	cborError = cbor_encode_text_stringz(&encoderMap, "a");
-	if (cborError != CborNoError)
-		return 0;
-	cborError = cbor_encode_byte_string(&encoderMap, (const uint8_t *)otThreadGetMeshLocalEid(thread_ot_instance_get()), sizeof(otIp6Address));
-	if (cborError != CborNoError)
-		return 0;
+static void block_writer_append(block_writer *p_writer, const uint8_t *p_data, uint32_t length)
+{
+	uint32_t start = p_writer->position;
+	uint32_t end = start + length;
+	uint32_t window_end = p_writer->offset + p_writer->size;
 
-	cborError = cbor_encode_text_stringz(&encoderMap, "s");
-	CborEncoder encoderArr;
+	p_writer->position = end;
 
-	cborError = cbor_encoder_create_array(&encoderMap, &encoderArr, CborIndefiniteLength);
-	if (cborError != CborNoError)
-		return 0;
+	if (p_writer->p_message == NULL || p_writer->error != OT_ERROR_NONE)
+		return;
+	if (end <= p_writer->offset || start >= window_end)
+		return;
 
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		cbor_encode_text_string(&encoderArr, &sensor_subscriptions[i].sensor_name, 1);
+	if (start < p_writer->offset) {
+		p_data += p_writer->offset - start;
+		start = p_writer->offset;
 	}
+	if (end > window_end)
+		end = window_end;
 
-	cborError = cbor_encoder_close_container(&encoderMap, &encoderArr);
-	if (cborError != CborNoError)
-		return 0;
+	p_writer->error = otMessageAppend(p_writer->p_message, p_data, (uint16_t)(end - start));
+}
 
-	cborError = cbor_encoder_close_container(&encoder, &encoderMap);
-	if (cborError != CborNoError)
-		return 0;
+/**@brief Moves the items encoded into p_writer->encoder to the payload. */
+static void block_writer_flush(block_writer *p_writer)
+{
+	if (cbor_encoder_get_extra_bytes_needed(&p_writer->encoder) != 0)
+		p_writer->error = OT_ERROR_NO_BUFS;
+	else
+		block_writer_append(p_writer, p_writer->scratch, cbor_encoder_get_buffer_size(&p_writer->encoder, p_writer->scratch));
 
-	return cbor_encoder_get_buffer_size(&encoder, pBuffer);
+	cbor_encoder_init(&p_writer->encoder, p_writer->scratch, sizeof(p_writer->scratch), 0);
 }
 
-static otError info_response_send(otMessage * p_request_message, const otMessageInfo * p_message_info)
+static void block_writer_put_byte(block_writer *p_writer, uint8_t value)
+{
+	block_writer_append(p_writer, &value, 1);
+}
+
+/**@brief Sends a CONTENT response, split into Block2 blocks when it does not fit in one message. */
+static otError block_response_send(otMessage *p_request_message, const otMessageInfo *p_message_info, block_content_writer_t content_writer, const void *p_context)
 {
 	otError error = OT_ERROR_NO_BUFS;
-	otMessage * p_response;
-	otInstance * p_instance = thread_ot_instance_get();
+	otMessage *p_response = NULL;
+	otInstance *p_instance = thread_ot_instance_get();
+	block_writer writer;
 
 	do {
+		uint32_t block2;
+		bool block_requested = coap_message_uint_option_get(p_request_message, OT_COAP_OPTION_BLOCK2, &block2);
+		uint32_t block_number = 0;
+		uint32_t block_szx = COAP_BLOCK_SZX;
+
+		if (block_requested) {
+			block_number = block2 >> 4;
+			if ((block2 & 0x07) < block_szx)
+				block_szx = block2 & 0x07;
+		}
+
+		uint32_t block_size = 16 << block_szx;
+
+		block_writer_init(&writer, NULL, 0, 0);
+		content_writer(&writer, p_context);
+		if (writer.error != OT_ERROR_NONE)
+			break;
+
+		uint32_t payload_size = writer.position;
+		bool blockwise = block_requested || payload_size > COAP_BLOCK_UNFRAGMENTED_MAX;
+		if (!blockwise)
+			block_size = payload_size;
+
+		// a Block2 number takes up to 20 bits, check it against the block count before it is multiplied
+		uint32_t blocks = blockwise ? (payload_size + block_size - 1) / block_size : 1;
+		bool out_of_range = block_number != 0 && block_number >= blocks;
+		uint32_t offset = out_of_range ? 0 : block_number * block_size;
+		bool more = offset + block_size < payload_size;
+
 		p_response = otCoapNewMessage(p_instance, NULL);
 		if (p_response == NULL)
 			break;
 
-		otCoapMessageInit(p_response, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
+		if (out_of_range) {
+			error = coap_response_init(p_response, p_request_message, OT_COAP_CODE_BAD_REQUEST);
+			if (error != OT_ERROR_NONE)
+				break;
+			error = otCoapSendResponse(p_instance, p_response, p_message_info);
+			break;
+		}
 
-		error = otCoapMessageSetToken(p_response, otCoapMessageGetToken(p_request_message), otCoapMessageGetTokenLength(p_request_message));
+		error = coap_response_init(p_response, p_request_message, OT_COAP_CODE_CONTENT);
 		if (error != OT_ERROR_NONE)
 			break;
 
@@ -400,22 +447,23 @@ static otError info_response_send(otMessage * p_request_message, const otMessage
 		if (error != OT_ERROR_NONE)
 			break;
 
+		if (blockwise) {
+			error = otCoapMessageAppendUintOption(p_response, OT_COAP_OPTION_BLOCK2, (block_number << 4) | (more ? 0x08 : 0) | block_szx);
+			if (error != OT_ERROR_NONE)
+				break;
+		}
+
 		error = otCoapMessageSetPayloadMarker(p_response);
 		if (error != OT_ERROR_NONE)
 			break;
 
-		uint8_t buff[256];
-
-		size_t packet_len = fill_info_packet(buff, sizeof(buff));
-		if (packet_len == 0)
-			break;
-
-		error = otMessageAppend(p_response, buff, packet_len);
+		block_writer_init(&writer, p_response, offset, block_size);
+		content_writer(&writer, p_context);
+		error = writer.error;
 		if (error != OT_ERROR_NONE)
 			break;
 
 		error = otCoapSendResponse(p_instance, p_response, p_message_info);
-
 	} while (false);
 
 	if (error != OT_ERROR_NONE && p_response != NULL)
@@ -424,6 +472,102 @@ static otError info_response_send(otMessage * p_request_message, const otMessage
 	return error;
 }
 
+// sizeof counts the terminator, the same byte count as the CBOR head of a name shorter than 24
+#define INFO_LONG_NAME_SIZE(id, name, lname, read_only, handler) + sizeof(lname)
+
+_Static_assert(SENSOR_LONG_NAME_MAX < 24, "INFO_PACKET_SIZE assumes one byte text string heads");
+
+/**@brief Largest /info payload: the map head and break, the eight one-character keys (t, v, r, m, e,
+ *        a, s, n), "t" and "v", "r" as a uint32, "m", "e" and "a" as byte strings, then the "s" and
+ *        "n" arrays over SENSOR_LIST.
+ */
+#define INFO_PACKET_SIZE (2 + 8 * 2 + sizeof(INFO_FIRMWARE_TYPE) + sizeof(INFO_FIRMWARE_VERSION) + 5 + \
+	(1 + 8) + (1 + sizeof(otExtAddress)) + (1 + sizeof(otIp6Address)) + \
+	2 + SENSORS_COUNT * 2 + 2 + (0 SENSOR_LIST(INFO_LONG_NAME_SIZE)))
+
+static uint8_t m_info_packet[INFO_PACKET_SIZE];
+static size_t m_info_packet_size = 0;
+
+static size_t fill_info_packet(uint8_t *pBuffer, size_t stBufferSize)
+{
+	CborEncoder encoder;
+	cbor_encoder_init(&encoder, pBuffer, stBufferSize, 0);
+
+	CborEncoder encoderMap;
+	CborError cborError = cbor_encoder_create_map(&encoder, &encoderMap, CborIndefiniteLength);
+	if (cborError != CborNoError)
+		return 0;
+
+	cbor_encode_map_set_stringz(&encoderMap, "t", INFO_FIRMWARE_TYPE);
+	cbor_encode_map_set_stringz(&encoderMap, "v", INFO_FIRMWARE_VERSION);
+	cbor_encode_map_set_int(&encoderMap, "r", otPlatGetResetReason(thread_ot_instance_get()));
+
+	uint8_t macAddr[8];
+	otPlatRadioGetIeeeEui64(thread_ot_instance_get(), macAddr);
+
+	cbor_encode_text_stringz(&encoderMap, "m");
+	cbor_encode_byte_string(&encoderMap, macAddr, sizeof(macAddr));
+	cbor_encode_text_stringz(&encoderMap, "e");
+	cbor_encode_byte_string(&encoderMap, (const uint8_t *)otLinkGetExtendedAddress(thread_ot_instance_get()), sizeof(otExtAddress));
+	cbor_encode_text_stringz(&encoderMap, "a");
+	cbor_encode_byte_string(&encoderMap, (const uint8_t *)otThreadGetMeshLocalEid(thread_ot_instance_get()), sizeof(otIp6Address));
+
+	cbor_encode_text_stringz(&encoderMap, "s");
+	CborEncoder encoderArray;
+	cborError = cbor_encoder_create_array(&encoderMap, &encoderArray, CborIndefiniteLength);
+	if (cborError != CborNoError)
+		return 0;
+
+	for (int i = 0; i < SENSORS_COUNT; i++) {
+		cbor_encode_text_string(&encoderArray, &sensor_descriptors[i].sensor_name, 1);
+	}
+
+	cborError = cbor_encoder_close_container(&encoderMap, &encoderArray);
+	if (cborError != CborNoError)
+		return 0;
+
+	cbor_encode_text_stringz(&encoderMap, "n");
+	cborError = cbor_encoder_create_array(&encoderMap, &encoderArray, CborIndefiniteLength);
+	if (cborError != CborNoError)
+		return 0;
+
+	for (int i = 0; i < SENSORS_COUNT; i++) {
+		cbor_encode_text_stringz(&encoderArray, sensor_descriptors[i].long_name);
+	}
+
+	cborError = cbor_encoder_close_container(&encoderMap, &encoderArray);
+	if (cborError != CborNoError)
+		return 0;
+
+	cborError = cbor_encoder_close_container(&encoder, &encoderMap);
+	if (cborError != CborNoError)
+		return 0;
+
+	return cbor_encoder_get_buffer_size(&encoder, pBuffer);
+}
+
+/**@brief Appends the /info payload, re-encoded only after a state change invalidated the cache. */
+static void write_info_packet(block_writer *p_writer, const void *p_context)
+{
+	UNUSED_PARAMETER(p_context);
+
+	if (m_info_packet_size == 0)
+		m_info_packet_size = fill_info_packet(m_info_packet, sizeof(m_info_packet));
+
+	if (m_info_packet_size == 0) {
+		p_writer->error = OT_ERROR_NO_BUFS;
+		return;
+	}
+
+	block_writer_append(p_writer, m_info_packet, m_info_packet_size);
+}
+
+void thread_coap_utils_state_changed(uint32_t flags)
+{
+	if (flags & (OT_CHANGED_THREAD_ROLE | OT_CHANGED_THREAD_ML_ADDR | OT_CHANGED_IP6_ADDRESS_ADDED | OT_CHANGED_IP6_ADDRESS_REMOVED))
+		m_info_packet_size = 0;
+}
+
 static void info_request_handler(void * p_context, otMessage * p_message, const otMessageInfo * p_message_info)
 {
 	UNUSED_PARAMETER(p_message);
@@ -435,12 +579,114 @@ static void info_request_handler(void * p_context, otMessage * p_message, const
 		message_info = *p_message_info;
 		memset(&message_info.mSockAddr, 0, sizeof(message_info.mSockAddr));
 
-		error = info_response_send(p_message, &message_info);
+		error = block_response_send(p_message, &message_info, write_info_packet, NULL);
 		if (error == OT_ERROR_NONE) {
 		}
 	}
 }
 
+/**@brief Recently answered /set requests, so that a retransmission gets the same response
+ *        instead of applying the values again.
+ */
+typedef struct coap_dedup_entry
+{
+	otIp6Address peer_address;
+	uint16_t peer_port;
+	uint16_t message_id;
+	uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+	uint8_t token_length;
+	bool valid;
+	uint32_t used_at;
+	uint8_t response_size;
+	uint8_t response[SET_RESPONSE_SIZE_MAX];
+} coap_dedup_entry;
+
+_Static_assert(SET_RESPONSE_SIZE_MAX <= UINT8_MAX, "coap_dedup_entry.response_size is a uint8_t");
+
+static coap_dedup_entry m_dedup_cache[COAP_DEDUP_CACHE_SIZE];
+
+static bool dedup_entry_matches(const coap_dedup_entry *p_entry, const otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	uint8_t token_length = otCoapMessageGetTokenLength(p_message);
+
+	if (!p_entry->valid)
+		return false;
+	if (p_entry->message_id != otCoapMessageGetMessageId(p_message) || p_entry->peer_port != p_message_info->mPeerPort)
+		return false;
+	if (p_entry->token_length != token_length || memcmp(p_entry->token, otCoapMessageGetToken(p_message), token_length) != 0)
+		return false;
+	return otIp6IsAddressEqual(&p_entry->peer_address, &p_message_info->mPeerAddr);
+}
+
+static coap_dedup_entry *dedup_cache_find(const otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	uint32_t time_now = otPlatAlarmMilliGetNow();
+
+	for (int i = 0; i < COAP_DEDUP_CACHE_SIZE; i++) {
+		coap_dedup_entry *p_entry = &m_dedup_cache[i];
+		if (p_entry->valid && time_now - p_entry->used_at > COAP_DEDUP_LIFETIME)
+			p_entry->valid = false;
+		if (dedup_entry_matches(p_entry, p_message, p_message_info)) {
+			p_entry->used_at = time_now;
+			return p_entry;
+		}
+	}
+	return NULL;
+}
+
+static void dedup_cache_store(const otMessage *p_message, const otMessageInfo *p_message_info, const uint8_t *p_response, size_t response_size)
+{
+	// a retry must get the same response, one that is not stored whole is not stored at all
+	if (response_size > SET_RESPONSE_SIZE_MAX)
+		return;
+
+	coap_dedup_entry *p_entry = &m_dedup_cache[0];
+	for (int i = 0; i < COAP_DEDUP_CACHE_SIZE; i++) {
+		if (!m_dedup_cache[i].valid) {
+			p_entry = &m_dedup_cache[i];
+			break;
+		}
+		if ((int32_t)(m_dedup_cache[i].used_at - p_entry->used_at) < 0)
+			p_entry = &m_dedup_cache[i];
+	}
+
+	p_entry->peer_address = p_message_info->mPeerAddr;
+	p_entry->peer_port = p_message_info->mPeerPort;
+	p_entry->message_id = otCoapMessageGetMessageId(p_message);
+	p_entry->token_length = otCoapMessageGetTokenLength(p_message);
+	memcpy(p_entry->token, otCoapMessageGetToken(p_message), p_entry->token_length);
+	p_entry->used_at = otPlatAlarmMilliGetNow();
+	p_entry->valid = true;
+
+	memcpy(p_entry->response, p_response, response_size);
+	p_entry->response_size = (uint8_t)response_size;
+}
+
+/**@brief Answers a confirmable request with a bare response code. */
+static void code_response_send(otMessage *p_request_message, const otMessageInfo *p_message_info, otCoapCode code)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otInstance *p_instance = thread_ot_instance_get();
+
+	if (otCoapMessageGetType(p_request_message) != OT_COAP_TYPE_CONFIRMABLE)
+		return;
+
+	otMessage *p_response = otCoapNewMessage(p_instance, NULL);
+	if (p_response == NULL)
+		return;
+
+	do {
+		error = coap_response_init(p_response, p_request_message, code);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapSendResponse(p_instance, p_response, p_message_info);
+	} while (false);
+
+	if (error != OT_ERROR_NONE)
+		otMessageFree(p_response);
+}
+
 static void set_response_send(otMessage * p_request_message, const otMessageInfo * p_message_info, const uint8_t *p_buff, size_t buff_size)
 {
 	otError      error = OT_ERROR_NO_BUFS;
@@ -452,9 +698,7 @@ static void set_response_send(otMessage * p_request_message, const otMessageInfo
 		if (p_response == NULL)
 			break;
 
-		otCoapMessageInit(p_response, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
-
-		error = otCoapMessageSetToken(p_response, otCoapMessageGetToken(p_request_message), otCoapMessageGetTokenLength(p_request_message));
+		error = coap_response_init(p_response, p_request_message, OT_COAP_CODE_CONTENT);
 		if (error != OT_ERROR_NONE)
 			break;
 
@@ -477,8 +721,164 @@ static void set_response_send(otMessage * p_request_message, const otMessageInfo
 		otMessageFree(p_response);
 }
 
+/**@brief Response to a confirmable /set that is held back until the new channel values
+ *        reach the outputs, e.g. while the PSU is powering up.
+ */
+typedef struct coap_separate_response
+{
+	bool pending;
+	otMessageInfo message_info;
+	uint8_t token[OT_COAP_MAX_TOKEN_LENGTH];
+	uint8_t token_length;
+	uint32_t started_at;
+	uint8_t response_size;
+	uint8_t response[SET_RESPONSE_SIZE_MAX];
+} coap_separate_response;
+
+static coap_separate_response m_separate_response = { .pending = false, };
+
+/**@brief Sends the Empty ACKs from the CoAP port, open for the node's lifetime.
+ *
+ * @details OpenThread hands a datagram to the most recently opened socket bound to its port. The socket
+ *          is opened before otCoapStart(), so the CoAP socket stays in front of it and keeps every
+ *          request, nothing reaches this one.
+ */
+static otUdpSocket m_empty_ack_socket;
+
+static void empty_ack_socket_receive(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	// the socket only sends, the CoAP socket in front of it receives everything
+}
+
+static void empty_ack_socket_open(otInstance *p_instance)
+{
+	otError error = otUdpOpen(p_instance, &m_empty_ack_socket, empty_ack_socket_receive, NULL);
+	ASSERT(error == OT_ERROR_NONE);
+
+	otSockAddr sock_name;
+	memset(&sock_name, 0, sizeof(sock_name));
+	sock_name.mPort = OT_DEFAULT_COAP_PORT;
+
+	error = otUdpBind(&m_empty_ack_socket, &sock_name);
+	ASSERT(error == OT_ERROR_NONE);
+}
+
+/**@brief Acknowledges a confirmable request with an Empty message, the response follows separately.
+ *
+ * @details An Empty message has no token (RFC 7252 section 4.1), but otCoapMessageInitResponse() copies
+ *          the token of the request and the CoAP API cannot set the message ID of a new message. The
+ *          four header bytes go out on the empty ACK socket instead.
+ */
+static otError empty_ack_send(otMessage *p_request_message, const otMessageInfo *p_message_info)
+{
+	otInstance *p_instance = thread_ot_instance_get();
+
+	uint16_t message_id = otCoapMessageGetMessageId(p_request_message);
+	// version 1, type ACK, TKL 0, code 0.00
+	const uint8_t ack[] = { 0x60, OT_COAP_CODE_EMPTY, (uint8_t)(message_id >> 8), (uint8_t)message_id };
+
+	otMessage *p_ack = otUdpNewMessage(p_instance, NULL);
+	if (p_ack == NULL)
+		return OT_ERROR_NO_BUFS;
+
+	otError error = otMessageAppend(p_ack, ack, sizeof(ack));
+	if (error == OT_ERROR_NONE)
+		error = otUdpSend(&m_empty_ack_socket, p_ack, p_message_info);
+
+	if (error != OT_ERROR_NONE)
+		otMessageFree(p_ack);
+
+	return error;
+}
+
+static bool separate_response_start(otMessage *p_request_message, const otMessageInfo *p_message_info, const uint8_t *p_buff, size_t buff_size)
+{
+	if (m_separate_response.pending || buff_size > sizeof(m_separate_response.response))
+		return false;
+
+	if (empty_ack_send(p_request_message, p_message_info) != OT_ERROR_NONE)
+		return false;
+
+	m_separate_response.message_info = *p_message_info;
+	m_separate_response.token_length = otCoapMessageGetTokenLength(p_request_message);
+	memcpy(m_separate_response.token, otCoapMessageGetToken(p_request_message), m_separate_response.token_length);
+	memcpy(m_separate_response.response, p_buff, buff_size);
+	m_separate_response.response_size = (uint8_t)buff_size;
+	m_separate_response.started_at = otPlatAlarmMilliGetNow();
+	m_separate_response.pending = true;
+
+	return true;
+}
+
+static void separate_response_process(uint32_t time_now)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otInstance *p_instance = thread_ot_instance_get();
+
+	if (!m_separate_response.pending)
+		return;
+
+	if (!dimmer_output_ready() && time_now - m_separate_response.started_at < COAP_SEPARATE_RESPONSE_TIMEOUT)
+		return;
+
+	m_separate_response.pending = false;
+
+	otMessage *p_response = otCoapNewMessage(p_instance, NULL);
+	if (p_response == NULL)
+		return;
+
+	do {
+		otCoapMessageInit(p_response, OT_COAP_TYPE_CONFIRMABLE, OT_COAP_CODE_CONTENT);
+
+		error = otCoapMessageSetToken(p_response, m_separate_response.token, m_separate_response.token_length);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapMessageAppendContentFormatOption(p_response, OT_COAP_OPTION_CONTENT_FORMAT_CBOR);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapMessageSetPayloadMarker(p_response);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otMessageAppend(p_response, m_separate_response.response, m_separate_response.response_size);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		// sent as a request so that the stack retransmits it until the client acknowledges
+		error = otCoapSendRequest(p_instance, p_response, &m_separate_response.message_info, NULL, NULL);
+	} while (false);
+
+	if (error != OT_ERROR_NONE)
+		otMessageFree(p_response);
+}
+
+/**@brief Applies the values of a request, each item is left with the value its handler actually applied. */
+static void set_request_apply(set_request *p_request)
+{
+	// "@" starts the colour transitions of the request at a network time
+	uint32_t local_time;
+	bool start_scheduled = p_request->start_present && thread_coap_timesync_local_time_get(p_request->start, &local_time);
+	if (start_scheduled)
+		colour_start_time_set(local_time);
+
+	for (int i = 0; i < p_request->count; i++) {
+		set_request_item *p_item = &p_request->items[i];
+		set_sensor_value(sensor_descriptors[p_item->sensor_index].sensor_name, p_item->value, true);
+		// the response echoes what was applied, a clamped or rejected value reads back as such
+		p_item->value = sensor_current_values[p_item->sensor_index];
+	}
+
+	if (start_scheduled)
+		colour_start_time_clear();
+}
+
 static void set_request_handler(void * p_context, otMessage * p_message, const otMessageInfo * p_message_info)
 {
+	// further requests usually follow
+	poll_period_fast_set();
+
 	do {
 		if (otCoapMessageGetType(p_message) != OT_COAP_TYPE_CONFIRMABLE && otCoapMessageGetType(p_message) != OT_COAP_TYPE_NON_CONFIRMABLE)
 			break;
@@ -486,117 +886,124 @@ static void set_request_handler(void * p_context, otMessage * p_message, const o
 		if (otCoapMessageGetCode(p_message) != OT_COAP_CODE_PUT)
 			break;
 
+		coap_dedup_entry *p_entry = dedup_cache_find(p_message, p_message_info);
+		if (p_entry != NULL) {
+			if (otCoapMessageGetType(p_message) == OT_COAP_TYPE_CONFIRMABLE)
+				set_response_send(p_message, p_message_info, p_entry->response, p_entry->response_size);
+			break;
+		}
+
 		uint8_t buff[256];
 
 		uint16_t body_len = otMessageGetLength(p_message) - otMessageGetOffset(p_message);
 
-		if (body_len > sizeof(buff))
+		if (body_len > sizeof(buff)) {
+			code_response_send(p_message, p_message_info, OT_COAP_CODE_REQUEST_TOO_LARGE);
 			break;
+		}
 
 		if (otMessageRead(p_message, otMessageGetOffset(p_message), buff, body_len) != body_len)
 			break;
 
-		CborParser parser;
-		CborValue it;
-		CborError cborError = cbor_parser_init(buff, body_len, 0, &parser, &it);
-		if (cborError != CborNoError)
-			break;
-
-		if (cbor_value_at_end(&it) || cbor_value_get_type(&it) != CborMapType)
+		// nothing is applied from a request that does not decode as a whole
+		set_request request;
+		if (!coap_payload_set_parse(buff, body_len, &request)) {
+			code_response_send(p_message, p_message_info, OT_COAP_CODE_BAD_REQUEST);
 			break;
+		}
 
-		CborValue recursed;
-		cborError = cbor_value_enter_container(&it, &recursed);
-		if (cborError != CborNoError)
-			break;
+		set_request_apply(&request);
 
-		uint8_t buff_resp[256];
-		CborEncoder encoder;
-		cbor_encoder_init(&encoder, buff_resp, sizeof(buff_resp), 0);
+		uint8_t buff_resp[SET_RESPONSE_SIZE_MAX];
 
-		CborEncoder encoderMap;
-		cborError = cbor_encoder_create_map(&encoder, &encoderMap, CborIndefiniteLength);
-		if (cborError != CborNoError)
+		size_t buff_size = coap_payload_set_response_encode(&request, buff_resp, sizeof(buff_resp));
+		if (buff_size == 0)
 			break;
 
-		while (!cbor_value_at_end(&recursed)) {
-			CborType type = cbor_value_get_type(&recursed);
-			if (type != CborTextStringType)
-				break;
-			char key[256];
-			size_t keyLen = sizeof(key);
-			CborValue next;
-			cborError = cbor_value_copy_text_string(&recursed, key, &keyLen, &next);
-			if (key[1] != 0)
-				break;
-			recursed = next;
-			type = cbor_value_get_type(&recursed);
-			if (type != CborIntegerType)
-				break;
-			int64_t val;
-			cborError = cbor_value_get_int64(&recursed, &val);
-			if (cborError != CborNoError)
-				break;
+		// an idle dimmer runs its control loop slowly, the new values should not wait for it
+		wakeup_kick(WAKEUP_PSU_CONTROL);
 
-			if (!is_sensor_readonly(key[0])) {
-				set_sensor_value(key[0], val, true);
-				cbor_encode_map_set_int(&encoderMap, key, val);
-			}
+		dedup_cache_store(p_message, p_message_info, buff_resp, buff_size);
 
-			cborError = cbor_value_advance(&recursed);
-			if (cborError != CborNoError)
-				break;
-		}
+		if (otCoapMessageGetType(p_message) != OT_COAP_TYPE_CONFIRMABLE)
+			break;
 
-		cborError = cbor_encoder_close_container(&encoder, &encoderMap);
-		if (cborError != CborNoError)
+		if (!dimmer_output_ready() && separate_response_start(p_message, p_message_info, buff_resp, buff_size))
 			break;
 
-		if (otCoapMessageGetType(p_message) == OT_COAP_TYPE_CONFIRMABLE) {
-			size_t buff_size = cbor_encoder_get_buffer_size(&encoder, buff_resp);
-			set_response_send(p_message, p_message_info, buff_resp, buff_size);
-		}
+		set_response_send(p_message, p_message_info, buff_resp, buff_size);
 	}
 	while (false);
 }
 
-static otError get_response_send(otMessage *p_request_message, const otMessageInfo *p_message_info, const uint8_t *p_buff, size_t buff_size)
+static void write_get_packet(block_writer *p_writer, const void *p_context)
 {
-	otError error = OT_ERROR_NO_BUFS;
-	otMessage *p_response;
-	otInstance *p_instance = thread_ot_instance_get();
+	sensor_mask_t sensors = *(const sensor_mask_t *)p_context;
 
-	do {
-		p_response = otCoapNewMessage(p_instance, NULL);
-		if (p_response == NULL)
-			break;
+	block_writer_put_byte(p_writer, CBOR_INDEFINITE_MAP);
 
-		otCoapMessageInit(p_response, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
+	while (sensors) {
+		int i = __builtin_ctzll(sensors);
+		sensors &= sensors - 1;
 
-		error = otCoapMessageSetToken(p_response, otCoapMessageGetToken(p_request_message), otCoapMessageGetTokenLength(p_request_message));
-		if (error != OT_ERROR_NONE)
-			break;
+		char key[2] = {sensor_descriptors[i].sensor_name, 0};
 
-		error = otCoapMessageAppendContentFormatOption(p_response, OT_COAP_OPTION_CONTENT_FORMAT_CBOR);
-		if (error != OT_ERROR_NONE)
-			break;
+		cbor_encode_map_set_int(&p_writer->encoder, key, sensor_current_values[i]);
+		block_writer_flush(p_writer);
+	}
 
-		error = otCoapMessageSetPayloadMarker(p_response);
-		if (error != OT_ERROR_NONE)
-			break;
+	block_writer_put_byte(p_writer, CBOR_BREAK);
+}
 
-		error = otMessageAppend(p_response, p_buff, buff_size);
-		if (error != OT_ERROR_NONE)
-			break;
+/**@brief Appends the /stats payload: the device role "r" (otDeviceRole), the router policy decision "d"
+ *        (router_policy_decision_t) and its inputs, neighbours "n", routers heard with a good link "l",
+ *        routers of the partition "p", children "c" and frames in the last interval "f", the applied
+ *        upgrade threshold "u", downgrade threshold "g" and selection jitter "j", and the wakeup counters
+ *        "w": timer expiries followed by the runs of each wakeup_source_t.
+ */
+static void write_stats_packet(block_writer *p_writer, const void *p_context)
+{
+	UNUSED_PARAMETER(p_context);
 
-		error = otCoapSendResponse(p_instance, p_response, p_message_info);
+	const router_policy_state *p_state = thread_router_policy_state_get();
+
+	block_writer_put_byte(p_writer, CBOR_INDEFINITE_MAP);
+
+	cbor_encode_map_set_int(&p_writer->encoder, "r", otThreadGetDeviceRole(thread_ot_instance_get()));
+	cbor_encode_map_set_int(&p_writer->encoder, "d", p_state->decision);
+	cbor_encode_map_set_int(&p_writer->encoder, "n", p_state->neighbours);
+	cbor_encode_map_set_int(&p_writer->encoder, "l", p_state->routers);
+	cbor_encode_map_set_int(&p_writer->encoder, "p", p_state->partition_routers);
+	block_writer_flush(p_writer);
+
+	cbor_encode_map_set_int(&p_writer->encoder, "c", p_state->children);
+	cbor_encode_map_set_int(&p_writer->encoder, "f", p_state->frames);
+	cbor_encode_map_set_int(&p_writer->encoder, "u", p_state->upgrade_threshold);
+	cbor_encode_map_set_int(&p_writer->encoder, "g", p_state->downgrade_threshold);
+	cbor_encode_map_set_int(&p_writer->encoder, "j", p_state->jitter);
+	block_writer_flush(p_writer);
+
+	cbor_encode_text_stringz(&p_writer->encoder, "w");
+	block_writer_flush(p_writer);
+	block_writer_put_byte(p_writer, CBOR_INDEFINITE_ARRAY);
+	cbor_encode_uint(&p_writer->encoder, wakeup_timer_count_get());
+	for (int i = 0; i < WAKEUP_SOURCES; i++) {
+		cbor_encode_uint(&p_writer->encoder, wakeup_count_get((wakeup_source_t)i));
+	}
+	block_writer_flush(p_writer);
+	block_writer_put_byte(p_writer, CBOR_BREAK);
 
-	} while (false);
+	block_writer_put_byte(p_writer, CBOR_BREAK);
+}
 
-	if (error != OT_ERROR_NONE && p_response != NULL)
-		otMessageFree(p_response);
+static void stats_request_handler(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	UNUSED_PARAMETER(p_context);
 
-	return error;
+	if (otCoapMessageGetCode(p_message) != OT_COAP_CODE_GET)
+		return;
+
+	block_response_send(p_message, p_message_info, write_stats_packet, NULL);
 }
 
 static void get_request_handler(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
@@ -618,59 +1025,73 @@ static void get_request_handler(void *p_context, otMessage *p_message, const otM
 		if (otMessageRead(p_message, otMessageGetOffset(p_message), buff_req, body_len) != body_len)
 			break;
 
-		CborParser parser;
-		CborValue it;
-		CborError cborError = cbor_parser_init(buff_req, body_len, 0, &parser, &it);
-		if (cborError != CborNoError)
+		sensor_mask_t sensors;
+		if (!coap_payload_get_parse(buff_req, body_len, &sensors))
 			break;
+		sensors &= sensor_initialized_mask;
+
+		block_response_send(p_message, p_message_info, write_get_packet, &sensors);
+	} while (false);
+}
+
+static void fx_request_handler(void *p_context, otMessage *p_message, const otMessageInfo *p_message_info)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otMessage *p_response = NULL;
+	otInstance *p_instance = thread_ot_instance_get();
+
+	poll_period_fast_set();
 
-		if (cbor_value_at_end(&it) || cbor_value_get_type(&it) != CborArrayType)
+	do {
+		if (otCoapMessageGetType(p_message) != OT_COAP_TYPE_CONFIRMABLE && otCoapMessageGetType(p_message) != OT_COAP_TYPE_NON_CONFIRMABLE)
 			break;
 
-		CborValue recursed;
-		cborError = cbor_value_enter_container(&it, &recursed);
-		if (cborError != CborNoError)
+		if (otCoapMessageGetCode(p_message) != OT_COAP_CODE_PUT)
 			break;
 
-		uint8_t buff_resp[256];
-		CborEncoder encoder;
-		cbor_encoder_init(&encoder, buff_resp, sizeof(buff_resp), 0);
+		uint8_t buff[EFFECT_REQUEST_SIZE_MAX];
 
-		CborEncoder encoderMap;
-		cborError = cbor_encoder_create_map(&encoder, &encoderMap, CborIndefiniteLength);
-		if (cborError != CborNoError)
-			break;
+		uint16_t body_len = otMessageGetLength(p_message) - otMessageGetOffset(p_message);
 
-		while (!cbor_value_at_end(&recursed))
-		{
-			CborType type = cbor_value_get_type(&recursed);
-			if (type != CborTextStringType)
-				break;
+		if (body_len > sizeof(buff))
+			break;
 
-			char key[2];
-			size_t keyLen = sizeof(key);
-			CborValue next;
-			cborError = cbor_value_copy_text_string(&recursed, key, &keyLen, &next);
-			if (key[1] != 0)
-				break;
-			recursed = next;
+		if (otMessageRead(p_message, otMessageGetOffset(p_message), buff, body_len) != body_len)
+			break;
 
-			int64_t sensor_value;
-			if (!get_sensor_value(key[0], &sensor_value))
-				break;
+		fx_request request;
+		otCoapCode code = OT_COAP_CODE_CHANGED;
 
-			cbor_encode_map_set_int(&encoderMap, key, sensor_value);
+		if (!coap_payload_fx_parse(buff, body_len, &request)) {
+			code = OT_COAP_CODE_BAD_REQUEST;
+		} else if (request.count == 0) {
+			effect_stop();
+		} else if (!effect_load(request.keyframes, request.count, request.loops)) {
+			code = OT_COAP_CODE_BAD_REQUEST;
+		} else {
+			uint32_t local_time;
+			// without network time the effect starts at once
+			if (request.start_present && thread_coap_timesync_local_time_get(request.start, &local_time))
+				effect_start_time_set(local_time);
 		}
+		wakeup_kick(WAKEUP_PSU_CONTROL);
 
-		cborError = cbor_encoder_close_container(&encoder, &encoderMap);
-		if (cborError != CborNoError)
+		if (otCoapMessageGetType(p_message) != OT_COAP_TYPE_CONFIRMABLE)
 			break;
 
-		if (otCoapMessageGetType(p_message) == OT_COAP_TYPE_CONFIRMABLE) {
-			size_t buff_size = cbor_encoder_get_buffer_size(&encoder, buff_resp);
-			get_response_send(p_message, p_message_info, buff_resp, buff_size);
-		}
+		p_response = otCoapNewMessage(p_instance, NULL);
+		if (p_response == NULL)
+			break;
+
+		error = coap_response_init(p_response, p_message, code);
+		if (error != OT_ERROR_NONE)
+			break;
+
+		error = otCoapSendResponse(p_instance, p_response, p_message_info);
 	} while (false);
+
+	if (error != OT_ERROR_NONE && p_response != NULL)
+		otMessageFree(p_response);
 }
 
 static void sub_response_send(otMessage * p_request_message, const otMessageInfo * p_message_info, const uint8_t *p_buff, size_t buff_size)
@@ -684,9 +1105,7 @@ static void sub_response_send(otMessage * p_request_message, const otMessageInfo
 		if (p_response == NULL)
 			break;
 
-		otCoapMessageInit(p_response, OT_COAP_TYPE_NON_CONFIRMABLE, OT_COAP_CODE_CONTENT);
-
-		error = otCoapMessageSetToken(p_response, otCoapMessageGetToken(p_request_message), otCoapMessageGetTokenLength(p_request_message));
+		error = coap_response_init(p_response, p_request_message, OT_COAP_CODE_CONTENT);
 		if (error != OT_ERROR_NONE)
 			break;
 
@@ -709,170 +1128,28 @@ static void sub_response_send(otMessage * p_request_message, const otMessageInfo
 		otMessageFree(p_response);
 }
 
-static size_t parse_subscriptions(uint8_t *p_request, size_t request_size, uint8_t *p_response, size_t response_size)
+static void sub_request_apply(const sub_request *p_request)
 {
 	uint32_t time_now = otPlatAlarmMilliGetNow();
 
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		sensor_subscriptions[i].disable_reporting = true;
-		sensor_subscriptions[i].last_sent_at = time_now;
-		sensor_subscriptions[i].sent_value = sensor_subscriptions[i].current_value;
+	// a subscription replaces the previous one, sensors it does not list are not reported
+	sensor_disable_reporting_mask = SENSORS_ALL_MASK;
+	for (int i = 0; i < SENSORS_COUNT; i++) {
+		sensor_last_sent_at[i] = time_now;
+		sensor_sent_values[i] = sensor_current_values[i];
 	}
 
-	CborParser parser;
-	CborValue it;
-	CborError cborError = cbor_parser_init(p_request, request_size, 0, &parser, &it);
-	if (cborError != CborNoError)
-		return 0;
-
-	if (cbor_value_at_end(&it) || cbor_value_get_type(&it) != CborMapType)
-		return 0;
-
-	CborValue recursed;
-	cborError = cbor_value_enter_container(&it, &recursed);
-	if (cborError != CborNoError)
-		return 0;
-
-	CborEncoder encoder;
-	cbor_encoder_init(&encoder, p_response, response_size, 0);
-
-	CborEncoder encoderMap;
-	cborError = cbor_encoder_create_map(&encoder, &encoderMap, CborIndefiniteLength);
-	if (cborError != CborNoError)
-		return 0;
+	if (p_request->address_present)
+		memcpy(subscription_settings.subscription_address.mFields.m8, p_request->address, sizeof(otIp6Address));
 
-	while (!cbor_value_at_end(&recursed)) {
-		CborType type = cbor_value_get_type(&recursed);
-		if (type != CborTextStringType)
-			return 0;
-
-		char key[2];
-		size_t keyLen = sizeof(key);
-		CborValue next;
-
-		cborError = cbor_value_copy_text_string(&recursed, key, &keyLen, &next);
-		if (cborError != CborNoError)
-			return 0;
-		if (key[1] != 0)
-			return 0;
-
-		recursed = next;
-
-		type = cbor_value_get_type(&recursed);
-		switch (key[0]) {
-			case 'a': {
-				if (type != CborByteStringType)
-					return 0;
-				size_t addr_size = 0;
-				cborError = cbor_value_calculate_string_length(&recursed, &addr_size);
-				if (cborError != CborNoError)
-					return 0;
-				if (addr_size != sizeof(otIp6Address))
-					return 0;
-				addr_size = sizeof(otIp6Address);
-				cborError = cbor_value_copy_byte_string(&recursed, subscription_settings.subscription_address.mFields.m8, &addr_size, &next);
-				if (cborError != CborNoError)
-					return 0;
-				if (addr_size != sizeof(otIp6Address))
-					return 0;
-				recursed = next;
-				break;
-			}
-			case 's': {
-				if (type != CborMapType)
-					return 0;
-				
-				CborValue recursedMapS;
-				cborError = cbor_value_enter_container(&recursed, &recursedMapS);
-				if (cborError != CborNoError)
-					return 0;
-
-				while (!cbor_value_at_end(&recursedMapS)) {
-					CborType type = cbor_value_get_type(&recursedMapS);
-					if (type != CborTextStringType)
-						return 0;
-
-					char keyS[2];
-					size_t keySLen = sizeof(keyS);
-
-					cborError = cbor_value_copy_text_string(&recursedMapS, keyS, &keySLen, &next);
-					if (cborError != CborNoError)
-						return 0;
-					if (keyS[1] != 0)
-						return 0;
-					
-					int16_t sensor_index = get_sensor_index(keyS[0]);
-					if (sensor_index == -1)
-						return 0;
-
-					recursedMapS = next;
-
-					if (cbor_value_get_type(&recursedMapS) != CborMapType)
-						return 0;
-
-					CborValue recursedMapSR;
-					cborError = cbor_value_enter_container(&recursedMapS, &recursedMapSR);
-					if (cborError != CborNoError)
-						return 0;
-
-					while (!cbor_value_at_end(&recursedMapSR)) {
-						CborType type = cbor_value_get_type(&recursedMapSR);
-						if (type != CborTextStringType)
-							return 0;
-
-						char keySR[2];
-						size_t keySRLen = sizeof(keySR);
-
-						cborError = cbor_value_copy_text_string(&recursedMapSR, keySR, &keySRLen, &next);
-						if (cborError != CborNoError)
-							return 0;
-
-						if (keySR[0] != 'i' && keySR[0] != 'r')
-							return 0;
-						if (keySR[1] != 0)
-							return 0;
-
-						recursedMapSR = next;
-						type = cbor_value_get_type(&recursedMapSR);
-						if (type != CborIntegerType)
-							return 0;
-						int64_t val;
-						cborError = cbor_value_get_int64(&recursedMapSR, &val);
-						if (cborError != CborNoError)
-							return 0;
-						cborError = cbor_value_advance(&recursedMapSR);
-						if (cborError != CborNoError)
-							return 0;
-
-						if (keySR[0] == 'i')
-							sensor_subscriptions[sensor_index].report_interval = (uint32_t)val;
-						else if (keySR[0] == 'r')
-							sensor_subscriptions[sensor_index].reportable_change = val;
-					}
-
-					cborError = cbor_value_leave_container(&recursedMapS, &recursedMapSR);
-					if (cborError != CborNoError)
-						return 0;
-
-					sensor_subscriptions[sensor_index].disable_reporting = false;
-				}
-
-				cborError = cbor_value_leave_container(&recursed, &recursedMapS);
-				if (cborError != CborNoError)
-					return 0;
-				
-				break;
-			}
-			default:
-				return 0;
-		}
+	for (int i = 0; i < p_request->count; i++) {
+		const sub_request_item *p_item = &p_request->items[i];
+		if (p_item->interval_present)
+			set_sensor_report_interval(p_item->sensor_index, p_item->interval);
+		if (p_item->change_present)
+			sensor_reportable_changes[p_item->sensor_index] = p_item->change;
+		sensor_disable_reporting_mask &= ~SENSOR_MASK(p_item->sensor_index);
 	}
-
-	cborError = cbor_encoder_close_container(&encoder, &encoderMap);
-	if (cborError != CborNoError)
-		return 0;
-
-	return cbor_encoder_get_buffer_size(&encoder, p_response);
 }
 
 static void sub_request_handler(void * p_context, otMessage * p_message, const otMessageInfo * p_message_info)
@@ -894,15 +1171,16 @@ static void sub_request_handler(void * p_context, otMessage * p_message, const o
 		if (otMessageRead(p_message, otMessageGetOffset(p_message), buff_request, request_size) != request_size)
 			break;
 
-		uint8_t buff_response[256];
+		sub_request request;
+		if (!coap_payload_sub_parse(buff_request, request_size, &request))
+			break;
 
-		size_t response_size = parse_subscriptions(buff_request, request_size, buff_response, sizeof(buff_response));
+		sub_request_apply(&request);
 
-		if (response_size == 0)
-			break;
+		static const uint8_t empty_map[] = { CBOR_INDEFINITE_MAP, CBOR_BREAK };
 
 		if (otCoapMessageGetType(p_message) == OT_COAP_TYPE_CONFIRMABLE)
-			set_response_send(p_message, p_message_info, buff_response, response_size);
+			set_response_send(p_message, p_message_info, empty_map, sizeof(empty_map));
 	}
 	while (false);
 }
@@ -912,7 +1190,10 @@ static void subscription_response_handler(void                * p_context,
 										  const otMessageInfo * p_message_info,
 										  otError               result)
 {
-	poll_period_restore();
+	UNUSED_PARAMETER(p_context);
+	UNUSED_PARAMETER(p_message);
+	UNUSED_PARAMETER(p_message_info);
+	UNUSED_PARAMETER(result);
 }
 
 static void send_subscription_broadcast()
@@ -941,13 +1222,10 @@ static void send_subscription_broadcast()
 		if (error != OT_ERROR_NONE)
 			break;
 
-		uint8_t buff[256];
-
-		size_t packet_len = fill_info_packet(buff, sizeof(buff));
-		if (packet_len == 0)
-			break;
-
-		error = otMessageAppend(p_request, buff, packet_len);
+		block_writer writer;
+		block_writer_init(&writer, p_request, 0, UINT32_MAX);
+		write_info_packet(&writer, NULL);
+		error = writer.error;
 		if (error != OT_ERROR_NONE)
 			break;
 
@@ -984,33 +1262,30 @@ size_t fill_subscriptions_packet(uint32_t time_now, uint8_t *pBuffer, size_t stB
 
 	bool data_added = false;
 
-	for (int i = 0; sensor_subscriptions[i].sensor_name != SENSOR_SUBSCRIPTION_NAME_LAST; i++) {
-		if (sensor_subscriptions[i].disable_reporting)
-			continue;
+	sensor_mask_t pending = sensor_initialized_mask & ~sensor_disable_reporting_mask;
 
-		if (sensor_subscriptions[i].initialized == false)
-			continue;
+	while (pending) {
+		int i = __builtin_ctzll(pending);
+		pending &= pending - 1;
+
+		int32_t current_value = sensor_current_values[i];
+		// writable sensors take any int32, the difference needs the wider type
+		int64_t change = (int64_t)current_value - sensor_sent_values[i];
+		if (change < 0)
+			change = -change;
 
-		bool add = false;
-		if (sensor_subscriptions[i].last_sent_at + sensor_subscriptions[i].report_interval < time_now)
-			add = true;
-		else if ((sensor_subscriptions[i].current_value > sensor_subscriptions[i].sent_value) &&
-			((sensor_subscriptions[i].current_value - sensor_subscriptions[i].sent_value) > sensor_subscriptions[i].reportable_change))
-			add = true;
-		else if ((sensor_subscriptions[i].sent_value > sensor_subscriptions[i].current_value) &&
-			(sensor_subscriptions[i].sent_value - sensor_subscriptions[i].current_value) > sensor_subscriptions[i].reportable_change)
-			add = true;
+		if ((time_now - sensor_last_sent_at[i] <= (uint32_t)sensor_report_intervals[i] * SENSOR_REPORT_INTERVAL_UNIT) &&
+			(change <= sensor_reportable_changes[i]))
+			continue;
 
-		if (add) {
-			data_added = true;
+		data_added = true;
 
-			sensor_subscriptions[i].last_sent_at = time_now;
-			sensor_subscriptions[i].sent_value = sensor_subscriptions[i].current_value;
+		sensor_last_sent_at[i] = time_now;
+		sensor_sent_values[i] = current_value;
 
-			char key[2] = {sensor_subscriptions[i].sensor_name, 0};
+		char key[2] = {sensor_descriptors[i].sensor_name, 0};
 
-			cbor_encode_map_set_int(&encoderMap, key, sensor_subscriptions[i].current_value);
-		}
+		cbor_encode_map_set_int(&encoderMap, key, current_value);
 	}
 
 	if (!data_added)
@@ -1031,6 +1306,18 @@ static void subscription_timeout_handler(void *p_context)
 	if (device_role != OT_DEVICE_ROLE_CHILD && device_role != OT_DEVICE_ROLE_ROUTER && device_role != OT_DEVICE_ROLE_LEADER)
 		return;
 
+	uint32_t time_now = otPlatAlarmMilliGetNow();
+
+	separate_response_process(time_now);
+	thread_coap_timesync_process(time_now);
+	poll_period_apply(time_now);
+	thread_router_policy_process(time_now);
+
+	if (!report_window_open(time_now))
+		return;
+
+	thread_coap_observe_process(time_now);
+
 	if (subscription_settings.subscription_address.mFields.m32[0] == 0xFFFFFFFF &&
 		subscription_settings.subscription_address.mFields.m32[1] == 0xFFFFFFFF &&
 		subscription_settings.subscription_address.mFields.m32[2] == 0xFFFFFFFF &&
@@ -1038,14 +1325,11 @@ static void subscription_timeout_handler(void *p_context)
 			return;
 	}
 
-	uint32_t time_now = otPlatAlarmMilliGetNow();
-
 	if (otIp6IsAddressUnspecified(&subscription_settings.subscription_address)) {
-		if (subscription_settings.last_sent_at + subscription_settings.subscription_interval > time_now)
+		if ((int32_t)(time_now - subscription_settings.next_broadcast_at) < 0)
 			return;
-		subscription_settings.last_sent_at = time_now;
-		if (subscription_settings.subscription_interval < 60000)
-			subscription_settings.subscription_interval *= 2;
+		subscription_settings.next_broadcast_at = time_now +
+			backoff_next_delay(&subscription_settings.subscription_interval, otRandomNonCryptoGetUint32());
 		send_subscription_broadcast();
 		return;
 	}
@@ -1095,6 +1379,9 @@ static void subscription_timeout_handler(void *p_context)
 		error = otCoapSendRequest(p_instance, p_request, &message_info, NULL, NULL);
 		if (error != OT_ERROR_NONE)
 			break;
+
+		// a controller often answers a report with a /set
+		poll_period_fast_set();
 	} while (false);
 
 	if (error != OT_ERROR_NONE && p_request != NULL)
@@ -1114,6 +1401,9 @@ void thread_coap_utils_init()
 {
 	otInstance * p_instance = thread_ot_instance_get();
 
+	// before the CoAP socket, see m_empty_ack_socket
+	empty_ack_socket_open(p_instance);
+
 	otError error = otCoapStart(p_instance, OT_DEFAULT_COAP_PORT);
 	ASSERT(error == OT_ERROR_NONE);
 
@@ -1124,6 +1414,8 @@ void thread_coap_utils_init()
 	m_set_resource.mContext = p_instance;
 	m_get_resource.mContext = p_instance;
 	m_sub_resource.mContext = p_instance;
+	m_fx_resource.mContext = p_instance;
+	m_stats_resource.mContext = p_instance;
 
 	error = otCoapAddResource(p_instance, &m_boot_resource);
 	ASSERT(error == OT_ERROR_NONE);
@@ -1140,13 +1432,21 @@ void thread_coap_utils_init()
 	error = otCoapAddResource(p_instance, &m_sub_resource);
 	ASSERT(error == OT_ERROR_NONE);
 
-	uint32_t error_code = app_timer_create(&m_subscription_timer, APP_TIMER_MODE_REPEATED, subscription_timeout_handler);
-	APP_ERROR_CHECK(error_code);
+	error = otCoapAddResource(p_instance, &m_fx_resource);
+	ASSERT(error == OT_ERROR_NONE);
 
-	error_code = app_timer_start(m_subscription_timer, APP_TIMER_TICKS(SUBSCRIPTION_TIMER_INTERVAL), NULL);
-	APP_ERROR_CHECK(error_code);
+	error = otCoapAddResource(p_instance, &m_stats_resource);
+	ASSERT(error == OT_ERROR_NONE);
+
+	thread_coap_observe_init(p_instance);
+	thread_coap_timesync_init(p_instance);
+	thread_router_policy_init(p_instance);
+
+	subscription_settings.next_broadcast_at = otPlatAlarmMilliGetNow() + backoff_first_delay(otRandomNonCryptoGetUint32());
+
+	wakeup_start(WAKEUP_SUBSCRIPTION, subscription_timeout_handler, SUBSCRIPTION_TIMER_INTERVAL);
 
-	error_code = app_timer_create(&m_led_recv_timer, APP_TIMER_MODE_SINGLE_SHOT, bsp_recv_led_timer_handler);
+	uint32_t error_code = app_timer_create(&m_led_recv_timer, APP_TIMER_MODE_SINGLE_SHOT, bsp_recv_led_timer_handler);
 	APP_ERROR_CHECK(error_code);
 
 	error_code = app_timer_create(&m_led_send_timer, APP_TIMER_MODE_SINGLE_SHOT, bsp_send_led_timer_handler);
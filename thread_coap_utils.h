@@ -44,36 +44,25 @@
 #include <stdbool.h>
 #include <openthread/coap.h>
 
+#include "sensors.h"
 #include "thread_utils.h"
 
-typedef void (*sensor_set_value_handler_t)(char sensor_name, int64_t sensor_value);
-
-#define SENSOR_SUBSCRIPTION_NAME_LAST 255
-
-typedef struct sensor_subscription
-{
-	char sensor_name;
-	int64_t sent_value;
-	int64_t current_value;
-	int64_t reportable_change;
-	bool read_only;
-	bool disable_reporting;
-	bool initialized;
-	sensor_set_value_handler_t set_value_handler;
-	uint32_t report_interval;
-	uint32_t last_sent_at;
-} sensor_subscription;
-
 typedef struct subscription_settings_data
 {
 	otIp6Address subscription_address;
 	uint32_t subscription_interval;
-	uint32_t last_sent_at;
+	uint32_t next_broadcast_at;
 } subscription_settings_data;
 
 void thread_coap_utils_init();
 
-bool set_sensor_value(char sensor_name, int64_t sensor_value, bool external_request);
-bool get_sensor_value(char sensor_name, int64_t *p_sensor_value);
+/**@brief Drops cached payloads that depend on the role or the addresses, called with the OT_CHANGED_* flags. */
+void thread_coap_utils_state_changed(uint32_t flags);
+
+/**@brief Initializes a response to p_request, piggybacked on the ACK when the request is confirmable. */
+otError coap_response_init(otMessage *p_response, const otMessage *p_request, otCoapCode code);
+
+/**@brief Reads an unsigned integer option, such as Observe or Block2, from a CoAP message. */
+bool coap_message_uint_option_get(const otMessage *p_message, uint16_t option_number, uint32_t *p_value);
 
 #endif /* THREAD_COAP_UTILS_H__ */
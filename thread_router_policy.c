@@ -0,0 +1,128 @@
+#include "thread_router_policy.h"
+
+#include "settings.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <openthread/link.h>
+#include <openthread/thread.h>
+#include <openthread/thread_ftd.h>
+#include <openthread/platform/alarm-milli.h>
+
+static otInstance *mp_instance;
+static router_policy_state m_state;
+static router_policy_params m_defaults;
+static uint32_t m_last_frames;
+static uint32_t m_last_decision_at;
+static bool m_dense = false;
+
+static void neighbours_count(void)
+{
+	otNeighborInfoIterator iterator = OT_NEIGHBOR_INFO_ITERATOR_INIT;
+	otNeighborInfo info;
+
+	m_state.neighbours = 0;
+	m_state.children = 0;
+
+	while (otThreadGetNextNeighborInfo(mp_instance, &iterator, &info) == OT_ERROR_NONE) {
+		if (m_state.neighbours < UINT8_MAX)
+			m_state.neighbours++;
+		if (info.mIsChild && m_state.children < UINT8_MAX)
+			m_state.children++;
+	}
+}
+
+static void routers_count(void)
+{
+	uint16_t own_rloc16 = otThreadGetRloc16(mp_instance);
+	otRouterInfo info;
+
+	m_state.routers = 0;
+	m_state.partition_routers = 0;
+
+	for (uint16_t id = 0; id <= otThreadGetMaxRouterId(mp_instance); id++) {
+		if (otThreadGetRouterInfo(mp_instance, id, &info) != OT_ERROR_NONE || !info.mAllocated)
+			continue;
+
+		m_state.partition_routers++;
+		if (info.mRloc16 != own_rloc16 && info.mLinkQualityIn >= ROUTER_POLICY_LINK_QUALITY_MIN)
+			m_state.routers++;
+	}
+}
+
+static uint32_t frames_get(void)
+{
+	const otMacCounters *p_counters = otLinkGetCounters(mp_instance);
+	return p_counters->mTxTotal + p_counters->mRxTotal;
+}
+
+static void decision_apply(router_policy_decision_t decision)
+{
+	router_policy_params params;
+	router_policy_params_get(decision, &m_defaults, &params);
+
+	m_state.decision = decision;
+
+	if (params.upgrade_threshold != m_state.upgrade_threshold) {
+		m_state.upgrade_threshold = params.upgrade_threshold;
+		otThreadSetRouterUpgradeThreshold(mp_instance, params.upgrade_threshold);
+	}
+	if (params.downgrade_threshold != m_state.downgrade_threshold) {
+		m_state.downgrade_threshold = params.downgrade_threshold;
+		otThreadSetRouterDowngradeThreshold(mp_instance, params.downgrade_threshold);
+	}
+	if (params.jitter != m_state.jitter) {
+		m_state.jitter = params.jitter;
+		otThreadSetRouterSelectionJitter(mp_instance, params.jitter);
+	}
+}
+
+void thread_router_policy_init(otInstance *p_instance)
+{
+	mp_instance = p_instance;
+
+	memset(&m_state, 0, sizeof(m_state));
+	m_state.decision = ROUTER_POLICY_NONE;
+	m_state.upgrade_threshold = otThreadGetRouterUpgradeThreshold(p_instance);
+	m_state.downgrade_threshold = otThreadGetRouterDowngradeThreshold(p_instance);
+	m_state.jitter = otThreadGetRouterSelectionJitter(p_instance);
+
+	m_defaults.upgrade_threshold = m_state.upgrade_threshold;
+	m_defaults.downgrade_threshold = m_state.downgrade_threshold;
+	m_defaults.jitter = m_state.jitter;
+
+	m_dense = false;
+	m_last_frames = frames_get();
+	m_last_decision_at = otPlatAlarmMilliGetNow();
+}
+
+void thread_router_policy_process(uint32_t time_now)
+{
+	if (time_now - m_last_decision_at < ROUTER_POLICY_INTERVAL)
+		return;
+	m_last_decision_at = time_now;
+
+	uint32_t frames = frames_get();
+	m_state.frames = frames - m_last_frames;
+	m_last_frames = frames;
+
+	neighbours_count();
+	routers_count();
+
+	// a sleepy node never routes, a detached one has no routers to judge the area by; both go back to the
+	// OpenThread defaults, so a node that reattaches does not keep the values of its old area
+	otDeviceRole role = otThreadGetDeviceRole(mp_instance);
+	if (!otThreadGetLinkMode(mp_instance).mRxOnWhenIdle || role == OT_DEVICE_ROLE_DISABLED || role == OT_DEVICE_ROLE_DETACHED) {
+		m_dense = false;
+		decision_apply(ROUTER_POLICY_NONE);
+		return;
+	}
+
+	decision_apply(router_policy_decide(&m_dense, m_state.routers, m_state.children, m_state.frames));
+}
+
+const router_policy_state *thread_router_policy_state_get(void)
+{
+	return &m_state;
+}
@@ -0,0 +1,37 @@
+#ifndef THREAD_ROUTER_POLICY_H__
+#define THREAD_ROUTER_POLICY_H__
+
+#include <stdint.h>
+#include <openthread/instance.h>
+
+#include "router_policy.h"
+
+/**@brief Router selection policy: keeps the number of routers bounded where many dimmers are in range.
+ *
+ * @details Once per ROUTER_POLICY_INTERVAL the router table and the MAC frame counters are sampled and
+ *          router_policy_decide() picks the thresholds and jitter. The router table is used rather than the
+ *          neighbour table because the nodes that decide are mostly router-eligible children, whose neighbour
+ *          table holds their parent only; they keep the incoming link quality of every router they hear.
+ */
+
+typedef struct router_policy_state
+{
+	router_policy_decision_t decision;
+	uint8_t neighbours;         // all neighbours, children included
+	uint8_t routers;            // routers heard with a good incoming link
+	uint8_t partition_routers;  // allocated router IDs of the partition
+	uint8_t children;
+	uint32_t frames;            // frames sent and received during the last interval
+	uint8_t upgrade_threshold;
+	uint8_t downgrade_threshold;
+	uint8_t jitter;             // seconds
+} router_policy_state;
+
+void thread_router_policy_init(otInstance *p_instance);
+
+/**@brief Takes a decision when one is due, called from the subscription timer. */
+void thread_router_policy_process(uint32_t time_now);
+
+const router_policy_state *thread_router_policy_state_get(void);
+
+#endif /* THREAD_ROUTER_POLICY_H__ */
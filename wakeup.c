@@ -0,0 +1,148 @@
+#include "wakeup.h"
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "hal.h"
+#include "settings.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct wakeup_entry
+{
+	wakeup_handler_t handler; // NULL until started
+	uint32_t period;
+	uint32_t due_at;
+	bool kicked;
+	uint32_t count;
+} wakeup_entry;
+
+APP_TIMER_DEF(m_wakeup_timer);
+
+static wakeup_entry m_entries[WAKEUP_SOURCES];
+static uint32_t m_timer_count = 0;
+static bool m_running = false;
+
+static void wakeup_schedule(uint32_t time_now)
+{
+	bool active = false;
+	int32_t delay = INT32_MAX;
+
+	for (int i = 0; i < WAKEUP_SOURCES; i++) {
+		wakeup_entry *p_entry = &m_entries[i];
+		if (p_entry->handler == NULL)
+			continue;
+
+		active = true;
+		int32_t entry_delay = p_entry->kicked ? 0 : (int32_t)(p_entry->due_at + (p_entry->period >> WAKEUP_TOLERANCE_SHIFT) - time_now);
+		if (entry_delay < delay)
+			delay = entry_delay;
+	}
+
+	ret_code_t err_code = app_timer_stop(m_wakeup_timer);
+	APP_ERROR_CHECK(err_code);
+
+	if (!active)
+		return;
+
+	uint32_t ticks = delay > 0 ? APP_TIMER_TICKS(delay) : 0;
+	if (ticks < APP_TIMER_MIN_TIMEOUT_TICKS)
+		ticks = APP_TIMER_MIN_TIMEOUT_TICKS;
+
+	err_code = app_timer_start(m_wakeup_timer, ticks, NULL);
+	APP_ERROR_CHECK(err_code);
+}
+
+static void wakeup_timer_handler(void *p_context)
+{
+	UNUSED_PARAMETER(p_context);
+
+	m_timer_count++;
+	m_running = true;
+
+	for (int i = 0; i < WAKEUP_SOURCES; i++) {
+		wakeup_entry *p_entry = &m_entries[i];
+		uint32_t time_now = hal_clock_now();
+		if (p_entry->handler == NULL)
+			continue;
+		if (!p_entry->kicked && (int32_t)(time_now - p_entry->due_at) < 0)
+			continue;
+
+		// the period holds its phase, a source that fell a whole period behind starts over from now
+		p_entry->due_at += p_entry->period;
+		if (p_entry->kicked || (int32_t)(time_now - p_entry->due_at) >= 0)
+			p_entry->due_at = time_now + p_entry->period;
+		p_entry->kicked = false;
+		p_entry->count++;
+
+		p_entry->handler(NULL);
+	}
+
+	m_running = false;
+	wakeup_schedule(hal_clock_now());
+}
+
+void wakeup_init(void)
+{
+	for (int i = 0; i < WAKEUP_SOURCES; i++) {
+		m_entries[i].handler = NULL;
+		m_entries[i].kicked = false;
+		m_entries[i].count = 0;
+	}
+
+	ret_code_t err_code = app_timer_create(&m_wakeup_timer, APP_TIMER_MODE_SINGLE_SHOT, wakeup_timer_handler);
+	APP_ERROR_CHECK(err_code);
+}
+
+void wakeup_start(wakeup_source_t source, wakeup_handler_t handler, uint32_t period)
+{
+	uint32_t time_now = hal_clock_now();
+	wakeup_entry *p_entry = &m_entries[source];
+
+	p_entry->handler = handler;
+	p_entry->period = period;
+	p_entry->due_at = time_now + period;
+	p_entry->kicked = false;
+
+	if (!m_running)
+		wakeup_schedule(time_now);
+}
+
+void wakeup_period_set(wakeup_source_t source, uint32_t period)
+{
+	uint32_t time_now = hal_clock_now();
+	wakeup_entry *p_entry = &m_entries[source];
+
+	if (p_entry->handler == NULL || p_entry->period == period)
+		return;
+
+	p_entry->period = period;
+	p_entry->due_at = time_now + period;
+
+	// a handler changing a period is picked up when the timer handler reschedules
+	if (!m_running)
+		wakeup_schedule(time_now);
+}
+
+void wakeup_kick(wakeup_source_t source)
+{
+	wakeup_entry *p_entry = &m_entries[source];
+
+	if (p_entry->handler == NULL || p_entry->kicked)
+		return;
+
+	p_entry->kicked = true;
+
+	if (!m_running)
+		wakeup_schedule(hal_clock_now());
+}
+
+uint32_t wakeup_count_get(wakeup_source_t source)
+{
+	return m_entries[source].count;
+}
+
+uint32_t wakeup_timer_count_get(void)
+{
+	return m_timer_count;
+}
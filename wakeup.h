@@ -0,0 +1,42 @@
+#ifndef WAKEUP_H__
+#define WAKEUP_H__
+
+#include <stdint.h>
+
+/**@brief Periodic work of the application on one single-shot app_timer.
+ *
+ * @details Each source has a period and may run up to period >> WAKEUP_TOLERANCE_SHIFT late. The timer
+ *          fires at the earliest such deadline and runs every source that is due by then, so sources
+ *          with close deadlines share one CPU wakeup. Handlers run from the app_timer scheduler event,
+ *          like the timers they replace.
+ */
+
+typedef enum
+{
+	WAKEUP_VOLTAGE,
+	WAKEUP_TEMPERATURE,
+	WAKEUP_PSU_CONTROL,
+	WAKEUP_SUBSCRIPTION,
+	WAKEUP_SOURCES
+} wakeup_source_t;
+
+typedef void (*wakeup_handler_t)(void *p_context);
+
+void wakeup_init(void);
+
+/**@brief Runs the handler every period milliseconds, the first time one period from now. */
+void wakeup_start(wakeup_source_t source, wakeup_handler_t handler, uint32_t period);
+
+/**@brief Changes the period of a started source, the next run is one new period from now. */
+void wakeup_period_set(wakeup_source_t source, uint32_t period);
+
+/**@brief Runs the source as soon as possible, then on its period again. */
+void wakeup_kick(wakeup_source_t source);
+
+/**@brief Handler runs of a source since boot. */
+uint32_t wakeup_count_get(wakeup_source_t source);
+
+/**@brief Timer expiries since boot, one expiry runs all the sources that are due. */
+uint32_t wakeup_timer_count_get(void);
+
+#endif /* WAKEUP_H__ */